@@ -15,9 +15,11 @@
 // Defines TimeSeriesFramerCalculator.
 #include <math.h>
 
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "Eigen/Core"
 #include "audio/dsp/window_functions.h"
@@ -64,6 +66,10 @@ namespace mediapipe {
 // done by adopting the timestamp of the first sample of the packet and this
 // sample's timestamp is inferred by initial_input_timestamp_ +
 // cumulative_completed_samples / sample_rate_.
+//
+// Buffered samples are kept in a single ring buffer Matrix with one column per
+// sample, so output frames are assembled with at most two block copies and
+// no per-sample allocations.
 class TimeSeriesFramerCalculator : public CalculatorBase {
  public:
   static ::mediapipe::Status GetContract(CalculatorContract* cc) {
@@ -93,6 +99,17 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
   // Constructs and emits framed output packets.
   void FrameOutput(CalculatorContext* cc);
 
+  // Appends the columns of `samples` to the ring buffer, growing it if needed.
+  void AppendToBuffer(const Matrix& samples);
+  // Copies `num_samples` buffered samples, starting `offset` samples after the
+  // oldest one, into the first columns of `output`.
+  void CopyFromBuffer(int offset, int num_samples, Matrix* output) const;
+  // Discards the `num_samples` oldest buffered samples.
+  void DropFromBuffer(int num_samples);
+  // Returns the timestamp of the buffered sample `offset` samples after the
+  // oldest one, based on the timestamp of the input packet it came from.
+  Timestamp BufferedSampleTimestamp(int offset) const;
+
   Timestamp CurrentOutputTimestamp() {
     if (use_local_timestamp_) {
       return current_timestamp_;
@@ -109,7 +126,7 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
   // Returns the timestamp of a sample on a base, which is usually the time
   // stamp of a packet.
   Timestamp CurrentSampleTimestamp(const Timestamp& timestamp_base,
-                                   int64 number_of_samples) {
+                                   int64 number_of_samples) const {
     return timestamp_base + round(number_of_samples / sample_rate_ *
                                   Timestamp::kTimestampUnitsPerSecond);
   }
@@ -145,9 +162,15 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
   Timestamp current_timestamp_;
   int num_channels_;
 
-  // Each entry in this deque consists of a single sample, i.e. a
-  // single column vector, and its timestamp.
-  std::deque<std::pair<Matrix, Timestamp>> sample_buffer_;
+  // Ring buffer of samples, one column per sample. The oldest sample is in
+  // column buffer_start_, and buffer_size_ columns are in use.
+  Matrix sample_buffer_;
+  int buffer_start_;
+  int buffer_size_;
+  // The index of the first sample and the timestamp of every input packet
+  // that still has samples in the buffer, oldest first. Sample indices count
+  // all input samples since the start of the stream.
+  std::deque<std::pair<int64, Timestamp>> packet_starts_;
 
   bool use_window_;
   Matrix window_;
@@ -158,40 +181,80 @@ REGISTER_CALCULATOR(TimeSeriesFramerCalculator);
 
 void TimeSeriesFramerCalculator::EnqueueInput(CalculatorContext* cc) {
   const Matrix& input_frame = cc->Inputs().Index(0).Get<Matrix>();
+  if (input_frame.cols() == 0) return;
+
+  packet_starts_.emplace_back(cumulative_input_samples_, cc->InputTimestamp());
+  AppendToBuffer(input_frame);
+  cumulative_input_samples_ += input_frame.cols();
+}
 
-  for (int i = 0; i < input_frame.cols(); ++i) {
-    sample_buffer_.emplace_back(std::make_pair(
-        input_frame.col(i), CurrentSampleTimestamp(cc->InputTimestamp(), i)));
+void TimeSeriesFramerCalculator::AppendToBuffer(const Matrix& samples) {
+  const int num_samples = samples.cols();
+  const int capacity = sample_buffer_.cols();
+  if (buffer_size_ + num_samples > capacity) {
+    // Grow geometrically and move the buffered samples to the front.
+    Matrix grown(num_channels_,
+                 std::max(2 * capacity, buffer_size_ + num_samples));
+    CopyFromBuffer(0, buffer_size_, &grown);
+    sample_buffer_.swap(grown);
+    buffer_start_ = 0;
   }
+  const int end = (buffer_start_ + buffer_size_) % sample_buffer_.cols();
+  const int first_part =
+      std::min<int>(num_samples, sample_buffer_.cols() - end);
+  sample_buffer_.middleCols(end, first_part) = samples.leftCols(first_part);
+  sample_buffer_.leftCols(num_samples - first_part) =
+      samples.rightCols(num_samples - first_part);
+  buffer_size_ += num_samples;
+}
 
-  cumulative_input_samples_ += input_frame.cols();
+void TimeSeriesFramerCalculator::CopyFromBuffer(int offset, int num_samples,
+                                                Matrix* output) const {
+  if (num_samples == 0) return;
+  const int capacity = sample_buffer_.cols();
+  const int begin = (buffer_start_ + offset) % capacity;
+  const int first_part = std::min(num_samples, capacity - begin);
+  output->leftCols(first_part) = sample_buffer_.middleCols(begin, first_part);
+  output->middleCols(first_part, num_samples - first_part) =
+      sample_buffer_.leftCols(num_samples - first_part);
+}
+
+void TimeSeriesFramerCalculator::DropFromBuffer(int num_samples) {
+  buffer_start_ = (buffer_start_ + num_samples) % sample_buffer_.cols();
+  buffer_size_ -= num_samples;
+  const int64 first_buffered_sample = cumulative_input_samples_ - buffer_size_;
+  while (packet_starts_.size() > 1 &&
+         packet_starts_[1].first <= first_buffered_sample) {
+    packet_starts_.pop_front();
+  }
+}
+
+Timestamp TimeSeriesFramerCalculator::BufferedSampleTimestamp(
+    int offset) const {
+  const int64 sample = cumulative_input_samples_ - buffer_size_ + offset;
+  auto packet = std::upper_bound(
+      packet_starts_.begin(), packet_starts_.end(), sample,
+      [](int64 index, const std::pair<int64, Timestamp>& packet_start) {
+        return index < packet_start.first;
+      });
+  --packet;
+  return CurrentSampleTimestamp(packet->second, sample - packet->first);
 }
 
 void TimeSeriesFramerCalculator::FrameOutput(CalculatorContext* cc) {
-  while (sample_buffer_.size() >=
-         frame_duration_samples_ + samples_still_to_drop_) {
-    while (samples_still_to_drop_ > 0) {
-      sample_buffer_.pop_front();
-      --samples_still_to_drop_;
-    }
+  while (buffer_size_ >= frame_duration_samples_ + samples_still_to_drop_) {
+    DropFromBuffer(samples_still_to_drop_);
+    samples_still_to_drop_ = 0;
     const int frame_step_samples = next_frame_step_samples();
     std::unique_ptr<Matrix> output_frame(
         new Matrix(num_channels_, frame_duration_samples_));
-    for (int i = 0; i < std::min(frame_step_samples, frame_duration_samples_);
-         ++i) {
-      output_frame->col(i) = sample_buffer_.front().first;
-      current_timestamp_ = sample_buffer_.front().second;
-      sample_buffer_.pop_front();
-    }
-    const int frame_overlap_samples =
-        frame_duration_samples_ - frame_step_samples;
-    if (frame_overlap_samples > 0) {
-      for (int i = 0; i < frame_overlap_samples; ++i) {
-        output_frame->col(i + frame_step_samples) = sample_buffer_[i].first;
-        current_timestamp_ = sample_buffer_[i].second;
-      }
+    CopyFromBuffer(0, frame_duration_samples_, output_frame.get());
+    current_timestamp_ = BufferedSampleTimestamp(frame_duration_samples_ - 1);
+    if (frame_step_samples <= frame_duration_samples_) {
+      DropFromBuffer(frame_step_samples);
     } else {
-      samples_still_to_drop_ = -frame_overlap_samples;
+      DropFromBuffer(frame_duration_samples_);
+      samples_still_to_drop_ = frame_step_samples - frame_duration_samples_;
     }
 
     if (use_window_) {
@@ -218,17 +281,14 @@ void TimeSeriesFramerCalculator::FrameOutput(CalculatorContext* cc) {
 }
 
 ::mediapipe::Status TimeSeriesFramerCalculator::Close(CalculatorContext* cc) {
-  while (samples_still_to_drop_ > 0 && !sample_buffer_.empty()) {
-    sample_buffer_.pop_front();
-    --samples_still_to_drop_;
-  }
-  if (!sample_buffer_.empty() && pad_final_packet_) {
+  const int samples_to_drop = std::min(samples_still_to_drop_, buffer_size_);
+  DropFromBuffer(samples_to_drop);
+  samples_still_to_drop_ -= samples_to_drop;
+  if (buffer_size_ > 0 && pad_final_packet_) {
     std::unique_ptr<Matrix> output_frame(new Matrix);
     output_frame->setZero(num_channels_, frame_duration_samples_);
-    for (int i = 0; i < sample_buffer_.size(); ++i) {
-      output_frame->col(i) = sample_buffer_[i].first;
-      current_timestamp_ = sample_buffer_[i].second;
-    }
+    CopyFromBuffer(0, buffer_size_, output_frame.get());
+    current_timestamp_ = BufferedSampleTimestamp(buffer_size_ - 1);
 
     cc->Outputs().Index(0).Add(output_frame.release(),
                                CurrentOutputTimestamp());
@@ -289,6 +349,12 @@ void TimeSeriesFramerCalculator::FrameOutput(CalculatorContext* cc) {
   cumulative_input_samples_ = 0;
   cumulative_output_frames_ = 0;
   samples_still_to_drop_ = 0;
+  // Start with room for a few frames; the buffer grows if the input packets
+  // are larger.
+  sample_buffer_.resize(num_channels_, 2 * frame_duration_samples_);
+  buffer_start_ = 0;
+  buffer_size_ = 0;
+  packet_starts_.clear();
   initial_input_timestamp_ = Timestamp::Unstarted();
   current_timestamp_ = Timestamp::Unstarted();
 
@@ -82,11 +82,15 @@ class TimeSeriesFramerCalculatorTest
   void InitializeInput() {
     concatenated_input_samples_.resize(0, num_input_channels_);
     num_input_samples_ = 0;
-    for (int i = 0; i < 10; ++i) {
+    if (input_packet_sizes_.empty()) {
       // This range of packet sizes was chosen such that some input
       // packets will be smaller than the output packet size and other
       // input packets will be larger.
-      int packet_size = (i + 1) * 20;
+      for (int i = 0; i < 10; ++i) {
+        input_packet_sizes_.push_back((i + 1) * 20);
+      }
+    }
+    for (int packet_size : input_packet_sizes_) {
       double timestamp_seconds = kInitialTimestampOffsetMicroseconds * 1.0e-6 +
                                  num_input_samples_ / input_sample_rate_;
 
@@ -221,6 +225,9 @@ class TimeSeriesFramerCalculatorTest
     }
   }
 
+  // The number of samples of each input packet. Defaults to 20, 40, ...,
+  // 200 if empty.
+  std::vector<int> input_packet_sizes_;
   int num_input_samples_;
   Matrix concatenated_input_samples_;
   Matrix window_;
@@ -334,6 +341,37 @@ TEST_F(TimeSeriesFramerCalculatorTest, NoFinalPacketPadding) {
   CheckOutput();
 }
 
+TEST_F(TimeSeriesFramerCalculatorTest, SmallPacketsWrapAroundSampleBuffer) {
+  // The sample buffer starts with room for two frames, 60 samples. Packets
+  // of 7 samples never fill it, while each frame step of 11 samples moves its
+  // start, so the buffer wraps around about every 6 frames and frames are
+  // often copied from both ends of it.
+  options_.set_frame_duration_seconds(30 / input_sample_rate_);
+  options_.set_frame_overlap_seconds(19 / input_sample_rate_);
+  input_packet_sizes_.assign(150, 7);
+  MP_ASSERT_OK(Run());
+  // ceil((1050 - 30) / 11) + 1 = 94 packets.
+  EXPECT_EQ(output().packets.size(), 94);
+  CheckOutput();
+}
+
+TEST_F(TimeSeriesFramerCalculatorTest, LargePacketGrowsWrappedSampleBuffer) {
+  // After 19 packets of 7 samples, the 23 buffered samples of the 60-sample
+  // buffer start at column 50 and wrap around. The next packet of 200
+  // samples does not fit, so the buffer grows while its samples are split
+  // between its two ends. Further small packets wrap the grown buffer
+  // around again.
+  options_.set_frame_duration_seconds(30 / input_sample_rate_);
+  options_.set_frame_overlap_seconds(19 / input_sample_rate_);
+  input_packet_sizes_.assign(19, 7);
+  input_packet_sizes_.push_back(200);
+  input_packet_sizes_.insert(input_packet_sizes_.end(), 100, 7);
+  MP_ASSERT_OK(Run());
+  // ceil((1033 - 30) / 11) + 1 = 93 packets.
+  EXPECT_EQ(output().packets.size(), 93);
+  CheckOutput();
+}
+
 TEST_F(TimeSeriesFramerCalculatorTest,
        FrameRateHigherThanSampleRate_FrameDurationTooLow) {
   // Try to produce a frame rate 10 times the input sample rate by using a
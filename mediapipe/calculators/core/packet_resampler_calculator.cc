@@ -12,14 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "mediapipe/calculators/core/packet_resampler_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/collection_item_id.h"
+#include "mediapipe/framework/counter.h"
 #include "mediapipe/framework/deps/mathutil.h"
 #include "mediapipe/framework/deps/random_base.h"
 #include "mediapipe/framework/formats/video_stream_header.h"
@@ -55,6 +59,17 @@ namespace mediapipe {
 // The data stream may be either specified as the only stream (by index)
 // or as the stream with tag "DATA".
 //
+// Several synchronized streams can be resampled by one node by specifying
+// them as "DATA:0", "DATA:1", ..., with as many "DATA" output streams. All
+// streams share one output timeline, aligned with the first packet on any
+// stream, and each output timestamp is resolved by the first input timestamp
+// at or after it: streams that have a packet at that timestamp output
+// whichever of it and their previous packet is closer, the other streams
+// repeat their previous packet. Jitter is not supported with several
+// streams. For each stream i, the counters "Dropped DATA:i" and
+// "Duplicated DATA:i" count the input packets that were never output and
+// the outputs that repeat an already output packet.
+//
 // The input and output streams may be accompanied by a VIDEO_HEADER
 // stream.  This stream includes a VideoHeader at Timestamp::PreStream().
 // The input VideoHeader on the VIDEO_HEADER stream will always be updated
@@ -74,12 +89,30 @@ class PacketResamplerCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
 
  private:
+  // The state of one of several resampled "DATA" streams.
+  struct StreamState {
+    CollectionItemId input_id;
+    CollectionItemId output_id;
+    // The last packet that was received on the stream.
+    Packet last_packet;
+    // Whether last_packet has been output at least once.
+    bool last_packet_sent = false;
+    Counter* dropped = nullptr;
+    Counter* duplicated = nullptr;
+  };
+
   // Logic for Process() when jitter_ != 0.0.
   ::mediapipe::Status ProcessWithJitter(CalculatorContext* cc);
 
   // Logic for Process() when jitter_ == 0.0.
   ::mediapipe::Status ProcessWithoutJitter(CalculatorContext* cc);
 
+  // Logic for Process() when resampling several "DATA" streams.
+  ::mediapipe::Status ProcessMultipleStreams(CalculatorContext* cc);
+
+  // Initializes first_timestamp_ from the first received packet.
+  void InitializeFirstTimestamp(CalculatorContext* cc);
+
   // Given the current count of periods that have passed, this returns
   // the next valid timestamp of the middle point of the next period:
   //    if count is 0, it returns the first_timestamp_.
@@ -103,6 +136,10 @@ class PacketResamplerCalculator : public CalculatorBase {
   // Outputs a packet if it is in range (start_time_, end_time_).
   void OutputWithinLimits(CalculatorContext* cc, const Packet& packet) const;
 
+  // Returns true if a packet at `timestamp` is in range (start_time_,
+  // end_time_).
+  bool IsWithinLimits(Timestamp timestamp) const;
+
   // The timestamp of the first packet received.
   Timestamp first_timestamp_;
 
@@ -149,6 +186,14 @@ class PacketResamplerCalculator : public CalculatorBase {
   // are included in the output, even if the nearest timestamp is not
   // between start_time and end_time.
   bool round_limits_;
+
+  // Outputs the last packet of `stream` at `timestamp`, if it has one.
+  void OutputLastPacket(CalculatorContext* cc, Timestamp timestamp,
+                        StreamState* stream) const;
+
+  // Set if there are several "DATA" streams, in which case input_data_id_
+  // and output_data_id_ refer to the first of them.
+  std::vector<StreamState> streams_;
 };
 
 REGISTER_CALCULATOR(PacketResamplerCalculator);
@@ -169,6 +214,17 @@ TimestampDiff TimestampDiffFromSeconds(double seconds) {
   if (cc->InputSidePackets().HasTag("OPTIONS")) {
     cc->InputSidePackets().Tag("OPTIONS").Set<CalculatorOptions>();
   }
+  const int num_data_streams = cc->Inputs().NumEntries("DATA");
+  if (num_data_streams > 1) {
+    RET_CHECK_EQ(num_data_streams, cc->Outputs().NumEntries("DATA"))
+        << "Each DATA input stream needs a DATA output stream.";
+    RET_CHECK_EQ(resampler_options.jitter(), 0.0)
+        << "Jitter is not supported with several DATA streams.";
+    for (int i = 1; i < num_data_streams; ++i) {
+      cc->Inputs().Get("DATA", i).SetAny();
+      cc->Outputs().Get("DATA", i).SetSameAs(&cc->Inputs().Get("DATA", i));
+    }
+  }
   CollectionItemId input_data_id = cc->Inputs().GetId("DATA", 0);
   if (!input_data_id.IsValid()) {
     input_data_id = cc->Inputs().GetId("", 0);
@@ -235,21 +291,39 @@ TimestampDiff TimestampDiffFromSeconds(double seconds) {
   frame_time_usec_ = static_cast<int64>(1000000.0 / frame_rate_);
   video_header_.frame_rate = frame_rate_;
 
-  if (resampler_options.output_header() !=
-          PacketResamplerCalculatorOptions::NONE &&
-      !cc->Inputs().Get(input_data_id_).Header().IsEmpty()) {
+  if (cc->Inputs().NumEntries("DATA") > 1) {
+    streams_.resize(cc->Inputs().NumEntries("DATA"));
+    for (int i = 0; i < streams_.size(); ++i) {
+      streams_[i].input_id = cc->Inputs().GetId("DATA", i);
+      streams_[i].output_id = cc->Outputs().GetId("DATA", i);
+      streams_[i].dropped = cc->GetCounter(absl::StrCat("Dropped DATA:", i));
+      streams_[i].duplicated =
+          cc->GetCounter(absl::StrCat("Duplicated DATA:", i));
+    }
+  }
+  std::vector<std::pair<CollectionItemId, CollectionItemId>> data_streams;
+  if (streams_.empty()) {
+    data_streams.emplace_back(input_data_id_, output_data_id_);
+  }
+  for (const StreamState& stream : streams_) {
+    data_streams.emplace_back(stream.input_id, stream.output_id);
+  }
+  for (const auto& data_stream : data_streams) {
+    const Packet& header = cc->Inputs().Get(data_stream.first).Header();
+    if (resampler_options.output_header() ==
+            PacketResamplerCalculatorOptions::NONE ||
+        header.IsEmpty()) {
+      continue;
+    }
     if (resampler_options.output_header() ==
         PacketResamplerCalculatorOptions::UPDATE_VIDEO_HEADER) {
-      video_header_ =
-          cc->Inputs().Get(input_data_id_).Header().Get<VideoHeader>();
+      video_header_ = header.Get<VideoHeader>();
       video_header_.frame_rate = frame_rate_;
       cc->Outputs()
-          .Get(output_data_id_)
+          .Get(data_stream.second)
           .SetHeader(Adopt(new VideoHeader(video_header_)));
     } else {
-      cc->Outputs()
-          .Get(output_data_id_)
-          .SetHeader(cc->Inputs().Get(input_data_id_).Header());
+      cc->Outputs().Get(data_stream.second).SetHeader(header);
     }
   }
 
@@ -282,10 +356,17 @@ TimestampDiff TimestampDiffFromSeconds(double seconds) {
       !cc->Inputs().Tag("VIDEO_HEADER").IsEmpty()) {
     video_header_ = cc->Inputs().Tag("VIDEO_HEADER").Get<VideoHeader>();
     video_header_.frame_rate = frame_rate_;
-    if (cc->Inputs().Get(input_data_id_).IsEmpty()) {
+    bool data_is_empty = cc->Inputs().Get(input_data_id_).IsEmpty();
+    for (const StreamState& stream : streams_) {
+      data_is_empty &= cc->Inputs().Get(stream.input_id).IsEmpty();
+    }
+    if (data_is_empty) {
       return ::mediapipe::OkStatus();
     }
   }
+  if (!streams_.empty()) {
+    return ProcessMultipleStreams(cc);
+  }
   if (jitter_ != 0.0 && random_ != nullptr) {
     MP_RETURN_IF_ERROR(ProcessWithJitter(cc));
   } else {
@@ -334,23 +415,7 @@ TimestampDiff TimestampDiffFromSeconds(double seconds) {
   RET_CHECK_EQ(jitter_, 0.0);
 
   if (first_timestamp_ == Timestamp::Unset()) {
-    // This is the first packet, initialize the first_timestamp_.
-    if (base_timestamp_ == Timestamp::Unset()) {
-      // Initialize first_timestamp_ with exactly the first packet timestamp.
-      first_timestamp_ = cc->InputTimestamp();
-    } else {
-      // Initialize first_timestamp_ with the first packet timestamp
-      // aligned to the base_timestamp_.
-      int64 first_index = MathUtil::SafeRound<int64, double>(
-          (cc->InputTimestamp() - base_timestamp_).Seconds() * frame_rate_);
-      first_timestamp_ =
-          base_timestamp_ + TimestampDiffFromSeconds(first_index / frame_rate_);
-    }
-    if (cc->Outputs().UsesTags() && cc->Outputs().HasTag("VIDEO_HEADER")) {
-      cc->Outputs()
-          .Tag("VIDEO_HEADER")
-          .Add(new VideoHeader(video_header_), Timestamp::PreStream());
-    }
+    InitializeFirstTimestamp(cc);
   }
   const Timestamp received_timestamp = cc->InputTimestamp();
   const int64 received_timestamp_idx =
@@ -394,12 +459,105 @@ TimestampDiff TimestampDiffFromSeconds(double seconds) {
   return ::mediapipe::OkStatus();
 }
 
+::mediapipe::Status PacketResamplerCalculator::ProcessMultipleStreams(
+    CalculatorContext* cc) {
+  RET_CHECK_GT(cc->InputTimestamp(), Timestamp::PreStream());
+
+  if (first_timestamp_ == Timestamp::Unset()) {
+    InitializeFirstTimestamp(cc);
+  }
+  const Timestamp received_timestamp = cc->InputTimestamp();
+  const int64 received_timestamp_idx =
+      TimestampToPeriodIndex(received_timestamp);
+  const bool advance = received_timestamp_idx >= period_count_;
+  const Timestamp target_timestamp =
+      PeriodIndexToTimestamp(std::max(received_timestamp_idx, period_count_));
+  // Same as ProcessWithoutJitter(), for each stream in turn.
+  for (StreamState& stream : streams_) {
+    const Packet& packet = cc->Inputs().Get(stream.input_id).Value();
+    bool packet_sent = false;
+    if (advance) {
+      for (int64 index = period_count_; index < received_timestamp_idx;
+           ++index) {
+        OutputLastPacket(cc, PeriodIndexToTimestamp(index), &stream);
+      }
+      if (received_timestamp >= target_timestamp) {
+        const bool have_last_packet = !stream.last_packet.IsEmpty();
+        if (!packet.IsEmpty() &&
+            (!have_last_packet ||
+             received_timestamp - target_timestamp <=
+                 target_timestamp - stream.last_packet.Timestamp())) {
+          if (IsWithinLimits(target_timestamp)) {
+            cc->Outputs()
+                .Get(stream.output_id)
+                .AddPacket(packet.At(target_timestamp));
+          }
+          packet_sent = true;
+        } else {
+          OutputLastPacket(cc, target_timestamp, &stream);
+        }
+      }
+    }
+    if (!packet.IsEmpty()) {
+      if (!stream.last_packet.IsEmpty() && !stream.last_packet_sent) {
+        stream.dropped->Increment();
+      }
+      stream.last_packet = packet;
+      stream.last_packet_sent = packet_sent;
+    }
+  }
+  if (advance) {
+    period_count_ = received_timestamp_idx;
+    if (received_timestamp >= target_timestamp) ++period_count_;
+    for (const StreamState& stream : streams_) {
+      cc->Outputs()
+          .Get(stream.output_id)
+          .SetNextTimestampBound(PeriodIndexToTimestamp(period_count_));
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+void PacketResamplerCalculator::InitializeFirstTimestamp(
+    CalculatorContext* cc) {
+  // This is the first packet, initialize the first_timestamp_.
+  if (base_timestamp_ == Timestamp::Unset()) {
+    // Initialize first_timestamp_ with exactly the first packet timestamp.
+    first_timestamp_ = cc->InputTimestamp();
+  } else {
+    // Initialize first_timestamp_ with the first packet timestamp
+    // aligned to the base_timestamp_.
+    int64 first_index = MathUtil::SafeRound<int64, double>(
+        (cc->InputTimestamp() - base_timestamp_).Seconds() * frame_rate_);
+    first_timestamp_ =
+        base_timestamp_ + TimestampDiffFromSeconds(first_index / frame_rate_);
+  }
+  if (cc->Outputs().UsesTags() && cc->Outputs().HasTag("VIDEO_HEADER")) {
+    cc->Outputs()
+        .Tag("VIDEO_HEADER")
+        .Add(new VideoHeader(video_header_), Timestamp::PreStream());
+  }
+}
+
 ::mediapipe::Status PacketResamplerCalculator::Close(CalculatorContext* cc) {
   if (!cc->GraphStatus().ok()) {
     return ::mediapipe::OkStatus();
   }
   // Emit the last packet received if we have at least one packet, but
   // haven't sent anything for its period.
+  for (StreamState& stream : streams_) {
+    if (stream.last_packet.IsEmpty() || stream.last_packet_sent) continue;
+    if (flush_last_packet_ &&
+        TimestampToPeriodIndex(stream.last_packet.Timestamp()) ==
+            period_count_) {
+      OutputLastPacket(cc, PeriodIndexToTimestamp(period_count_), &stream);
+    } else {
+      stream.dropped->Increment();
+    }
+  }
+  if (!streams_.empty()) {
+    return ::mediapipe::OkStatus();
+  }
   if (first_timestamp_ != Timestamp::Unset() && flush_last_packet_ &&
       TimestampToPeriodIndex(last_packet_.Timestamp()) == period_count_) {
     OutputWithinLimits(cc,
@@ -424,11 +582,27 @@ int64 PacketResamplerCalculator::TimestampToPeriodIndex(
 
 void PacketResamplerCalculator::OutputWithinLimits(CalculatorContext* cc,
                                                    const Packet& packet) const {
-  TimestampDiff margin((round_limits_) ? frame_time_usec_ / 2 : 0);
-  if (packet.Timestamp() >= start_time_ - margin &&
-      packet.Timestamp() < end_time_ + margin) {
+  if (IsWithinLimits(packet.Timestamp())) {
     cc->Outputs().Get(output_data_id_).AddPacket(packet);
   }
 }
 
+bool PacketResamplerCalculator::IsWithinLimits(Timestamp timestamp) const {
+  TimestampDiff margin((round_limits_) ? frame_time_usec_ / 2 : 0);
+  return timestamp >= start_time_ - margin && timestamp < end_time_ + margin;
+}
+
+void PacketResamplerCalculator::OutputLastPacket(CalculatorContext* cc,
+                                                 Timestamp timestamp,
+                                                 StreamState* stream) const {
+  if (stream->last_packet.IsEmpty()) return;
+  if (stream->last_packet_sent) stream->duplicated->Increment();
+  stream->last_packet_sent = true;
+  if (IsWithinLimits(timestamp)) {
+    cc->Outputs()
+        .Get(stream->output_id)
+        .AddPacket(stream->last_packet.At(timestamp));
+  }
+}
+
 }  // namespace mediapipe
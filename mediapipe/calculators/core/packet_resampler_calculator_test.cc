@@ -14,8 +14,10 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "mediapipe/calculators/core/packet_resampler_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -675,5 +677,76 @@ TEST(PacketResamplerCalculatorTest, OptionsSidePacket) {
   }
 }
 
+TEST(PacketResamplerCalculatorTest, MultipleStreams) {
+  CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(R"(
+    calculator: "PacketResamplerCalculator"
+    input_stream: "DATA:0:camera_0"
+    input_stream: "DATA:1:camera_1"
+    output_stream: "DATA:0:resampled_0"
+    output_stream: "DATA:1:resampled_1"
+    options {
+      [mediapipe.PacketResamplerCalculatorOptions.ext] { frame_rate: 30 }
+    })"));
+  const std::vector<std::vector<int64>> input_timestamps = {
+      {0, 10000, 20000, 33000, 40000, 70000, 101000}, {0, 40000, 100000}};
+  for (int i = 0; i < input_timestamps.size(); ++i) {
+    for (const int64 ts : input_timestamps[i]) {
+      runner.MutableInputs()->Get("DATA", i).packets.push_back(
+          Adopt(new int64(ts)).At(Timestamp(ts)));
+    }
+  }
+  MP_ASSERT_OK(runner.Run());
+
+  // Both streams share the output timeline. Stream 1 has no packet at 70000,
+  // which resolves the output at 66667, so it repeats its packet at 40000.
+  const std::vector<std::vector<std::pair<int64, int64>>> expected_outputs = {
+      {{0, 0}, {33000, 33333}, {70000, 66667}, {70000, 100000}},
+      {{0, 0}, {40000, 33333}, {40000, 66667}, {100000, 100000}}};
+  for (int i = 0; i < expected_outputs.size(); ++i) {
+    const auto& packets = runner.Outputs().Get("DATA", i).packets;
+    ASSERT_EQ(expected_outputs[i].size(), packets.size());
+    for (int j = 0; j < packets.size(); ++j) {
+      EXPECT_EQ(expected_outputs[i][j].first, packets[j].Get<int64>());
+      EXPECT_EQ(Timestamp(expected_outputs[i][j].second),
+                packets[j].Timestamp());
+    }
+  }
+
+  const auto counters = runner.GetCountersValues();
+  auto counter_value = [&counters](const std::string& name) {
+    for (const auto& counter : counters) {
+      if (absl::EndsWith(counter.first, name)) return counter.second;
+    }
+    return int64{-1};
+  };
+  EXPECT_EQ(4, counter_value("Dropped DATA:0"));
+  EXPECT_EQ(1, counter_value("Duplicated DATA:0"));
+  EXPECT_EQ(0, counter_value("Dropped DATA:1"));
+  EXPECT_EQ(1, counter_value("Duplicated DATA:1"));
+}
+
+TEST(PacketResamplerCalculatorTest, MultipleStreamsRejectJitter) {
+  CalculatorGraphConfig config = ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+    input_stream: "camera_0"
+    input_stream: "camera_1"
+    input_side_packet: "seed"
+    node {
+      calculator: "PacketResamplerCalculator"
+      input_stream: "DATA:0:camera_0"
+      input_stream: "DATA:1:camera_1"
+      input_side_packet: "SEED:seed"
+      output_stream: "DATA:0:resampled_0"
+      output_stream: "DATA:1:resampled_1"
+      options {
+        [mediapipe.PacketResamplerCalculatorOptions.ext] {
+          frame_rate: 30
+          jitter: 0.2
+        }
+      }
+    })");
+  CalculatorGraph graph;
+  EXPECT_FALSE(graph.Initialize(config).ok());
+}
+
 }  // namespace
 }  // namespace mediapipe
@@ -15,6 +15,7 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
@@ -73,6 +74,7 @@ class ColorConvertCalculator : public CalculatorBase {
  public:
   ~ColorConvertCalculator() override = default;
   static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
   ::mediapipe::Status Process(CalculatorContext* cc) override;
 
  private:
@@ -85,6 +87,9 @@ class ColorConvertCalculator : public CalculatorBase {
                                        ImageFormat::Format output_format,
                                        int open_cv_convert_code,
                                        CalculatorContext* cc);
+
+  // Recycles the output frames, if the graph provides a pool.
+  ImageFramePool* image_frame_pool_ = nullptr;
 };
 
 REGISTER_CALCULATOR(ColorConvertCalculator);
@@ -120,6 +125,14 @@ REGISTER_CALCULATOR(ColorConvertCalculator);
     cc->Outputs().Tag(kRgbaOutTag).Set<ImageFrame>();
   }
 
+  cc->UseService(kImageFramePoolService).Optional();
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ColorConvertCalculator::Open(CalculatorContext* cc) {
+  if (cc->Service(kImageFramePoolService).IsAvailable()) {
+    image_frame_pool_ = &cc->Service(kImageFramePoolService).GetObject();
+  }
   return ::mediapipe::OkStatus();
 }
 
@@ -129,8 +142,8 @@ REGISTER_CALCULATOR(ColorConvertCalculator);
     CalculatorContext* cc) {
   const cv::Mat& input_mat =
       formats::MatView(&cc->Inputs().Tag(input_tag).Get<ImageFrame>());
-  std::unique_ptr<ImageFrame> output_frame(
-      new ImageFrame(output_format, input_mat.cols, input_mat.rows));
+  std::unique_ptr<ImageFrame> output_frame = MakeImageFrame(
+      image_frame_pool_, output_format, input_mat.cols, input_mat.rows);
   cv::Mat output_mat = formats::MatView(output_frame.get());
   cv::cvtColor(input_mat, output_mat, open_cv_convert_code);
 
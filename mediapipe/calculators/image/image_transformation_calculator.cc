@@ -13,9 +13,11 @@
 // limitations under the License.
 
 #include "mediapipe/calculators/image/image_transformation_calculator.pb.h"
+#include "mediapipe/calculators/image/image_transformation_utils.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
 #include "mediapipe/framework/port/ret_check.h"
@@ -138,8 +140,13 @@ mediapipe::ScaleMode_Mode ParseScaleMode(
 // Note: To enable horizontal or vertical flipping, specify them in the
 // calculator options. Flipping is applied after rotation.
 //
-// Note: Only scale mode STRETCH is currently supported on CPU,
-// and flipping is not yet supported either.
+// Note: On CPU, the image is scaled first and then rotated about the center
+// of the scaled image, and flipping is not supported. FILL_AND_CROP scales
+// the image to fit and outputs it without padding, instead of cropping it.
+// Images with 8-bit channels are scaled and rotated in one pass with
+// ImageTransformer, unless a 90 or 270 degree rotation falls between pixels,
+// which happens when explicit output dimensions differ by an odd number.
+// Other images are scaled and rotated with OpenCV.
 //
 class ImageTransformationCalculator : public CalculatorBase {
  public:
@@ -154,6 +161,7 @@ class ImageTransformationCalculator : public CalculatorBase {
 
  private:
   ::mediapipe::Status RenderCpu(CalculatorContext* cc);
+  ::mediapipe::Status ScaleCpu(const ImageFrame& input, ImageFrame* output);
   ::mediapipe::Status RenderGpu(CalculatorContext* cc);
   ::mediapipe::Status GlSetup();
 
@@ -169,6 +177,12 @@ class ImageTransformationCalculator : public CalculatorBase {
   mediapipe::RotationMode_Mode rotation_;
   mediapipe::ScaleMode_Mode scale_mode_;
 
+  // Transforms 8-bit images on CPU. Keeps its sampling tables as long as the
+  // input and output dimensions and the rotation do not change.
+  image_transformation::ImageTransformer transformer_;
+  // Recycles the output frames, if the graph provides a pool.
+  ImageFramePool* image_frame_pool_ = nullptr;
+
   bool use_gpu_ = false;
 #if !defined(MEDIAPIPE_DISABLE_GPU)
   GlCalculatorHelper helper_;
@@ -191,6 +205,7 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
     RET_CHECK(cc->Outputs().HasTag("IMAGE"));
     cc->Inputs().Tag("IMAGE").Set<ImageFrame>();
     cc->Outputs().Tag("IMAGE").Set<ImageFrame>();
+    cc->UseService(kImageFramePoolService).Optional();
   }
 #if !defined(MEDIAPIPE_DISABLE_GPU)
   if (cc->Inputs().HasTag("IMAGE_GPU")) {
@@ -234,6 +249,8 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
 
   if (cc->Inputs().HasTag("IMAGE_GPU")) {
     use_gpu_ = true;
+  } else if (cc->Service(kImageFramePoolService).IsAvailable()) {
+    image_frame_pool_ = &cc->Service(kImageFramePoolService).GetObject();
   }
 
   if (cc->InputSidePackets().HasTag("OUTPUT_DIMENSIONS")) {
@@ -309,38 +326,23 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
 
 ::mediapipe::Status ImageTransformationCalculator::RenderCpu(
     CalculatorContext* cc) {
-  int input_width = cc->Inputs().Tag("IMAGE").Get<ImageFrame>().Width();
-  int input_height = cc->Inputs().Tag("IMAGE").Get<ImageFrame>().Height();
-
   const auto& input_img = cc->Inputs().Tag("IMAGE").Get<ImageFrame>();
-  cv::Mat input_mat = formats::MatView(&input_img);
-  cv::Mat scaled_mat;
+  const int input_width = input_img.Width();
+  const int input_height = input_img.Height();
 
-  if (scale_mode_ == mediapipe::ScaleMode_Mode_STRETCH) {
-    cv::resize(input_mat, scaled_mat, cv::Size(output_width_, output_height_));
-  } else {
+  if (cc->InputSidePackets().HasTag("ROTATION_DEGREES")) {
+    rotation_ = DegreesToRotationMode(
+        cc->InputSidePackets().Tag("ROTATION_DEGREES").Get<int>());
+  }
+
+  if (scale_mode_ == mediapipe::ScaleMode_Mode_FILL_AND_CROP &&
+      output_width_ > 0 && output_height_ > 0) {
+    // Scales the image to fit and shrinks the output to the scaled size.
     const float scale =
         std::min(static_cast<float>(output_width_) / input_width,
                  static_cast<float>(output_height_) / input_height);
-    const int target_width = std::round(input_width * scale);
-    const int target_height = std::round(input_height * scale);
-
-    if (scale_mode_ == mediapipe::ScaleMode_Mode_FIT) {
-      cv::Mat intermediate_mat;
-      cv::resize(input_mat, intermediate_mat,
-                 cv::Size(target_width, target_height));
-      const int top = (output_height_ - target_height) / 2;
-      const int bottom = output_height_ - target_height - top;
-      const int left = (output_width_ - target_width) / 2;
-      const int right = output_width_ - target_width - left;
-      cv::copyMakeBorder(intermediate_mat, scaled_mat, top, bottom, left, right,
-                         options_.constant_padding() ? cv::BORDER_CONSTANT
-                                                     : cv::BORDER_REPLICATE);
-    } else {
-      cv::resize(input_mat, scaled_mat, cv::Size(target_width, target_height));
-      output_width_ = target_width;
-      output_height_ = target_height;
-    }
+    output_width_ = std::round(input_width * scale);
+    output_height_ = std::round(input_height * scale);
   }
 
   int output_width;
@@ -356,26 +358,109 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
         .Add(padding.release(), cc->InputTimestamp());
   }
 
-  if (cc->InputSidePackets().HasTag("ROTATION_DEGREES")) {
-    rotation_ = DegreesToRotationMode(
-        cc->InputSidePackets().Tag("ROTATION_DEGREES").Get<int>());
-  }
-
-  cv::Mat rotated_mat;
+  std::unique_ptr<ImageFrame> output_frame = MakeImageFrame(
+      image_frame_pool_, input_img.Format(), output_width, output_height);
   const int angle = RotationModeToDegrees(rotation_);
-  cv::Point2f src_center(scaled_mat.cols / 2.0, scaled_mat.rows / 2.0);
-  cv::Mat rotation_mat = cv::getRotationMatrix2D(src_center, angle, 1.0);
-  cv::warpAffine(scaled_mat, rotated_mat, rotation_mat, scaled_mat.size());
-
-  std::unique_ptr<ImageFrame> output_frame(
-      new ImageFrame(input_img.Format(), output_width, output_height));
-  cv::Mat output_mat = formats::MatView(output_frame.get());
-  rotated_mat.copyTo(output_mat);
+  image_transformation::TransformationSpec spec;
+  spec.input_width = input_width;
+  spec.input_height = input_height;
+  spec.scaled_width = output_width_ > 0 ? output_width_ : input_width;
+  spec.scaled_height = output_height_ > 0 ? output_height_ : input_height;
+  spec.scale_mode = scale_mode_ == mediapipe::ScaleMode_Mode_FIT
+                        ? image_transformation::TransformationSpec::FIT
+                        : image_transformation::TransformationSpec::STRETCH;
+  spec.constant_padding = options_.constant_padding();
+  spec.rotation_degrees = angle;
+  spec.output_width = output_width;
+  spec.output_height = output_height;
+  if (angle == 0) {
+    MP_RETURN_IF_ERROR(ScaleCpu(input_img, output_frame.get()));
+  } else if (input_img.ByteDepth() == 1 &&
+             input_img.NumberOfChannels() <= 4 &&
+             image_transformation::ImageTransformer::CanTransform(spec)) {
+    // Scales and rotates in one pass, with the same result as below.
+    if (spec != transformer_.spec()) {
+      MP_RETURN_IF_ERROR(transformer_.Reset(spec));
+    }
+    transformer_.Transform(input_img.PixelData(), input_img.WidthStep(),
+                           input_img.NumberOfChannels(),
+                           output_frame->MutablePixelData(),
+                           output_frame->WidthStep());
+  } else {
+    std::unique_ptr<ImageFrame> scaled_frame;
+    cv::Mat scaled_mat;
+    if (output_width_ > 0 && output_height_ > 0) {
+      scaled_frame = MakeImageFrame(image_frame_pool_, input_img.Format(),
+                                    output_width_, output_height_);
+      MP_RETURN_IF_ERROR(ScaleCpu(input_img, scaled_frame.get()));
+      scaled_mat = formats::MatView(scaled_frame.get());
+    } else {
+      scaled_mat = formats::MatView(&input_img);
+    }
+    cv::Mat output_mat = formats::MatView(output_frame.get());
+    cv::Point2f src_center(scaled_mat.cols / 2.0, scaled_mat.rows / 2.0);
+    cv::Mat rotation_mat = cv::getRotationMatrix2D(src_center, angle, 1.0);
+    // Without output dimensions, the output has the rotated input dimensions
+    // and the center of the input moves to the center of the output.
+    rotation_mat.at<double>(0, 2) += (output_mat.cols - scaled_mat.cols) / 2.0;
+    rotation_mat.at<double>(1, 2) += (output_mat.rows - scaled_mat.rows) / 2.0;
+    cv::warpAffine(scaled_mat, output_mat, rotation_mat, output_mat.size());
+  }
   cc->Outputs().Tag("IMAGE").Add(output_frame.release(), cc->InputTimestamp());
 
   return ::mediapipe::OkStatus();
 }
 
+::mediapipe::Status ImageTransformationCalculator::ScaleCpu(
+    const ImageFrame& input, ImageFrame* output) {
+  if (output_width_ <= 0 || output_height_ <= 0) {
+    cv::Mat output_mat = formats::MatView(output);
+    formats::MatView(&input).copyTo(output_mat);
+    return ::mediapipe::OkStatus();
+  }
+  const bool fit = scale_mode_ == mediapipe::ScaleMode_Mode_FIT;
+  const int num_channels = input.NumberOfChannels();
+  if (input.ByteDepth() == 1 && num_channels <= 4) {
+    image_transformation::TransformationSpec spec;
+    spec.input_width = input.Width();
+    spec.input_height = input.Height();
+    spec.scaled_width = spec.output_width = output_width_;
+    spec.scaled_height = spec.output_height = output_height_;
+    spec.scale_mode = fit ? image_transformation::TransformationSpec::FIT
+                          : image_transformation::TransformationSpec::STRETCH;
+    spec.constant_padding = options_.constant_padding();
+    if (spec != transformer_.spec()) {
+      MP_RETURN_IF_ERROR(transformer_.Reset(spec));
+    }
+    transformer_.Transform(input.PixelData(), input.WidthStep(), num_channels,
+                           output->MutablePixelData(), output->WidthStep());
+    return ::mediapipe::OkStatus();
+  }
+
+  cv::Mat input_mat = formats::MatView(&input);
+  cv::Mat output_mat = formats::MatView(output);
+  if (!fit) {
+    cv::resize(input_mat, output_mat, output_mat.size());
+    return ::mediapipe::OkStatus();
+  }
+  const float scale =
+      std::min(static_cast<float>(output_width_) / input.Width(),
+               static_cast<float>(output_height_) / input.Height());
+  const int target_width = std::round(input.Width() * scale);
+  const int target_height = std::round(input.Height() * scale);
+  cv::Mat intermediate_mat;
+  cv::resize(input_mat, intermediate_mat,
+             cv::Size(target_width, target_height));
+  const int top = (output_height_ - target_height) / 2;
+  const int bottom = output_height_ - target_height - top;
+  const int left = (output_width_ - target_width) / 2;
+  const int right = output_width_ - target_width - left;
+  cv::copyMakeBorder(intermediate_mat, output_mat, top, bottom, left, right,
+                     options_.constant_padding() ? cv::BORDER_CONSTANT
+                                                 : cv::BORDER_REPLICATE);
+  return ::mediapipe::OkStatus();
+}
+
 ::mediapipe::Status ImageTransformationCalculator::RenderGpu(
     CalculatorContext* cc) {
 #if !defined(MEDIAPIPE_DISABLE_GPU)
@@ -0,0 +1,238 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/calculators/image/image_transformation_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/gpu/scale_mode.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr int kInputWidth = 64;
+constexpr int kInputHeight = 48;
+constexpr int kOutputWidth = 40;
+constexpr int kOutputHeight = 24;
+
+// A smooth gradient with some texture, so that both scaling and rotation
+// errors show up.
+std::unique_ptr<ImageFrame> MakeInputFrame(ImageFormat::Format format) {
+  auto frame =
+      absl::make_unique<ImageFrame>(format, kInputWidth, kInputHeight);
+  cv::Mat mat = formats::MatView(frame.get());
+  const int max_value = frame->ByteDepth() == 1 ? 255 : 65535;
+  for (int y = 0; y < kInputHeight; ++y) {
+    for (int x = 0; x < kInputWidth; ++x) {
+      for (int c = 0; c < mat.channels(); ++c) {
+        const int value = (x * 3 + y * 5 + c * 40 + (x * y) % 17) % 256;
+        const int scaled = value * max_value / 255;
+        if (frame->ByteDepth() == 1) {
+          mat.ptr<uint8>(y)[x * mat.channels() + c] = scaled;
+        } else {
+          mat.ptr<uint16>(y)[x * mat.channels() + c] = scaled;
+        }
+      }
+    }
+  }
+  return frame;
+}
+
+// The CPU transformation that ImageTransformationCalculator has always done
+// with OpenCV: scale, then rotate about the center of the scaled image.
+// FILL_AND_CROP scales to fit without padding. Flips are not applied.
+cv::Mat ReferenceTransform(const cv::Mat& input,
+                           const ImageTransformationCalculatorOptions& options,
+                           int degrees) {
+  cv::Mat scaled_mat;
+  const int output_width = options.output_width();
+  const int output_height = options.output_height();
+  if (options.scale_mode() == ScaleMode::STRETCH) {
+    cv::resize(input, scaled_mat, cv::Size(output_width, output_height));
+  } else {
+    const float scale =
+        std::min(static_cast<float>(output_width) / input.cols,
+                 static_cast<float>(output_height) / input.rows);
+    const int target_width = std::round(input.cols * scale);
+    const int target_height = std::round(input.rows * scale);
+    if (options.scale_mode() == ScaleMode::FIT) {
+      cv::Mat intermediate_mat;
+      cv::resize(input, intermediate_mat,
+                 cv::Size(target_width, target_height));
+      const int top = (output_height - target_height) / 2;
+      const int bottom = output_height - target_height - top;
+      const int left = (output_width - target_width) / 2;
+      const int right = output_width - target_width - left;
+      cv::copyMakeBorder(intermediate_mat, scaled_mat, top, bottom, left,
+                         right,
+                         options.constant_padding() ? cv::BORDER_CONSTANT
+                                                    : cv::BORDER_REPLICATE);
+    } else {
+      cv::resize(input, scaled_mat, cv::Size(target_width, target_height));
+    }
+  }
+
+  cv::Mat rotated_mat;
+  cv::Point2f src_center(scaled_mat.cols / 2.0, scaled_mat.rows / 2.0);
+  cv::Mat rotation_mat = cv::getRotationMatrix2D(src_center, degrees, 1.0);
+  cv::warpAffine(scaled_mat, rotated_mat, rotation_mat, scaled_mat.size());
+  return rotated_mat;
+}
+
+RotationMode::Mode ToRotationMode(int degrees) {
+  switch (degrees) {
+    case 90:
+      return RotationMode::ROTATION_90;
+    case 180:
+      return RotationMode::ROTATION_180;
+    case 270:
+      return RotationMode::ROTATION_270;
+    default:
+      return RotationMode::ROTATION_0;
+  }
+}
+
+std::vector<Packet> RunCalculator(
+    const ImageTransformationCalculatorOptions& options,
+    const ImageFrame& input, int num_frames) {
+  CalculatorGraphConfig::Node node_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig::Node>(R"(
+        calculator: "ImageTransformationCalculator"
+        input_stream: "IMAGE:input_image"
+        output_stream: "IMAGE:output_image"
+      )");
+  *node_config.mutable_options()->MutableExtension(
+      ImageTransformationCalculatorOptions::ext) = options;
+  CalculatorRunner runner(node_config);
+  for (int i = 0; i < num_frames; ++i) {
+    auto frame = absl::make_unique<ImageFrame>();
+    frame->CopyFrom(input, ImageFrame::kDefaultAlignmentBoundary);
+    runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+        Adopt(frame.release()).At(Timestamp(i)));
+  }
+  MP_EXPECT_OK(runner.Run());
+  return runner.Outputs().Tag("IMAGE").packets;
+}
+
+double MaxDifference(const cv::Mat& a, const cv::Mat& b) {
+  cv::Mat diff;
+  cv::absdiff(a, b, diff);
+  double max_value;
+  cv::minMaxLoc(diff.reshape(1), nullptr, &max_value);
+  return max_value;
+}
+
+// Compares the output for every scale mode, rotation and flip against the
+// OpenCV steps of the original CPU implementation. Two frames are sent so
+// that FILL_AND_CROP also covers the output dimensions that it updates.
+TEST(ImageTransformationCalculatorTest, CpuMatchesOpenCvSteps) {
+  for (ImageFormat::Format format :
+       {ImageFormat::SRGB, ImageFormat::SRGBA, ImageFormat::GRAY8,
+        ImageFormat::SRGB48}) {
+    const std::unique_ptr<ImageFrame> input = MakeInputFrame(format);
+    for (ScaleMode::Mode scale_mode :
+         {ScaleMode::STRETCH, ScaleMode::FIT, ScaleMode::FILL_AND_CROP}) {
+      for (int degrees : {0, 90, 180, 270}) {
+        for (int flips = 0; flips < 4; ++flips) {
+          for (bool constant_padding : {true, false}) {
+            ImageTransformationCalculatorOptions options;
+            options.set_output_width(kOutputWidth);
+            options.set_output_height(kOutputHeight);
+            options.set_scale_mode(scale_mode);
+            options.set_rotation_mode(ToRotationMode(degrees));
+            options.set_flip_horizontally(flips & 1);
+            options.set_flip_vertically(flips & 2);
+            options.set_constant_padding(constant_padding);
+            const cv::Mat expected =
+                ReferenceTransform(formats::MatView(input.get()), options,
+                                   degrees);
+
+            const std::vector<Packet> packets =
+                RunCalculator(options, *input, /*num_frames=*/2);
+            ASSERT_EQ(2, packets.size());
+            for (const Packet& packet : packets) {
+              const ImageFrame& output = packet.Get<ImageFrame>();
+              ASSERT_EQ(expected.cols, output.Width());
+              ASSERT_EQ(expected.rows, output.Height());
+              ASSERT_EQ(format, output.Format());
+              // ImageTransformer rounds its weights differently from
+              // cv::resize.
+              EXPECT_LE(MaxDifference(expected, formats::MatView(&output)), 2)
+                  << "format " << format << ", scale mode " << scale_mode
+                  << ", " << degrees << " degrees, flips " << flips
+                  << ", constant padding " << constant_padding;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(ImageTransformationCalculatorTest, FillAndCropShrinksOutputToFit) {
+  const std::unique_ptr<ImageFrame> input = MakeInputFrame(ImageFormat::SRGB);
+  ImageTransformationCalculatorOptions options;
+  options.set_output_width(kOutputWidth);
+  options.set_output_height(kOutputHeight);
+  options.set_scale_mode(ScaleMode::FILL_AND_CROP);
+  const std::vector<Packet> packets =
+      RunCalculator(options, *input, /*num_frames=*/1);
+  ASSERT_EQ(1, packets.size());
+  const ImageFrame& output = packets[0].Get<ImageFrame>();
+  EXPECT_EQ(32, output.Width());
+  EXPECT_EQ(24, output.Height());
+}
+
+TEST(ImageTransformationCalculatorTest, DefaultDimensionsFollowRotation) {
+  const std::unique_ptr<ImageFrame> input = MakeInputFrame(ImageFormat::SRGB);
+  for (int degrees : {0, 90, 180, 270}) {
+    ImageTransformationCalculatorOptions options;
+    options.set_rotation_mode(ToRotationMode(degrees));
+    const std::vector<Packet> packets =
+        RunCalculator(options, *input, /*num_frames=*/1);
+    ASSERT_EQ(1, packets.size());
+    const ImageFrame& output = packets[0].Get<ImageFrame>();
+    const bool transposed = degrees == 90 || degrees == 270;
+    ASSERT_EQ(transposed ? kInputHeight : kInputWidth, output.Width());
+    ASSERT_EQ(transposed ? kInputWidth : kInputHeight, output.Height());
+    // The input is rotated about its center, which moves to the center of
+    // the output.
+    const cv::Mat input_mat = formats::MatView(input.get());
+    cv::Mat rotation_mat = cv::getRotationMatrix2D(
+        cv::Point2f(kInputWidth / 2.0, kInputHeight / 2.0), degrees, 1.0);
+    rotation_mat.at<double>(0, 2) += (output.Width() - kInputWidth) / 2.0;
+    rotation_mat.at<double>(1, 2) += (output.Height() - kInputHeight) / 2.0;
+    cv::Mat expected;
+    cv::warpAffine(input_mat, expected, rotation_mat,
+                   cv::Size(output.Width(), output.Height()));
+    EXPECT_EQ(0, MaxDifference(expected, formats::MatView(&output)))
+        << degrees << " degrees";
+  }
+}
+
+}  // namespace
+
+}  // namespace mediapipe
@@ -0,0 +1,367 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/image/image_transformation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+namespace image_transformation {
+
+namespace {
+
+// Bilinear weights are fixed point with 7 fractional bits, so that a
+// horizontally interpolated value fits in 15 bits and two of them can be
+// blended with 16-bit multiplies.
+constexpr int kWeightBits = 7;
+constexpr int kWeightOne = 1 << kWeightBits;
+constexpr int kBlendShift = 2 * kWeightBits;
+constexpr int kBlendRound = 1 << (kBlendShift - 1);
+
+// Output rows processed together by the transposed path, so that the source
+// pixels they share stay in cache.
+constexpr int kTransposedTileRows = 8;
+
+// Fills `taps` for an axis of the scaled image of `scaled_size` pixels.
+// The scaled input covers `target_size` of them starting at `offset`, and
+// maps them onto a source axis of `source_size` pixels.
+template <class Taps>
+void ComputeTaps(int scaled_size, int target_size, int offset,
+                 int source_size, bool pad, Taps* taps) {
+  taps->index0.assign(scaled_size, 0);
+  taps->index1.assign(scaled_size, 0);
+  taps->weight.assign(scaled_size, 0);
+  taps->begin = scaled_size;
+  taps->end = 0;
+  const double scale = static_cast<double>(source_size) / target_size;
+  for (int i = 0; i < scaled_size; ++i) {
+    int target = i - offset;
+    if (target < 0 || target >= target_size) {
+      if (pad) continue;
+      // Replicates the edge of the scaled image, as cv::BORDER_REPLICATE.
+      target = std::min(std::max(target, 0), target_size - 1);
+    }
+    taps->begin = std::min(taps->begin, i);
+    taps->end = i + 1;
+    // Pixel centers are aligned, as in cv::resize().
+    const double position = (target + 0.5) * scale - 0.5;
+    if (position <= 0.0) continue;
+    if (position >= source_size - 1) {
+      taps->index0[i] = taps->index1[i] = source_size - 1;
+      continue;
+    }
+    int index = static_cast<int>(position);
+    int weight = static_cast<int>(std::lround((position - index) * kWeightOne));
+    if (weight == kWeightOne) {
+      ++index;
+      weight = 0;
+    }
+    taps->index0[i] = index;
+    taps->index1[i] = std::min(index + 1, source_size - 1);
+    taps->weight[i] = weight;
+  }
+  if (taps->begin >= taps->end) taps->begin = taps->end = 0;
+}
+
+// Fills `taps` for an output axis of `output_size` pixels, whose pixel i
+// shows pixel (origin + direction * i) of the scaled image axis sampled by
+// `scaled_taps`.
+template <class Taps>
+void RotateTaps(const Taps& scaled_taps, int output_size, int origin,
+                int direction, Taps* taps) {
+  taps->index0.assign(output_size, 0);
+  taps->index1.assign(output_size, 0);
+  taps->weight.assign(output_size, 0);
+  taps->begin = output_size;
+  taps->end = 0;
+  for (int i = 0; i < output_size; ++i) {
+    const int scaled = origin + direction * i;
+    if (scaled < scaled_taps.begin || scaled >= scaled_taps.end) continue;
+    taps->begin = std::min(taps->begin, i);
+    taps->end = i + 1;
+    taps->index0[i] = scaled_taps.index0[scaled];
+    taps->index1[i] = scaled_taps.index1[scaled];
+    taps->weight[i] = scaled_taps.weight[scaled];
+  }
+  if (taps->begin >= taps->end) taps->begin = taps->end = 0;
+}
+
+// Writes round((row0 * (kWeightOne - weight) + row1 * weight) / kWeightOne^2)
+// for `size` values.
+void BlendRows(const uint16* row0, const uint16* row1, int weight, int size,
+               uint8* output) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i weights =
+      _mm_set1_epi32((weight << 16) | (kWeightOne - weight));
+  const __m128i round = _mm_set1_epi32(kBlendRound);
+  for (; i + 8 <= size; i += 8) {
+    const __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i));
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i));
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kBlendShift);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kBlendShift);
+    const __m128i words = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i),
+                     _mm_packus_epi16(words, words));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const int16x4_t weight0 = vdup_n_s16(kWeightOne - weight);
+  const int16x4_t weight1 = vdup_n_s16(weight);
+  for (; i + 8 <= size; i += 8) {
+    const int16x8_t a = vreinterpretq_s16_u16(vld1q_u16(row0 + i));
+    const int16x8_t b = vreinterpretq_s16_u16(vld1q_u16(row1 + i));
+    int32x4_t lo = vmull_s16(vget_low_s16(a), weight0);
+    lo = vmlal_s16(lo, vget_low_s16(b), weight1);
+    int32x4_t hi = vmull_s16(vget_high_s16(a), weight0);
+    hi = vmlal_s16(hi, vget_high_s16(b), weight1);
+    const int16x8_t words = vcombine_s16(vrshrn_n_s32(lo, kBlendShift),
+                                         vrshrn_n_s32(hi, kBlendShift));
+    vst1_u8(output + i, vqmovun_s16(words));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = (row0[i] * (kWeightOne - weight) + row1[i] * weight +
+                 kBlendRound) >>
+                kBlendShift;
+  }
+}
+
+}  // namespace
+
+bool TransformationSpec::operator==(const TransformationSpec& other) const {
+  return input_width == other.input_width &&
+         input_height == other.input_height &&
+         scaled_width == other.scaled_width &&
+         scaled_height == other.scaled_height &&
+         scale_mode == other.scale_mode &&
+         constant_padding == other.constant_padding &&
+         rotation_degrees == other.rotation_degrees &&
+         output_width == other.output_width &&
+         output_height == other.output_height;
+}
+
+bool ImageTransformer::CanTransform(const TransformationSpec& spec) {
+  const bool transposed =
+      spec.rotation_degrees == 90 || spec.rotation_degrees == 270;
+  const int aligned_width = transposed ? spec.scaled_height : spec.scaled_width;
+  const int aligned_height =
+      transposed ? spec.scaled_width : spec.scaled_height;
+  return (spec.output_width - aligned_width) % 2 == 0 &&
+         (spec.output_height - aligned_height) % 2 == 0;
+}
+
+::mediapipe::Status ImageTransformer::Reset(const TransformationSpec& spec) {
+  RET_CHECK(spec.rotation_degrees == 0 || spec.rotation_degrees == 90 ||
+            spec.rotation_degrees == 180 || spec.rotation_degrees == 270)
+      << "Unsupported rotation: " << spec.rotation_degrees;
+  RET_CHECK(spec.input_width > 0 && spec.input_height > 0 &&
+            spec.scaled_width > 0 && spec.scaled_height > 0 &&
+            spec.output_width > 0 && spec.output_height > 0)
+      << "Image dimensions must be positive.";
+  RET_CHECK(CanTransform(spec))
+      << "A rotation by " << spec.rotation_degrees << " degrees of a "
+      << spec.scaled_width << "x" << spec.scaled_height << " image into a "
+      << spec.output_width << "x" << spec.output_height
+      << " output needs interpolation.";
+  spec_ = spec;
+  transposed_ = spec.rotation_degrees == 90 || spec.rotation_degrees == 270;
+
+  int target_width = spec.scaled_width;
+  int target_height = spec.scaled_height;
+  if (spec.scale_mode == TransformationSpec::FIT) {
+    const float scale =
+        std::min(static_cast<float>(spec.scaled_width) / spec.input_width,
+                 static_cast<float>(spec.scaled_height) / spec.input_height);
+    target_width = std::max<int>(1, std::round(spec.input_width * scale));
+    target_height = std::max<int>(1, std::round(spec.input_height * scale));
+  }
+  const bool pad =
+      spec.scale_mode == TransformationSpec::FIT && spec.constant_padding;
+  Taps scaled_columns;
+  Taps scaled_rows;
+  ComputeTaps(spec.scaled_width, target_width,
+              (spec.scaled_width - target_width) / 2, spec.input_width, pad,
+              &scaled_columns);
+  ComputeTaps(spec.scaled_height, target_height,
+              (spec.scaled_height - target_height) / 2, spec.input_height, pad,
+              &scaled_rows);
+
+  // With centers aligned, output pixel (x, y) shows pixel (x + (sw - ow) / 2,
+  // y + (sh - oh) / 2) of the sw x sh scaled image without rotation,
+  // ((sw + ow) / 2 - x, (sh + oh) / 2 - y) after 180 degrees,
+  // ((sw + oh) / 2 - y, x + (sh - ow) / 2) after 90 degrees and
+  // (y + (sw - oh) / 2, (sh + ow) / 2 - x) after 270 degrees.
+  const int sw = spec.scaled_width;
+  const int sh = spec.scaled_height;
+  const int ow = spec.output_width;
+  const int oh = spec.output_height;
+  switch (spec.rotation_degrees) {
+    case 0:
+      RotateTaps(scaled_columns, ow, (sw - ow) / 2, 1, &column_taps_);
+      RotateTaps(scaled_rows, oh, (sh - oh) / 2, 1, &row_taps_);
+      break;
+    case 90:
+      RotateTaps(scaled_rows, ow, (sh - ow) / 2, 1, &column_taps_);
+      RotateTaps(scaled_columns, oh, (sw + oh) / 2, -1, &row_taps_);
+      break;
+    case 180:
+      RotateTaps(scaled_columns, ow, (sw + ow) / 2, -1, &column_taps_);
+      RotateTaps(scaled_rows, oh, (sh + oh) / 2, -1, &row_taps_);
+      break;
+    case 270:
+      RotateTaps(scaled_rows, ow, (sh + ow) / 2, -1, &column_taps_);
+      RotateTaps(scaled_columns, oh, (sw - oh) / 2, 1, &row_taps_);
+      break;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+void ImageTransformer::Transform(const uint8* input, int input_step,
+                                 int num_channels, uint8* output,
+                                 int output_step) {
+  switch (num_channels) {
+    case 1:
+      transposed_ ? TransformTransposed<1>(input, input_step, output,
+                                           output_step)
+                  : TransformRows<1>(input, input_step, output, output_step);
+      break;
+    case 2:
+      transposed_ ? TransformTransposed<2>(input, input_step, output,
+                                           output_step)
+                  : TransformRows<2>(input, input_step, output, output_step);
+      break;
+    case 3:
+      transposed_ ? TransformTransposed<3>(input, input_step, output,
+                                           output_step)
+                  : TransformRows<3>(input, input_step, output, output_step);
+      break;
+    case 4:
+      transposed_ ? TransformTransposed<4>(input, input_step, output,
+                                           output_step)
+                  : TransformRows<4>(input, input_step, output, output_step);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported number of channels: " << num_channels;
+  }
+}
+
+template <int kChannels>
+void ImageTransformer::TransformRows(const uint8* input, int input_step,
+                                     uint8* output, int output_step) {
+  const int row_size = spec_.output_width * kChannels;
+  const int begin = column_taps_.begin * kChannels;
+  const int end = column_taps_.end * kChannels;
+  for (auto& buffer : row_buffers_) buffer.resize(row_size);
+  buffered_rows_[0] = buffered_rows_[1] = -1;
+
+  // Returns the buffer holding source row `row` interpolated horizontally,
+  // evicting a buffer that does not hold `keep_row` if needed.
+  auto interpolated_row = [&](int row, int keep_row) -> const uint16* {
+    for (int slot = 0; slot < 2; ++slot) {
+      if (buffered_rows_[slot] == row) return row_buffers_[slot].data();
+    }
+    const int slot = buffered_rows_[0] == keep_row ? 1 : 0;
+    buffered_rows_[slot] = row;
+    const uint8* source = input + row * input_step;
+    uint16* buffer = row_buffers_[slot].data();
+    for (int x = column_taps_.begin; x < column_taps_.end; ++x) {
+      const uint8* pixel0 = source + column_taps_.index0[x] * kChannels;
+      const uint8* pixel1 = source + column_taps_.index1[x] * kChannels;
+      const int weight = column_taps_.weight[x];
+      for (int c = 0; c < kChannels; ++c) {
+        buffer[x * kChannels + c] =
+            pixel0[c] * (kWeightOne - weight) + pixel1[c] * weight;
+      }
+    }
+    return buffer;
+  };
+
+  for (int y = 0; y < spec_.output_height; ++y) {
+    uint8* output_row = output + y * output_step;
+    if (y < row_taps_.begin || y >= row_taps_.end) {
+      std::memset(output_row, 0, row_size);
+      continue;
+    }
+    const int row0 = row_taps_.index0[y];
+    const int row1 = row_taps_.index1[y];
+    const uint16* interpolated0 = interpolated_row(row0, row1);
+    const uint16* interpolated1 = interpolated_row(row1, row0);
+    std::memset(output_row, 0, begin);
+    BlendRows(interpolated0 + begin, interpolated1 + begin,
+              row_taps_.weight[y], end - begin, output_row + begin);
+    std::memset(output_row + end, 0, row_size - end);
+  }
+}
+
+template <int kChannels>
+void ImageTransformer::TransformTransposed(const uint8* input, int input_step,
+                                           uint8* output, int output_step) {
+  const int row_size = spec_.output_width * kChannels;
+  for (int tile = 0; tile < spec_.output_height;
+       tile += kTransposedTileRows) {
+    const int tile_end =
+        std::min(tile + kTransposedTileRows, spec_.output_height);
+    for (int y = tile; y < tile_end; ++y) {
+      uint8* output_row = output + y * output_step;
+      if (y < row_taps_.begin || y >= row_taps_.end) {
+        std::memset(output_row, 0, row_size);
+        continue;
+      }
+      std::memset(output_row, 0, column_taps_.begin * kChannels);
+      std::memset(output_row + column_taps_.end * kChannels, 0,
+                  row_size - column_taps_.end * kChannels);
+    }
+    const int rows_begin = std::max(tile, row_taps_.begin);
+    const int rows_end = std::min(tile_end, row_taps_.end);
+    // Output columns walk down the source, output rows walk across it.
+    for (int x = column_taps_.begin; x < column_taps_.end; ++x) {
+      const uint8* source0 = input + column_taps_.index0[x] * input_step;
+      const uint8* source1 = input + column_taps_.index1[x] * input_step;
+      const int weight_y = column_taps_.weight[x];
+      for (int y = rows_begin; y < rows_end; ++y) {
+        const int column0 = row_taps_.index0[y] * kChannels;
+        const int column1 = row_taps_.index1[y] * kChannels;
+        const int weight_x = row_taps_.weight[y];
+        uint8* pixel = output + y * output_step + x * kChannels;
+        for (int c = 0; c < kChannels; ++c) {
+          const int top = source0[column0 + c] * (kWeightOne - weight_x) +
+                          source0[column1 + c] * weight_x;
+          const int bottom = source1[column0 + c] * (kWeightOne - weight_x) +
+                             source1[column1 + c] * weight_x;
+          pixel[c] = (top * (kWeightOne - weight_y) + bottom * weight_y +
+                      kBlendRound) >>
+                     kBlendShift;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace image_transformation
+}  // namespace mediapipe
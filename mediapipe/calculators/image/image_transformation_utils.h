@@ -0,0 +1,114 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A single-pass CPU kernel for bilinear scaling with stretching or
+// letterboxing followed by a rotation by a multiple of 90 degrees, written
+// straight into the output image without intermediate images. It produces
+// what ImageTransformationCalculator does with cv::resize() and
+// cv::warpAffine() on 8-bit images.
+#ifndef MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
+#define MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
+
+#include <vector>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+namespace image_transformation {
+
+struct TransformationSpec {
+  enum ScaleMode {
+    // The input fills the scaled image exactly.
+    STRETCH,
+    // The input is scaled to fit the scaled image, preserving its aspect
+    // ratio, and centered; the remaining border is padding.
+    FIT,
+  };
+
+  int input_width = 0;
+  int input_height = 0;
+  // The input is first scaled to scaled_width x scaled_height.
+  int scaled_width = 0;
+  int scaled_height = 0;
+  ScaleMode scale_mode = STRETCH;
+  // With FIT, whether the padding is zero or repeats the edge pixels.
+  bool constant_padding = true;
+  // The scaled image is then rotated counterclockwise about its center, which
+  // lands on the center of the output, as with cv::warpAffine(). Output
+  // pixels outside of the rotated image are zero. Must be 0, 90, 180 or 270.
+  int rotation_degrees = 0;
+  int output_width = 0;
+  int output_height = 0;
+
+  bool operator==(const TransformationSpec& other) const;
+  bool operator!=(const TransformationSpec& other) const {
+    return !(*this == other);
+  }
+};
+
+class ImageTransformer {
+ public:
+  // Returns true if the rotation of `spec` moves pixel centers onto pixel
+  // centers, which is the case if every output dimension has the same
+  // parity as the dimension of the scaled image that the rotation aligns
+  // with it. E.g. rotating a 40x25 image by 90 degrees into a 40x25 output
+  // would need interpolation.
+  static bool CanTransform(const TransformationSpec& spec);
+
+  // Computes the sampling tables for `spec`, which must satisfy
+  // CanTransform().
+  ::mediapipe::Status Reset(const TransformationSpec& spec);
+  const TransformationSpec& spec() const { return spec_; }
+
+  // Writes the transformed `input`, which must have the input dimensions of
+  // the spec, to `output`, which must have its output dimensions. Steps are
+  // in bytes.
+  void Transform(const uint8* input, int input_step, int num_channels,
+                 uint8* output, int output_step);
+
+ private:
+  // Bilinear taps along one image axis: position i samples source positions
+  // index0[i] and index1[i] with weights (kWeightOne - weight[i]) and
+  // weight[i]. Outside [begin, end) the image is zero.
+  struct Taps {
+    std::vector<int> index0;
+    std::vector<int> index1;
+    std::vector<int16> weight;
+    int begin = 0;
+    int end = 0;
+  };
+
+  template <int kChannels>
+  void TransformRows(const uint8* input, int input_step, uint8* output,
+                     int output_step);
+  template <int kChannels>
+  void TransformTransposed(const uint8* input, int input_step, uint8* output,
+                           int output_step);
+
+  TransformationSpec spec_;
+  // With 90 and 270 degree rotations, columns sample the source vertically
+  // and rows sample it horizontally.
+  bool transposed_ = false;
+  Taps column_taps_;
+  Taps row_taps_;
+  // Horizontally interpolated source rows, cached across output rows.
+  std::vector<uint16> row_buffers_[2];
+  int buffered_rows_[2] = {-1, -1};
+};
+
+}  // namespace image_transformation
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
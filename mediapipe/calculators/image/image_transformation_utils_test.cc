@@ -0,0 +1,373 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/image/image_transformation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace image_transformation {
+namespace {
+
+struct Image {
+  int width;
+  int height;
+  int channels;
+  std::vector<uint8> pixels;
+
+  uint8& at(int x, int y, int c) {
+    return pixels[(y * width + x) * channels + c];
+  }
+  uint8 at(int x, int y, int c) const {
+    return pixels[(y * width + x) * channels + c];
+  }
+};
+
+Image RandomImage(int width, int height, int channels, int seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  Image image{width, height, channels};
+  image.pixels.resize(width * height * channels);
+  for (uint8& value : image.pixels) value = distribution(random);
+  return image;
+}
+
+// Transforms in floating point, one step at a time: scaling into the scaled
+// image, then rotating it about the centers as cv::warpAffine() does.
+Image ReferenceTransform(const TransformationSpec& spec, const Image& input) {
+  int target_width = spec.scaled_width;
+  int target_height = spec.scaled_height;
+  if (spec.scale_mode == TransformationSpec::FIT) {
+    const float scale =
+        std::min(static_cast<float>(spec.scaled_width) / input.width,
+                 static_cast<float>(spec.scaled_height) / input.height);
+    target_width = std::round(input.width * scale);
+    target_height = std::round(input.height * scale);
+  }
+  const int left = (spec.scaled_width - target_width) / 2;
+  const int top = (spec.scaled_height - target_height) / 2;
+  const bool pad =
+      spec.scale_mode == TransformationSpec::FIT && spec.constant_padding;
+
+  Image scaled{spec.scaled_width, spec.scaled_height, input.channels};
+  scaled.pixels.resize(scaled.width * scaled.height * scaled.channels);
+  for (int y = 0; y < scaled.height; ++y) {
+    for (int x = 0; x < scaled.width; ++x) {
+      int target_x = x - left;
+      int target_y = y - top;
+      if (pad && (target_x < 0 || target_x >= target_width || target_y < 0 ||
+                  target_y >= target_height)) {
+        continue;
+      }
+      // Without padding, the border repeats the edge of the scaled input.
+      target_x = std::min(std::max(target_x, 0), target_width - 1);
+      target_y = std::min(std::max(target_y, 0), target_height - 1);
+      const double source_x = std::min<double>(
+          std::max((target_x + 0.5) * input.width / target_width - 0.5, 0.0),
+          input.width - 1);
+      const double source_y = std::min<double>(
+          std::max((target_y + 0.5) * input.height / target_height - 0.5,
+                   0.0),
+          input.height - 1);
+      const int x0 = source_x;
+      const int y0 = source_y;
+      const int x1 = std::min(x0 + 1, input.width - 1);
+      const int y1 = std::min(y0 + 1, input.height - 1);
+      const double wx = source_x - x0;
+      const double wy = source_y - y0;
+      for (int c = 0; c < input.channels; ++c) {
+        const double value =
+            (input.at(x0, y0, c) * (1 - wx) + input.at(x1, y0, c) * wx) *
+                (1 - wy) +
+            (input.at(x0, y1, c) * (1 - wx) + input.at(x1, y1, c) * wx) * wy;
+        scaled.at(x, y, c) = std::lround(value);
+      }
+    }
+  }
+
+  // cv::getRotationMatrix2D() maps (x, y) relative to the center to
+  // (x * cos + y * sin, -x * sin + y * cos); this is its inverse.
+  const int degrees = spec.rotation_degrees;
+  const int cosine = degrees == 0 ? 1 : degrees == 180 ? -1 : 0;
+  const int sine = degrees == 90 ? 1 : degrees == 270 ? -1 : 0;
+  Image output{spec.output_width, spec.output_height, input.channels};
+  output.pixels.resize(output.width * output.height * output.channels);
+  for (int y = 0; y < output.height; ++y) {
+    for (int x = 0; x < output.width; ++x) {
+      const double dx = x - output.width / 2.0;
+      const double dy = y - output.height / 2.0;
+      const double scaled_x = scaled.width / 2.0 + dx * cosine - dy * sine;
+      const double scaled_y = scaled.height / 2.0 + dx * sine + dy * cosine;
+      CHECK_EQ(scaled_x, std::floor(scaled_x));
+      CHECK_EQ(scaled_y, std::floor(scaled_y));
+      if (scaled_x < 0 || scaled_x >= scaled.width || scaled_y < 0 ||
+          scaled_y >= scaled.height) {
+        continue;
+      }
+      for (int c = 0; c < input.channels; ++c) {
+        output.at(x, y, c) = scaled.at(scaled_x, scaled_y, c);
+      }
+    }
+  }
+  return output;
+}
+
+// Transforms with ImageTransformer, into an output with padded rows.
+Image Transform(const TransformationSpec& spec, const Image& input) {
+  ImageTransformer transformer;
+  MP_EXPECT_OK(transformer.Reset(spec));
+  const int output_step = spec.output_width * input.channels + 13;
+  std::vector<uint8> padded(output_step * spec.output_height, 77);
+  transformer.Transform(input.pixels.data(), input.width * input.channels,
+                        input.channels, padded.data(), output_step);
+  Image output{spec.output_width, spec.output_height, input.channels};
+  for (int y = 0; y < output.height; ++y) {
+    output.pixels.insert(
+        output.pixels.end(), padded.begin() + y * output_step,
+        padded.begin() + y * output_step + output.width * output.channels);
+  }
+  return output;
+}
+
+int MaxDifference(const Image& a, const Image& b) {
+  EXPECT_EQ(a.pixels.size(), b.pixels.size());
+  int max_difference = 0;
+  for (int i = 0; i < a.pixels.size(); ++i) {
+    max_difference =
+        std::max(max_difference, std::abs(a.pixels[i] - b.pixels[i]));
+  }
+  return max_difference;
+}
+
+TEST(ImageTransformerTest, IdentityIsExact) {
+  const Image input = RandomImage(31, 17, 3, 1);
+  TransformationSpec spec;
+  spec.input_width = spec.scaled_width = spec.output_width = 31;
+  spec.input_height = spec.scaled_height = spec.output_height = 17;
+  EXPECT_EQ(input.pixels, Transform(spec, input).pixels);
+}
+
+// Like cv::warpAffine(), rotations about the center of an image with even
+// dimensions move it by a pixel, so that the first row or column is zero.
+TEST(ImageTransformerTest, RotationsAreExact) {
+  const Image input = RandomImage(30, 18, 4, 2);
+  for (int degrees : {0, 90, 180, 270}) {
+    TransformationSpec spec;
+    spec.input_width = spec.scaled_width = 30;
+    spec.input_height = spec.scaled_height = 18;
+    spec.rotation_degrees = degrees;
+    const bool transposed = degrees == 90 || degrees == 270;
+    spec.output_width = transposed ? 18 : 30;
+    spec.output_height = transposed ? 30 : 18;
+    const Image output = Transform(spec, input);
+    EXPECT_EQ(ReferenceTransform(spec, input).pixels, output.pixels)
+        << degrees << " degrees";
+  }
+
+  TransformationSpec spec;
+  spec.input_width = spec.scaled_width = spec.output_height = 30;
+  spec.input_height = spec.scaled_height = spec.output_width = 18;
+  spec.rotation_degrees = 90;
+  const Image output = Transform(spec, input);
+  for (int x = 0; x < 18; ++x) {
+    EXPECT_EQ(0, output.at(x, 0, 0));
+    for (int y = 1; y < 30; ++y) {
+      EXPECT_EQ(input.at(30 - y, x, 0), output.at(x, y, 0));
+    }
+  }
+}
+
+TEST(ImageTransformerTest, MatchesReference) {
+  for (int channels : {1, 3, 4}) {
+    const Image input = RandomImage(61, 37, channels, channels);
+    for (int degrees : {0, 90, 180, 270}) {
+      for (auto scale_mode :
+           {TransformationSpec::STRETCH, TransformationSpec::FIT}) {
+        for (bool constant_padding : {true, false}) {
+          for (const auto& size : std::vector<std::pair<int, int>>{
+                   {24, 40}, {150, 90}, {64, 64}}) {
+            TransformationSpec spec;
+            spec.input_width = input.width;
+            spec.input_height = input.height;
+            spec.scaled_width = spec.output_width = size.first;
+            spec.scaled_height = spec.output_height = size.second;
+            spec.rotation_degrees = degrees;
+            spec.scale_mode = scale_mode;
+            spec.constant_padding = constant_padding;
+            EXPECT_LE(MaxDifference(ReferenceTransform(spec, input),
+                                    Transform(spec, input)),
+                      2)
+                << channels << " channels, " << degrees << " degrees, mode "
+                << scale_mode << ", " << size.first << "x" << size.second;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(ImageTransformerTest, RejectsRotationBetweenPixels) {
+  TransformationSpec spec;
+  spec.input_width = spec.scaled_width = spec.output_width = 40;
+  spec.input_height = spec.scaled_height = spec.output_height = 25;
+  spec.rotation_degrees = 180;
+  EXPECT_TRUE(ImageTransformer::CanTransform(spec));
+  spec.rotation_degrees = 90;
+  EXPECT_FALSE(ImageTransformer::CanTransform(spec));
+  ImageTransformer transformer;
+  EXPECT_FALSE(transformer.Reset(spec).ok());
+  spec.output_width = 25;
+  spec.output_height = 40;
+  EXPECT_TRUE(ImageTransformer::CanTransform(spec));
+}
+
+TEST(ImageTransformerTest, LetterboxPaddingIsZero) {
+  const Image input = RandomImage(40, 20, 3, 3);
+  TransformationSpec spec;
+  spec.input_width = 40;
+  spec.input_height = 20;
+  spec.scaled_width = spec.output_width = 40;
+  spec.scaled_height = spec.output_height = 40;
+  spec.scale_mode = TransformationSpec::FIT;
+  Image output = Transform(spec, input);
+  for (int y = 0; y < 40; ++y) {
+    const bool padding = y < 10 || y >= 30;
+    for (int x = 0; x < 40; ++x) {
+      if (padding) {
+        EXPECT_EQ(0, output.at(x, y, 0));
+      } else {
+        EXPECT_EQ(input.at(x, y - 10, 0), output.at(x, y, 0));
+      }
+    }
+  }
+}
+
+TEST(ImageTransformerTest, ReplicatePaddingRepeatsScaledEdge) {
+  const Image input = RandomImage(20, 10, 1, 1);
+  TransformationSpec spec;
+  spec.input_width = 20;
+  spec.input_height = 10;
+  spec.scaled_width = spec.output_width = 10;
+  spec.scaled_height = spec.output_height = 10;
+  spec.scale_mode = TransformationSpec::FIT;
+  spec.constant_padding = false;
+  Image output = Transform(spec, input);
+  // The scaled image covers rows 2 to 6; the rows above and below repeat
+  // its first and last rows rather than the input's.
+  for (int x = 0; x < 10; ++x) {
+    for (int y = 0; y < 2; ++y) {
+      EXPECT_EQ(output.at(x, 2, 0), output.at(x, y, 0));
+    }
+    for (int y = 7; y < 10; ++y) {
+      EXPECT_EQ(output.at(x, 6, 0), output.at(x, y, 0));
+    }
+  }
+}
+
+TEST(ImageTransformerTest, RejectsInvalidSpec) {
+  ImageTransformer transformer;
+  TransformationSpec spec;
+  spec.input_width = spec.scaled_width = spec.output_width = 4;
+  spec.input_height = spec.scaled_height = spec.output_height = 4;
+  spec.rotation_degrees = 45;
+  EXPECT_FALSE(transformer.Reset(spec).ok());
+}
+
+// Benchmarks transform 3-channel 720p and 1080p frames into a 256x256 model
+// input with letterboxing, with and without a 90 degree rotation.
+void TransformArgs(benchmark::internal::Benchmark* b) {
+  for (int height : {720, 1080}) {
+    for (int degrees : {0, 90}) b->Args({height, degrees});
+  }
+}
+
+constexpr int kBenchmarkOutputSize = 256;
+
+// What ImageTransformationCalculator did on CPU before using
+// ImageTransformer: resize, pad, rotate and copy into the output frame.
+void BM_OpenCvTransform(benchmark::State& state) {
+  const int height = state.range(0);
+  const int width = height * 16 / 9;
+  const int degrees = state.range(1);
+  const Image input = RandomImage(width, height, 3, 4);
+  cv::Mat input_mat(height, width, CV_8UC3,
+                    const_cast<uint8*>(input.pixels.data()));
+  cv::Mat output_mat(kBenchmarkOutputSize, kBenchmarkOutputSize, CV_8UC3);
+  const float scale =
+      std::min(static_cast<float>(kBenchmarkOutputSize) / width,
+               static_cast<float>(kBenchmarkOutputSize) / height);
+  const int target_width = std::round(width * scale);
+  const int target_height = std::round(height * scale);
+  const int top = (kBenchmarkOutputSize - target_height) / 2;
+  const int left = (kBenchmarkOutputSize - target_width) / 2;
+  for (auto _ : state) {
+    cv::Mat intermediate_mat;
+    cv::resize(input_mat, intermediate_mat,
+               cv::Size(target_width, target_height));
+    cv::Mat scaled_mat;
+    cv::copyMakeBorder(intermediate_mat, scaled_mat, top,
+                       kBenchmarkOutputSize - target_height - top, left,
+                       kBenchmarkOutputSize - target_width - left,
+                       cv::BORDER_CONSTANT);
+    cv::Mat rotated_mat;
+    cv::Point2f center(scaled_mat.cols / 2.0, scaled_mat.rows / 2.0);
+    cv::warpAffine(scaled_mat, rotated_mat,
+                   cv::getRotationMatrix2D(center, degrees, 1.0),
+                   scaled_mat.size());
+    rotated_mat.copyTo(output_mat);
+    benchmark::DoNotOptimize(output_mat.data);
+  }
+}
+
+// What ImageTransformationCalculator does on CPU now: scale and rotate in
+// one pass with ImageTransformer.
+void BM_ImageTransformer(benchmark::State& state) {
+  const int height = state.range(0);
+  const int width = height * 16 / 9;
+  const int degrees = state.range(1);
+  const Image input = RandomImage(width, height, 3, 4);
+  TransformationSpec spec;
+  spec.input_width = width;
+  spec.input_height = height;
+  spec.scaled_width = spec.output_width = kBenchmarkOutputSize;
+  spec.scaled_height = spec.output_height = kBenchmarkOutputSize;
+  spec.scale_mode = TransformationSpec::FIT;
+  spec.rotation_degrees = degrees;
+  ImageTransformer transformer;
+  CHECK(transformer.Reset(spec).ok());
+  std::vector<uint8> output(kBenchmarkOutputSize * kBenchmarkOutputSize * 3);
+  for (auto _ : state) {
+    transformer.Transform(input.pixels.data(), width * 3, 3, output.data(),
+                          kBenchmarkOutputSize * 3);
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+
+BENCHMARK(BM_OpenCvTransform)->Apply(TransformArgs);
+BENCHMARK(BM_ImageTransformer)->Apply(TransformArgs);
+
+}  // namespace
+}  // namespace image_transformation
+}  // namespace mediapipe
@@ -27,6 +27,7 @@
 #include "mediapipe/framework/formats/image_format.pb.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
 #include "mediapipe/framework/formats/video_stream_header.h"
 #include "mediapipe/framework/formats/yuv_image.h"
 #include "mediapipe/framework/port/image_resizer.h"
@@ -179,6 +180,7 @@ class ScaleImageCalculator : public CalculatorBase {
       cc->Outputs().Get(output_data_id).Set<YUVImage>();
     } else {
       cc->Outputs().Get(output_data_id).Set<ImageFrame>();
+      cc->UseService(kImageFramePoolService).Optional();
     }
 
     if (cc->Inputs().HasTag("OVERRIDE_OPTIONS")) {
@@ -238,6 +240,8 @@ class ScaleImageCalculator : public CalculatorBase {
 
   // The alignment boundary that newly created images should have.
   int alignment_boundary_;
+  // Recycles the cropped and downscaled frames, if the graph provides a pool.
+  ImageFramePool* image_frame_pool_ = nullptr;
 
   ScaleImageCalculatorOptions options_;
 
@@ -317,6 +321,10 @@ ScaleImageCalculator::~ScaleImageCalculator() {}
   // The output packets are at the same timestamp as the input.
   cc->Outputs().Get(output_data_id_).SetOffset(mediapipe::TimestampDiff(0));
 
+  if (cc->Service(kImageFramePoolService).IsAvailable()) {
+    image_frame_pool_ = &cc->Service(kImageFramePoolService).GetObject();
+  }
+
   has_header_ = false;
   input_width_ = 0;
   input_height_ = 0;
@@ -603,8 +611,9 @@ ScaleImageCalculator::~ScaleImageCalculator() {}
   if (crop_width_ < input_width_ || crop_height_ < input_height_) {
     cc->GetCounter("Crops")->Increment();
     // TODO Do the crop as a range restrict inside OpenCV code below.
-    cropped_image.reset(new ImageFrame(image_frame->Format(), crop_width_,
-                                       crop_height_, alignment_boundary_));
+    cropped_image = MakeImageFrame(image_frame_pool_, image_frame->Format(),
+                                   crop_width_, crop_height_,
+                                   alignment_boundary_);
     if (image_frame->ByteDepth() == 1 || image_frame->ByteDepth() == 2) {
       CropImageFrame(*image_frame, col_start_, row_start_, crop_width_,
                      crop_height_, cropped_image.get());
@@ -657,19 +666,21 @@ ScaleImageCalculator::~ScaleImageCalculator() {}
   }
 
   // Rescale the image frame.
-  std::unique_ptr<ImageFrame> output_frame(new ImageFrame());
+  std::unique_ptr<ImageFrame> output_frame;
   if (image_frame->Width() >= output_width_ &&
       image_frame->Height() >= output_height_) {
     // Downscale.
     cc->GetCounter("Downscales")->Increment();
     cv::Mat input_mat = ::mediapipe::formats::MatView(image_frame);
-    output_frame->Reset(image_frame->Format(), output_width_, output_height_,
-                        alignment_boundary_);
+    output_frame =
+        MakeImageFrame(image_frame_pool_, image_frame->Format(), output_width_,
+                       output_height_, alignment_boundary_);
     cv::Mat output_mat = ::mediapipe::formats::MatView(output_frame.get());
     downscaler_->Resize(input_mat, &output_mat);
   } else {
     // Upscale. If upscaling is disallowed, output_width_ and output_height_ are
     // the same as the input/crop width and height.
+    output_frame = absl::make_unique<ImageFrame>();
     image_frame_util::RescaleImageFrame(
         *image_frame, output_width_, output_height_, alignment_boundary_,
         interpolation_algorithm_, output_frame.get());
@@ -0,0 +1,86 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensorflow/frozen_graph_session.h"
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/shared_file_cache.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/public/session_options.h"
+
+#if defined(MEDIAPIPE_LITE) || defined(__ANDROID__) || \
+    defined(__APPLE__) && !TARGET_OS_OSX
+#include "mediapipe/util/android/file/base/helpers.h"
+#else
+#include "mediapipe/framework/port/file_helpers.h"
+#endif
+
+namespace mediapipe {
+
+namespace tf = ::tensorflow;
+
+namespace {
+
+SharedFileCache<tf::Session>* SessionCache() {
+  static auto* cache = new SharedFileCache<tf::Session>();
+  return cache;
+}
+
+}  // namespace
+
+::mediapipe::StatusOr<std::unique_ptr<tf::Session>> CreateFrozenGraphSession(
+    const std::string& graph_def_serialized, const tf::ConfigProto& config,
+    const std::vector<std::string>& initialization_op_names) {
+  tf::SessionOptions session_options;
+  session_options.config.CopyFrom(config);
+  std::unique_ptr<tf::Session> session(tf::NewSession(session_options));
+  RET_CHECK(session) << "Failed to create a TensorFlow session.";
+
+  tf::GraphDef graph_def;
+  RET_CHECK(graph_def.ParseFromString(graph_def_serialized));
+  const tf::Status tf_status = session->Create(graph_def);
+  RET_CHECK(tf_status.ok()) << "Create failed: " << tf_status.error_message();
+
+  if (!initialization_op_names.empty()) {
+    const tf::Status tf_status =
+        session->Run({}, {}, initialization_op_names, {});
+    // RET_CHECK on the tf::Status object itself in order to print an
+    // informative error message.
+    RET_CHECK(tf_status.ok()) << "Run failed: " << tf_status.error_message();
+  }
+  return std::move(session);
+}
+
+::mediapipe::StatusOr<std::shared_ptr<tf::Session>>
+GetSharedFrozenGraphSession(
+    const std::string& graph_path, const tf::ConfigProto& config,
+    const std::vector<std::string>& initialization_op_names) {
+  const std::string variant =
+      absl::StrCat(config.SerializeAsString(), "\n",
+                   absl::StrJoin(initialization_op_names, ","));
+  return SessionCache()->Get(
+      graph_path, variant,
+      [&]() -> ::mediapipe::StatusOr<std::unique_ptr<tf::Session>> {
+        std::string graph_def_serialized;
+        MP_RETURN_IF_ERROR(
+            mediapipe::file::GetContents(graph_path, &graph_def_serialized));
+        return CreateFrozenGraphSession(graph_def_serialized, config,
+                                        initialization_op_names);
+      });
+}
+
+}  // namespace mediapipe
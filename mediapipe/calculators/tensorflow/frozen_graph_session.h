@@ -0,0 +1,53 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Creates TensorFlow sessions for the frozen graphs loaded by
+// TensorFlowSessionFromFrozenGraphCalculator and
+// TensorFlowSessionFromFrozenGraphGenerator.
+
+#ifndef MEDIAPIPE_CALCULATORS_TENSORFLOW_FROZEN_GRAPH_SESSION_H_
+#define MEDIAPIPE_CALCULATORS_TENSORFLOW_FROZEN_GRAPH_SESSION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mediapipe/framework/port/statusor.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace mediapipe {
+
+// Creates a session with `config` for the serialized GraphDef
+// `graph_def_serialized`, and runs `initialization_op_names` in it.
+::mediapipe::StatusOr<std::unique_ptr<tensorflow::Session>>
+CreateFrozenGraphSession(
+    const std::string& graph_def_serialized,
+    const tensorflow::ConfigProto& config,
+    const std::vector<std::string>& initialization_op_names);
+
+// Like CreateFrozenGraphSession(), for the GraphDef in the file at
+// `graph_path`. The session is created once per process and shared by every
+// calculator and graph that loads the same version of the file with the same
+// config and initialization ops, while any of them holds it. Session::Run()
+// is thread-safe, and the constants of the graph are held in memory once
+// however many pipelines run it.
+::mediapipe::StatusOr<std::shared_ptr<tensorflow::Session>>
+GetSharedFrozenGraphSession(
+    const std::string& graph_path, const tensorflow::ConfigProto& config,
+    const std::vector<std::string>& initialization_op_names);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TENSORFLOW_FROZEN_GRAPH_SESSION_H_
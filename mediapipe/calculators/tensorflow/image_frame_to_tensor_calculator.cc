@@ -20,6 +20,8 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/util/image_normalization.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
@@ -29,6 +31,9 @@ namespace mediapipe {
 namespace tf = tensorflow;
 
 namespace {
+// Counts the frames that are copied although alias_image_frame is set.
+constexpr char kUnaliasedFramesCounter[] = "Unaliased Frames";
+
 // Convert the ImageFrame into Tensor with floating point value type.
 // The value will be normalized based on mean and stddev.
 std::unique_ptr<tf::Tensor> ImageFrameToNormalizedTensor(
@@ -36,20 +41,60 @@ std::unique_ptr<tf::Tensor> ImageFrameToNormalizedTensor(
   const int cols = image_frame.Width();
   const int rows = image_frame.Height();
   const int channels = image_frame.NumberOfChannels();
-  const uint8* pixel = image_frame.PixelData();
-  const int width_padding = image_frame.WidthStep() - cols * channels;
   auto tensor = ::absl::make_unique<tf::Tensor>(
       tf::DT_FLOAT, tf::TensorShape({rows, cols, channels}));
-  auto tensor_data = tensor->tensor<float, 3>();
+  // (pixel - mean) / stddev, as the multiply-add of the vectorized kernel.
+  NormalizeUint8Image(image_frame.PixelData(), image_frame.WidthStep(), cols,
+                      rows, channels, channels, 1.0f / stddev, -mean / stddev,
+                      /*flip_vertically=*/false, tensor->flat<float>().data());
+  return tensor;
+}
 
-  for (int row = 0; row < rows; ++row) {
-    for (int col = 0; col < cols; ++col) {
-      for (int channel = 0; channel < channels; ++channel) {
-        tensor_data(row, col, channel) = (pixel[channel] - mean) / stddev;
-      }
-      pixel += channels;
-    }
-    pixel += width_padding;
+// A TensorBuffer pointing at the pixels of an ImageFrame, which it keeps
+// alive by holding the packet of the frame.
+class ImageFrameTensorBuffer : public tf::TensorBuffer {
+ public:
+  explicit ImageFrameTensorBuffer(const Packet& image_frame_packet)
+      : tf::TensorBuffer(const_cast<uint8*>(
+            image_frame_packet.Get<ImageFrame>().PixelData())),
+        image_frame_packet_(image_frame_packet) {}
+
+  size_t size() const override {
+    return image_frame_packet_.Get<ImageFrame>().PixelDataSize();
+  }
+  tf::TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(
+      tf::AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size());
+    proto->set_allocator_name("ImageFrame");
+  }
+  // The pixels belong to the ImageFrame, which is immutable, so TensorFlow
+  // must not write op outputs into them.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const Packet image_frame_packet_;
+};
+
+// Returns a tensor aliasing the pixels of the ImageFrame in
+// `image_frame_packet`, or null if the frame cannot be aliased. Frames that
+// ImageFrame or ImageFramePool allocated start at
+// ImageFrame::kPixelDataAlignmentBoundary, which meets the alignment that
+// TensorFlow requires, so only frames with padded rows or adopted pixel data
+// are copied.
+std::unique_ptr<tf::Tensor> ImageFramePacketToAliasingTensor(
+    const Packet& image_frame_packet, tf::DataType data_type,
+    const tf::TensorShape& tensor_shape) {
+  if (!image_frame_packet.Get<ImageFrame>().IsContiguous()) {
+    return nullptr;
+  }
+  auto* buffer = new ImageFrameTensorBuffer(image_frame_packet);
+  auto tensor =
+      ::absl::make_unique<tf::Tensor>(data_type, tensor_shape, buffer);
+  // The tensor holds its own reference.
+  buffer->Unref();
+  if (!tensor->IsAligned()) {
+    return nullptr;
   }
   return tensor;
 }
@@ -68,7 +113,10 @@ std::unique_ptr<tf::Tensor> ImageFrameToNormalizedTensor(
 // for the first three types, DT_UINT16 for GRAY16, and DT_FLOAT for VEC32F1.
 //
 // The ImageFrame data can be packed or padded. The pixel data will be copied
-// to the Tensor in row-major order.
+// to the Tensor in row-major order, unless alias_image_frame is set and the
+// Tensor can point at the pixels of a packed ImageFrame instead. Frames that
+// are copied although alias_image_frame is set are counted in the
+// "Unaliased Frames" counter.
 //
 // Example config:
 //  node {
@@ -157,19 +205,28 @@ REGISTER_CALCULATOR(ImageFrameToTensorCalculator);
         << "Tensor data type does not support memcpy (type=" << data_type
         << ")";
 
-    // Create the output tensor.
-    tensor = ::absl::make_unique<tf::Tensor>(data_type, tensor_shape);
-
-    // Copy pixel data from the ImageFrame to the tensor.
-    if (data_type == tf::DT_UINT8) {
-      uint8* dst = tensor->flat<uint8>().data();
-      video_frame.CopyToBuffer(dst, num_components);
-    } else if (data_type == tf::DT_UINT16) {
-      uint16* dst = tensor->flat<uint16>().data();
-      video_frame.CopyToBuffer(dst, num_components);
-    } else {
-      float* dst = tensor->flat<float>().data();
-      video_frame.CopyToBuffer(dst, num_components);
+    if (options_.alias_image_frame()) {
+      tensor = ImageFramePacketToAliasingTensor(input_item, data_type,
+                                                tensor_shape);
+      if (!tensor) {
+        cc->GetCounter(kUnaliasedFramesCounter)->Increment();
+      }
+    }
+    if (!tensor) {
+      // Create the output tensor.
+      tensor = ::absl::make_unique<tf::Tensor>(data_type, tensor_shape);
+
+      // Copy pixel data from the ImageFrame to the tensor.
+      if (data_type == tf::DT_UINT8) {
+        uint8* dst = tensor->flat<uint8>().data();
+        video_frame.CopyToBuffer(dst, num_components);
+      } else if (data_type == tf::DT_UINT16) {
+        uint16* dst = tensor->flat<uint16>().data();
+        video_frame.CopyToBuffer(dst, num_components);
+      } else {
+        float* dst = tensor->flat<float>().data();
+        video_frame.CopyToBuffer(dst, num_components);
+      }
     }
   }
 
@@ -19,11 +19,14 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/status_matchers.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/mem.h"
 
 namespace mediapipe {
 
@@ -454,4 +457,147 @@ TEST_F(ImageFrameToTensorCalculatorTest, FixedRGBFrameWithMeanAndStddev) {
   EXPECT_EQ(actual[2], 127.0f / 128.0f);  // (255 - 128) / 128
 }
 
+TEST_F(ImageFrameToTensorCalculatorTest, AliasesPackedFrame) {
+  runner_ = ::absl::make_unique<CalculatorRunner>(
+      "ImageFrameToTensorCalculator",
+      "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+      "{alias_image_frame:true}",
+      1, 1, 0);
+
+  // A packed frame with pixels at TensorFlow's alignment.
+  const int width = 8;
+  const int height = 4;
+  uint8* pixels = static_cast<uint8*>(
+      tf::port::AlignedMalloc(width * height * 3, EIGEN_MAX_ALIGN_BYTES));
+  auto image_frame = ::absl::make_unique<ImageFrame>(
+      ImageFormat::SRGB, width, height, width * 3, pixels,
+      [](uint8* data) { tf::port::AlignedFree(data); });
+  const uint8 color[] = {kRed, kGreen, kBlue};
+  SetToColor<uint8>(color, image_frame.get());
+  runner_->MutableInputs()->Index(0).packets.push_back(
+      Adopt(image_frame.release()).At(Timestamp(0)));
+  MP_ASSERT_OK(runner_->Run());
+
+  const tf::Tensor tensor =
+      runner_->Outputs().Index(0).packets[0].Get<tf::Tensor>();
+  EXPECT_EQ(tensor.dtype(), tf::DT_UINT8);
+  ASSERT_EQ(tensor.dims(), 3);
+  EXPECT_EQ(tensor.shape().dim_size(0), height);
+  EXPECT_EQ(tensor.shape().dim_size(1), width);
+  EXPECT_EQ(tensor.shape().dim_size(2), 3);
+  // The tensor points at the frame, which it keeps alive.
+  runner_.reset();
+  EXPECT_EQ(tensor.tensor_data().data(), reinterpret_cast<char*>(pixels));
+  const uint8* data = tensor.flat<uint8>().data();
+  for (int i = 0; i < width * height; ++i) {
+    ASSERT_EQ(kRed, data[3 * i]);
+    ASSERT_EQ(kGreen, data[3 * i + 1]);
+    ASSERT_EQ(kBlue, data[3 * i + 2]);
+  }
+}
+
+TEST_F(ImageFrameToTensorCalculatorTest, AliasesDefaultImageFrame) {
+  runner_ = ::absl::make_unique<CalculatorRunner>(
+      "ImageFrameToTensorCalculator",
+      "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+      "{alias_image_frame:true}",
+      1, 1, 0);
+  // Rows of 16 RGB pixels fill whole rows of the default alignment.
+  AddRGBFrame(16, 4);
+  const uint8* pixels = runner_->MutableInputs()
+                            ->Index(0)
+                            .packets[0]
+                            .Get<ImageFrame>()
+                            .PixelData();
+  MP_ASSERT_OK(runner_->Run());
+
+  const auto& tensor = runner_->Outputs().Index(0).packets[0].Get<tf::Tensor>();
+  EXPECT_EQ(tensor.tensor_data().data(),
+            reinterpret_cast<const char*>(pixels));
+  EXPECT_EQ(0, runner_->GetCounter("Unaliased Frames")->Get());
+}
+
+TEST_F(ImageFrameToTensorCalculatorTest, CopiesPaddedFrameWhenAliasing) {
+  runner_ = ::absl::make_unique<CalculatorRunner>(
+      "ImageFrameToTensorCalculator",
+      "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+      "{alias_image_frame:true}",
+      1, 1, 0);
+  // Rows of 3 RGB pixels are padded to the 16 byte alignment boundary.
+  AddRGBFrame(3, 2);
+  const uint8* pixels = runner_->MutableInputs()
+                            ->Index(0)
+                            .packets[0]
+                            .Get<ImageFrame>()
+                            .PixelData();
+  MP_ASSERT_OK(runner_->Run());
+
+  const auto& tensor = runner_->Outputs().Index(0).packets[0].Get<tf::Tensor>();
+  EXPECT_NE(tensor.tensor_data().data(),
+            reinterpret_cast<const char*>(pixels));
+  EXPECT_EQ(1, runner_->GetCounter("Unaliased Frames")->Get());
+  const uint8* data = tensor.flat<uint8>().data();
+  for (int i = 0; i < 3 * 2; ++i) {
+    ASSERT_EQ(kRed, data[3 * i]);
+    ASSERT_EQ(kGreen, data[3 * i + 1]);
+    ASSERT_EQ(kBlue, data[3 * i + 2]);
+  }
+}
+
+TEST_F(ImageFrameToTensorCalculatorTest, RandomRGBFrameWithMeanAndStddev) {
+  runner_ = ::absl::make_unique<CalculatorRunner>(
+      "ImageFrameToTensorCalculator",
+      "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+      "{data_type:DT_FLOAT mean:127.5 stddev:58.4}",
+      1, 1, 0);
+  // An odd width pads the rows and leaves a tail for the vectorized kernel.
+  const int width = 37;
+  const int height = kFixedNoiseHeight;
+  AddRandomRGBFrame(width, height, 1234);
+  const ImageFrame& image_frame =
+      runner_->MutableInputs()->Index(0).packets[0].Get<ImageFrame>();
+  MP_ASSERT_OK(runner_->Run());
+
+  const auto& tensor = runner_->Outputs().Index(0).packets[0].Get<tf::Tensor>();
+  EXPECT_EQ(tensor.dtype(), tf::DT_FLOAT);
+  const float* actual = tensor.flat<float>().data();
+  for (int row = 0; row < height; ++row) {
+    const uint8* pixel =
+        image_frame.PixelData() + row * image_frame.WidthStep();
+    for (int i = 0; i < width * 3; ++i) {
+      EXPECT_NEAR((pixel[i] - 127.5f) / 58.4f, *actual++, 1e-5);
+    }
+  }
+}
+
+// Converts kBenchmarkFrames 640x480 RGB frames with the calculator options
+// `options`.
+void BM_ImageFrameToTensor(benchmark::State& state, const char* options) {
+  constexpr int kBenchmarkFrames = 32;
+  for (auto _ : state) {
+    state.PauseTiming();
+    CalculatorRunner runner("ImageFrameToTensorCalculator", options, 1, 1, 0);
+    for (int i = 0; i < kBenchmarkFrames; ++i) {
+      // 640 RGB pixels fill whole rows of the default alignment.
+      auto image_frame =
+          ::absl::make_unique<ImageFrame>(ImageFormat::SRGB, 640, 480);
+      image_frame->SetToZero();
+      runner.MutableInputs()->Index(0).packets.push_back(
+          Adopt(image_frame.release()).At(Timestamp(i)));
+    }
+    state.ResumeTiming();
+    MEDIAPIPE_CHECK_OK(runner.Run());
+    // Makes sure that the Alias benchmark does not measure copies.
+    CHECK_EQ(0, runner.GetCounter("Unaliased Frames")->Get());
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchmarkFrames);
+}
+BENCHMARK_CAPTURE(BM_ImageFrameToTensor, Copy, "");
+BENCHMARK_CAPTURE(BM_ImageFrameToTensor, Alias,
+                  "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+                  "{alias_image_frame:true}");
+BENCHMARK_CAPTURE(BM_ImageFrameToTensor, Normalize,
+                  "[mediapipe.ImageFrameToTensorCalculatorOptions.ext]"
+                  "{data_type:DT_FLOAT mean:127.5 stddev:127.5}");
+
 }  // namespace mediapipe
@@ -12,10 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "mediapipe/calculators/image/opencv_image_encoder_calculator.pb.h"
 #include "mediapipe/calculators/tensorflow/pack_media_sequence_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -25,10 +31,16 @@
 #include "mediapipe/framework/port/opencv_imgcodecs_inc.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/port/threadpool.h"
 #include "mediapipe/util/sequence/media_sequence.h"
 #include "mediapipe/util/sequence/media_sequence_util.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
 
 namespace mediapipe {
 
@@ -39,6 +51,7 @@ const char kForwardFlowEncodedTag[] = "FORWARD_FLOW_ENCODED";
 const char kBBoxTag[] = "BBOX";
 const char kKeypointsTag[] = "KEYPOINTS";
 const char kSegmentationMaskTag[] = "CLASS_SEGMENTATION";
+const char kTFRecordPathTag[] = "TFRECORD_PATH";
 
 namespace tf = ::tensorflow;
 namespace mpms = ::mediapipe::mediasequence;
@@ -61,6 +74,13 @@ namespace mpms = ::mediapipe::mediasequence;
 // each stream, which allows for multiple image streams to be included. However,
 // the default names are suppored by more tools.
 //
+// The SequenceExample is emitted on the "SEQUENCE_EXAMPLE" output stream or
+// output side packet. If the "TFRECORD_PATH" input side packet is set, it is
+// also serialized and written to that TFRecord file, on a thread of the
+// calculator so that writing overlaps with processing. Long videos can set
+// chunk_duration_us to emit the sequence in chunks as it is packed, rather
+// than hold all of it until Close(). See the options for details.
+//
 // Example config:
 // node {
 //   calculator: "PackMediaSequenceCalculator"
@@ -150,10 +170,19 @@ class PackMediaSequenceCalculator : public CalculatorBase {
       }
     }
 
+    if (cc->InputSidePackets().HasTag(kTFRecordPathTag)) {
+      cc->InputSidePackets().Tag(kTFRecordPathTag).Set<std::string>();
+    }
     CHECK(cc->Outputs().HasTag(kSequenceExampleTag) ||
-          cc->OutputSidePackets().HasTag(kSequenceExampleTag))
-        << "Neither the output stream nor the output side packet is set to "
-           "output the sequence example.";
+          cc->OutputSidePackets().HasTag(kSequenceExampleTag) ||
+          cc->InputSidePackets().HasTag(kTFRecordPathTag))
+        << "Neither the output stream, the output side packet nor a TFRecord "
+           "file is set to output the sequence example.";
+    const auto& options = cc->Options<PackMediaSequenceCalculatorOptions>();
+    RET_CHECK(options.chunk_duration_us() == 0 ||
+              !cc->OutputSidePackets().HasTag(kSequenceExampleTag))
+        << "chunk_duration_us is not supported with the output side packet.";
+    RET_CHECK_GT(options.max_pending_records(), 0);
     if (cc->Outputs().HasTag(kSequenceExampleTag)) {
       cc->Outputs().Tag(kSequenceExampleTag).Set<tf::SequenceExample>();
     }
@@ -229,14 +258,32 @@ class PackMediaSequenceCalculator : public CalculatorBase {
       }
     }
 
-    if (cc->Outputs().HasTag(kSequenceExampleTag)) {
+    const auto& options = cc->Options<PackMediaSequenceCalculatorOptions>();
+    chunk_duration_us_ = options.chunk_duration_us();
+    if (chunk_duration_us_ > 0) {
+      // Only the first chunk keeps the feature lists of the side packet.
+      later_chunk_template_ = *sequence_;
+      later_chunk_template_.clear_feature_lists();
+    } else if (cc->Outputs().HasTag(kSequenceExampleTag)) {
       cc->Outputs()
           .Tag(kSequenceExampleTag)
           .SetNextTimestampBound(Timestamp::Max());
     }
+
+    if (cc->InputSidePackets().HasTag(kTFRecordPathTag)) {
+      tfrecord_path_ =
+          cc->InputSidePackets().Tag(kTFRecordPathTag).Get<std::string>();
+      records_per_shard_ = options.records_per_shard();
+      max_pending_records_ = options.max_pending_records();
+      writer_thread_ =
+          absl::make_unique<ThreadPool>("pack_media_sequence_writer", 1);
+      writer_thread_->StartWorkers();
+    }
     return ::mediapipe::OkStatus();
   }
 
+  ~PackMediaSequenceCalculator() override { FinishWrites().IgnoreError(); }
+
   ::mediapipe::Status VerifySequence() {
     std::string error_msg = "Missing features - ";
     bool all_present = true;
@@ -254,6 +301,9 @@ class PackMediaSequenceCalculator : public CalculatorBase {
   }
 
   ::mediapipe::Status Close(CalculatorContext* cc) override {
+    if (!sequence_) {
+      return FinishWrites();
+    }
     auto& options = cc->Options<PackMediaSequenceCalculatorOptions>();
     if (options.reconcile_metadata()) {
       RET_CHECK_OK(mpms::ReconcileMetadata(
@@ -265,6 +315,7 @@ class PackMediaSequenceCalculator : public CalculatorBase {
       ::mediapipe::Status status = VerifySequence();
       if (!status.ok()) {
         cc->GetCounter(status.error_message())->Increment();
+        FinishWrites().IgnoreError();
         return status;
       }
     }
@@ -274,17 +325,155 @@ class PackMediaSequenceCalculator : public CalculatorBase {
           .Tag(kSequenceExampleTag)
           .Set(MakePacket<tensorflow::SequenceExample>(*sequence_));
     }
+    ::mediapipe::Status status = EmitSequence(
+        cc, std::move(sequence_),
+        chunk_start_ != Timestamp::Unset() ? chunk_start_
+                                           : Timestamp::PostStream());
+    status.Update(FinishWrites());
+    return status;
+  }
+
+  // Emits the chunk being packed and starts the next one. Like the whole
+  // sequence in Close(), each chunk must have all of its features if
+  // output_only_if_all_present is set.
+  ::mediapipe::Status FinishChunk(CalculatorContext* cc) {
+    auto& options = cc->Options<PackMediaSequenceCalculatorOptions>();
+    if (options.reconcile_metadata()) {
+      RET_CHECK_OK(mpms::ReconcileMetadata(
+          options.reconcile_bbox_annotations(),
+          options.reconcile_region_annotations(), sequence_.get()));
+    }
+
+    if (options.output_only_if_all_present()) {
+      ::mediapipe::Status status = VerifySequence();
+      if (!status.ok()) {
+        cc->GetCounter(status.error_message())->Increment();
+        return status;
+      }
+    }
+
+    // Start the next chunk first, so that a write error leaves a sequence for
+    // Close() to work on.
+    std::unique_ptr<tf::SequenceExample> chunk = std::move(sequence_);
+    sequence_ = ::absl::make_unique<tf::SequenceExample>(later_chunk_template_);
+    for (auto& feature : features_present_) {
+      feature.second = false;
+    }
+    return EmitSequence(cc, std::move(chunk), chunk_start_);
+  }
+
+  // Sends `sequence` to the output stream at `timestamp`, and to the TFRecord
+  // file.
+  ::mediapipe::Status EmitSequence(
+      CalculatorContext* cc, std::unique_ptr<tf::SequenceExample> sequence_ptr,
+      Timestamp timestamp) {
+    Packet sequence = Adopt(sequence_ptr.release()).At(timestamp);
     if (cc->Outputs().HasTag(kSequenceExampleTag)) {
-      cc->Outputs()
-          .Tag(kSequenceExampleTag)
-          .Add(sequence_.release(), Timestamp::PostStream());
+      cc->Outputs().Tag(kSequenceExampleTag).AddPacket(sequence);
+    }
+    if (writer_thread_) {
+      MP_RETURN_IF_ERROR(WriteSequence(sequence));
+    }
+    return ::mediapipe::OkStatus();
+  }
+
+  // Queues the SequenceExample in `sequence` for the writer thread, first
+  // waiting for room in the queue. Returns the error of an earlier write.
+  ::mediapipe::Status WriteSequence(const Packet& sequence) {
+    absl::MutexLock lock(&write_mutex_);
+    write_mutex_.Await(absl::Condition(
+        this, &PackMediaSequenceCalculator::CanQueueWrite));
+    MP_RETURN_IF_ERROR(write_status_);
+    ++pending_records_;
+    writer_thread_->Schedule([this, sequence] {
+      ::mediapipe::Status status =
+          WriteRecord(sequence.Get<tf::SequenceExample>());
+      absl::MutexLock lock(&write_mutex_);
+      --pending_records_;
+      write_status_.Update(status);
+    });
+    return ::mediapipe::OkStatus();
+  }
+
+  bool CanQueueWrite() const EXCLUSIVE_LOCKS_REQUIRED(write_mutex_) {
+    return pending_records_ < max_pending_records_ || !write_status_.ok();
+  }
+
+  // Writes `sequence` to the current TFRecord file, starting a new shard if
+  // needed. Runs on the writer thread.
+  ::mediapipe::Status WriteRecord(const tf::SequenceExample& sequence) {
+    {
+      absl::MutexLock lock(&write_mutex_);
+      if (!write_status_.ok()) {
+        return ::mediapipe::OkStatus();
+      }
+    }
+    if (!record_writer_ ||
+        (records_per_shard_ > 0 && records_in_shard_ == records_per_shard_)) {
+      MP_RETURN_IF_ERROR(CloseShard());
+      std::string path = tfrecord_path_;
+      if (records_per_shard_ > 0) {
+        absl::StrAppend(&path, "-", absl::Dec(num_shards_, absl::kZeroPad5));
+      }
+      ++num_shards_;
+      const tf::Status tf_status =
+          tf::Env::Default()->NewWritableFile(path, &file_);
+      RET_CHECK(tf_status.ok())
+          << "Failed to open tfrecord file: " << tf_status.error_message();
+      record_writer_ = ::absl::make_unique<tf::io::RecordWriter>(file_.get());
+      records_in_shard_ = 0;
     }
-    sequence_.reset();
+    std::string record;
+    RET_CHECK(sequence.SerializeToString(&record));
+    const tf::Status tf_status = record_writer_->WriteRecord(record);
+    RET_CHECK(tf_status.ok())
+        << "Failed to write tfrecord: " << tf_status.error_message();
+    ++records_in_shard_;
+    return ::mediapipe::OkStatus();
+  }
 
+  // Closes the current TFRecord file, if any.
+  ::mediapipe::Status CloseShard() {
+    if (!record_writer_) {
+      return ::mediapipe::OkStatus();
+    }
+    tf::Status tf_status = record_writer_->Close();
+    if (tf_status.ok()) {
+      tf_status = file_->Close();
+    }
+    record_writer_.reset();
+    file_.reset();
+    RET_CHECK(tf_status.ok())
+        << "Failed to close tfrecord file: " << tf_status.error_message();
     return ::mediapipe::OkStatus();
   }
 
+  // Waits for the queued writes and closes the TFRecord file. Returns the
+  // first write error.
+  ::mediapipe::Status FinishWrites() {
+    if (!writer_thread_) {
+      return ::mediapipe::OkStatus();
+    }
+    // The writer thread runs the queued writes before it stops.
+    writer_thread_.reset();
+    absl::MutexLock lock(&write_mutex_);
+    write_status_.Update(CloseShard());
+    return write_status_;
+  }
+
   ::mediapipe::Status Process(CalculatorContext* cc) override {
+    if (chunk_duration_us_ > 0) {
+      const int64 timestamp = cc->InputTimestamp().Value();
+      if (chunk_start_ == Timestamp::Unset()) {
+        chunk_start_ = cc->InputTimestamp();
+      } else if (timestamp - chunk_start_.Value() >= chunk_duration_us_) {
+        MP_RETURN_IF_ERROR(FinishChunk(cc));
+        // Chunks keep a fixed duration, and skip spans without inputs.
+        const int64 offset = timestamp - chunk_start_.Value();
+        chunk_start_ = Timestamp(timestamp - offset % chunk_duration_us_);
+      }
+    }
+
     int image_height = -1;
     int image_width = -1;
     // Because the tag order may vary, we need to loop through tags to get
@@ -460,6 +649,27 @@ class PackMediaSequenceCalculator : public CalculatorBase {
 
   std::unique_ptr<tf::SequenceExample> sequence_;
   std::map<std::string, bool> features_present_;
+
+  // With chunk_duration_us, the start of the chunk being packed, and the
+  // sequence each later chunk starts from.
+  int64 chunk_duration_us_ = 0;
+  Timestamp chunk_start_ = Timestamp::Unset();
+  tf::SequenceExample later_chunk_template_;
+
+  // With a TFRECORD_PATH, the thread writing the sequences, and the state of
+  // the writes. The TFRecord file is only used by the writer thread while it
+  // runs.
+  std::string tfrecord_path_;
+  int records_per_shard_ = 0;
+  int max_pending_records_ = 0;
+  std::unique_ptr<ThreadPool> writer_thread_;
+  std::unique_ptr<tf::WritableFile> file_;
+  std::unique_ptr<tf::io::RecordWriter> record_writer_;
+  int records_in_shard_ = 0;
+  int num_shards_ = 0;
+  absl::Mutex write_mutex_;
+  int pending_records_ GUARDED_BY(write_mutex_) = 0;
+  ::mediapipe::Status write_status_ GUARDED_BY(write_mutex_);
 };
 REGISTER_CALCULATOR(PackMediaSequenceCalculator);
 
@@ -16,6 +16,7 @@
 
 #include "absl/memory/memory.h"
 #include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "mediapipe/calculators/image/opencv_image_encoder_calculator.pb.h"
 #include "mediapipe/calculators/tensorflow/pack_media_sequence_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -31,6 +32,9 @@
 #include "mediapipe/util/sequence/media_sequence.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
 
 namespace mediapipe {
 namespace {
@@ -59,9 +63,58 @@ class PackMediaSequenceCalculatorTest : public ::testing::Test {
     runner_ = ::absl::make_unique<CalculatorRunner>(config);
   }
 
+  // Sets up a calculator packing the "FLOAT_FEATURE_TEST" stream in chunks,
+  // also writing them to TFRecord files if `tfrecord_path` is not empty.
+  void SetUpChunkingCalculator(int64 chunk_duration_us,
+                               const std::string& tfrecord_path,
+                               int records_per_shard) {
+    CalculatorGraphConfig::Node config;
+    config.set_calculator("PackMediaSequenceCalculator");
+    config.add_input_side_packet("SEQUENCE_EXAMPLE:input_sequence");
+    if (!tfrecord_path.empty()) {
+      config.add_input_side_packet("TFRECORD_PATH:tfrecord_path");
+    }
+    config.add_output_stream("SEQUENCE_EXAMPLE:output_sequence");
+    config.add_input_stream("FLOAT_FEATURE_TEST:test");
+    auto options = config.mutable_options()->MutableExtension(
+        PackMediaSequenceCalculatorOptions::ext);
+    options->set_chunk_duration_us(chunk_duration_us);
+    options->set_records_per_shard(records_per_shard);
+    runner_ = ::absl::make_unique<CalculatorRunner>(config);
+    auto input_sequence = ::absl::make_unique<tf::SequenceExample>();
+    mpms::SetClipMediaId("test_video", input_sequence.get());
+    runner_->MutableSidePackets()->Tag("SEQUENCE_EXAMPLE") =
+        Adopt(input_sequence.release());
+    if (!tfrecord_path.empty()) {
+      runner_->MutableSidePackets()->Tag("TFRECORD_PATH") =
+          MakePacket<std::string>(tfrecord_path);
+    }
+    for (int i = 0; i < 10; ++i) {
+      runner_->MutableInputs()->Tag("FLOAT_FEATURE_TEST").packets.push_back(
+          MakePacket<std::vector<float>>(2, i).At(Timestamp(i)));
+    }
+  }
+
   std::unique_ptr<CalculatorRunner> runner_;
 };
 
+// Returns the SequenceExamples in the TFRecord file at `path`.
+std::vector<tf::SequenceExample> ReadSequences(const std::string& path) {
+  std::vector<tf::SequenceExample> sequences;
+  std::unique_ptr<tf::RandomAccessFile> file;
+  if (!tf::Env::Default()->NewRandomAccessFile(path, &file).ok()) {
+    return sequences;
+  }
+  tf::io::RecordReader reader(file.get(), tf::io::RecordReaderOptions());
+  tf::uint64 offset = 0;
+  std::string record;
+  while (reader.ReadRecord(&offset, &record).ok()) {
+    sequences.emplace_back();
+    sequences.back().ParseFromString(record);
+  }
+  return sequences;
+}
+
 TEST_F(PackMediaSequenceCalculatorTest, PacksTwoImages) {
   SetUpCalculator({"IMAGE:images"}, {}, false, true);
   auto input_sequence = ::absl::make_unique<tf::SequenceExample>();
@@ -194,6 +247,84 @@ TEST_F(PackMediaSequenceCalculatorTest, PacksTwoFloatLists) {
   }
 }
 
+TEST_F(PackMediaSequenceCalculatorTest, PacksChunks) {
+  SetUpChunkingCalculator(4, "", 0);
+  MP_ASSERT_OK(runner_->Run());
+
+  const std::vector<Packet>& output_packets =
+      runner_->Outputs().Tag("SEQUENCE_EXAMPLE").packets;
+  ASSERT_EQ(3, output_packets.size());
+  const std::vector<int> chunk_sizes = {4, 4, 2};
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_EQ(Timestamp(4 * c), output_packets[c].Timestamp());
+    const tf::SequenceExample& chunk =
+        output_packets[c].Get<tf::SequenceExample>();
+    EXPECT_EQ("test_video", mpms::GetClipMediaId(chunk));
+    ASSERT_EQ(chunk_sizes[c], mpms::GetFeatureTimestampSize("TEST", chunk));
+    ASSERT_EQ(chunk_sizes[c], mpms::GetFeatureFloatsSize("TEST", chunk));
+    for (int i = 0; i < chunk_sizes[c]; ++i) {
+      const int timestamp = 4 * c + i;
+      EXPECT_EQ(timestamp, mpms::GetFeatureTimestampAt("TEST", chunk, i));
+      EXPECT_THAT(
+          mpms::GetFeatureFloatsAt("TEST", chunk, i),
+          ::testing::ElementsAreArray(std::vector<float>(2, timestamp)));
+    }
+  }
+}
+
+TEST_F(PackMediaSequenceCalculatorTest, WritesChunksToTFRecordShards) {
+  const std::string path =
+      absl::StrCat(::testing::TempDir(), "pack_media_sequence");
+  SetUpChunkingCalculator(4, path, 2);
+  MP_ASSERT_OK(runner_->Run());
+  ASSERT_EQ(3, runner_->Outputs().Tag("SEQUENCE_EXAMPLE").packets.size());
+
+  std::vector<tf::SequenceExample> shard0 = ReadSequences(path + "-00000");
+  std::vector<tf::SequenceExample> shard1 = ReadSequences(path + "-00001");
+  ASSERT_EQ(2, shard0.size());
+  ASSERT_EQ(1, shard1.size());
+  EXPECT_EQ(4, mpms::GetFeatureTimestampSize("TEST", shard0[0]));
+  EXPECT_EQ(4, mpms::GetFeatureTimestampAt("TEST", shard0[1], 0));
+  EXPECT_EQ(2, mpms::GetFeatureTimestampSize("TEST", shard1[0]));
+  EXPECT_EQ(8, mpms::GetFeatureTimestampAt("TEST", shard1[0], 0));
+  EXPECT_EQ("test_video", mpms::GetClipMediaId(shard1[0]));
+}
+
+TEST_F(PackMediaSequenceCalculatorTest, UnwritableTFRecordPathNotOK) {
+  const std::string path = absl::StrCat(
+      ::testing::TempDir(), "missing_directory/pack_media_sequence");
+  SetUpChunkingCalculator(4, path, 0);
+  EXPECT_FALSE(runner_->Run().ok());
+}
+
+TEST_F(PackMediaSequenceCalculatorTest, MissingStreamInChunkNotOK) {
+  CalculatorGraphConfig::Node config;
+  config.set_calculator("PackMediaSequenceCalculator");
+  config.add_input_side_packet("SEQUENCE_EXAMPLE:input_sequence");
+  config.add_output_stream("SEQUENCE_EXAMPLE:output_sequence");
+  config.add_input_stream("FLOAT_FEATURE_TEST:test");
+  config.add_input_stream("FLOAT_FEATURE_OTHER:test2");
+  auto options = config.mutable_options()->MutableExtension(
+      PackMediaSequenceCalculatorOptions::ext);
+  options->set_chunk_duration_us(4);
+  options->set_output_only_if_all_present(true);
+  runner_ = ::absl::make_unique<CalculatorRunner>(config);
+  runner_->MutableSidePackets()->Tag("SEQUENCE_EXAMPLE") =
+      Adopt(new tf::SequenceExample());
+  for (int i = 0; i < 10; ++i) {
+    runner_->MutableInputs()->Tag("FLOAT_FEATURE_TEST").packets.push_back(
+        MakePacket<std::vector<float>>(2, i).At(Timestamp(i)));
+  }
+  // Only the last chunk has the second stream.
+  for (int i = 8; i < 10; ++i) {
+    runner_->MutableInputs()->Tag("FLOAT_FEATURE_OTHER").packets.push_back(
+        MakePacket<std::vector<float>>(2, i).At(Timestamp(i)));
+  }
+
+  EXPECT_FALSE(runner_->Run().ok());
+  EXPECT_TRUE(runner_->Outputs().Tag("SEQUENCE_EXAMPLE").packets.empty());
+}
+
 TEST_F(PackMediaSequenceCalculatorTest, PacksAdditionalContext) {
   tf::Features context;
   (*context.mutable_feature())["TEST"].mutable_bytes_list()->add_value("YES");
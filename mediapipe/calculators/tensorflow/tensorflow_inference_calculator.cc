@@ -13,14 +13,20 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_split.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "mediapipe/calculators/tensorflow/tensorflow_inference_calculator.pb.h"
 #include "mediapipe/calculators/tensorflow/tensorflow_session.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -29,10 +35,12 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/port/threadpool.h"
 #include "mediapipe/framework/tool/status_util.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_util.h"
+#include "tensorflow/core/framework/types.h"
 
 #if !defined(__ANDROID__) && !defined(__APPLE__)
 #include "tensorflow/core/profiler/lib/traceme.h"
@@ -77,6 +85,105 @@ class SimpleSemaphore {
   absl::Mutex mutex_;
   absl::CondVar cond_;
 };
+
+// The input tensors of one tag for a batch. The elements are copied into a
+// tensor allocated for the whole batch as they arrive, so that running the
+// batch needs no concatenation. Elements that cannot be copied this way,
+// such as strings or tensors of varying shapes, are concatenated instead.
+class TensorBatch {
+ public:
+  // Adds `element` to a batch of up to `capacity` elements.
+  void Add(const tf::Tensor& element, int capacity) {
+    if (size_ == 0) {
+      element_shape_ = element.shape();
+      if (capacity > 1 && element.dims() > 0 &&
+          tf::DataTypeCanUseMemcpy(element.dtype())) {
+        tf::TensorShape batch_shape(element_shape_);
+        batch_shape.set_dim(0, element_shape_.dim_size(0) * capacity);
+        batch_ = tf::Tensor(element.dtype(), batch_shape);
+        element_bytes_ = element.tensor_data().size();
+        capacity_ = capacity;
+        copy_in_place_ = true;
+      }
+    }
+    if (copy_in_place_ &&
+        (element.shape() != element_shape_ || size_ >= capacity_)) {
+      FallBackToConcat();
+    }
+    if (copy_in_place_) {
+      std::memcpy(MutableElementData(size_), element.tensor_data().data(),
+                  element_bytes_);
+    } else {
+      elements_.push_back(element);
+    }
+    ++size_;
+  }
+
+  // Returns the batch of `size` elements, padded by replicating the first
+  // element, and clears this batch. `size` must be at least size().
+  ::mediapipe::Status Finish(int size, tf::Tensor* batch) {
+    RET_CHECK_GT(size_, 0);
+    RET_CHECK_GE(size, size_);
+    if (copy_in_place_ && size > capacity_) {
+      FallBackToConcat();
+    }
+    if (copy_in_place_) {
+      for (int i = size_; i < size; ++i) {
+        std::memcpy(MutableElementData(i), MutableElementData(0),
+                    element_bytes_);
+      }
+      const int64 rows = element_shape_.dim_size(0) * size;
+      // Slicing from the start keeps the alignment of the batch tensor.
+      *batch = rows == batch_.dim_size(0) ? batch_ : batch_.Slice(0, rows);
+    } else if (size == 1) {
+      // Short circuit to avoid the cost of deep copying tensors in concat.
+      *batch = elements_[0];
+    } else {
+      const tf::Tensor first = elements_[0];
+      elements_.resize(size, first);
+      const tf::Status concat_status = tf::tensor::Concat(elements_, batch);
+      RET_CHECK(concat_status.ok()) << concat_status.ToString();
+    }
+    Clear();
+    return ::mediapipe::OkStatus();
+  }
+
+  // Removes all elements.
+  void Clear() {
+    elements_.clear();
+    batch_ = tf::Tensor();
+    copy_in_place_ = false;
+    size_ = 0;
+  }
+
+  int size() const { return size_; }
+
+ private:
+  char* MutableElementData(int i) {
+    return const_cast<char*>(batch_.tensor_data().data()) + i * element_bytes_;
+  }
+
+  // Turns the elements copied so far into slices of the batch tensor.
+  void FallBackToConcat() {
+    const int64 rows = element_shape_.dim_size(0);
+    for (int i = 0; i < size_; ++i) {
+      elements_.push_back(batch_.Slice(i * rows, (i + 1) * rows));
+    }
+    batch_ = tf::Tensor();
+    copy_in_place_ = false;
+  }
+
+  // The shape of the first element.
+  tf::TensorShape element_shape_;
+  // True while the elements are copied into batch_, otherwise they are kept
+  // in elements_.
+  bool copy_in_place_ = false;
+  tf::Tensor batch_;
+  int64 element_bytes_ = 0;
+  int capacity_ = 0;
+  std::vector<tf::Tensor> elements_;
+  int size_ = 0;
+};
 }  // namespace
 
 // This calculator performs inference on a trained TensorFlow model.
@@ -110,6 +217,14 @@ class SimpleSemaphore {
 // corresponding to the input stream packets. Setting the batch_size to 1
 // completely disables batching, but is indepdent of add_batch_dim_to_tensors.
 //
+// Setting max_batch_wait_us bounds the latency that batching adds: a partial
+// batch is run once its first element has waited that long, on a thread of
+// the calculator. The Process() calls of the batch elements complete when
+// their batch has run (see CalculatorContext::DeferCompletion()), so up to
+// twice batch_size timestamps are in flight, and each output is sent with the
+// timestamp of its input. Partial batches are padded to batch_size, as at
+// Close(), unless pad_partial_batches is false.
+//
 // The TensorFlowInferenceCalculator also support feeding states recurrently for
 // RNNs and LSTMs. Simply set the recurrent_tag_pair options to define the
 // recurrent tensors. Initializing the recurrent state can be handled by the
@@ -202,6 +317,18 @@ class SimpleSemaphore {
 //   }
 class TensorFlowInferenceCalculator : public CalculatorBase {
  public:
+  // The inputs of a batch that has yet to run.
+  struct Batch {
+    // The input tensors of the batch, by tag.
+    std::map<std::string, TensorBatch> inputs;
+    // The input timestamps of the batch elements.
+    std::vector<Timestamp> timestamps;
+    // With max_batch_wait_us, the deferred calculator contexts of the batch
+    // elements, and the callbacks that complete them.
+    std::vector<CalculatorContext*> contexts;
+    std::vector<CalculatorContext::CompletionCallback> done;
+  };
+
   // Counters for recording timing information. The actual names have the value
   // of CalculatorGraphConfig::Node::name() prepended.
   static constexpr char kTotalUsecsCounterSuffix[] = "TotalTimeUsecs";
@@ -217,6 +344,8 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
         mediapipe::MonotonicClock::CreateSynchronizedMonotonicClock());
   }
 
+  ~TensorFlowInferenceCalculator() override { StopDeadlineThread(); }
+
   static ::mediapipe::Status GetContract(CalculatorContract* cc) {
     RET_CHECK(!cc->Inputs().GetTags().empty());
     for (const std::string& tag : cc->Inputs().GetTags()) {
@@ -239,6 +368,14 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
           .Tag("RECURRENT_INIT_TENSORS")
           .Set<std::unique_ptr<std::map<std::string, tf::Tensor>>>();
     }
+    const auto& options = cc->Options<TensorFlowInferenceCalculatorOptions>();
+    if (options.max_batch_wait_us() > 0) {
+      RET_CHECK_GT(options.batch_size(), 1)
+          << "max_batch_wait_us requires batch_size > 1.";
+      // The elements of a batch wait in deferred Process() calls, and the
+      // next batch can fill up while one runs.
+      cc->SetMaxInFlight(2 * options.batch_size());
+    }
     return ::mediapipe::OkStatus();
   }
 
@@ -280,8 +417,9 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
       std::map<std::string, tf::Tensor>* init_tensor_map;
       init_tensor_map = GetFromUniquePtr<std::map<std::string, tf::Tensor>>(
           cc->InputSidePackets().Tag("RECURRENT_INIT_TENSORS"));
+      absl::MutexLock lock(&mutex_);
       for (const auto& p : *init_tensor_map) {
-        input_tensor_batches_[p.first].emplace_back(p.second);
+        pending_.inputs[p.first].Add(p.second, options_.batch_size());
       }
     }
 
@@ -297,9 +435,15 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
           << options_.signature_name();
     }
 
-    if (options_.batch_size() == 1) {
+    if (options_.batch_size() == 1 || options_.max_batch_wait_us() > 0) {
       cc->SetOffset(0);
     }
+    if (options_.max_batch_wait_us() > 0) {
+      deadline_thread_ =
+          absl::make_unique<ThreadPool>("tf_inference_deadline", 1);
+      deadline_thread_->StartWorkers();
+      deadline_thread_->Schedule([this] { RunDeadlineThread(); });
+    }
     return ::mediapipe::OkStatus();
   }
 
@@ -348,77 +492,95 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
         tf::Tensor input_tensor(
             cc->Inputs().Tag(tag_as_node_name).Get<tf::Tensor>());
         RET_CHECK_OK(AddBatchDimension(&input_tensor));
-        if (::mediapipe::ContainsKey(recurrent_feed_tags_, tag_as_node_name)) {
+        input_tensors_by_tag.insert(
+            std::make_pair(tag_as_node_name, input_tensor));
+      }
+    }
+
+    CalculatorContext::CompletionCallback done;
+    if (options_.max_batch_wait_us() > 0) {
+      // This call completes when its batch has run.
+      done = cc->DeferCompletion();
+    }
+    Batch batch;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (pending_.timestamps.empty()) {
+        pending_deadline_ =
+            absl::Now() + absl::Microseconds(options_.max_batch_wait_us());
+      }
+      pending_.timestamps.emplace_back(cc->InputTimestamp());
+      for (const auto& input_tensor_and_tag : input_tensors_by_tag) {
+        TensorBatch& tensors = pending_.inputs[input_tensor_and_tag.first];
+        if (::mediapipe::ContainsKey(recurrent_feed_tags_,
+                                     input_tensor_and_tag.first)) {
           // If we receive an input on a recurrent tag, override the state.
           // It's OK to override the global state because there is just one
           // input stream allowed for recurrent tensors.
-          input_tensor_batches_[tag_as_node_name].clear();
+          tensors.Clear();
         }
-        input_tensors_by_tag.insert(
-            std::make_pair(tag_as_node_name, input_tensor));
+        tensors.Add(input_tensor_and_tag.second, options_.batch_size());
       }
-    }
-    batch_timestamps_.emplace_back(cc->InputTimestamp());
-    for (const auto& input_tensor_and_tag : input_tensors_by_tag) {
-      input_tensor_batches_[input_tensor_and_tag.first].emplace_back(
-          input_tensor_and_tag.second);
+      if (done) {
+        pending_.contexts.push_back(cc);
+        pending_.done.push_back(std::move(done));
+      }
+      if (pending_.timestamps.size() < options_.batch_size()) {
+        return ::mediapipe::OkStatus();
+      }
+      batch = TakePendingBatch();
     }
 
-    if (batch_timestamps_.size() == options_.batch_size()) {
-      MP_RETURN_IF_ERROR(OutputBatch(cc));
+    if (batch.done.empty()) {
+      return OutputBatch(cc, &batch);
     }
+    CompleteDeferredBatch(&batch);
     return ::mediapipe::OkStatus();
   }
 
   ::mediapipe::Status Close(CalculatorContext* cc) override {
-    if (!batch_timestamps_.empty()) {
-      MP_RETURN_IF_ERROR(OutputBatch(cc));
+    // The deferred Process() calls have completed before Close(), so the
+    // deadline thread has no batch left.
+    StopDeadlineThread();
+    Batch batch;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (pending_.timestamps.empty()) {
+        return ::mediapipe::OkStatus();
+      }
+      batch = TakePendingBatch();
     }
-    return ::mediapipe::OkStatus();
+    return OutputBatch(cc, &batch);
   }
 
   // When a batch of input tensors is ready to be run, runs TensorFlow and
   // outputs the output tensors. The output tensors have timestamps matching
-  // the input tensor that formed that batch element. Any requested
+  // the input tensor that formed that batch element, and are sent through the
+  // deferred calculator context of that element if it has one. Any requested
   // batch_dimension is added and removed. This code takes advantage of the fact
   // that copying a tensor shares the same reference-counted, heap allocated
   // memory buffer. Therefore, copies are cheap and should not cause the memory
-  // buffer to fall out of scope. In contrast, concat is only used where
-  // necessary.
-  ::mediapipe::Status OutputBatch(CalculatorContext* cc) {
+  // buffer to fall out of scope. The input tensors of a batch were already
+  // copied into their batch tensors by Process().
+  ::mediapipe::Status OutputBatch(CalculatorContext* cc, Batch* batch) {
     const int64 start_time = absl::ToUnixMicros(clock_->TimeNow());
+    const int num_timestamps = batch->timestamps.size();
+    // The size of the batch fed to TensorFlow.
+    const int run_batch_size = options_.pad_partial_batches()
+                                   ? options_.batch_size()
+                                   : num_timestamps;
     std::vector<std::pair<mediapipe::ProtoString, tf::Tensor>> input_tensors;
-    for (auto& keyed_tensors : input_tensor_batches_) {
-      if (options_.batch_size() == 1) {
-        // Short circuit to avoid the cost of deep copying tensors in concat.
-        if (!keyed_tensors.second.empty()) {
-          input_tensors.emplace_back(tag_to_tensor_map_[keyed_tensors.first],
-                                     keyed_tensors.second[0]);
-        } else {
-          // The input buffer can be empty for recurrent tensors.
-          RET_CHECK(::mediapipe::ContainsKey(recurrent_feed_tags_,
-                                             keyed_tensors.first))
-              << "A non-recurrent tensor does not have an input: "
-              << keyed_tensors.first;
-        }
-      } else {
-        // Pad by replicating the first tens  or, then ignore the values.
-        keyed_tensors.second.resize(options_.batch_size());
-        std::fill(keyed_tensors.second.begin() + batch_timestamps_.size(),
-                  keyed_tensors.second.end(), keyed_tensors.second[0]);
-        tf::Tensor concated;
-        const tf::Status concat_status =
-            tf::tensor::Concat(keyed_tensors.second, &concated);
-        CHECK(concat_status.ok()) << concat_status.ToString();
-        input_tensors.emplace_back(tag_to_tensor_map_[keyed_tensors.first],
-                                   concated);
-      }
+    for (auto& keyed_tensors : batch->inputs) {
+      tf::Tensor batched;
+      MP_RETURN_IF_ERROR(keyed_tensors.second.Finish(
+          std::max(run_batch_size, keyed_tensors.second.size()), &batched));
+      input_tensors.emplace_back(tag_to_tensor_map_.at(keyed_tensors.first),
+                                 batched);
     }
-    input_tensor_batches_.clear();
     std::vector<mediapipe::ProtoString> output_tensor_names;
     std::vector<std::string> output_name_in_signature;
     for (const std::string& tag : cc->Outputs().GetTags()) {
-      output_tensor_names.emplace_back(tag_to_tensor_map_[tag]);
+      output_tensor_names.emplace_back(tag_to_tensor_map_.at(tag));
       output_name_in_signature.emplace_back(tag);
     }
     for (const auto& tag_pair : recurrent_fetch_tags_to_feed_tags_) {
@@ -426,7 +588,7 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
       if (std::find(output_name_in_signature.begin(),
                     output_name_in_signature.end(),
                     tag_pair.first) == output_name_in_signature.end()) {
-        output_tensor_names.emplace_back(tag_to_tensor_map_[tag_pair.first]);
+        output_tensor_names.emplace_back(tag_to_tensor_map_.at(tag_pair.first));
         output_name_in_signature.emplace_back(tag_pair.first);
       }
     }
@@ -462,15 +624,19 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
     cc->GetCounter(kTotalNumSessionRunsCounterSuffix)->Increment();
 
     // Feed back the recurrent state.
-    for (const auto& tag_pair : recurrent_fetch_tags_to_feed_tags_) {
-      int pos = std::find(output_name_in_signature.begin(),
-                          output_name_in_signature.end(), tag_pair.first) -
-                output_name_in_signature.begin();
-      input_tensor_batches_[tag_pair.second].emplace_back(outputs[pos]);
+    if (!recurrent_fetch_tags_to_feed_tags_.empty()) {
+      absl::MutexLock lock(&mutex_);
+      for (const auto& tag_pair : recurrent_fetch_tags_to_feed_tags_) {
+        int pos = std::find(output_name_in_signature.begin(),
+                            output_name_in_signature.end(), tag_pair.first) -
+                  output_name_in_signature.begin();
+        pending_.inputs[tag_pair.second].Add(outputs[pos],
+                                             options_.batch_size());
+      }
     }
 
     // Set that we want to split on each index of the 0th dimension.
-    std::vector<tf::int64> split_vector(options_.batch_size(), 1);
+    std::vector<tf::int64> split_vector(run_batch_size, 1);
     for (int i = 0; i < output_tensor_names.size(); ++i) {
       if (options_.batch_size() == 1) {
         if (cc->Outputs().HasTag(output_name_in_signature[i])) {
@@ -478,7 +644,7 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
           RET_CHECK_OK(RemoveBatchDimension(&output_tensor));
           cc->Outputs()
               .Tag(output_name_in_signature[i])
-              .Add(new tf::Tensor(output_tensor), batch_timestamps_[0]);
+              .Add(new tf::Tensor(output_tensor), batch->timestamps[0]);
         }
       } else {
         std::vector<tf::Tensor> split_tensors;
@@ -486,12 +652,14 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
             tf::tensor::Split(outputs[i], split_vector, &split_tensors);
         CHECK(split_status.ok()) << split_status.ToString();
         // Loop over timestamps so that we don't copy the padding.
-        for (int j = 0; j < batch_timestamps_.size(); ++j) {
+        for (int j = 0; j < num_timestamps; ++j) {
           tf::Tensor output_tensor(split_tensors[j]);
           RET_CHECK_OK(RemoveBatchDimension(&output_tensor));
-          cc->Outputs()
+          CalculatorContext* output_cc =
+              batch->contexts.empty() ? cc : batch->contexts[j];
+          output_cc->Outputs()
               .Tag(output_name_in_signature[i])
-              .Add(new tf::Tensor(output_tensor), batch_timestamps_[j]);
+              .Add(new tf::Tensor(output_tensor), batch->timestamps[j]);
         }
       }
     }
@@ -500,12 +668,72 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
     cc->GetCounter(kTotalUsecsCounterSuffix)
         ->IncrementBy(end_time - start_time);
     cc->GetCounter(kTotalProcessedTimestampsCounterSuffix)
-        ->IncrementBy(batch_timestamps_.size());
-    batch_timestamps_.clear();
+        ->IncrementBy(num_timestamps);
     return ::mediapipe::OkStatus();
   }
 
  private:
+  // Runs the batch of deferred Process() calls `batch`, then completes them.
+  void CompleteDeferredBatch(Batch* batch) {
+    const ::mediapipe::Status status =
+        OutputBatch(batch->contexts.front(), batch);
+    for (const auto& done : batch->done) {
+      done(status);
+    }
+  }
+
+  // Returns the pending batch and starts a new one.
+  Batch TakePendingBatch() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    Batch batch = std::move(pending_);
+    pending_ = Batch();
+    ++pending_batch_id_;
+    return batch;
+  }
+
+  // Runs each partial batch once its deadline has passed, unless it filled
+  // up and ran before.
+  void RunDeadlineThread() {
+    while (true) {
+      Batch batch;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(
+            this, &TensorFlowInferenceCalculator::HasPendingBatch));
+        if (stopping_) {
+          return;
+        }
+        timed_batch_id_ = pending_batch_id_;
+        if (mutex_.AwaitWithDeadline(
+                absl::Condition(
+                    this, &TensorFlowInferenceCalculator::TimedBatchTaken),
+                pending_deadline_)) {
+          continue;
+        }
+        batch = TakePendingBatch();
+      }
+      CompleteDeferredBatch(&batch);
+    }
+  }
+
+  bool HasPendingBatch() const EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return stopping_ || !pending_.timestamps.empty();
+  }
+
+  bool TimedBatchTaken() const EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return stopping_ || pending_batch_id_ != timed_batch_id_;
+  }
+
+  void StopDeadlineThread() {
+    if (!deadline_thread_) {
+      return;
+    }
+    {
+      absl::MutexLock lock(&mutex_);
+      stopping_ = true;
+    }
+    deadline_thread_.reset();
+  }
+
   // The Session object is provided by a packet factory and is owned by the
   // MediaPipe framework. Individual calls are thread-safe, but session state
   // may be shared across threads.
@@ -514,12 +742,6 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
   // A mapping between stream tags and the tensor names they are bound to.
   std::map<std::string, std::string> tag_to_tensor_map_;
 
-  // A mapping between stream tags and the tensors we are collecting as a batch.
-  std::map<std::string, std::vector<tf::Tensor>> input_tensor_batches_;
-
-  // The timestamps that go into a batch.
-  std::vector<Timestamp> batch_timestamps_;
-
   // The options for the calculator.
   TensorFlowInferenceCalculatorOptions options_;
 
@@ -530,6 +752,18 @@ class TensorFlowInferenceCalculator : public CalculatorBase {
   // Clock used to measure the computation time in OutputBatch().
   std::unique_ptr<mediapipe::Clock> clock_;
 
+  // Guards the batch being collected, which Process() calls share with each
+  // other and with the deadline thread when max_batch_wait_us is set.
+  absl::Mutex mutex_;
+  Batch pending_ GUARDED_BY(mutex_);
+  // Identifies the pending batch, and the batch the deadline thread waits on.
+  int64 pending_batch_id_ GUARDED_BY(mutex_) = 0;
+  int64 timed_batch_id_ GUARDED_BY(mutex_) = 0;
+  // The time at which the pending batch runs, with max_batch_wait_us.
+  absl::Time pending_deadline_ GUARDED_BY(mutex_);
+  bool stopping_ GUARDED_BY(mutex_) = false;
+  std::unique_ptr<ThreadPool> deadline_thread_;
+
   // The static singleton semaphore to throttle concurrent session runs.
   static SimpleSemaphore* get_session_run_throttle(
       int32 max_concurrent_session_runs) {
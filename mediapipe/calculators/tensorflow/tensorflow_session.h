@@ -21,8 +21,9 @@
 
 namespace mediapipe {
 struct TensorFlowSession {
-  // TensorFlow session wrapper to get around the RTTI issue.
-  std::unique_ptr<tensorflow::Session> session;
+  // TensorFlow session wrapper to get around the RTTI issue. Sessions loaded
+  // from frozen graph files may be shared with other TensorFlowSessions.
+  std::shared_ptr<tensorflow::Session> session;
 
   // Store an optional mapping to the between MediaPipe tags and TensorFlow
   // tensor names. Creating this mapping when the session is loaded allows more
@@ -312,5 +312,39 @@ TEST_F(TensorFlowSessionFromFrozenGraphCalculatorTest,
   VerifySignatureMap(session);
 }
 
+// Calculators loading the same graph file with the same options share one
+// session, while different options get their own.
+TEST_F(TensorFlowSessionFromFrozenGraphCalculatorTest,
+       SharesSessionsForTheSameGraphFile) {
+  const std::string node = R"(
+        calculator: "TensorFlowSessionFromFrozenGraphCalculator"
+        output_side_packet: "SESSION:session"
+        options {
+          [mediapipe.TensorFlowSessionFromFrozenGraphCalculatorOptions.ext]: {
+            $0
+          }
+        })";
+  CalculatorRunner first_runner(
+      absl::Substitute(node, calculator_options_->DebugString()));
+  CalculatorRunner second_runner(
+      absl::Substitute(node, calculator_options_->DebugString()));
+  calculator_options_->mutable_config()->set_intra_op_parallelism_threads(2);
+  CalculatorRunner other_runner(
+      absl::Substitute(node, calculator_options_->DebugString()));
+  MP_ASSERT_OK(first_runner.Run());
+  MP_ASSERT_OK(second_runner.Run());
+  MP_ASSERT_OK(other_runner.Run());
+
+  const TensorFlowSession& first =
+      first_runner.OutputSidePackets().Tag("SESSION").Get<TensorFlowSession>();
+  const TensorFlowSession& second =
+      second_runner.OutputSidePackets().Tag("SESSION").Get<TensorFlowSession>();
+  const TensorFlowSession& other =
+      other_runner.OutputSidePackets().Tag("SESSION").Get<TensorFlowSession>();
+  VerifySignatureMap(first);
+  EXPECT_EQ(first.session, second.session);
+  EXPECT_NE(first.session, other.session);
+}
+
 }  // namespace
 }  // namespace mediapipe
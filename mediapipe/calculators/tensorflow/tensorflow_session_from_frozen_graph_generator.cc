@@ -18,25 +18,25 @@
 // input_side_packet:STRING_MODEL_FILE_PATH
 // 3. Provide a serialized GraphDef through input_side_packet:STRING_MODEL,
 // typically provided by EmbeddingFilePacketFactory.
+// A session loaded from a file is shared with every other calculator or
+// generator in the process that loads the same file with the same options.
 //
 // See tensorflow_session_bundle_from_graph_generator.proto for options.
 // Produces a SessionBundle that TensorFlowInferenceCalculator can use.
 
 #include <string>
+#include <vector>
 
+#include "mediapipe/calculators/tensorflow/frozen_graph_session.h"
 #include "mediapipe/calculators/tensorflow/tensorflow_session.h"
 #include "mediapipe/calculators/tensorflow/tensorflow_session_from_frozen_graph_generator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
-#include "mediapipe/framework/port/file_helpers.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/tool/status_util.h"
-#include "tensorflow/core/public/session_options.h"
 
 namespace mediapipe {
 
-namespace tf = ::tensorflow;
-
 class TensorFlowSessionFromFrozenGraphGenerator : public PacketGenerator {
  public:
   static ::mediapipe::Status FillExpectations(
@@ -83,44 +83,30 @@ class TensorFlowSessionFromFrozenGraphGenerator : public PacketGenerator {
     // Output bundle packet.
     auto session = ::absl::make_unique<TensorFlowSession>();
 
-    tf::SessionOptions session_options;
-    session_options.config.CopyFrom(options.config());
-    std::vector<mediapipe::ProtoString> initialization_op_names;
-    initialization_op_names.reserve(options.initialization_op_names_size());
-    for (int i = 0; i < options.initialization_op_names_size(); ++i) {
-      initialization_op_names.emplace_back(options.initialization_op_names(i));
-    }
-    session->session.reset(tf::NewSession(session_options));
-
-    std::string graph_def_serialized;
+    const std::vector<std::string> initialization_op_names(
+        options.initialization_op_names().begin(),
+        options.initialization_op_names().end());
     if (input_side_packets.HasTag("STRING_MODEL")) {
-      graph_def_serialized =
-          input_side_packets.Tag("STRING_MODEL").Get<std::string>();
-    } else if (input_side_packets.HasTag("STRING_MODEL_FILE_PATH")) {
-      const std::string& frozen_graph =
-          input_side_packets.Tag("STRING_MODEL_FILE_PATH").Get<std::string>();
-      RET_CHECK_OK(
-          mediapipe::file::GetContents(frozen_graph, &graph_def_serialized));
+      ASSIGN_OR_RETURN(
+          session->session,
+          CreateFrozenGraphSession(
+              input_side_packets.Tag("STRING_MODEL").Get<std::string>(),
+              options.config(), initialization_op_names));
     } else {
-      RET_CHECK_OK(mediapipe::file::GetContents(options.graph_proto_path(),
-                                                &graph_def_serialized));
+      // Sessions for graph files are shared across generators and graphs.
+      const std::string& graph_path =
+          input_side_packets.HasTag("STRING_MODEL_FILE_PATH")
+              ? input_side_packets.Tag("STRING_MODEL_FILE_PATH")
+                    .Get<std::string>()
+              : options.graph_proto_path();
+      ASSIGN_OR_RETURN(session->session,
+                       GetSharedFrozenGraphSession(graph_path, options.config(),
+                                                   initialization_op_names));
     }
-    tensorflow::GraphDef graph_def;
-
-    RET_CHECK(graph_def.ParseFromString(graph_def_serialized));
-    const tf::Status tf_status = session->session->Create(graph_def);
-    RET_CHECK(tf_status.ok()) << "Create failed: " << tf_status.error_message();
 
     for (const auto& key_value : options.tag_to_tensor_names()) {
       session->tag_to_tensor_map[key_value.first] = key_value.second;
     }
-    if (!initialization_op_names.empty()) {
-      const tf::Status tf_status =
-          session->session->Run({}, {}, initialization_op_names, {});
-      // RET_CHECK on the tf::Status object itself in order to print an
-      // informative error message.
-      RET_CHECK(tf_status.ok()) << "Run failed: " << tf_status.error_message();
-    }
 
     output_side_packets->Tag("SESSION") = Adopt(session.release());
     return ::mediapipe::OkStatus();
@@ -0,0 +1,232 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mediapipe/calculators/tflite/batched_tflite_inference_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_batch_runner.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/stream_handler/batching_input_stream_handler.pb.h"
+#include "mediapipe/util/resource_util.h"
+#include "mediapipe/util/tflite/tflite_model_cache.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+// Runs TF Lite inference on CPU over batches of input timestamps.
+//
+// The calculator uses BatchingInputStreamHandler by default, which passes it
+// up to max_batch_size consecutive input timestamps at a time. The input
+// tensors of a batch are stacked along dimension 0, so that the model runs
+// once per batch, and each output tensor is split along dimension 0 back into
+// one slice per input timestamp. The model must therefore accept a variable
+// size in dimension 0 of every input, and produce outputs whose dimension 0
+// is proportional to it. See TfLiteBatchRunner.
+//
+// Input:
+//  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32 or kTfLiteUInt8
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS
+//
+// Output:
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor holding the slice of each
+//                   model output for the input timestamp
+//
+// Input side packet:
+//  CUSTOM_OP_RESOLVER (optional) - Use a custom op resolver,
+//                                  instead of the builtin one.
+//
+// Example use:
+// node {
+//   calculator: "BatchedTfLiteInferenceCalculator"
+//   input_stream: "TENSORS:tensor_image"
+//   output_stream: "POOLED_TENSORS:tensors"
+//   options: {
+//     [mediapipe.BatchedTfLiteInferenceCalculatorOptions.ext] {
+//       model_path: "modelname.tflite"
+//       max_batch_size: 4
+//       max_wait_time_usec: 5000
+//     }
+//   }
+// }
+//
+// IMPORTANT Notes:
+//  Tensors are assumed to be ordered correctly (sequentially added to model).
+//  Input tensors are assumed to be of the correct size and already normalized.
+//  Outputs are emitted once the whole batch has run, so the latency of a
+//  timestamp includes the time spent waiting for the rest of its batch.
+//
+class BatchedTfLiteInferenceCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+  ::mediapipe::Status Close(CalculatorContext* cc) override;
+
+ private:
+  // The input tensors of one timestamp, waiting for the rest of the batch.
+  struct BatchEntry {
+    Timestamp timestamp;
+    std::vector<PooledTfLiteTensor> tensors;
+  };
+
+  ::mediapipe::Status LoadModel(CalculatorContext* cc);
+  // Runs the model over batch_ and emits the outputs of every entry.
+  ::mediapipe::Status RunBatch(CalculatorContext* cc);
+
+  std::shared_ptr<const tflite::FlatBufferModel> model_;
+  std::unique_ptr<TfLiteBatchRunner> runner_;
+  TfLiteTensorPool tensor_pool_;
+  std::vector<BatchEntry> batch_;
+  int max_batch_size_ = 1;
+};
+REGISTER_CALCULATOR(BatchedTfLiteInferenceCalculator);
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK_EQ(
+      cc->Inputs().HasTag("TENSORS") + cc->Inputs().HasTag("POOLED_TENSORS"),
+      1);
+  RET_CHECK(cc->Outputs().HasTag("POOLED_TENSORS"));
+
+  if (cc->Inputs().HasTag("TENSORS"))
+    cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
+  if (cc->Inputs().HasTag("POOLED_TENSORS"))
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+  cc->Outputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+
+  if (cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER")) {
+    cc->InputSidePackets()
+        .Tag("CUSTOM_OP_RESOLVER")
+        .Set<tflite::ops::builtin::BuiltinOpResolver>();
+  }
+
+  const auto& options =
+      cc->Options<::mediapipe::BatchedTfLiteInferenceCalculatorOptions>();
+  RET_CHECK_GE(options.max_batch_size(), 1);
+
+  // Assign this calculator's default InputStreamHandler.
+  cc->SetInputStreamHandler("BatchingInputStreamHandler");
+  MediaPipeOptions handler_options;
+  auto* batching_options =
+      handler_options.MutableExtension(BatchingInputStreamHandlerOptions::ext);
+  batching_options->set_max_batch_size(options.max_batch_size());
+  batching_options->set_max_wait_time_usec(options.max_wait_time_usec());
+  cc->SetInputStreamHandlerOptions(handler_options);
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::Open(
+    CalculatorContext* cc) {
+  // No timestamp offset is set, since the outputs of a batch are emitted
+  // during the Process() call of its last timestamp.
+  const auto& options =
+      cc->Options<::mediapipe::BatchedTfLiteInferenceCalculatorOptions>();
+  max_batch_size_ = options.max_batch_size();
+  batch_.reserve(max_batch_size_);
+  return LoadModel(cc);
+}
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::Process(
+    CalculatorContext* cc) {
+  BatchEntry entry;
+  entry.timestamp = cc->InputTimestamp();
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    // Pooled tensors own their data, so they are buffered without a copy.
+    entry.tensors = cc->Inputs()
+                        .Tag("POOLED_TENSORS")
+                        .Get<std::vector<PooledTfLiteTensor>>();
+  } else {
+    // Plain tensors may point into an upstream interpreter that is reused.
+    for (const TfLiteTensor* tensor :
+         GetTfLiteTensors(cc->Inputs().Tag("TENSORS").Value())) {
+      RET_CHECK(tensor->data.raw);
+      entry.tensors.push_back(tensor_pool_.Copy(*tensor));
+    }
+  }
+  RET_CHECK_EQ(entry.tensors.size(), runner_->interpreter()->inputs().size());
+  batch_.push_back(std::move(entry));
+
+  if (cc->NumRemainingInputTimestamps() == 1 ||
+      batch_.size() >= max_batch_size_) {
+    MP_RETURN_IF_ERROR(RunBatch(cc));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::Close(
+    CalculatorContext* cc) {
+  // The last batch is cut short when the inputs are done.
+  if (!batch_.empty()) {
+    MP_RETURN_IF_ERROR(RunBatch(cc));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::LoadModel(
+    CalculatorContext* cc) {
+  const auto& options =
+      cc->Options<::mediapipe::BatchedTfLiteInferenceCalculatorOptions>();
+  RET_CHECK(!options.model_path().empty())
+      << "Must specify path to TFLite model.";
+  ASSIGN_OR_RETURN(std::string model_path,
+                   mediapipe::PathToResourceAsFile(options.model_path()));
+  ASSIGN_OR_RETURN(model_, GetSharedTfLiteModel(model_path));
+
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  if (cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER")) {
+    const auto& op_resolver =
+        cc->InputSidePackets()
+            .Tag("CUSTOM_OP_RESOLVER")
+            .Get<tflite::ops::builtin::BuiltinOpResolver>();
+    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter);
+  } else {
+    const tflite::ops::builtin::BuiltinOpResolver op_resolver;
+    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter);
+  }
+  RET_CHECK(interpreter);
+  if (options.cpu_num_threads() > 0) {
+    interpreter->SetNumThreads(options.cpu_num_threads());
+  }
+  ASSIGN_OR_RETURN(runner_, TfLiteBatchRunner::Create(std::move(interpreter)));
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BatchedTfLiteInferenceCalculator::RunBatch(
+    CalculatorContext* cc) {
+  std::vector<std::vector<const TfLiteTensor*>> inputs(batch_.size());
+  for (int j = 0; j < batch_.size(); ++j) {
+    for (const PooledTfLiteTensor& tensor : batch_[j].tensors) {
+      inputs[j].push_back(tensor.tensor());
+    }
+  }
+  std::vector<std::vector<PooledTfLiteTensor>> outputs;
+  MP_RETURN_IF_ERROR(runner_->Run(inputs, &tensor_pool_, &outputs));
+  for (int j = 0; j < batch_.size(); ++j) {
+    cc->Outputs().Tag("POOLED_TENSORS").Add(
+        new std::vector<PooledTfLiteTensor>(std::move(outputs[j])),
+        batch_[j].timestamp);
+  }
+  batch_.clear();
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
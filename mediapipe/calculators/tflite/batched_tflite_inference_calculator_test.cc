@@ -0,0 +1,161 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/calculators/tflite/batched_tflite_inference_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kNumElements = 8 * 8 * 3;
+constexpr int kMaxBatchSize = 4;
+
+// Runs testdata/add.bin, which outputs three times its [1, 8, 8, 3] input,
+// through a BatchedTfLiteInferenceCalculator with batches of up to
+// kMaxBatchSize inputs.
+class BatchedTfLiteInferenceCalculatorTest : public ::testing::Test {
+ protected:
+  void StartGraph(int64 max_wait_time_usec) {
+    CalculatorGraphConfig config =
+        ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+          input_stream: "tensor_in"
+          node {
+            calculator: "BatchedTfLiteInferenceCalculator"
+            input_stream: "POOLED_TENSORS:tensor_in"
+            output_stream: "POOLED_TENSORS:tensor_out"
+            options {
+              [mediapipe.BatchedTfLiteInferenceCalculatorOptions.ext] {
+                model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+              }
+            }
+          }
+        )");
+    auto* options = config.mutable_node(0)->mutable_options()->MutableExtension(
+        BatchedTfLiteInferenceCalculatorOptions::ext);
+    options->set_max_batch_size(kMaxBatchSize);
+    options->set_max_wait_time_usec(max_wait_time_usec);
+    MP_ASSERT_OK(graph_.Initialize(config));
+    MP_ASSERT_OK(graph_.ObserveOutputStream(
+        "tensor_out", [this](const Packet& packet) {
+          absl::MutexLock lock(&mutex_);
+          outputs_.push_back(packet);
+          return ::mediapipe::OkStatus();
+        }));
+    MP_ASSERT_OK(graph_.StartRun({}));
+  }
+
+  // Sends an input of shape `dims` filled with `frame` at timestamp `frame`.
+  void AddInput(int frame, const std::vector<int>& dims) {
+    auto input = absl::make_unique<std::vector<PooledTfLiteTensor>>();
+    input->push_back(pool_.Acquire(kTfLiteFloat32, dims));
+    for (int i = 0; i < kNumElements; ++i) {
+      (*input)[0].mutable_tensor()->data.f[i] = frame;
+    }
+    MP_ASSERT_OK(graph_.AddPacketToInputStream(
+        "tensor_in", Adopt(input.release()).At(Timestamp(frame))));
+  }
+
+  int NumOutputs() {
+    absl::MutexLock lock(&mutex_);
+    return outputs_.size();
+  }
+
+  // Expects one output per frame so far, each a [1, 8, 8, 3] tensor holding
+  // three times the frame number.
+  void ExpectOutputs() {
+    absl::MutexLock lock(&mutex_);
+    for (int frame = 0; frame < outputs_.size(); ++frame) {
+      const Packet& packet = outputs_[frame];
+      EXPECT_EQ(Timestamp(frame), packet.Timestamp());
+      const auto& tensors = packet.Get<std::vector<PooledTfLiteTensor>>();
+      ASSERT_EQ(1, tensors.size());
+      const TfLiteTensor* tensor = tensors[0].tensor();
+      ASSERT_EQ(4, tensor->dims->size);
+      EXPECT_EQ(1, tensor->dims->data[0]);
+      ASSERT_EQ(kNumElements * sizeof(float), tensor->bytes);
+      EXPECT_EQ(3 * frame, tensor->data.f[0]);
+      EXPECT_EQ(3 * frame, tensor->data.f[kNumElements - 1]);
+    }
+  }
+
+  TfLiteTensorPool pool_;
+  CalculatorGraph graph_;
+  absl::Mutex mutex_;
+  std::vector<Packet> outputs_ GUARDED_BY(mutex_);
+};
+
+// Full batches run as soon as they are complete. The inputs leave out the
+// batch dimension of the model, which the calculator must take from the
+// model rather than from the inputs.
+TEST_F(BatchedTfLiteInferenceCalculatorTest, RunsFullBatches) {
+  StartGraph(/*max_wait_time_usec=*/-1);
+  for (int frame = 0; frame < 2 * kMaxBatchSize; ++frame) {
+    AddInput(frame, {8, 8, 3});
+  }
+  MP_ASSERT_OK(graph_.WaitUntilIdle());
+  EXPECT_EQ(2 * kMaxBatchSize, NumOutputs());
+  MP_ASSERT_OK(graph_.CloseAllInputStreams());
+  MP_ASSERT_OK(graph_.WaitUntilDone());
+  EXPECT_EQ(2 * kMaxBatchSize, NumOutputs());
+  ExpectOutputs();
+}
+
+// An incomplete batch runs once max_wait_time_usec has passed, while the
+// inputs are still open.
+TEST_F(BatchedTfLiteInferenceCalculatorTest, TimerRunsPartialBatch) {
+  StartGraph(/*max_wait_time_usec=*/10000);
+  AddInput(0, {1, 8, 8, 3});
+  AddInput(1, {1, 8, 8, 3});
+  {
+    absl::MutexLock lock(&mutex_);
+    EXPECT_TRUE(mutex_.AwaitWithTimeout(
+        absl::Condition(
+            +[](std::vector<Packet>* outputs) { return outputs->size() == 2; },
+            &outputs_),
+        absl::Seconds(10)));
+  }
+  ExpectOutputs();
+  MP_ASSERT_OK(graph_.CloseAllInputStreams());
+  MP_ASSERT_OK(graph_.WaitUntilDone());
+  EXPECT_EQ(2, NumOutputs());
+}
+
+// With a negative wait time, only full batches run while the inputs are open,
+// and the incomplete last batch runs in Close().
+TEST_F(BatchedTfLiteInferenceCalculatorTest, CloseRunsIncompleteBatch) {
+  StartGraph(/*max_wait_time_usec=*/-1);
+  for (int frame = 0; frame < kMaxBatchSize + 2; ++frame) {
+    AddInput(frame, {1, 8, 8, 3});
+  }
+  MP_ASSERT_OK(graph_.WaitUntilIdle());
+  EXPECT_EQ(kMaxBatchSize, NumOutputs());
+  MP_ASSERT_OK(graph_.CloseAllInputStreams());
+  MP_ASSERT_OK(graph_.WaitUntilDone());
+  EXPECT_EQ(kMaxBatchSize + 2, NumOutputs());
+  ExpectOutputs();
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,335 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/detection_decoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// No threshold needs a sigmoid logit above this to pass.
+constexpr float kMaxPrefilterThresh = 14.0f;
+
+// Clips and squashes the score the same way for every code path.
+class ScoreTransform {
+ public:
+  explicit ScoreTransform(const DetectionScoringOptions& options)
+      : sigmoid_(options.sigmoid_score),
+        clip_(options.sigmoid_score && options.has_score_clipping_thresh),
+        clip_thresh_(options.score_clipping_thresh) {
+    if (!options.has_min_score_thresh) {
+      prefilter_thresh_ = -std::numeric_limits<float>::infinity();
+    } else if (!sigmoid_) {
+      prefilter_thresh_ = options.min_score_thresh;
+    } else {
+      // The sigmoid is monotonic, so a box can only pass if its top clipped
+      // logit is at least logit(min_score_thresh). The float sigmoid is off
+      // by a few ulps of its result, which is a logit error of up to about
+      // 1e-6 / (1 - thresh) near 1, so the margin grows like TieFloor()'s.
+      // Survivors are checked exactly.
+      const double thresh = options.min_score_thresh;
+      if (thresh <= 0.0) {
+        prefilter_thresh_ = -std::numeric_limits<float>::infinity();
+      } else if (thresh >= 1.0) {
+        // 1 / (1 + exp(-x)) only rounds to 1.0f for x above 16.
+        prefilter_thresh_ = kMaxPrefilterThresh;
+      } else {
+        prefilter_thresh_ = std::min(
+            std::log(thresh / (1.0 - thresh)) - 0.01 - 1e-4 / (1.0 - thresh),
+            static_cast<double>(kMaxPrefilterThresh));
+      }
+      // Clipping raises every logit to at least -clip_thresh_. If that is
+      // enough to pass, the unclipped logit cannot reject any box.
+      if (clip_ && -clip_thresh_ >= prefilter_thresh_) {
+        prefilter_thresh_ = -std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+
+  // Applies clipping only; order-preserving.
+  float Clip(float value) const {
+    if (!clip_) return value;
+    return std::min(std::max(value, -clip_thresh_), clip_thresh_);
+  }
+
+  // Maps a clipped value to the final score.
+  float Score(float clipped) const {
+    return sigmoid_ ? 1.0f / (1.0f + std::exp(-clipped)) : clipped;
+  }
+
+  // True if Score() can map different clipped values to the same score.
+  bool saturates() const { return sigmoid_; }
+
+  // Returns a bound below which no unclipped value scores the same as the
+  // clipped value `clipped`, whose score is `score`. The float sigmoid is
+  // accurate to a few ulps, and its slope is score * (1 - score), so a tie
+  // needs the logits to be within about 1e-6 / (1 - score); the margin is
+  // 100 times that. Only logits above 15 round to 1.0f, and denormal scores
+  // lose the relative accuracy the bound relies on.
+  float TieFloor(float clipped, float score) const {
+    if (score < std::numeric_limits<float>::min()) {
+      return -std::numeric_limits<float>::infinity();
+    }
+    const float floor =
+        score >= 1.0f ? 15.0f : clipped - 1e-4f / (1.0f - score);
+    // Clipping raises every value to at least -clip_thresh_.
+    if (clip_ && floor <= -clip_thresh_) {
+      return -std::numeric_limits<float>::infinity();
+    }
+    return floor;
+  }
+
+  // Boxes whose top unclipped value is below this cannot pass the threshold.
+  float prefilter_thresh() const { return prefilter_thresh_; }
+
+ private:
+  const bool sigmoid_;
+  const bool clip_;
+  const float clip_thresh_;
+  float prefilter_thresh_;
+};
+
+// Returns the largest of the `size` values at `values`.
+float RowMax(const float* values, int size) {
+  float max_value = -std::numeric_limits<float>::max();
+  int i = 0;
+#if defined(__SSE2__)
+  if (size >= 4) {
+    __m128 max_v = _mm_loadu_ps(values);
+    for (i = 4; i + 4 <= size; i += 4) {
+      max_v = _mm_max_ps(max_v, _mm_loadu_ps(values + i));
+    }
+    max_v = _mm_max_ps(max_v, _mm_shuffle_ps(max_v, max_v, 0x4E));
+    max_v = _mm_max_ps(max_v, _mm_shuffle_ps(max_v, max_v, 0xB1));
+    max_value = std::max(max_value, _mm_cvtss_f32(max_v));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  if (size >= 4) {
+    float32x4_t max_v = vld1q_f32(values);
+    for (i = 4; i + 4 <= size; i += 4) {
+      max_v = vmaxq_f32(max_v, vld1q_f32(values + i));
+    }
+    float32x2_t max_half = vpmax_f32(vget_low_f32(max_v), vget_high_f32(max_v));
+    max_half = vpmax_f32(max_half, max_half);
+    max_value = std::max(max_value, vget_lane_f32(max_half, 0));
+  }
+#endif
+  for (; i < size; ++i) max_value = std::max(max_value, values[i]);
+  return max_value;
+}
+
+// Returns the index of the first of the `size` values at `values` that is at
+// least `threshold`, or `size` if there is none.
+int FirstAtLeast(const float* values, int size, float threshold) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 thresh_v = _mm_set1_ps(threshold);
+  for (; i + 4 <= size; i += 4) {
+    const int mask =
+        _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(values + i), thresh_v));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t thresh_v = vdupq_n_f32(threshold);
+  for (; i + 4 <= size; i += 4) {
+    const uint32x4_t pass = vcgeq_f32(vld1q_f32(values + i), thresh_v);
+    if (vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(pass)), 0) != 0) break;
+  }
+#endif
+  while (i < size && !(values[i] >= threshold)) ++i;
+  return i;
+}
+
+void AddCandidate(int box, float score, int class_id,
+                  DetectionCandidates* candidates) {
+  candidates->box_index.push_back(box);
+  candidates->score.push_back(score);
+  candidates->class_id.push_back(class_id);
+}
+
+// Single-class models: the scores of consecutive boxes are contiguous, so the
+// threshold is tested for several boxes at a time.
+void ScoreSingleClass(const float* raw_scores, int num_boxes,
+                      const ScoreTransform& transform,
+                      const DetectionScoringOptions& options,
+                      DetectionCandidates* candidates) {
+  const float prefilter_thresh = transform.prefilter_thresh();
+  auto score_box = [&](int box) {
+    const float score = transform.Score(transform.Clip(raw_scores[box]));
+    if (options.has_min_score_thresh && score < options.min_score_thresh) {
+      return;
+    }
+    AddCandidate(box, score, 0, candidates);
+  };
+  int box = 0;
+#if defined(__SSE2__)
+  // prefilter_thresh accounts for clipping raising low values, and clipping
+  // high values can only lower them below it, so testing the unclipped
+  // value only lets extra boxes through to the exact check.
+  if (options.has_min_score_thresh) {
+    const __m128 thresh_v = _mm_set1_ps(prefilter_thresh);
+    for (; box + 4 <= num_boxes; box += 4) {
+      int mask = _mm_movemask_ps(
+          _mm_cmpge_ps(_mm_loadu_ps(raw_scores + box), thresh_v));
+      while (mask) {
+        const int lane = __builtin_ctz(mask);
+        score_box(box + lane);
+        mask &= mask - 1;
+      }
+    }
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  if (options.has_min_score_thresh) {
+    const float32x4_t thresh_v = vdupq_n_f32(prefilter_thresh);
+    for (; box + 4 <= num_boxes; box += 4) {
+      const uint32x4_t pass =
+          vcgeq_f32(vld1q_f32(raw_scores + box), thresh_v);
+      if (vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(pass)), 0) == 0) {
+        continue;
+      }
+      for (int lane = 0; lane < 4; ++lane) {
+        if (raw_scores[box + lane] >= prefilter_thresh) score_box(box + lane);
+      }
+    }
+  }
+#endif
+  for (; box < num_boxes; ++box) {
+    if (raw_scores[box] >= prefilter_thresh || !options.has_min_score_thresh) {
+      score_box(box);
+    }
+  }
+}
+
+}  // namespace
+
+void ScoreDetections(const float* raw_scores, int num_boxes,
+                     const DetectionScoringOptions& options,
+                     DetectionCandidates* candidates) {
+  const ScoreTransform transform(options);
+  const int num_classes = options.num_classes;
+  if (num_classes == 1 && options.ignore_classes.empty()) {
+    ScoreSingleClass(raw_scores, num_boxes, transform, options, candidates);
+    return;
+  }
+
+  std::vector<bool> ignored(num_classes, false);
+  for (int class_id : options.ignore_classes) {
+    if (class_id >= 0 && class_id < num_classes) ignored[class_id] = true;
+  }
+  const bool any_ignored =
+      std::find(ignored.begin(), ignored.end(), true) != ignored.end();
+  const float prefilter_thresh = transform.prefilter_thresh();
+
+  for (int box = 0; box < num_boxes; ++box) {
+    const float* scores = raw_scores + box * num_classes;
+    // Without ignored classes, the row maximum bounds the top score and most
+    // boxes are rejected without looking for the arg max.
+    if (!any_ignored && options.has_min_score_thresh &&
+        RowMax(scores, num_classes) < prefilter_thresh) {
+      continue;
+    }
+    int class_id = -1;
+    float max_clipped = -std::numeric_limits<float>::max();
+    for (int c = 0; c < num_classes; ++c) {
+      if (ignored[c]) continue;
+      const float clipped = transform.Clip(scores[c]);
+      if (class_id < 0 || max_clipped < clipped) {
+        max_clipped = clipped;
+        class_id = c;
+      }
+    }
+    const float score = class_id < 0 ? -std::numeric_limits<float>::max()
+                                     : transform.Score(max_clipped);
+    if (options.has_min_score_thresh && score < options.min_score_thresh) {
+      continue;
+    }
+    // A lower logit can round to the same score, such as 1.0f, and the
+    // classes are ranked by score, so the lowest of the tied classes wins.
+    if (transform.saturates()) {
+      const float tie_floor = transform.TieFloor(max_clipped, score);
+      for (int c = FirstAtLeast(scores, class_id, tie_floor); c < class_id;
+           c += 1 + FirstAtLeast(scores + c + 1, class_id - c - 1, tie_floor)) {
+        if (ignored[c]) continue;
+        if (transform.Score(transform.Clip(scores[c])) == score) {
+          class_id = c;
+          break;
+        }
+      }
+    }
+    AddCandidate(box, score, class_id, candidates);
+  }
+}
+
+void DecodeDetectionBoxes(const float* raw_boxes,
+                          const DetectionAnchors& anchors,
+                          const BoxDecodingOptions& options,
+                          const std::vector<int>& box_indices, float* boxes) {
+  const int num_coords = options.num_coords;
+  for (size_t i = 0; i < box_indices.size(); ++i) {
+    const int box = box_indices[i];
+    const float* raw = raw_boxes + box * num_coords;
+    float* out = boxes + i * num_coords;
+    const float anchor_x = anchors.x_center[box];
+    const float anchor_y = anchors.y_center[box];
+    const float anchor_h = anchors.h[box];
+    const float anchor_w = anchors.w[box];
+
+    const float* raw_box = raw + options.box_coord_offset;
+    float y_center = raw_box[0];
+    float x_center = raw_box[1];
+    float h = raw_box[2];
+    float w = raw_box[3];
+    if (options.reverse_output_order) {
+      std::swap(x_center, y_center);
+      std::swap(w, h);
+    }
+
+    x_center = x_center / options.x_scale * anchor_w + anchor_x;
+    y_center = y_center / options.y_scale * anchor_h + anchor_y;
+    if (options.apply_exponential_on_box_size) {
+      h = std::exp(h / options.h_scale) * anchor_h;
+      w = std::exp(w / options.w_scale) * anchor_w;
+    } else {
+      h = h / options.h_scale * anchor_h;
+      w = w / options.w_scale * anchor_w;
+    }
+
+    out[0] = y_center - h / 2.f;
+    out[1] = x_center - w / 2.f;
+    out[2] = y_center + h / 2.f;
+    out[3] = x_center + w / 2.f;
+
+    for (int k = 0; k < options.num_keypoints; ++k) {
+      const int offset =
+          options.keypoint_coord_offset + k * options.num_values_per_keypoint;
+      float keypoint_y = raw[offset];
+      float keypoint_x = raw[offset + 1];
+      if (options.reverse_output_order) std::swap(keypoint_x, keypoint_y);
+      out[offset] = keypoint_x / options.x_scale * anchor_w + anchor_x;
+      out[offset + 1] = keypoint_y / options.y_scale * anchor_h + anchor_y;
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,97 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU kernels for turning raw SSD-style model outputs (per-anchor class scores
+// and box regressions) into detection candidates. Scoring picks the top class
+// of every box and applies the score threshold in one pass, and only boxes
+// that pass are decoded, so the cost of decoding and of building Detection
+// protos scales with the number of survivors instead of the number of anchors.
+#ifndef MEDIAPIPE_CALCULATORS_TFLITE_DETECTION_DECODING_H_
+#define MEDIAPIPE_CALCULATORS_TFLITE_DETECTION_DECODING_H_
+
+#include <vector>
+
+namespace mediapipe {
+
+struct DetectionScoringOptions {
+  int num_classes = 1;
+  // Classes that are never selected as the top class of a box.
+  std::vector<int> ignore_classes;
+  // Whether scores are logits that go through a sigmoid, after clipping to
+  // [-score_clipping_thresh, score_clipping_thresh] if that is set.
+  bool sigmoid_score = false;
+  bool has_score_clipping_thresh = false;
+  float score_clipping_thresh = 0.0f;
+  // Boxes whose top score is below min_score_thresh are dropped.
+  bool has_min_score_thresh = false;
+  float min_score_thresh = 0.0f;
+};
+
+struct BoxDecodingOptions {
+  int num_coords = 4;
+  int box_coord_offset = 0;
+  int keypoint_coord_offset = 0;
+  int num_keypoints = 0;
+  int num_values_per_keypoint = 2;
+  float x_scale = 0.0f;
+  float y_scale = 0.0f;
+  float w_scale = 0.0f;
+  float h_scale = 0.0f;
+  bool apply_exponential_on_box_size = false;
+  // If true, raw values are ordered [x_center, y_center, w, h].
+  bool reverse_output_order = false;
+};
+
+// Anchors in struct-of-arrays layout, one entry per box.
+struct DetectionAnchors {
+  std::vector<float> y_center;
+  std::vector<float> x_center;
+  std::vector<float> h;
+  std::vector<float> w;
+};
+
+// The boxes that passed scoring, in struct-of-arrays layout and in box order.
+struct DetectionCandidates {
+  std::vector<int> box_index;
+  std::vector<float> score;
+  std::vector<int> class_id;
+
+  int size() const { return box_index.size(); }
+  void Clear() {
+    box_index.clear();
+    score.clear();
+    class_id.clear();
+  }
+};
+
+// Finds the top class of each of `num_boxes` boxes in `raw_scores`, laid out
+// as [num_boxes][num_classes], and appends the boxes that pass the score
+// threshold to `candidates`. A box whose classes are all ignored gets class -1
+// and the lowest float score. When two classes tie, the lower id wins.
+void ScoreDetections(const float* raw_scores, int num_boxes,
+                     const DetectionScoringOptions& options,
+                     DetectionCandidates* candidates);
+
+// Decodes the boxes listed in `box_indices` from `raw_boxes`, laid out as
+// [num_boxes][num_coords], relative to `anchors`. Writes num_coords values per
+// listed box to `boxes`, in the order of `box_indices`: [ymin, xmin, ymax,
+// xmax] followed by the decoded (x, y) keypoints at keypoint_coord_offset.
+void DecodeDetectionBoxes(const float* raw_boxes,
+                          const DetectionAnchors& anchors,
+                          const BoxDecodingOptions& options,
+                          const std::vector<int>& box_indices, float* boxes);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TFLITE_DETECTION_DECODING_H_
@@ -0,0 +1,277 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/detection_decoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+std::vector<float> RandomValues(int size, float low, float high, int seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> distribution(low, high);
+  std::vector<float> values(size);
+  for (float& value : values) value = distribution(random);
+  return values;
+}
+
+// Scores every class of every box, as TfLiteTensorsToDetectionsCalculator
+// did before it used ScoreDetections.
+void ReferenceScores(const float* raw_scores, int num_boxes,
+                     const DetectionScoringOptions& options,
+                     std::vector<float>* scores, std::vector<int>* classes) {
+  scores->resize(num_boxes);
+  classes->resize(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) {
+    int class_id = -1;
+    float max_score = -std::numeric_limits<float>::max();
+    for (int c = 0; c < options.num_classes; ++c) {
+      if (std::find(options.ignore_classes.begin(),
+                    options.ignore_classes.end(),
+                    c) != options.ignore_classes.end()) {
+        continue;
+      }
+      float score = raw_scores[i * options.num_classes + c];
+      if (options.sigmoid_score) {
+        if (options.has_score_clipping_thresh) {
+          score = std::min(std::max(score, -options.score_clipping_thresh),
+                           options.score_clipping_thresh);
+        }
+        score = 1.0f / (1.0f + std::exp(-score));
+      }
+      if (max_score < score) {
+        max_score = score;
+        class_id = c;
+      }
+    }
+    (*scores)[i] = max_score;
+    (*classes)[i] = class_id;
+  }
+}
+
+void ExpectMatchesReference(const std::vector<float>& raw_scores,
+                            int num_boxes,
+                            const DetectionScoringOptions& options) {
+  std::vector<float> expected_scores;
+  std::vector<int> expected_classes;
+  ReferenceScores(raw_scores.data(), num_boxes, options, &expected_scores,
+                  &expected_classes);
+  DetectionCandidates candidates;
+  ScoreDetections(raw_scores.data(), num_boxes, options, &candidates);
+
+  int next_candidate = 0;
+  for (int i = 0; i < num_boxes; ++i) {
+    if (options.has_min_score_thresh &&
+        expected_scores[i] < options.min_score_thresh) {
+      continue;
+    }
+    ASSERT_LT(next_candidate, candidates.size());
+    EXPECT_EQ(i, candidates.box_index[next_candidate]);
+    EXPECT_EQ(expected_scores[i], candidates.score[next_candidate]);
+    EXPECT_EQ(expected_classes[i], candidates.class_id[next_candidate]);
+    ++next_candidate;
+  }
+  EXPECT_EQ(next_candidate, candidates.size());
+}
+
+TEST(DetectionDecodingTest, SingleClassSigmoidWithThreshold) {
+  DetectionScoringOptions options;
+  options.sigmoid_score = true;
+  options.has_score_clipping_thresh = true;
+  options.score_clipping_thresh = 4.0f;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.75f;
+  ExpectMatchesReference(RandomValues(2943, -8.0f, 8.0f, 1), 2943, options);
+}
+
+// Near 1, the float sigmoid rounds logits well below logit(min_score_thresh)
+// up to the threshold.
+TEST(DetectionDecodingTest, SingleClassSigmoidWithThresholdNearOne) {
+  DetectionScoringOptions options;
+  options.sigmoid_score = true;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.9999999f;
+  ExpectMatchesReference(RandomValues(4000, 15.0f, 17.0f, 8), 4000, options);
+}
+
+// Clipping raises logits below -score_clipping_thresh above
+// logit(min_score_thresh), so every box passes however low its raw score.
+TEST(DetectionDecodingTest, SingleClassClippingRaisesLowScores) {
+  DetectionScoringOptions options;
+  options.sigmoid_score = true;
+  options.has_score_clipping_thresh = true;
+  options.score_clipping_thresh = 5.0f;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.005f;
+  const std::vector<float> raw_scores = RandomValues(103, -200.0f, -5.0f, 6);
+  ExpectMatchesReference(raw_scores, 103, options);
+  DetectionCandidates candidates;
+  ScoreDetections(raw_scores.data(), 103, options, &candidates);
+  EXPECT_EQ(103, candidates.size());
+}
+
+TEST(DetectionDecodingTest, MultiClassClippingRaisesLowScores) {
+  DetectionScoringOptions options;
+  options.num_classes = 5;
+  options.sigmoid_score = true;
+  options.has_score_clipping_thresh = true;
+  options.score_clipping_thresh = 5.0f;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.005f;
+  ExpectMatchesReference(RandomValues(100 * 5, -200.0f, -5.0f, 7), 100,
+                         options);
+}
+
+TEST(DetectionDecodingTest, SingleClassWithoutThreshold) {
+  DetectionScoringOptions options;
+  ExpectMatchesReference(RandomValues(37, -1.0f, 1.0f, 2), 37, options);
+}
+
+TEST(DetectionDecodingTest, MultiClassWithIgnoredClass) {
+  DetectionScoringOptions options;
+  options.num_classes = 7;
+  options.ignore_classes = {0};
+  options.sigmoid_score = true;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.6f;
+  ExpectMatchesReference(RandomValues(500 * 7, -4.0f, 4.0f, 3), 500, options);
+}
+
+TEST(DetectionDecodingTest, MultiClassRawScores) {
+  DetectionScoringOptions options;
+  options.num_classes = 13;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.9f;
+  ExpectMatchesReference(RandomValues(300 * 13, 0.0f, 1.0f, 4), 300, options);
+}
+
+// Logits above about 17 all score 1.0f, so the lowest such class wins even
+// if a later class has a higher logit.
+TEST(DetectionDecodingTest, SaturatedScoresKeepLowestClass) {
+  DetectionScoringOptions options;
+  options.num_classes = 4;
+  options.ignore_classes = {0};
+  options.sigmoid_score = true;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.5f;
+  const std::vector<float> raw_scores = {30.0f, 2.0f, 20.0f, 40.0f,
+                                         -1.0f, 50.0f, 3.0f, 60.0f};
+  ExpectMatchesReference(raw_scores, 2, options);
+  DetectionCandidates candidates;
+  ScoreDetections(raw_scores.data(), 2, options, &candidates);
+  ASSERT_EQ(2, candidates.size());
+  EXPECT_EQ(1.0f, candidates.score[0]);
+  EXPECT_EQ(2, candidates.class_id[0]);
+  EXPECT_EQ(1.0f, candidates.score[1]);
+  EXPECT_EQ(1, candidates.class_id[1]);
+}
+
+TEST(DetectionDecodingTest, AllClassesIgnored) {
+  DetectionScoringOptions options;
+  options.num_classes = 2;
+  options.ignore_classes = {0, 1};
+  DetectionCandidates candidates;
+  ScoreDetections(RandomValues(2, 0.0f, 1.0f, 5).data(), 1, options,
+                  &candidates);
+  ASSERT_EQ(1, candidates.size());
+  EXPECT_EQ(-1, candidates.class_id[0]);
+}
+
+TEST(DetectionDecodingTest, DecodeBoxesAndKeypoints) {
+  BoxDecodingOptions options;
+  options.num_coords = 8;
+  options.keypoint_coord_offset = 4;
+  options.num_keypoints = 2;
+  options.x_scale = options.y_scale = 10.0f;
+  options.w_scale = options.h_scale = 5.0f;
+  options.reverse_output_order = true;
+  DetectionAnchors anchors;
+  anchors.x_center = {0.0f, 0.5f};
+  anchors.y_center = {0.0f, 0.25f};
+  anchors.w = {1.0f, 0.5f};
+  anchors.h = {1.0f, 0.2f};
+  // Box 1 is [x_center, y_center, w, h, kp0_x, kp0_y, kp1_x, kp1_y].
+  const std::vector<float> raw_boxes = {0, 0, 0, 0, 0, 0, 0, 0,
+                                        1, 2, 5, 5, 4, 6, -2, 0};
+
+  std::vector<float> boxes(8);
+  DecodeDetectionBoxes(raw_boxes.data(), anchors, options, {1}, boxes.data());
+  const float x_center = 1.0f / 10 * 0.5f + 0.5f;
+  const float y_center = 2.0f / 10 * 0.2f + 0.25f;
+  EXPECT_FLOAT_EQ(y_center - 0.1f, boxes[0]);
+  EXPECT_FLOAT_EQ(x_center - 0.25f, boxes[1]);
+  EXPECT_FLOAT_EQ(y_center + 0.1f, boxes[2]);
+  EXPECT_FLOAT_EQ(x_center + 0.25f, boxes[3]);
+  EXPECT_FLOAT_EQ(4.0f / 10 * 0.5f + 0.5f, boxes[4]);
+  EXPECT_FLOAT_EQ(6.0f / 10 * 0.2f + 0.25f, boxes[5]);
+  EXPECT_FLOAT_EQ(-2.0f / 10 * 0.5f + 0.5f, boxes[6]);
+  EXPECT_FLOAT_EQ(0.25f, boxes[7]);
+}
+
+// Palm detection: 2944 anchors, 1 class. SSD MobileNet: 1917 anchors,
+// 91 classes.
+void ScoringArgs(benchmark::internal::Benchmark* b) {
+  b->Args({2944, 1})->Args({1917, 91});
+}
+
+DetectionScoringOptions BenchmarkOptions(int num_classes) {
+  DetectionScoringOptions options;
+  options.num_classes = num_classes;
+  options.sigmoid_score = true;
+  options.has_score_clipping_thresh = true;
+  options.score_clipping_thresh = 100.0f;
+  options.has_min_score_thresh = true;
+  options.min_score_thresh = 0.7f;
+  return options;
+}
+
+void BM_ScoreDetectionsReference(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const DetectionScoringOptions options = BenchmarkOptions(state.range(1));
+  const std::vector<float> raw_scores =
+      RandomValues(num_boxes * options.num_classes, -10.0f, 1.5f, 6);
+  std::vector<float> scores;
+  std::vector<int> classes;
+  for (auto _ : state) {
+    ReferenceScores(raw_scores.data(), num_boxes, options, &scores, &classes);
+    benchmark::DoNotOptimize(scores.data());
+  }
+}
+
+void BM_ScoreDetections(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const DetectionScoringOptions options = BenchmarkOptions(state.range(1));
+  const std::vector<float> raw_scores =
+      RandomValues(num_boxes * options.num_classes, -10.0f, 1.5f, 6);
+  DetectionCandidates candidates;
+  for (auto _ : state) {
+    candidates.Clear();
+    ScoreDetections(raw_scores.data(), num_boxes, options, &candidates);
+    benchmark::DoNotOptimize(candidates.score.data());
+  }
+}
+
+BENCHMARK(BM_ScoreDetectionsReference)->Apply(ScoringArgs);
+BENCHMARK(BM_ScoreDetections)->Apply(ScoringArgs);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,121 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/tflite_batch_runner.h"
+
+#include <cstring>
+#include <utility>
+
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+
+// static
+::mediapipe::StatusOr<std::unique_ptr<TfLiteBatchRunner>>
+TfLiteBatchRunner::Create(std::unique_ptr<tflite::Interpreter> interpreter) {
+  RET_CHECK(interpreter);
+  std::unique_ptr<TfLiteBatchRunner> runner(
+      new TfLiteBatchRunner(std::move(interpreter)));
+  tflite::Interpreter* raw = runner->interpreter_.get();
+  RET_CHECK_EQ(raw->AllocateTensors(), kTfLiteOk);
+  for (int index : raw->inputs()) {
+    const TfLiteIntArray* dims = raw->tensor(index)->dims;
+    runner->input_dims_.emplace_back(dims->data, dims->data + dims->size);
+  }
+  runner->allocated_batch_size_ = 1;
+  return std::move(runner);
+}
+
+TfLiteBatchRunner::TfLiteBatchRunner(
+    std::unique_ptr<tflite::Interpreter> interpreter)
+    : interpreter_(std::move(interpreter)) {}
+
+::mediapipe::Status TfLiteBatchRunner::Resize(int batch_size) {
+  if (batch_size == allocated_batch_size_) {
+    return ::mediapipe::OkStatus();
+  }
+  for (int i = 0; i < input_dims_.size(); ++i) {
+    RET_CHECK(!input_dims_[i].empty())
+        << "Input tensor " << i << " is a scalar and cannot be batched.";
+    std::vector<int> batched_dims = input_dims_[i];
+    batched_dims[0] *= batch_size;
+    RET_CHECK_EQ(interpreter_->ResizeInputTensor(interpreter_->inputs()[i],
+                                                 batched_dims),
+                 kTfLiteOk);
+  }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  allocated_batch_size_ = batch_size;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteBatchRunner::Run(
+    const std::vector<std::vector<const TfLiteTensor*>>& batch,
+    TfLiteTensorPool* pool,
+    std::vector<std::vector<PooledTfLiteTensor>>* outputs) {
+  const int batch_size = batch.size();
+  RET_CHECK_GT(batch_size, 0);
+  MP_RETURN_IF_ERROR(Resize(batch_size));
+
+  // 1. Stack the inputs of the batch along dimension 0.
+  const auto& input_indexes = interpreter_->inputs();
+  for (int i = 0; i < input_indexes.size(); ++i) {
+    TfLiteTensor* input = interpreter_->tensor(input_indexes[i]);
+    const size_t entry_bytes = input->bytes / batch_size;
+    for (int j = 0; j < batch_size; ++j) {
+      RET_CHECK_EQ(batch[j].size(), input_indexes.size());
+      const TfLiteTensor* tensor = batch[j][i];
+      RET_CHECK(tensor->data.raw);
+      RET_CHECK_EQ(tensor->bytes, entry_bytes)
+          << "Input tensor " << i << " does not match the model.";
+      std::memcpy(input->data.raw + j * entry_bytes, tensor->data.raw,
+                  entry_bytes);
+    }
+  }
+
+  // 2. Run inference.
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+
+  // 3. Split the outputs along dimension 0, one slice per entry.
+  const auto& output_indexes = interpreter_->outputs();
+  outputs->resize(batch_size);
+  for (auto& output : *outputs) {
+    output.reserve(output.size() + output_indexes.size());
+  }
+  for (int i = 0; i < output_indexes.size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->tensor(output_indexes[i]);
+    if (batch_size == 1) {
+      (*outputs)[0].push_back(pool->Copy(*tensor));
+      continue;
+    }
+    RET_CHECK_GT(tensor->dims->size, 0);
+    RET_CHECK_EQ(tensor->dims->data[0] % batch_size, 0)
+        << "Output tensor " << i << " cannot be split into " << batch_size
+        << " slices.";
+    std::vector<int> slice_dims(tensor->dims->data,
+                                tensor->dims->data + tensor->dims->size);
+    slice_dims[0] /= batch_size;
+    const size_t slice_bytes = tensor->bytes / batch_size;
+    for (int j = 0; j < batch_size; ++j) {
+      PooledTfLiteTensor slice = pool->Acquire(tensor->type, slice_dims);
+      RET_CHECK_EQ(slice->bytes, slice_bytes);
+      slice.mutable_tensor()->params = tensor->params;
+      std::memcpy(slice.mutable_tensor()->data.raw,
+                  tensor->data.raw + j * slice_bytes, slice_bytes);
+      (*outputs)[j].push_back(std::move(slice));
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
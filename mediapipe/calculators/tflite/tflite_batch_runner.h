@@ -0,0 +1,68 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_BATCH_RUNNER_H_
+#define MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_BATCH_RUNNER_H_
+
+#include <memory>
+#include <vector>
+
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "tensorflow/lite/interpreter.h"
+
+namespace mediapipe {
+
+// Runs a CPU TF Lite interpreter on several sets of inputs at once. The
+// inputs of a batch are stacked along dimension 0, the model is invoked once,
+// and every output is split along dimension 0 into one slice per set. For
+// batches of more than one set, the model must accept a variable size in
+// dimension 0 of every input, and produce outputs whose dimension 0 grows in
+// proportion. The interpreter is only resized when the batch size changes.
+//
+// Not thread-safe.
+class TfLiteBatchRunner {
+ public:
+  // Takes over `interpreter`, whose input shapes are those of a batch of one.
+  static ::mediapipe::StatusOr<std::unique_ptr<TfLiteBatchRunner>> Create(
+      std::unique_ptr<tflite::Interpreter> interpreter);
+
+  // Runs the model on `batch`, which holds one set of input tensors per
+  // entry, each shaped like the model's inputs. Appends the output tensors of
+  // each entry to the corresponding element of `outputs`, which is resized to
+  // the batch size. Output buffers come from `pool`.
+  ::mediapipe::Status Run(
+      const std::vector<std::vector<const TfLiteTensor*>>& batch,
+      TfLiteTensorPool* pool,
+      std::vector<std::vector<PooledTfLiteTensor>>* outputs);
+
+  tflite::Interpreter* interpreter() { return interpreter_.get(); }
+
+ private:
+  explicit TfLiteBatchRunner(std::unique_ptr<tflite::Interpreter> interpreter);
+
+  // Resizes the interpreter inputs for `batch_size` entries if needed.
+  ::mediapipe::Status Resize(int batch_size);
+
+  std::unique_ptr<tflite::Interpreter> interpreter_;
+  // The input dims of the model for a batch of one.
+  std::vector<std::vector<int>> input_dims_;
+  // The batch size the interpreter tensors are allocated for.
+  int allocated_batch_size_ = 0;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_BATCH_RUNNER_H_
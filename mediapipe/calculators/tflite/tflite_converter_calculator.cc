@@ -16,11 +16,13 @@
 #include <vector>
 
 #include "mediapipe/calculators/tflite/tflite_converter_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/util.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/matrix.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/image_normalization.h"
 #include "mediapipe/util/resource_util.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
@@ -107,6 +109,7 @@ struct GPUData {
 // Output:
 //  One of the following tags:
 //  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32, or kTfLiteUint8.
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS.
 //  TENSORS_GPU - vector of GlBuffer or MTLBuffer.
 //
 // Example use:
@@ -126,6 +129,9 @@ struct GPUData {
 //  Inputs/outputs must match type: CPU->CPU or GPU->GPU.
 //  GPU tensors are currently only supported on mobile platforms.
 //  This calculator uses FixedSizeInputStreamHandler by default.
+//  With POOLED_TENSORS output, a quantized tensor from an IMAGE whose rows are
+//  tightly packed and whose channels are all kept aliases the ImageFrame pixel
+//  data instead of copying it; the tensor keeps the input packet alive.
 //
 class TfLiteConverterCalculator : public CalculatorBase {
  public:
@@ -138,16 +144,18 @@ class TfLiteConverterCalculator : public CalculatorBase {
  private:
   ::mediapipe::Status InitGpu(CalculatorContext* cc);
   ::mediapipe::Status LoadOptions(CalculatorContext* cc);
-  template <class T>
   ::mediapipe::Status NormalizeImage(const ImageFrame& image_frame,
                                      bool zero_center, bool flip_vertically,
                                      float* tensor_buffer);
+  ::mediapipe::Status CopyImage(const ImageFrame& image_frame,
+                                uint8* tensor_buffer);
   ::mediapipe::Status CopyMatrixToTensor(const Matrix& matrix,
                                          float* tensor_buffer);
   ::mediapipe::Status ProcessCPU(CalculatorContext* cc);
   ::mediapipe::Status ProcessGPU(CalculatorContext* cc);
 
   std::unique_ptr<tflite::Interpreter> interpreter_ = nullptr;
+  TfLiteTensorPool tensor_pool_;
 
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
     !defined(__APPLE__)
@@ -178,8 +186,10 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
             !(has_image_tag && has_image_gpu_tag && has_matrix_tag));
 
   // Confirm only one of the output streams is present.
-  RET_CHECK(cc->Outputs().HasTag("TENSORS") ^
-            cc->Outputs().HasTag("TENSORS_GPU"));
+  RET_CHECK_EQ(cc->Outputs().HasTag("TENSORS") +
+                   cc->Outputs().HasTag("POOLED_TENSORS") +
+                   cc->Outputs().HasTag("TENSORS_GPU"),
+               1);
 
   bool use_gpu = false;
 
@@ -194,6 +204,8 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
 
   if (cc->Outputs().HasTag("TENSORS"))
     cc->Outputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
+  if (cc->Outputs().HasTag("POOLED_TENSORS"))
+    cc->Outputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__)
   if (cc->Outputs().HasTag("TENSORS_GPU")) {
     cc->Outputs().Tag("TENSORS_GPU").Set<std::vector<GpuTensor>>();
@@ -243,7 +255,7 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
     gpu_helper_ = [[MPPMetalHelper alloc] initWithCalculatorContext:cc];
     RET_CHECK(gpu_helper_);
 #endif
-  } else {
+  } else if (cc->Outputs().HasTag("TENSORS")) {
     interpreter_ = absl::make_unique<tflite::Interpreter>();
     interpreter_->AddTensors(1);
     interpreter_->SetInputs({0});
@@ -297,21 +309,48 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
             image_frame.Format() == mediapipe::ImageFormat::GRAY8 ||
             image_frame.Format() == mediapipe::ImageFormat::VEC32F1))
         RET_CHECK_FAIL() << "Unsupported CPU input format.";
-      TfLiteQuantization quant;
       if (use_quantized_tensors_) {
         RET_CHECK(image_frame.Format() != mediapipe::ImageFormat::VEC32F1)
             << "Only 8-bit input images are supported for quantization.";
-        // Optional: Set 'quant' quantization params here if needed.
-        interpreter_->SetTensorParametersReadWrite(0, kTfLiteUInt8, "",
-                                                   {channels_preserved}, quant);
-      } else {
+      }
+      if (interpreter_) {
         // Default TfLiteQuantization used for no quantization.
-        interpreter_->SetTensorParametersReadWrite(0, kTfLiteFloat32, "",
-                                                   {channels_preserved}, quant);
+        // Optional: Set 'quant' quantization params here if needed.
+        TfLiteQuantization quant;
+        interpreter_->SetTensorParametersReadWrite(
+            0, use_quantized_tensors_ ? kTfLiteUInt8 : kTfLiteFloat32, "",
+            {channels_preserved}, quant);
       }
       initialized_ = true;
     }
 
+    if (cc->Outputs().HasTag("POOLED_TENSORS")) {
+      const std::vector<int> dims = {height, width, channels_preserved};
+      auto output_tensors =
+          absl::make_unique<std::vector<PooledTfLiteTensor>>();
+      if (use_quantized_tensors_ && channels == channels_preserved &&
+          image_frame.IsContiguous()) {
+        // The pixels are already laid out as the tensor expects them.
+        const Packet& image_packet = cc->Inputs().Tag("IMAGE").Value();
+        output_tensors->push_back(PooledTfLiteTensor::Alias(
+            kTfLiteUInt8, dims,
+            const_cast<uint8*>(image_frame.PixelData()),
+            std::make_shared<Packet>(image_packet)));
+      } else if (use_quantized_tensors_) {
+        output_tensors->push_back(tensor_pool_.Acquire(kTfLiteUInt8, dims));
+        MP_RETURN_IF_ERROR(CopyImage(
+            image_frame, output_tensors->back().mutable_tensor()->data.uint8));
+      } else {
+        output_tensors->push_back(tensor_pool_.Acquire(kTfLiteFloat32, dims));
+        MP_RETURN_IF_ERROR(NormalizeImage(
+            image_frame, zero_center_, flip_vertically_,
+            output_tensors->back().mutable_tensor()->data.f));
+      }
+      cc->Outputs().Tag("POOLED_TENSORS").Add(output_tensors.release(),
+                                              cc->InputTimestamp());
+      return ::mediapipe::OkStatus();
+    }
+
     const int tensor_idx = interpreter_->inputs()[0];
     TfLiteTensor* tensor = interpreter_->tensor(tensor_idx);
     interpreter_->ResizeInputTensor(tensor_idx,
@@ -319,41 +358,15 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
     interpreter_->AllocateTensors();
 
     // Copy image data into tensor.
-    // TODO: This is super inefficient. Copies should always be avoided at
-    // all costs. TFLite can operate on pointers passed to it, and if input
-    // data is packed as expected, i.e. row stride == width, input can be
-    // used as is. Thus image_frame should use alignment 1 if at all possible.
-    // When not possible data should be copied row by row to take advantage
-    // of optimized memcpy routines in libc, never one byte at the time.
     if (use_quantized_tensors_) {
-      const int width_padding =
-          image_frame.WidthStep() / image_frame.ByteDepth() - width * channels;
-      const uint8* image_buffer =
-          reinterpret_cast<const uint8*>(image_frame.PixelData());
       uint8* tensor_buffer = tensor->data.uint8;
       RET_CHECK(tensor_buffer);
-      for (int row = 0; row < height; ++row) {
-        for (int col = 0; col < width; ++col) {
-          for (int channel = 0; channel < channels_preserved; ++channel) {
-            *tensor_buffer++ = image_buffer[channel];
-          }
-          image_buffer += channels;
-        }
-        image_buffer += width_padding;
-      }
+      MP_RETURN_IF_ERROR(CopyImage(image_frame, tensor_buffer));
     } else {
       float* tensor_buffer = tensor->data.f;
       RET_CHECK(tensor_buffer);
-      if (image_frame.ByteDepth() == 1) {
-        MP_RETURN_IF_ERROR(NormalizeImage<uint8>(
-            image_frame, zero_center_, flip_vertically_, tensor_buffer));
-      } else if (image_frame.ByteDepth() == 4) {
-        MP_RETURN_IF_ERROR(NormalizeImage<float>(
-            image_frame, zero_center_, flip_vertically_, tensor_buffer));
-      } else {
-        return ::mediapipe::InternalError(
-            "Only byte-based (8 bit) and float (32 bit) images supported.");
-      }
+      MP_RETURN_IF_ERROR(NormalizeImage(image_frame, zero_center_,
+                                        flip_vertically_, tensor_buffer));
     }
 
     auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
@@ -368,6 +381,18 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
     const int width = matrix.cols();
     const int channels = 1;
 
+    if (cc->Outputs().HasTag("POOLED_TENSORS")) {
+      auto output_tensors =
+          absl::make_unique<std::vector<PooledTfLiteTensor>>();
+      output_tensors->push_back(
+          tensor_pool_.Acquire(kTfLiteFloat32, {height, width, channels}));
+      MP_RETURN_IF_ERROR(CopyMatrixToTensor(
+          matrix, output_tensors->back().mutable_tensor()->data.f));
+      cc->Outputs().Tag("POOLED_TENSORS").Add(output_tensors.release(),
+                                              cc->InputTimestamp());
+      return ::mediapipe::OkStatus();
+    }
+
     if (!initialized_) {
       interpreter_->SetTensorParametersReadWrite(
           /*tensor_index=*/0, /*type=*/kTfLiteFloat32, /*name=*/"",
@@ -638,7 +663,6 @@ REGISTER_CALCULATOR(TfLiteConverterCalculator);
   return ::mediapipe::OkStatus();
 }
 
-template <class T>
 ::mediapipe::Status TfLiteConverterCalculator::NormalizeImage(
     const ImageFrame& image_frame, bool zero_center, bool flip_vertically,
     float* tensor_buffer) {
@@ -646,31 +670,36 @@ template <class T>
   const int width = image_frame.Width();
   const int channels = image_frame.NumberOfChannels();
   const int channels_preserved = std::min(channels, max_num_channels_);
-  const int channels_ignored = channels - channels_preserved;
 
-  float div, sub;
-  if (zero_center) {
-    // [-1,1]
-    div = 127.5f;
-    sub = 1.0f;
+  // value * scale + offset maps [0,255] to [-1,1] or [0,1].
+  const float scale = zero_center ? 1.0f / 127.5f : 1.0f / 255.0f;
+  const float offset = zero_center ? -1.0f : 0.0f;
+
+  if (image_frame.ByteDepth() == 1) {
+    NormalizeUint8Image(image_frame.PixelData(), image_frame.WidthStep(),
+                        width, height, channels, channels_preserved, scale,
+                        offset, flip_vertically, tensor_buffer);
+  } else if (image_frame.ByteDepth() == 4) {
+    NormalizeFloatImage(
+        reinterpret_cast<const float*>(image_frame.PixelData()),
+        image_frame.WidthStep(), width, height, channels, channels_preserved,
+        scale, offset, flip_vertically, tensor_buffer);
   } else {
-    // [0,1]
-    div = 255.0f;
-    sub = 0.0f;
+    return ::mediapipe::InternalError(
+        "Only byte-based (8 bit) and float (32 bit) images supported.");
   }
 
-  for (int i = 0; i < height; ++i) {
-    const T* image_ptr = reinterpret_cast<const T*>(
-        image_frame.PixelData() +
-        (flip_vertically ? height - 1 - i : i) * image_frame.WidthStep());
-    for (int j = 0; j < width; ++j) {
-      for (int c = 0; c < channels_preserved; ++c) {
-        *tensor_buffer++ = *image_ptr++ / div - sub;
-      }
-      image_ptr += channels_ignored;
-    }
-  }
+  return ::mediapipe::OkStatus();
+}
 
+::mediapipe::Status TfLiteConverterCalculator::CopyImage(
+    const ImageFrame& image_frame, uint8* tensor_buffer) {
+  const int channels = image_frame.NumberOfChannels();
+  // Quantized tensors are never flipped.
+  CopyUint8Image(image_frame.PixelData(), image_frame.WidthStep(),
+                 image_frame.Width(), image_frame.Height(), channels,
+                 std::min(channels, max_num_channels_),
+                 /*flip_vertically=*/false, tensor_buffer);
   return ::mediapipe::OkStatus();
 }
 
@@ -12,13 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <random>
 #include <vector>
 
 #include "absl/memory/memory.h"
 #include "mediapipe/calculators/tflite/tflite_converter_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/matrix.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -196,4 +199,81 @@ TEST_F(TfLiteConverterCalculatorTest, RandomMatrixRowMajor) {
   }
 }
 
+namespace {
+
+// Runs the converter on a single image with POOLED_TENSORS output.
+void RunPooledImageGraph(const TfLiteConverterCalculatorOptions& options,
+                         const Packet& image,
+                         std::vector<Packet>* output_packets) {
+  CalculatorGraphConfig graph_config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "image"
+        node {
+          calculator: "TfLiteConverterCalculator"
+          input_stream: "IMAGE:image"
+          output_stream: "POOLED_TENSORS:tensor"
+        }
+      )");
+  *graph_config.mutable_node(0)->mutable_options()->MutableExtension(
+      TfLiteConverterCalculatorOptions::ext) = options;
+  tool::AddVectorSink("tensor", &graph_config, output_packets);
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(graph_config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  MP_ASSERT_OK(graph.AddPacketToInputStream("image", image));
+  MP_ASSERT_OK(graph.CloseInputStream("image"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(1, output_packets->size());
+}
+
+// Returns a width x height RGB image with every byte set to its row index.
+Packet MakeRgbImage(int width, int height, uint32 alignment_boundary) {
+  auto image = absl::make_unique<ImageFrame>(ImageFormat::SRGB, width, height,
+                                             alignment_boundary);
+  for (int row = 0; row < height; ++row) {
+    std::fill_n(image->MutablePixelData() + row * image->WidthStep(),
+                width * 3, row);
+  }
+  return Adopt(image.release()).At(Timestamp(0));
+}
+
+}  // namespace
+
+TEST_F(TfLiteConverterCalculatorTest, PooledQuantizedImageAliasesPixels) {
+  const Packet image = MakeRgbImage(5, 3, /*alignment_boundary=*/1);
+  TfLiteConverterCalculatorOptions options;
+  options.set_use_quantized_tensors(true);
+  std::vector<Packet> output_packets;
+  RunPooledImageGraph(options, image, &output_packets);
+
+  const auto& tensors =
+      output_packets[0].Get<std::vector<PooledTfLiteTensor>>();
+  ASSERT_EQ(1, tensors.size());
+  EXPECT_EQ(kTfLiteUInt8, tensors[0]->type);
+  EXPECT_EQ(5 * 3 * 3, tensors[0]->bytes);
+  EXPECT_EQ(image.Get<ImageFrame>().PixelData(), tensors[0]->data.uint8);
+}
+
+TEST_F(TfLiteConverterCalculatorTest, PooledFloatImageIsNormalized) {
+  const Packet image = MakeRgbImage(5, 3, /*alignment_boundary=*/16);
+  TfLiteConverterCalculatorOptions options;
+  options.set_zero_center(false);
+  options.set_flip_vertically(true);
+  std::vector<Packet> output_packets;
+  RunPooledImageGraph(options, image, &output_packets);
+
+  const auto& tensors =
+      output_packets[0].Get<std::vector<PooledTfLiteTensor>>();
+  ASSERT_EQ(1, tensors.size());
+  EXPECT_EQ(kTfLiteFloat32, tensors[0]->type);
+  ASSERT_EQ(3, tensors[0]->dims->size);
+  EXPECT_EQ(3, tensors[0]->dims->data[0]);
+  EXPECT_EQ(5, tensors[0]->dims->data[1]);
+  for (int i = 0; i < 5 * 3 * 3; ++i) {
+    const int source_row = 2 - i / (5 * 3);
+    EXPECT_FLOAT_EQ(source_row / 255.0f, tensors[0]->data.f[i])
+        << "at i = " << i;
+  }
+}
+
 }  // namespace mediapipe
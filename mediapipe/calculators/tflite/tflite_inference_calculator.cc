@@ -17,11 +17,16 @@
 #include <string>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "mediapipe/calculators/tflite/tflite_inference_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_inference_service.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/util.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/cleanup.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/util/resource_util.h"
+#include "mediapipe/util/tflite/tflite_model_cache.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/kernels/register.h"
@@ -73,14 +78,14 @@ std::shared_ptr<edgetpu::EdgeTpuContext> edgetpu_context =
 std::unique_ptr<tflite::Interpreter> BuildEdgeTpuInterpreter(
     const tflite::FlatBufferModel& model,
     tflite::ops::builtin::BuiltinOpResolver* resolver,
-    edgetpu::EdgeTpuContext* edgetpu_context) {
+    edgetpu::EdgeTpuContext* edgetpu_context, int num_threads) {
   resolver->AddCustom(edgetpu::kCustomOp, edgetpu::RegisterCustomOp());
   std::unique_ptr<tflite::Interpreter> interpreter;
   if (tflite::InterpreterBuilder(model, *resolver)(&interpreter) != kTfLiteOk) {
     std::cerr << "Failed to build edge TPU interpreter." << std::endl;
   }
   interpreter->SetExternalContext(kTfLiteEdgeTpuContext, edgetpu_context);
-  interpreter->SetNumThreads(1);
+  interpreter->SetNumThreads(num_threads);
   if (interpreter->AllocateTensors() != kTfLiteOk) {
     std::cerr << "Failed to allocate edge TPU tensors." << std::endl;
   }
@@ -126,10 +131,14 @@ struct GPUData {
 //
 // Input:
 //  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32 or kTfLiteUInt8
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS
 //  TENSORS_GPU - Vector of GlBuffer or MTLBuffer
 //
 // Output:
 //  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32 or kTfLiteUInt8
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor of type kTfLiteFloat32 or
+//                   kTfLiteUInt8, holding a copy of the outputs that remains
+//                   valid after the next invocation
 //  TENSORS_GPU - Vector of GlBuffer or MTLBuffer
 //
 // Input side packet:
@@ -149,13 +158,41 @@ struct GPUData {
 //   }
 // }
 //
+// To keep several frames in flight on a multi-core CPU, create an interpreter
+// per in-flight frame. The calculator then requests max_in_flight equal to
+// num_interpreters, and outputs are still emitted in timestamp order:
+// node {
+//   calculator: "TfLiteInferenceCalculator"
+//   input_stream: "TENSORS:tensor_image"
+//   output_stream: "POOLED_TENSORS:tensors"
+//   options: {
+//     [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+//       model_path: "modelname.tflite"
+//       num_interpreters: 4
+//       cpu_num_threads: 2
+//     }
+//   }
+// }
+//
 // IMPORTANT Notes:
 //  Tensors are assumed to be ordered correctly (sequentially added to model).
 //  Input tensors are assumed to be of the correct size and already normalized.
 //  All output TfLiteTensors will be destroyed when the graph closes,
 //  (i.e. after calling graph.WaitUntilDone()).
+//  TENSORS outputs point into the interpreter and are overwritten by the next
+//  Process() call, so they must be consumed before then. POOLED_TENSORS
+//  outputs own their data, recycled through a TfLiteTensorPool, and can be
+//  held by any number of downstream calculators for as long as needed.
 //  GPU tensors are currently only supported on Android and iOS.
+//  num_interpreters > 1 requires CPU inference and POOLED_TENSORS output.
 //  This calculator uses FixedSizeInputStreamHandler by default.
+//  If the graph provides kTfLiteInferenceService, CPU inference runs on the
+//  shared service instead of interpreters owned by the calculator, unless a
+//  CUSTOM_OP_RESOLVER is given. num_interpreters then sets how many frames
+//  the calculator may have waiting on the service at once; waiting frames do
+//  not hold graph executor threads.
+//  The model is memory-mapped once per process and shared by all calculators
+//  and graphs that load the same model file.
 //
 class TfLiteInferenceCalculator : public CalculatorBase {
  public:
@@ -169,10 +206,34 @@ class TfLiteInferenceCalculator : public CalculatorBase {
   ::mediapipe::Status LoadOptions(CalculatorContext* cc);
   ::mediapipe::Status LoadModel(CalculatorContext* cc);
   ::mediapipe::Status LoadDelegate(CalculatorContext* cc);
-
+  // Runs CPU inference on inference_service_ instead of an own interpreter.
+  // The invocation completes asynchronously, once the service has run it.
+  ::mediapipe::Status ProcessWithService(CalculatorContext* cc);
+  void OutputServiceTensors(CalculatorContext* cc,
+                            std::vector<PooledTfLiteTensor> output_tensors);
+  ::mediapipe::Status BuildInterpreter(
+      CalculatorContext* cc, std::unique_ptr<tflite::Interpreter>* interpreter);
+
+  // Waits for an idle interpreter and checks it out for one Process() call.
+  tflite::Interpreter* AcquireInterpreter();
+  void ReleaseInterpreter(tflite::Interpreter* interpreter);
+
+  // interpreter_ is the only interpreter used for GPU inference. Extra
+  // interpreters share model_ and only serve parallel CPU invocations.
   std::unique_ptr<tflite::Interpreter> interpreter_;
-  std::unique_ptr<tflite::FlatBufferModel> model_;
+  std::vector<std::unique_ptr<tflite::Interpreter>> extra_interpreters_;
+  absl::Mutex interpreters_mutex_;
+  std::vector<tflite::Interpreter*> idle_interpreters_
+      GUARDED_BY(interpreters_mutex_);
+  std::shared_ptr<const tflite::FlatBufferModel> model_;
   TfLiteDelegate* delegate_ = nullptr;
+  TfLiteTensorPool tensor_pool_;
+
+  // Set if CPU inference runs on a TfLiteInferenceService.
+  TfLiteInferenceService* inference_service_ = nullptr;
+  TfLiteInferenceService::Model* service_model_ = nullptr;
+  // Holds the data of the latest TENSORS output produced by the service.
+  std::vector<PooledTfLiteTensor> service_outputs_;
 
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
     !defined(__APPLE__)
@@ -187,6 +248,8 @@ class TfLiteInferenceCalculator : public CalculatorBase {
 #endif
 
   std::string model_path_ = "";
+  int num_interpreters_ = 1;
+  int cpu_num_threads_ = -1;
   bool gpu_inference_ = false;
   bool gpu_input_ = false;
   bool gpu_output_ = false;
@@ -198,15 +261,21 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 
 ::mediapipe::Status TfLiteInferenceCalculator::GetContract(
     CalculatorContract* cc) {
-  RET_CHECK(cc->Inputs().HasTag("TENSORS") ^
-            cc->Inputs().HasTag("TENSORS_GPU"));
-  RET_CHECK(cc->Outputs().HasTag("TENSORS") ^
-            cc->Outputs().HasTag("TENSORS_GPU"));
+  RET_CHECK_EQ(cc->Inputs().HasTag("TENSORS") +
+                   cc->Inputs().HasTag("POOLED_TENSORS") +
+                   cc->Inputs().HasTag("TENSORS_GPU"),
+               1);
+  RET_CHECK_EQ(cc->Outputs().HasTag("TENSORS") +
+                   cc->Outputs().HasTag("POOLED_TENSORS") +
+                   cc->Outputs().HasTag("TENSORS_GPU"),
+               1);
 
   bool use_gpu = false;
 
   if (cc->Inputs().HasTag("TENSORS"))
     cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
+  if (cc->Inputs().HasTag("POOLED_TENSORS"))
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__)
   if (cc->Inputs().HasTag("TENSORS_GPU")) {
     cc->Inputs().Tag("TENSORS_GPU").Set<std::vector<GpuTensor>>();
@@ -216,6 +285,8 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 
   if (cc->Outputs().HasTag("TENSORS"))
     cc->Outputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
+  if (cc->Outputs().HasTag("POOLED_TENSORS"))
+    cc->Outputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__)
   if (cc->Outputs().HasTag("TENSORS_GPU")) {
     cc->Outputs().Tag("TENSORS_GPU").Set<std::vector<GpuTensor>>();
@@ -228,11 +299,20 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
         .Tag("CUSTOM_OP_RESOLVER")
         .Set<tflite::ops::builtin::BuiltinOpResolver>();
   }
+  cc->UseService(kTfLiteInferenceService).Optional();
 
   const auto& options =
       cc->Options<::mediapipe::TfLiteInferenceCalculatorOptions>();
   use_gpu |= options.use_gpu();
 
+  if (options.num_interpreters() > 1) {
+    RET_CHECK(!use_gpu) << "num_interpreters > 1 requires CPU inference.";
+    RET_CHECK(cc->Outputs().HasTag("POOLED_TENSORS"))
+        << "num_interpreters > 1 requires POOLED_TENSORS output, since "
+           "TENSORS output points into interpreter memory that is reused.";
+    cc->SetMaxInFlight(options.num_interpreters());
+  }
+
   if (use_gpu) {
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
     !defined(__APPLE__)
@@ -274,6 +354,14 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 #endif  //  !MEDIAPIPE_DISABLE_GPU
   }
 
+  if (!gpu_inference_ && !gpu_input_ &&
+      !cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER") &&
+      cc->Service(kTfLiteInferenceService).IsAvailable()) {
+    inference_service_ = &cc->Service(kTfLiteInferenceService).GetObject();
+    ASSIGN_OR_RETURN(service_model_, inference_service_->GetModel(model_path_));
+    return ::mediapipe::OkStatus();
+  }
+
   MP_RETURN_IF_ERROR(LoadModel(cc));
 
   if (gpu_inference_) {
@@ -301,6 +389,14 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::Process(CalculatorContext* cc) {
+  if (inference_service_) {
+    return ProcessWithService(cc);
+  }
+
+  tflite::Interpreter* interpreter = AcquireInterpreter();
+  auto release_interpreter = MakeCleanup(
+      [this, interpreter]() { ReleaseInterpreter(interpreter); });
+
   // 1. Receive pre-processed tensor inputs.
   if (gpu_input_) {
     // Read GPU input into SSBO.
@@ -329,20 +425,22 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 #endif
   } else {
     // Read CPU input into tensors.
-    const auto& input_tensors =
-        cc->Inputs().Tag("TENSORS").Get<std::vector<TfLiteTensor>>();
+    const std::vector<const TfLiteTensor*> input_tensors = GetTfLiteTensors(
+        cc->Inputs().HasTag("POOLED_TENSORS")
+            ? cc->Inputs().Tag("POOLED_TENSORS").Value()
+            : cc->Inputs().Tag("TENSORS").Value());
     RET_CHECK_GT(input_tensors.size(), 0);
     for (int i = 0; i < input_tensors.size(); ++i) {
-      const TfLiteTensor* input_tensor = &input_tensors[i];
+      const TfLiteTensor* input_tensor = input_tensors[i];
       RET_CHECK(input_tensor->data.raw);
       if (use_quantized_tensors_) {
         const uint8* input_tensor_buffer = input_tensor->data.uint8;
-        uint8* local_tensor_buffer = interpreter_->typed_input_tensor<uint8>(i);
+        uint8* local_tensor_buffer = interpreter->typed_input_tensor<uint8>(i);
         std::memcpy(local_tensor_buffer, input_tensor_buffer,
                     input_tensor->bytes);
       } else {
         const float* input_tensor_buffer = input_tensor->data.f;
-        float* local_tensor_buffer = interpreter_->typed_input_tensor<float>(i);
+        float* local_tensor_buffer = interpreter->typed_input_tensor<float>(i);
         std::memcpy(local_tensor_buffer, input_tensor_buffer,
                     input_tensor->bytes);
       }
@@ -354,15 +452,15 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
     !defined(__APPLE__)
     MP_RETURN_IF_ERROR(
-        gpu_helper_.RunInGlContext([this]() -> ::mediapipe::Status {
-          RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+        gpu_helper_.RunInGlContext([interpreter]() -> ::mediapipe::Status {
+          RET_CHECK_EQ(interpreter->Invoke(), kTfLiteOk);
           return ::mediapipe::OkStatus();
         }));
 #elif defined(__APPLE__) && !TARGET_OS_OSX  // iOS
-    RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+    RET_CHECK_EQ(interpreter->Invoke(), kTfLiteOk);
 #endif
   } else {
-    RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+    RET_CHECK_EQ(interpreter->Invoke(), kTfLiteOk);
   }
 
   // 3. Output processed tensors.
@@ -413,12 +511,23 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 #else
     RET_CHECK_FAIL() << "GPU processing not enabled.";
 #endif  //  !MEDIAPIPE_DISABLE_GPU
+  } else if (cc->Outputs().HasTag("POOLED_TENSORS")) {
+    // Output result tensors (CPU), copied out of the interpreter arena.
+    const auto& tensor_indexes = interpreter->outputs();
+    auto output_tensors = absl::make_unique<std::vector<PooledTfLiteTensor>>();
+    output_tensors->reserve(tensor_indexes.size());
+    for (int i = 0; i < tensor_indexes.size(); ++i) {
+      const TfLiteTensor* tensor = interpreter->tensor(tensor_indexes[i]);
+      output_tensors->push_back(tensor_pool_.Copy(*tensor));
+    }
+    cc->Outputs().Tag("POOLED_TENSORS").Add(output_tensors.release(),
+                                            cc->InputTimestamp());
   } else {
     // Output result tensors (CPU).
-    const auto& tensor_indexes = interpreter_->outputs();
+    const auto& tensor_indexes = interpreter->outputs();
     auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
     for (int i = 0; i < tensor_indexes.size(); ++i) {
-      TfLiteTensor* tensor = interpreter_->tensor(tensor_indexes[i]);
+      TfLiteTensor* tensor = interpreter->tensor(tensor_indexes[i]);
       output_tensors->emplace_back(*tensor);
     }
     cc->Outputs().Tag("TENSORS").Add(output_tensors.release(),
@@ -457,6 +566,59 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 
 // Calculator Auxiliary Section
 
+::mediapipe::Status TfLiteInferenceCalculator::ProcessWithService(
+    CalculatorContext* cc) {
+  std::vector<PooledTfLiteTensor> input_tensors;
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    input_tensors = cc->Inputs()
+                        .Tag("POOLED_TENSORS")
+                        .Get<std::vector<PooledTfLiteTensor>>();
+  } else {
+    // The input tensors are used in place, kept alive by their packet.
+    const Packet& packet = cc->Inputs().Tag("TENSORS").Value();
+    auto owner = std::make_shared<Packet>(packet);
+    for (const TfLiteTensor* tensor : GetTfLiteTensors(packet)) {
+      RET_CHECK(tensor->data.raw);
+      std::vector<int> dims(tensor->dims->data,
+                            tensor->dims->data + tensor->dims->size);
+      input_tensors.push_back(PooledTfLiteTensor::Alias(
+          tensor->type, dims, tensor->data.raw, owner));
+    }
+  }
+  RET_CHECK_GT(input_tensors.size(), 0);
+
+  // The invocation completes when the service has run it, so that it does
+  // not hold an executor thread while it waits.
+  CalculatorContext::CompletionCallback done = cc->DeferCompletion();
+  inference_service_->Submit(
+      service_model_, std::move(input_tensors),
+      [this, cc, done](
+          ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>> outputs) {
+        if (outputs.ok()) {
+          OutputServiceTensors(cc, std::move(outputs).ValueOrDie());
+        }
+        done(outputs.status());
+      });
+  return ::mediapipe::OkStatus();
+}
+
+void TfLiteInferenceCalculator::OutputServiceTensors(
+    CalculatorContext* cc, std::vector<PooledTfLiteTensor> output_tensors) {
+  if (cc->Outputs().HasTag("POOLED_TENSORS")) {
+    cc->Outputs().Tag("POOLED_TENSORS").Add(
+        new std::vector<PooledTfLiteTensor>(std::move(output_tensors)),
+        cc->InputTimestamp());
+  } else {
+    // Only one invocation is in flight with TENSORS output.
+    service_outputs_ = std::move(output_tensors);
+    auto outputs = absl::make_unique<std::vector<TfLiteTensor>>();
+    for (const PooledTfLiteTensor& tensor : service_outputs_) {
+      outputs->emplace_back(*tensor.tensor());
+    }
+    cc->Outputs().Tag("TENSORS").Add(outputs.release(), cc->InputTimestamp());
+  }
+}
+
 ::mediapipe::Status TfLiteInferenceCalculator::LoadOptions(
     CalculatorContext* cc) {
   // Get calculator options specified in the graph.
@@ -476,27 +638,59 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 
   // Get execution modes.
   gpu_inference_ = options.use_gpu();
+  num_interpreters_ = options.num_interpreters();
+  RET_CHECK_GE(num_interpreters_, 1);
+  cpu_num_threads_ = options.cpu_num_threads();
 
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::LoadModel(
     CalculatorContext* cc) {
-  model_ = tflite::FlatBufferModel::BuildFromFile(model_path_.c_str());
-  RET_CHECK(model_);
+  ASSIGN_OR_RETURN(model_, GetSharedTfLiteModel(model_path_));
 
+  MP_RETURN_IF_ERROR(BuildInterpreter(cc, &interpreter_));
+  for (int i = 1; i < num_interpreters_; ++i) {
+    extra_interpreters_.emplace_back();
+    MP_RETURN_IF_ERROR(BuildInterpreter(cc, &extra_interpreters_.back()));
+    RET_CHECK_EQ(extra_interpreters_.back()->AllocateTensors(), kTfLiteOk);
+  }
+  {
+    absl::MutexLock lock(&interpreters_mutex_);
+    idle_interpreters_.push_back(interpreter_.get());
+    for (const auto& interpreter : extra_interpreters_) {
+      idle_interpreters_.push_back(interpreter.get());
+    }
+  }
+
+  if (gpu_output_) {
+    use_quantized_tensors_ = false;
+  } else {
+    RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+    use_quantized_tensors_ =
+        (interpreter_->tensor(interpreter_->inputs()[0])->quantization.type ==
+         kTfLiteAffineQuantization);
+    if (use_quantized_tensors_) gpu_inference_ = false;
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::BuildInterpreter(
+    CalculatorContext* cc, std::unique_ptr<tflite::Interpreter>* interpreter) {
 #ifdef DRISHTI_EDGE_TPU
+  const int num_threads = cpu_num_threads_ > 0 ? cpu_num_threads_ : 1;
   if (cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER")) {
     auto& op_resolver = cc->InputSidePackets()
                             .Tag("CUSTOM_OP_RESOLVER")
                             .Get<tflite::ops::builtin::BuiltinOpResolver>();
-    interpreter_ = BuildEdgeTpuInterpreter(
+    *interpreter = BuildEdgeTpuInterpreter(
         *model_, (tflite::ops::builtin::BuiltinOpResolver*)&op_resolver,
-        edgetpu_context.get());
+        edgetpu_context.get(), num_threads);
   } else {
     tflite::ops::builtin::BuiltinOpResolver op_resolver;
-    interpreter_ =
-        BuildEdgeTpuInterpreter(*model_, &op_resolver, edgetpu_context.get());
+    *interpreter = BuildEdgeTpuInterpreter(
+        *model_, &op_resolver, edgetpu_context.get(), num_threads);
   }
 #else
   if (cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER")) {
@@ -504,32 +698,40 @@ REGISTER_CALCULATOR(TfLiteInferenceCalculator);
         cc->InputSidePackets()
             .Tag("CUSTOM_OP_RESOLVER")
             .Get<tflite::ops::builtin::BuiltinOpResolver>();
-    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter_);
+    tflite::InterpreterBuilder(*model_, op_resolver)(interpreter);
   } else {
     const tflite::ops::builtin::BuiltinOpResolver op_resolver;
-    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter_);
+    tflite::InterpreterBuilder(*model_, op_resolver)(interpreter);
   }
 #endif
 
-  RET_CHECK(interpreter_);
+  RET_CHECK(*interpreter);
 
 #if defined(__EMSCRIPTEN__)
-  interpreter_->SetNumThreads(1);
+  (*interpreter)->SetNumThreads(cpu_num_threads_ > 0 ? cpu_num_threads_ : 1);
+#else
+  if (cpu_num_threads_ > 0) (*interpreter)->SetNumThreads(cpu_num_threads_);
 #endif  // __EMSCRIPTEN__
 
-  if (gpu_output_) {
-    use_quantized_tensors_ = false;
-  } else {
-    RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
-    use_quantized_tensors_ =
-        (interpreter_->tensor(interpreter_->inputs()[0])->quantization.type ==
-         kTfLiteAffineQuantization);
-    if (use_quantized_tensors_) gpu_inference_ = false;
-  }
-
   return ::mediapipe::OkStatus();
 }
 
+tflite::Interpreter* TfLiteInferenceCalculator::AcquireInterpreter() {
+  absl::MutexLock lock(&interpreters_mutex_);
+  interpreters_mutex_.Await(absl::Condition(
+      +[](std::vector<tflite::Interpreter*>* idle) { return !idle->empty(); },
+      &idle_interpreters_));
+  tflite::Interpreter* interpreter = idle_interpreters_.back();
+  idle_interpreters_.pop_back();
+  return interpreter;
+}
+
+void TfLiteInferenceCalculator::ReleaseInterpreter(
+    tflite::Interpreter* interpreter) {
+  absl::MutexLock lock(&interpreters_mutex_);
+  idle_interpreters_.push_back(interpreter);
+}
+
 ::mediapipe::Status TfLiteInferenceCalculator::LoadDelegate(
     CalculatorContext* cc) {
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
@@ -17,6 +17,7 @@
 #include <vector>
 
 #include "mediapipe/calculators/tflite/tflite_inference_calculator.pb.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/deps/file_path.h"
@@ -120,4 +121,79 @@ TEST_F(TfLiteInferenceCalculatorTest, SmokeTest) {
   MP_ASSERT_OK(graph.WaitUntilDone());
 }
 
+// Runs the add model on several interpreters at once and checks that every
+// pooled output stays intact and arrives in timestamp order. The default input
+// stream handler is used so that no frame is dropped.
+TEST_F(TfLiteInferenceCalculatorTest, ParallelInterpretersWithPooledTensors) {
+  const int width = 8;
+  const int height = 8;
+  const int channels = 3;
+  const int num_elements = width * height * channels;
+  const int kNumFrames = 16;
+
+  CalculatorGraphConfig graph_config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
+          R"(
+            input_stream: "tensor_in"
+            node {
+              calculator: "TfLiteInferenceCalculator"
+              input_stream: "TENSORS:tensor_in"
+              output_stream: "POOLED_TENSORS:tensor_out"
+              input_stream_handler {
+                input_stream_handler: "DefaultInputStreamHandler"
+              }
+              options {
+                [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+                  model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+                  num_interpreters: 4
+                  cpu_num_threads: 1
+                }
+              }
+            }
+            num_threads: 4
+          )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  // Each frame owns its own input interpreter, filled with the frame index.
+  std::vector<std::unique_ptr<Interpreter>> input_interpreters;
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    input_interpreters.emplace_back(new Interpreter);
+    Interpreter* interpreter = input_interpreters.back().get();
+    interpreter->AddTensors(1);
+    interpreter->SetInputs({0});
+    interpreter->SetOutputs({0});
+    interpreter->SetTensorParametersReadWrite(0, kTfLiteFloat32, "", {3},
+                                              TfLiteQuantization());
+    int t = interpreter->inputs()[0];
+    interpreter->ResizeInputTensor(t, {width, height, channels});
+    interpreter->AllocateTensors();
+    TfLiteTensor* tensor = interpreter->tensor(t);
+    for (int i = 0; i < num_elements; ++i) {
+      tensor->data.f[i] = frame;
+    }
+    auto input_vec = absl::make_unique<std::vector<TfLiteTensor>>();
+    input_vec->emplace_back(*tensor);
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in", Adopt(input_vec.release()).At(Timestamp(frame))));
+  }
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+
+  ASSERT_EQ(kNumFrames, output_packets.size());
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    EXPECT_EQ(Timestamp(frame), output_packets[frame].Timestamp());
+    const auto& result_vec =
+        output_packets[frame].Get<std::vector<PooledTfLiteTensor>>();
+    ASSERT_EQ(1, result_vec.size());
+    const float* result_buffer = result_vec[0]->data.f;
+    ASSERT_NE(result_buffer, nullptr);
+    for (int i = 0; i < num_elements; ++i) {
+      ASSERT_EQ(3 * frame, result_buffer[i]);
+    }
+  }
+}
+
 }  // namespace mediapipe
@@ -0,0 +1,197 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/tflite_inference_service.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/tflite/tflite_model_cache.h"
+#include "tensorflow/lite/kernels/register.h"
+
+namespace mediapipe {
+
+const GraphService<TfLiteInferenceService> kTfLiteInferenceService(
+    "kTfLiteInferenceService");
+
+class TfLiteInferenceService::Model {
+ public:
+  Model(std::string path, std::shared_ptr<const tflite::FlatBufferModel> model)
+      : path_(std::move(path)), model_(std::move(model)) {}
+
+  const std::string& path() const { return path_; }
+  const tflite::FlatBufferModel& model() const { return *model_; }
+
+ private:
+  const std::string path_;
+  const std::shared_ptr<const tflite::FlatBufferModel> model_;
+};
+
+TfLiteInferenceService::TfLiteInferenceService()
+    : TfLiteInferenceService(Options()) {}
+
+TfLiteInferenceService::TfLiteInferenceService(const Options& options)
+    : options_(options) {
+  CHECK_GE(options_.num_workers, 1);
+  CHECK_GE(options_.max_batch_size, 1);
+  workers_ = absl::make_unique<ThreadPool>("mediapipe_tflite",
+                                           options_.num_workers);
+  workers_->StartWorkers();
+  for (int i = 0; i < options_.num_workers; ++i) {
+    workers_->Schedule([this] { RunWorker(); });
+  }
+}
+
+TfLiteInferenceService::~TfLiteInferenceService() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+  }
+  workers_.reset();
+}
+
+::mediapipe::StatusOr<TfLiteInferenceService::Model*>
+TfLiteInferenceService::GetModel(const std::string& model_path) {
+  absl::MutexLock lock(&models_mutex_);
+  auto it = models_.find(model_path);
+  if (it != models_.end()) {
+    return it->second.get();
+  }
+  ASSIGN_OR_RETURN(std::shared_ptr<const tflite::FlatBufferModel> model,
+                   GetSharedTfLiteModel(model_path));
+  auto& entry = models_[model_path];
+  entry = absl::make_unique<Model>(model_path, std::move(model));
+  return entry.get();
+}
+
+void TfLiteInferenceService::Submit(Model* model,
+                                    std::vector<PooledTfLiteTensor> inputs,
+                                    Callback done) {
+  absl::MutexLock lock(&mutex_);
+  queue_.push_back({model, std::move(inputs), std::move(done)});
+}
+
+::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>>
+TfLiteInferenceService::Run(Model* model,
+                            std::vector<PooledTfLiteTensor> inputs) {
+  absl::Notification finished;
+  ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>> result;
+  Submit(model, std::move(inputs),
+         [&finished, &result](
+             ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>> outputs) {
+           result = std::move(outputs);
+           finished.Notify();
+         });
+  finished.WaitForNotification();
+  return result;
+}
+
+int64 TfLiteInferenceService::NumRequests() {
+  absl::MutexLock lock(&mutex_);
+  return num_requests_;
+}
+
+int64 TfLiteInferenceService::NumInvocations() {
+  absl::MutexLock lock(&mutex_);
+  return num_invocations_;
+}
+
+void TfLiteInferenceService::RunWorker() {
+  // The interpreters of this worker, by model.
+  std::map<Model*, std::unique_ptr<TfLiteBatchRunner>> runners;
+  while (true) {
+    std::vector<Request> batch;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &TfLiteInferenceService::HasWork));
+      if (queue_.empty()) {
+        return;
+      }
+      batch = TakeBatch();
+    }
+    RunBatch(&batch, &runners);
+  }
+}
+
+bool TfLiteInferenceService::HasWork() const {
+  return stopping_ || !queue_.empty();
+}
+
+std::vector<TfLiteInferenceService::Request>
+TfLiteInferenceService::TakeBatch() {
+  std::vector<Request> batch;
+  Model* model = queue_.front().model;
+  for (auto it = queue_.begin();
+       it != queue_.end() && batch.size() < options_.max_batch_size;) {
+    if (it->model == model) {
+      batch.push_back(std::move(*it));
+      it = queue_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return batch;
+}
+
+void TfLiteInferenceService::RunBatch(
+    std::vector<Request>* batch,
+    std::map<Model*, std::unique_ptr<TfLiteBatchRunner>>* runners) {
+  Model* model = batch->front().model;
+  ::mediapipe::Status status;
+  std::vector<std::vector<PooledTfLiteTensor>> outputs;
+  std::unique_ptr<TfLiteBatchRunner>& runner = (*runners)[model];
+  if (!runner) {
+    std::unique_ptr<tflite::Interpreter> interpreter;
+    const tflite::ops::builtin::BuiltinOpResolver op_resolver;
+    tflite::InterpreterBuilder(model->model(), op_resolver)(&interpreter);
+    if (interpreter) {
+      interpreter->SetNumThreads(options_.cpu_num_threads);
+      auto runner_or = TfLiteBatchRunner::Create(std::move(interpreter));
+      if (runner_or.ok()) {
+        runner = std::move(runner_or).ValueOrDie();
+      } else {
+        status = runner_or.status();
+      }
+    } else {
+      status = ::mediapipe::InternalError(
+          "Failed to build an interpreter for " + model->path());
+    }
+  }
+  if (runner) {
+    std::vector<std::vector<const TfLiteTensor*>> inputs(batch->size());
+    for (int j = 0; j < batch->size(); ++j) {
+      for (const PooledTfLiteTensor& tensor : (*batch)[j].inputs) {
+        inputs[j].push_back(tensor.tensor());
+      }
+    }
+    status = runner->Run(inputs, &tensor_pool_, &outputs);
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    num_requests_ += batch->size();
+    ++num_invocations_;
+  }
+  for (int j = 0; j < batch->size(); ++j) {
+    if (status.ok()) {
+      (*batch)[j].done(std::move(outputs[j]));
+    } else {
+      (*batch)[j].done(status);
+    }
+  }
+}
+
+}  // namespace mediapipe
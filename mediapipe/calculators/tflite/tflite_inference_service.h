@@ -0,0 +1,145 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// TfLiteInferenceService runs CPU TF Lite inference on behalf of any number
+// of graphs. Each model is loaded once, and a fixed pool of worker threads
+// runs the requests of all graphs, so that many graphs running the same
+// model neither load it many times nor start more inference threads than
+// the host has cores.
+//
+// Requests for the same model that are waiting at the same time are run
+// together as one batch of up to max_batch_size, using TfLiteBatchRunner.
+// Each worker builds its own interpreter for each model it runs, since
+// interpreters are not thread-safe, but all of them share the model data.
+//
+// Applications share one service between their graphs with
+//
+//   auto service = std::make_shared<TfLiteInferenceService>(options);
+//   for (CalculatorGraph& graph : graphs) {
+//     graph.SetServiceObject(kTfLiteInferenceService, service);
+//   }
+//
+// and TfLiteInferenceCalculator then runs CPU inference through it.
+
+#ifndef MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_INFERENCE_SERVICE_H_
+#define MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_INFERENCE_SERVICE_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/calculators/tflite/tflite_batch_runner.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+class TfLiteInferenceService {
+ public:
+  struct Options {
+    // The number of worker threads running inference.
+    int num_workers = 4;
+    // The number of threads each interpreter uses to run an op.
+    int cpu_num_threads = 1;
+    // The largest number of requests run in one invocation. Batching above 1
+    // requires models that accept a variable size in dimension 0.
+    int max_batch_size = 1;
+  };
+
+  // A model loaded by the service. Owned by the service.
+  class Model;
+
+  using Callback = std::function<void(
+      ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>>)>;
+
+  TfLiteInferenceService();
+  explicit TfLiteInferenceService(const Options& options);
+  // Runs the requests still queued, then stops the workers.
+  ~TfLiteInferenceService();
+  TfLiteInferenceService(const TfLiteInferenceService&) = delete;
+  TfLiteInferenceService& operator=(const TfLiteInferenceService&) = delete;
+
+  // Returns the model at `model_path`, loading it on first use. The model
+  // stays loaded for the lifetime of the service.
+  ::mediapipe::StatusOr<Model*> GetModel(const std::string& model_path);
+
+  // Queues a request to run `model` on `inputs`, and returns immediately.
+  // `done` is called on a worker thread with the output tensors, or with the
+  // error of the invocation. The inputs must stay unchanged until then.
+  void Submit(Model* model, std::vector<PooledTfLiteTensor> inputs,
+              Callback done);
+
+  // Like Submit(), but waits for and returns the outputs.
+  ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>> Run(
+      Model* model, std::vector<PooledTfLiteTensor> inputs);
+
+  // The number of requests completed, and of model invocations used for
+  // them. Their ratio is the average batch size.
+  int64 NumRequests();
+  int64 NumInvocations();
+
+ private:
+  struct Request {
+    Model* model;
+    std::vector<PooledTfLiteTensor> inputs;
+    Callback done;
+  };
+
+  // Takes queued requests and runs them until the service is destroyed.
+  void RunWorker();
+
+  // Returns true if a worker should take a batch or stop.
+  bool HasWork() const EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Removes the oldest queued request and up to max_batch_size - 1 more for
+  // the same model from the queue.
+  std::vector<Request> TakeBatch() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Runs `batch` with the interpreter of the calling worker for its model.
+  void RunBatch(std::vector<Request>* batch,
+                std::map<Model*, std::unique_ptr<TfLiteBatchRunner>>* runners);
+
+  const Options options_;
+  TfLiteTensorPool tensor_pool_;
+
+  absl::Mutex models_mutex_;
+  std::map<std::string, std::unique_ptr<Model>> models_
+      GUARDED_BY(models_mutex_);
+
+  absl::Mutex mutex_;
+  std::deque<Request> queue_ GUARDED_BY(mutex_);
+  bool stopping_ GUARDED_BY(mutex_) = false;
+  int64 num_requests_ GUARDED_BY(mutex_) = 0;
+  int64 num_invocations_ GUARDED_BY(mutex_) = 0;
+
+  std::unique_ptr<ThreadPool> workers_;
+};
+
+// Provides a TfLiteInferenceService, which may be shared by several graphs,
+// to the calculators that request it.
+extern const GraphService<TfLiteInferenceService> kTfLiteInferenceService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_INFERENCE_SERVICE_H_
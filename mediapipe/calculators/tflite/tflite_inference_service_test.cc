@@ -0,0 +1,173 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/tflite_inference_service.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr char kModelPath[] = "mediapipe/calculators/tflite/testdata/add.bin";
+constexpr int kNumElements = 8 * 8 * 3;
+
+// Returns an input for the add model filled with `value`.
+PooledTfLiteTensor MakeInput(TfLiteTensorPool* pool, float value) {
+  PooledTfLiteTensor tensor = pool->Acquire(kTfLiteFloat32, {1, 8, 8, 3});
+  for (int i = 0; i < kNumElements; ++i) {
+    tensor.mutable_tensor()->data.f[i] = value;
+  }
+  return tensor;
+}
+
+TEST(TfLiteInferenceServiceTest, LoadsEachModelOnce) {
+  TfLiteInferenceService service;
+  auto first = service.GetModel(kModelPath);
+  auto second = service.GetModel(kModelPath);
+  MP_ASSERT_OK(first);
+  MP_ASSERT_OK(second);
+  EXPECT_EQ(first.ValueOrDie(), second.ValueOrDie());
+  EXPECT_FALSE(service.GetModel("does/not/exist.tflite").ok());
+}
+
+TEST(TfLiteInferenceServiceTest, RunsRequests) {
+  TfLiteInferenceService service;
+  TfLiteTensorPool pool;
+  auto model = service.GetModel(kModelPath);
+  MP_ASSERT_OK(model);
+  auto outputs = service.Run(model.ValueOrDie(), {MakeInput(&pool, 2)});
+  MP_ASSERT_OK(outputs);
+  ASSERT_EQ(1, outputs.ValueOrDie().size());
+  const TfLiteTensor* result = outputs.ValueOrDie()[0].tensor();
+  for (int i = 0; i < kNumElements; ++i) {
+    ASSERT_EQ(6, result->data.f[i]);
+  }
+  EXPECT_EQ(1, service.NumRequests());
+}
+
+// Requests queued together run in batches, and each gets its own outputs.
+TEST(TfLiteInferenceServiceTest, BatchesQueuedRequests) {
+  const int kNumRequests = 16;
+  TfLiteInferenceService::Options options;
+  options.num_workers = 1;
+  options.max_batch_size = 4;
+  TfLiteInferenceService service(options);
+  TfLiteTensorPool pool;
+  auto model = service.GetModel(kModelPath);
+  MP_ASSERT_OK(model);
+
+  // Keeps the only worker busy until all the requests are queued.
+  absl::Notification all_queued;
+  service.Submit(model.ValueOrDie(), {MakeInput(&pool, 0)},
+                 [&all_queued](::mediapipe::StatusOr<
+                               std::vector<PooledTfLiteTensor>>) {
+                   all_queued.WaitForNotification();
+                 });
+
+  absl::Mutex mutex;
+  std::vector<float> results(kNumRequests, -1);
+  int num_done = 0;
+  for (int r = 0; r < kNumRequests; ++r) {
+    service.Submit(
+        model.ValueOrDie(), {MakeInput(&pool, r)},
+        [r, &mutex, &results, &num_done](
+            ::mediapipe::StatusOr<std::vector<PooledTfLiteTensor>> outputs) {
+          absl::MutexLock lock(&mutex);
+          ++num_done;
+          if (outputs.ok()) {
+            results[r] = outputs.ValueOrDie()[0]->data.f[kNumElements - 1];
+          }
+        });
+  }
+  all_queued.Notify();
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(
+        +[](int* num_done) { return *num_done == kNumRequests; }, &num_done));
+  }
+  for (int r = 0; r < kNumRequests; ++r) {
+    EXPECT_EQ(3 * r, results[r]) << r;
+  }
+  EXPECT_EQ(1 + kNumRequests, service.NumRequests());
+  EXPECT_EQ(1 + kNumRequests / 4, service.NumInvocations());
+}
+
+// Several graphs share one service and its model.
+TEST(TfLiteInferenceServiceTest, SharedByGraphs) {
+  const int kNumGraphs = 4;
+  const int kNumFrames = 8;
+  auto service = std::make_shared<TfLiteInferenceService>();
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "TfLiteInferenceCalculator"
+          input_stream: "POOLED_TENSORS:tensor_in"
+          output_stream: "POOLED_TENSORS:tensor_out"
+          input_stream_handler {
+            input_stream_handler: "DefaultInputStreamHandler"
+          }
+          options {
+            [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+            }
+          }
+        }
+      )");
+  std::vector<std::vector<Packet>> output_packets(kNumGraphs);
+  std::vector<std::unique_ptr<CalculatorGraph>> graphs;
+  TfLiteTensorPool pool;
+  for (int g = 0; g < kNumGraphs; ++g) {
+    CalculatorGraphConfig graph_config = config;
+    tool::AddVectorSink("tensor_out", &graph_config, &output_packets[g]);
+    graphs.push_back(absl::make_unique<CalculatorGraph>());
+    MP_ASSERT_OK(graphs[g]->Initialize(graph_config));
+    MP_ASSERT_OK(graphs[g]->SetServiceObject(kTfLiteInferenceService, service));
+    MP_ASSERT_OK(graphs[g]->StartRun({}));
+  }
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    for (int g = 0; g < kNumGraphs; ++g) {
+      auto input = absl::make_unique<std::vector<PooledTfLiteTensor>>();
+      input->push_back(MakeInput(&pool, g * kNumFrames + frame));
+      MP_ASSERT_OK(graphs[g]->AddPacketToInputStream(
+          "tensor_in", Adopt(input.release()).At(Timestamp(frame))));
+    }
+  }
+  for (int g = 0; g < kNumGraphs; ++g) {
+    MP_ASSERT_OK(graphs[g]->CloseAllInputStreams());
+    MP_ASSERT_OK(graphs[g]->WaitUntilDone());
+    ASSERT_EQ(kNumFrames, output_packets[g].size());
+    for (int frame = 0; frame < kNumFrames; ++frame) {
+      const auto& result =
+          output_packets[g][frame].Get<std::vector<PooledTfLiteTensor>>();
+      ASSERT_EQ(1, result.size());
+      EXPECT_EQ(3 * (g * kNumFrames + frame), result[0]->data.f[0]);
+    }
+  }
+  EXPECT_EQ(kNumGraphs * kNumFrames, service->NumRequests());
+}
+
+}  // namespace
+}  // namespace mediapipe
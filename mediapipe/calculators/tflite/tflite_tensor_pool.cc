@@ -0,0 +1,249 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr int kBufferAlignment = 64;
+
+size_t ElementSize(TfLiteType type) {
+  switch (type) {
+    case kTfLiteFloat32:
+      return sizeof(float);
+    case kTfLiteInt32:
+      return sizeof(int32_t);
+    case kTfLiteUInt8:
+      return sizeof(uint8_t);
+    case kTfLiteInt64:
+      return sizeof(int64_t);
+    case kTfLiteInt16:
+      return sizeof(int16_t);
+    case kTfLiteInt8:
+      return sizeof(int8_t);
+    case kTfLiteBool:
+      return sizeof(bool);
+    default:
+      LOG(FATAL) << "Unsupported TfLiteType " << type;
+      return 0;
+  }
+}
+
+// A TfLiteTensor description with owned dims, used to size new tensors.
+class TensorShape {
+ public:
+  TensorShape(TfLiteType type, const std::vector<int>& dims) {
+    std::memset(&tensor_, 0, sizeof(tensor_));
+    tensor_.type = type;
+    tensor_.dims = TfLiteIntArrayCreate(dims.size());
+    size_t num_elements = 1;
+    for (int i = 0; i < dims.size(); ++i) {
+      tensor_.dims->data[i] = dims[i];
+      num_elements *= dims[i];
+    }
+    tensor_.bytes = num_elements * ElementSize(type);
+  }
+  ~TensorShape() { TfLiteIntArrayFree(tensor_.dims); }
+
+  const TfLiteTensor& tensor() const { return tensor_; }
+
+ private:
+  TfLiteTensor tensor_;
+};
+
+void* AllocateBuffer(size_t bytes) {
+  // Zero-sized tensors still get a distinct, non-null buffer.
+  void* buffer = aligned_malloc(bytes > 0 ? bytes : 1, kBufferAlignment);
+  CHECK(buffer) << "Failed to allocate " << bytes << " bytes.";
+  return buffer;
+}
+
+}  // namespace
+
+namespace internal {
+
+class TfLiteTensorFreeList {
+ public:
+  explicit TfLiteTensorFreeList(int max_buffers_per_size)
+      : max_buffers_per_size_(max_buffers_per_size) {}
+
+  ~TfLiteTensorFreeList() {
+    for (auto& entry : buffers_) {
+      for (void* buffer : entry.second) aligned_free(buffer);
+    }
+  }
+
+  void* Get(size_t bytes) {
+    {
+      absl::MutexLock lock(&mutex_);
+      auto it = buffers_.find(bytes);
+      if (it != buffers_.end() && !it->second.empty()) {
+        void* buffer = it->second.back();
+        it->second.pop_back();
+        return buffer;
+      }
+    }
+    return AllocateBuffer(bytes);
+  }
+
+  void Put(size_t bytes, void* buffer) {
+    {
+      absl::MutexLock lock(&mutex_);
+      std::vector<void*>& buffers = buffers_[bytes];
+      if (buffers.size() < max_buffers_per_size_) {
+        buffers.push_back(buffer);
+        return;
+      }
+    }
+    aligned_free(buffer);
+  }
+
+  int NumBuffers() const {
+    absl::MutexLock lock(&mutex_);
+    int count = 0;
+    for (const auto& entry : buffers_) count += entry.second.size();
+    return count;
+  }
+
+ private:
+  const size_t max_buffers_per_size_;
+  mutable absl::Mutex mutex_;
+  std::map<size_t, std::vector<void*>> buffers_ GUARDED_BY(mutex_);
+};
+
+}  // namespace internal
+
+class PooledTfLiteTensor::Storage {
+ public:
+  Storage(const TfLiteTensor& like, void* buffer,
+          std::weak_ptr<internal::TfLiteTensorFreeList> free_list)
+      : free_list_(std::move(free_list)) {
+    Init(like, buffer);
+  }
+
+  Storage(const TfLiteTensor& like, void* data,
+          std::shared_ptr<const void> owner)
+      : owner_(std::move(owner)) {
+    Init(like, data);
+  }
+
+  ~Storage() {
+    TfLiteIntArrayFree(tensor_.dims);
+    if (owner_) return;
+    if (auto free_list = free_list_.lock()) {
+      free_list->Put(tensor_.bytes, tensor_.data.raw);
+    } else {
+      aligned_free(tensor_.data.raw);
+    }
+  }
+
+  TfLiteTensor* tensor() { return &tensor_; }
+
+ private:
+  void Init(const TfLiteTensor& like, void* buffer) {
+    std::memset(&tensor_, 0, sizeof(tensor_));
+    tensor_.type = like.type;
+    tensor_.params = like.params;
+    tensor_.bytes = like.bytes;
+    tensor_.dims = TfLiteIntArrayCopy(like.dims);
+    tensor_.data.raw = static_cast<char*>(buffer);
+  }
+
+  TfLiteTensor tensor_;
+  // Set for pooled buffers.
+  std::weak_ptr<internal::TfLiteTensorFreeList> free_list_;
+  // Set for aliased data, which is never freed or recycled here.
+  std::shared_ptr<const void> owner_;
+};
+
+PooledTfLiteTensor::PooledTfLiteTensor(std::shared_ptr<Storage> storage)
+    : storage_(std::move(storage)) {}
+
+// static
+PooledTfLiteTensor PooledTfLiteTensor::Alias(
+    TfLiteType type, const std::vector<int>& dims, void* data,
+    std::shared_ptr<const void> owner) {
+  CHECK(owner);
+  TensorShape shape(type, dims);
+  return PooledTfLiteTensor(
+      std::make_shared<Storage>(shape.tensor(), data, std::move(owner)));
+}
+
+const TfLiteTensor* PooledTfLiteTensor::tensor() const {
+  return storage_ ? storage_->tensor() : nullptr;
+}
+
+TfLiteTensor* PooledTfLiteTensor::mutable_tensor() {
+  return storage_ ? storage_->tensor() : nullptr;
+}
+
+TfLiteTensorPool::TfLiteTensorPool(int max_free_buffers_per_size)
+    : free_list_(std::make_shared<internal::TfLiteTensorFreeList>(
+          max_free_buffers_per_size)) {}
+
+TfLiteTensorPool::~TfLiteTensorPool() = default;
+
+PooledTfLiteTensor TfLiteTensorPool::Acquire(const TfLiteTensor& like) {
+  void* buffer = free_list_->Get(like.bytes);
+  std::weak_ptr<internal::TfLiteTensorFreeList> free_list = free_list_;
+  return PooledTfLiteTensor(
+      std::make_shared<PooledTfLiteTensor::Storage>(like, buffer, free_list));
+}
+
+PooledTfLiteTensor TfLiteTensorPool::Acquire(TfLiteType type,
+                                             const std::vector<int>& dims) {
+  TensorShape shape(type, dims);
+  return Acquire(shape.tensor());
+}
+
+PooledTfLiteTensor TfLiteTensorPool::Copy(const TfLiteTensor& source) {
+  PooledTfLiteTensor tensor = Acquire(source);
+  if (source.bytes > 0) {
+    std::memcpy(tensor.mutable_tensor()->data.raw, source.data.raw,
+                source.bytes);
+  }
+  return tensor;
+}
+
+int TfLiteTensorPool::NumFreeBuffers() const {
+  return free_list_->NumBuffers();
+}
+
+std::vector<const TfLiteTensor*> GetTfLiteTensors(const Packet& packet) {
+  std::vector<const TfLiteTensor*> tensors;
+  if (packet.ValidateAsType<std::vector<PooledTfLiteTensor>>().ok()) {
+    const auto& pooled = packet.Get<std::vector<PooledTfLiteTensor>>();
+    tensors.reserve(pooled.size());
+    for (const PooledTfLiteTensor& tensor : pooled) {
+      tensors.push_back(tensor.tensor());
+    }
+  } else {
+    const auto& plain = packet.Get<std::vector<TfLiteTensor>>();
+    tensors.reserve(plain.size());
+    for (const TfLiteTensor& tensor : plain) tensors.push_back(&tensor);
+  }
+  return tensors;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,103 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_TENSOR_POOL_H_
+#define MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_TENSOR_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/packet.h"
+#include "tensorflow/lite/context.h"
+
+namespace mediapipe {
+
+namespace internal {
+class TfLiteTensorFreeList;
+}  // namespace internal
+
+// A CPU TfLiteTensor that owns its dims and data instead of pointing into an
+// interpreter arena. Copies share the same storage; the data buffer goes back
+// to the TfLiteTensorPool that produced it when the last copy is destroyed.
+// A packet holding PooledTfLiteTensors therefore stays valid after the
+// interpreter that produced it has been invoked again.
+class PooledTfLiteTensor {
+ public:
+  PooledTfLiteTensor() = default;
+
+  // Returns a tensor of `type` and `dims` that uses `data` in place instead of
+  // a pooled buffer. `data` must stay valid while `owner` is alive; every copy
+  // of the tensor holds a reference to `owner`. Only fixed-size types are
+  // supported.
+  static PooledTfLiteTensor Alias(TfLiteType type,
+                                  const std::vector<int>& dims, void* data,
+                                  std::shared_ptr<const void> owner);
+
+  // Returns the tensor, or nullptr for a default-constructed instance.
+  const TfLiteTensor* tensor() const;
+  const TfLiteTensor* operator->() const { return tensor(); }
+
+  // Gives write access to the data. Only the producer should write, and only
+  // before the tensor is sent downstream, since all copies see the change.
+  TfLiteTensor* mutable_tensor();
+
+ private:
+  friend class TfLiteTensorPool;
+  class Storage;
+
+  explicit PooledTfLiteTensor(std::shared_ptr<Storage> storage);
+
+  std::shared_ptr<Storage> storage_;
+};
+
+// Recycles the data buffers of PooledTfLiteTensors. Buffers are 64-byte
+// aligned and kept in free lists keyed by byte size, so a calculator that
+// emits the same output shapes every frame stops allocating after warm-up.
+// Thread-safe. Tensors may outlive the pool; their buffers are then freed
+// instead of recycled.
+class TfLiteTensorPool {
+ public:
+  // Keeps at most `max_free_buffers_per_size` unused buffers of each size.
+  explicit TfLiteTensorPool(int max_free_buffers_per_size = 8);
+  ~TfLiteTensorPool();
+  TfLiteTensorPool(const TfLiteTensorPool&) = delete;
+  TfLiteTensorPool& operator=(const TfLiteTensorPool&) = delete;
+
+  // Returns a tensor with the type, dims and quantization parameters of
+  // `like` and a buffer of `like.bytes` bytes. The contents are unspecified.
+  PooledTfLiteTensor Acquire(const TfLiteTensor& like);
+
+  // Returns a tensor of `type` and `dims`. The contents are unspecified. Only
+  // fixed-size types are supported.
+  PooledTfLiteTensor Acquire(TfLiteType type, const std::vector<int>& dims);
+
+  // Like Acquire(), and also copies the data of `source`.
+  PooledTfLiteTensor Copy(const TfLiteTensor& source);
+
+  // Returns the number of buffers waiting to be reused.
+  int NumFreeBuffers() const;
+
+ private:
+  std::shared_ptr<internal::TfLiteTensorFreeList> free_list_;
+};
+
+// Returns the tensors held by `packet`, which must contain either a
+// std::vector<TfLiteTensor> or a std::vector<PooledTfLiteTensor>. Lets
+// calculators accept "TENSORS" and "POOLED_TENSORS" with one code path.
+std::vector<const TfLiteTensor*> GetTfLiteTensors(const Packet& packet);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TFLITE_TFLITE_TENSOR_POOL_H_
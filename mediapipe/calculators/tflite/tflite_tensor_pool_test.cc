@@ -0,0 +1,156 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "tensorflow/lite/context.h"
+
+namespace mediapipe {
+namespace {
+
+// Owns the dims of a float TfLiteTensor that borrows `values`.
+class FloatTensor {
+ public:
+  FloatTensor(const std::vector<int>& dims, std::vector<float>* values) {
+    std::memset(&tensor_, 0, sizeof(tensor_));
+    tensor_.type = kTfLiteFloat32;
+    tensor_.dims = TfLiteIntArrayCreate(dims.size());
+    for (int i = 0; i < dims.size(); ++i) tensor_.dims->data[i] = dims[i];
+    tensor_.data.f = values->data();
+    tensor_.bytes = values->size() * sizeof(float);
+  }
+  ~FloatTensor() { TfLiteIntArrayFree(tensor_.dims); }
+
+  const TfLiteTensor& tensor() const { return tensor_; }
+
+ private:
+  TfLiteTensor tensor_;
+};
+
+TEST(TfLiteTensorPoolTest, CopyOwnsDataAndDims) {
+  std::vector<float> values = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+  TfLiteTensorPool pool;
+  PooledTfLiteTensor copy;
+  {
+    FloatTensor source({2, 3}, &values);
+    copy = pool.Copy(source.tensor());
+  }
+  // Overwrite the source, as an interpreter arena would on the next Invoke().
+  values.assign(values.size(), 0.0f);
+
+  ASSERT_NE(copy.tensor(), nullptr);
+  EXPECT_EQ(copy->type, kTfLiteFloat32);
+  EXPECT_EQ(copy->bytes, 6 * sizeof(float));
+  ASSERT_EQ(copy->dims->size, 2);
+  EXPECT_EQ(copy->dims->data[0], 2);
+  EXPECT_EQ(copy->dims->data[1], 3);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(copy->data.f[i], i + 1.0f);
+  }
+}
+
+TEST(TfLiteTensorPoolTest, RecyclesBuffersOfTheSameSize) {
+  std::vector<float> values(16, 1.0f);
+  FloatTensor source({16}, &values);
+  TfLiteTensorPool pool;
+
+  const char* first_buffer;
+  {
+    PooledTfLiteTensor tensor = pool.Copy(source.tensor());
+    first_buffer = tensor->data.raw;
+    PooledTfLiteTensor shared = tensor;
+    EXPECT_EQ(shared->data.raw, first_buffer);
+    EXPECT_EQ(pool.NumFreeBuffers(), 0);
+  }
+  EXPECT_EQ(pool.NumFreeBuffers(), 1);
+
+  PooledTfLiteTensor reused = pool.Acquire(source.tensor());
+  EXPECT_EQ(reused->data.raw, first_buffer);
+  EXPECT_EQ(pool.NumFreeBuffers(), 0);
+}
+
+TEST(TfLiteTensorPoolTest, BoundsFreeBuffersPerSize) {
+  std::vector<float> values(4, 1.0f);
+  FloatTensor source({4}, &values);
+  TfLiteTensorPool pool(/*max_free_buffers_per_size=*/2);
+  {
+    std::vector<PooledTfLiteTensor> tensors;
+    for (int i = 0; i < 5; ++i) tensors.push_back(pool.Copy(source.tensor()));
+  }
+  EXPECT_EQ(pool.NumFreeBuffers(), 2);
+}
+
+TEST(TfLiteTensorPoolTest, TensorsMayOutliveThePool) {
+  std::vector<float> values = {7.0f, 8.0f};
+  FloatTensor source({2}, &values);
+  PooledTfLiteTensor tensor;
+  {
+    TfLiteTensorPool pool;
+    tensor = pool.Copy(source.tensor());
+  }
+  EXPECT_EQ(tensor->data.f[0], 7.0f);
+  EXPECT_EQ(tensor->data.f[1], 8.0f);
+}
+
+TEST(TfLiteTensorPoolTest, AcquireByTypeAndDims) {
+  TfLiteTensorPool pool;
+  PooledTfLiteTensor tensor = pool.Acquire(kTfLiteUInt8, {1, 4, 5, 3});
+  EXPECT_EQ(tensor->type, kTfLiteUInt8);
+  EXPECT_EQ(tensor->bytes, 4 * 5 * 3);
+  ASSERT_EQ(tensor->dims->size, 4);
+  EXPECT_EQ(tensor->dims->data[2], 5);
+}
+
+TEST(TfLiteTensorPoolTest, AliasKeepsOwnerAliveAndIsNotRecycled) {
+  auto values = std::make_shared<std::vector<float>>(6, 3.0f);
+  std::weak_ptr<std::vector<float>> weak_values = values;
+  TfLiteTensorPool pool;
+  PooledTfLiteTensor tensor = PooledTfLiteTensor::Alias(
+      kTfLiteFloat32, {2, 3}, values->data(), values);
+  values.reset();
+
+  EXPECT_FALSE(weak_values.expired());
+  EXPECT_EQ(tensor->bytes, 6 * sizeof(float));
+  EXPECT_EQ(tensor->data.f[5], 3.0f);
+  tensor = PooledTfLiteTensor();
+  EXPECT_TRUE(weak_values.expired());
+  EXPECT_EQ(pool.NumFreeBuffers(), 0);
+}
+
+TEST(TfLiteTensorPoolTest, GetTfLiteTensorsAcceptsBothPacketTypes) {
+  std::vector<float> values = {1.0f, 2.0f};
+  FloatTensor source({2}, &values);
+  TfLiteTensorPool pool;
+
+  Packet plain = MakePacket<std::vector<TfLiteTensor>>(1, source.tensor());
+  std::vector<const TfLiteTensor*> plain_tensors = GetTfLiteTensors(plain);
+  ASSERT_EQ(plain_tensors.size(), 1);
+  EXPECT_EQ(plain_tensors[0]->data.f[1], 2.0f);
+
+  Packet pooled = MakePacket<std::vector<PooledTfLiteTensor>>(
+      2, pool.Copy(source.tensor()));
+  std::vector<const TfLiteTensor*> pooled_tensors = GetTfLiteTensors(pooled);
+  ASSERT_EQ(pooled_tensors.size(), 2);
+  EXPECT_EQ(pooled_tensors[0], pooled_tensors[1]);
+  EXPECT_EQ(pooled_tensors[0]->data.f[0], 1.0f);
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -18,6 +18,7 @@
 
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/tflite_tensors_to_classification_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/classification.pb.h"
@@ -40,6 +41,7 @@ namespace mediapipe {
 // Input:
 //  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32 containing one
 //            tensor, the size of which must be (1, * num_classes).
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS.
 // Output:
 //  CLASSIFICATIONS - Result MediaPipe ClassificationList. The score and index
 //                    fields of each classification are set, while the label
@@ -79,9 +81,14 @@ REGISTER_CALCULATOR(TfLiteTensorsToClassificationCalculator);
   RET_CHECK(!cc->Inputs().GetTags().empty());
   RET_CHECK(!cc->Outputs().GetTags().empty());
 
+  RET_CHECK(!(cc->Inputs().HasTag("TENSORS") &&
+              cc->Inputs().HasTag("POOLED_TENSORS")));
   if (cc->Inputs().HasTag("TENSORS")) {
     cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
   }
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+  }
 
   if (cc->Outputs().HasTag("CLASSIFICATIONS")) {
     cc->Outputs().Tag("CLASSIFICATIONS").Set<ClassificationList>();
@@ -119,12 +126,14 @@ REGISTER_CALCULATOR(TfLiteTensorsToClassificationCalculator);
 
 ::mediapipe::Status TfLiteTensorsToClassificationCalculator::Process(
     CalculatorContext* cc) {
-  const auto& input_tensors =
-      cc->Inputs().Tag("TENSORS").Get<std::vector<TfLiteTensor>>();
+  const std::vector<const TfLiteTensor*> input_tensors = GetTfLiteTensors(
+      cc->Inputs().HasTag("POOLED_TENSORS")
+          ? cc->Inputs().Tag("POOLED_TENSORS").Value()
+          : cc->Inputs().Tag("TENSORS").Value());
 
   RET_CHECK_EQ(input_tensors.size(), 1);
 
-  const TfLiteTensor* raw_score_tensor = &input_tensors[0];
+  const TfLiteTensor* raw_score_tensor = input_tensors[0];
   int num_classes = 1;
   for (int i = 0; i < raw_score_tensor->dims->size; ++i) {
     num_classes *= raw_score_tensor->dims->data[i];
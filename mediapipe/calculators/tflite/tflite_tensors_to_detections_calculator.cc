@@ -17,6 +17,8 @@
 
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
+#include "mediapipe/calculators/tflite/detection_decoding.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/tflite_tensors_to_detections_calculator.pb.h"
 #include "mediapipe/calculators/tflite/util.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -125,6 +127,7 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
 //               optional to pass in a third tensor for anchors (e.g. for SSD
 //               models) depend on the outputs of the detection model. The size
 //               of anchor tensor must be (num_boxes * 4).
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS.
 //  TENSORS_GPU - vector of GlBuffer of MTLBuffer.
 // Output:
 //  DETECTIONS - Result MediaPipe detections.
@@ -164,12 +167,10 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
 
   ::mediapipe::Status LoadOptions(CalculatorContext* cc);
   ::mediapipe::Status GpuInit(CalculatorContext* cc);
-  ::mediapipe::Status DecodeBoxes(const float* raw_boxes,
-                                  const std::vector<Anchor>& anchors,
-                                  std::vector<float>* boxes);
   ::mediapipe::Status ConvertToDetections(
       const float* detection_boxes, const float* detection_scores,
-      const int* detection_classes, std::vector<Detection>* output_detections);
+      const int* detection_classes, int num_boxes,
+      std::vector<Detection>* output_detections);
   Detection ConvertToDetection(float box_ymin, float box_xmin, float box_ymax,
                                float box_xmax, float score, int class_id,
                                int detection_id, bool flip_vertically);
@@ -185,6 +186,12 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
   std::vector<Anchor> anchors_;
   bool side_packet_anchors_{};
 
+  // CPU decoding state, derived from options_ and anchors_.
+  DetectionScoringOptions scoring_options_;
+  BoxDecodingOptions decoding_options_;
+  DetectionAnchors detection_anchors_;
+  DetectionCandidates candidates_;
+
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__) && \
     !defined(__APPLE__)
   mediapipe::GlCalculatorHelper gpu_helper_;
@@ -210,9 +217,14 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
 
   bool use_gpu = false;
 
+  RET_CHECK(!(cc->Inputs().HasTag("TENSORS") &&
+              cc->Inputs().HasTag("POOLED_TENSORS")));
   if (cc->Inputs().HasTag("TENSORS")) {
     cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
   }
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+  }
 
 #if !defined(MEDIAPIPE_DISABLE_GPU) && !defined(__EMSCRIPTEN__)
   if (cc->Inputs().HasTag("TENSORS_GPU")) {
@@ -270,8 +282,13 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
 
 ::mediapipe::Status TfLiteTensorsToDetectionsCalculator::Process(
     CalculatorContext* cc) {
-  if ((!gpu_input_ && cc->Inputs().Tag("TENSORS").IsEmpty()) ||
-      (gpu_input_ && cc->Inputs().Tag("TENSORS_GPU").IsEmpty())) {
+  const char* tensors_tag = "TENSORS";
+  if (gpu_input_) {
+    tensors_tag = "TENSORS_GPU";
+  } else if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    tensors_tag = "POOLED_TENSORS";
+  }
+  if (cc->Inputs().Tag(tensors_tag).IsEmpty()) {
     return ::mediapipe::OkStatus();
   }
 
@@ -295,15 +312,17 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
 
 ::mediapipe::Status TfLiteTensorsToDetectionsCalculator::ProcessCPU(
     CalculatorContext* cc, std::vector<Detection>* output_detections) {
-  const auto& input_tensors =
-      cc->Inputs().Tag("TENSORS").Get<std::vector<TfLiteTensor>>();
+  const std::vector<const TfLiteTensor*> input_tensors = GetTfLiteTensors(
+      cc->Inputs().HasTag("POOLED_TENSORS")
+          ? cc->Inputs().Tag("POOLED_TENSORS").Value()
+          : cc->Inputs().Tag("TENSORS").Value());
 
   if (input_tensors.size() == 2 ||
       input_tensors.size() == kNumInputTensorsWithAnchors) {
     // Postprocessing on CPU for model without postprocessing op. E.g. output
     // raw score tensor and box tensor. Anchor decoding will be handled below.
-    const TfLiteTensor* raw_box_tensor = &input_tensors[0];
-    const TfLiteTensor* raw_score_tensor = &input_tensors[1];
+    const TfLiteTensor* raw_box_tensor = input_tensors[0];
+    const TfLiteTensor* raw_score_tensor = input_tensors[1];
 
     // TODO: Add flexible input tensor size handling.
     CHECK_EQ(raw_box_tensor->dims->size, 3);
@@ -320,7 +339,7 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
     // TODO: Support other options to load anchors.
     if (!anchors_init_) {
       if (input_tensors.size() == kNumInputTensorsWithAnchors) {
-        const TfLiteTensor* anchor_tensor = &input_tensors[2];
+        const TfLiteTensor* anchor_tensor = input_tensors[2];
         CHECK_EQ(anchor_tensor->dims->size, 2);
         CHECK_EQ(anchor_tensor->dims->data[0], num_boxes_);
         CHECK_EQ(anchor_tensor->dims->data[1], kNumCoordsPerBox);
@@ -333,55 +352,35 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
       } else {
         return ::mediapipe::UnavailableError("No anchor data available.");
       }
-      anchors_init_ = true;
-    }
-    std::vector<float> boxes(num_boxes_ * num_coords_);
-    MP_RETURN_IF_ERROR(DecodeBoxes(raw_boxes, anchors_, &boxes));
-
-    std::vector<float> detection_scores(num_boxes_);
-    std::vector<int> detection_classes(num_boxes_);
-
-    // Filter classes by scores.
-    for (int i = 0; i < num_boxes_; ++i) {
-      int class_id = -1;
-      float max_score = -std::numeric_limits<float>::max();
-      // Find the top score for box i.
-      for (int score_idx = 0; score_idx < num_classes_; ++score_idx) {
-        if (ignore_classes_.find(score_idx) == ignore_classes_.end()) {
-          auto score = raw_scores[i * num_classes_ + score_idx];
-          if (options_.sigmoid_score()) {
-            if (options_.has_score_clipping_thresh()) {
-              score = score < -options_.score_clipping_thresh()
-                          ? -options_.score_clipping_thresh()
-                          : score;
-              score = score > options_.score_clipping_thresh()
-                          ? options_.score_clipping_thresh()
-                          : score;
-            }
-            score = 1.0f / (1.0f + std::exp(-score));
-          }
-          if (max_score < score) {
-            max_score = score;
-            class_id = score_idx;
-          }
-        }
+      for (const Anchor& anchor : anchors_) {
+        detection_anchors_.y_center.push_back(anchor.y_center());
+        detection_anchors_.x_center.push_back(anchor.x_center());
+        detection_anchors_.h.push_back(anchor.h());
+        detection_anchors_.w.push_back(anchor.w());
       }
-      detection_scores[i] = max_score;
-      detection_classes[i] = class_id;
+      anchors_init_ = true;
     }
 
-    MP_RETURN_IF_ERROR(
-        ConvertToDetections(boxes.data(), detection_scores.data(),
-                            detection_classes.data(), output_detections));
+    // Pick the top class of every box and apply the score threshold first, so
+    // that only the surviving boxes are decoded and converted.
+    candidates_.Clear();
+    ScoreDetections(raw_scores, num_boxes_, scoring_options_, &candidates_);
+    std::vector<float> boxes(candidates_.size() * num_coords_);
+    DecodeDetectionBoxes(raw_boxes, detection_anchors_, decoding_options_,
+                         candidates_.box_index, boxes.data());
+
+    MP_RETURN_IF_ERROR(ConvertToDetections(
+        boxes.data(), candidates_.score.data(), candidates_.class_id.data(),
+        candidates_.size(), output_detections));
   } else {
     // Postprocessing on CPU with postprocessing op (e.g. anchor decoding and
     // non-maximum suppression) within the model.
     RET_CHECK_EQ(input_tensors.size(), 4);
 
-    const TfLiteTensor* detection_boxes_tensor = &input_tensors[0];
-    const TfLiteTensor* detection_classes_tensor = &input_tensors[1];
-    const TfLiteTensor* detection_scores_tensor = &input_tensors[2];
-    const TfLiteTensor* num_boxes_tensor = &input_tensors[3];
+    const TfLiteTensor* detection_boxes_tensor = input_tensors[0];
+    const TfLiteTensor* detection_classes_tensor = input_tensors[1];
+    const TfLiteTensor* detection_scores_tensor = input_tensors[2];
+    const TfLiteTensor* num_boxes_tensor = input_tensors[3];
     RET_CHECK_EQ(num_boxes_tensor->dims->size, 1);
     RET_CHECK_EQ(num_boxes_tensor->dims->data[0], 1);
     const float* num_boxes = num_boxes_tensor->data.f;
@@ -406,7 +405,7 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
     }
     MP_RETURN_IF_ERROR(ConvertToDetections(detection_boxes, detection_scores,
                                            detection_classes.data(),
-                                           output_detections));
+                                           num_boxes_, output_detections));
   }
   return ::mediapipe::OkStatus();
 }
@@ -470,9 +469,9 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
       detection_scores[i] = score_class_id_pairs[i * 2];
       detection_classes[i] = static_cast<int>(score_class_id_pairs[i * 2 + 1]);
     }
-    MP_RETURN_IF_ERROR(
-        ConvertToDetections(boxes.data(), detection_scores.data(),
-                            detection_classes.data(), output_detections));
+    MP_RETURN_IF_ERROR(ConvertToDetections(
+        boxes.data(), detection_scores.data(), detection_classes.data(),
+        num_boxes_, output_detections));
 
     return ::mediapipe::OkStatus();
   }));
@@ -564,7 +563,7 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
     detection_classes[i] = static_cast<int>(score_class_id_pairs[i * 2 + 1]);
   }
   MP_RETURN_IF_ERROR(ConvertToDetections(boxes.data(), detection_scores.data(),
-                                         detection_classes.data(),
+                                         detection_classes.data(), num_boxes_,
                                          output_detections));
 
 #else
@@ -607,77 +606,38 @@ int TfLiteTensorsToDetectionsCalculator::next_detection_id_ = 0;
     ignore_classes_.insert(options_.ignore_classes(i));
   }
 
-  return ::mediapipe::OkStatus();
-}
-
-::mediapipe::Status TfLiteTensorsToDetectionsCalculator::DecodeBoxes(
-    const float* raw_boxes, const std::vector<Anchor>& anchors,
-    std::vector<float>* boxes) {
-  for (int i = 0; i < num_boxes_; ++i) {
-    const int box_offset = i * num_coords_ + options_.box_coord_offset();
-
-    float y_center = raw_boxes[box_offset];
-    float x_center = raw_boxes[box_offset + 1];
-    float h = raw_boxes[box_offset + 2];
-    float w = raw_boxes[box_offset + 3];
-    if (options_.reverse_output_order()) {
-      x_center = raw_boxes[box_offset];
-      y_center = raw_boxes[box_offset + 1];
-      w = raw_boxes[box_offset + 2];
-      h = raw_boxes[box_offset + 3];
-    }
-
-    x_center =
-        x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-    y_center =
-        y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
-
-    if (options_.apply_exponential_on_box_size()) {
-      h = std::exp(h / options_.h_scale()) * anchors[i].h();
-      w = std::exp(w / options_.w_scale()) * anchors[i].w();
-    } else {
-      h = h / options_.h_scale() * anchors[i].h();
-      w = w / options_.w_scale() * anchors[i].w();
-    }
-
-    const float ymin = y_center - h / 2.f;
-    const float xmin = x_center - w / 2.f;
-    const float ymax = y_center + h / 2.f;
-    const float xmax = x_center + w / 2.f;
-
-    (*boxes)[i * num_coords_ + 0] = ymin;
-    (*boxes)[i * num_coords_ + 1] = xmin;
-    (*boxes)[i * num_coords_ + 2] = ymax;
-    (*boxes)[i * num_coords_ + 3] = xmax;
-
-    if (options_.num_keypoints()) {
-      for (int k = 0; k < options_.num_keypoints(); ++k) {
-        const int offset = i * num_coords_ + options_.keypoint_coord_offset() +
-                           k * options_.num_values_per_keypoint();
-
-        float keypoint_y = raw_boxes[offset];
-        float keypoint_x = raw_boxes[offset + 1];
-        if (options_.reverse_output_order()) {
-          keypoint_x = raw_boxes[offset];
-          keypoint_y = raw_boxes[offset + 1];
-        }
-
-        (*boxes)[offset] = keypoint_x / options_.x_scale() * anchors[i].w() +
-                           anchors[i].x_center();
-        (*boxes)[offset + 1] =
-            keypoint_y / options_.y_scale() * anchors[i].h() +
-            anchors[i].y_center();
-      }
-    }
-  }
+  scoring_options_.num_classes = num_classes_;
+  scoring_options_.ignore_classes.assign(ignore_classes_.begin(),
+                                         ignore_classes_.end());
+  scoring_options_.sigmoid_score = options_.sigmoid_score();
+  scoring_options_.has_score_clipping_thresh =
+      options_.has_score_clipping_thresh();
+  scoring_options_.score_clipping_thresh = options_.score_clipping_thresh();
+  scoring_options_.has_min_score_thresh = options_.has_min_score_thresh();
+  scoring_options_.min_score_thresh = options_.min_score_thresh();
+
+  decoding_options_.num_coords = num_coords_;
+  decoding_options_.box_coord_offset = options_.box_coord_offset();
+  decoding_options_.keypoint_coord_offset = options_.keypoint_coord_offset();
+  decoding_options_.num_keypoints = options_.num_keypoints();
+  decoding_options_.num_values_per_keypoint =
+      options_.num_values_per_keypoint();
+  decoding_options_.x_scale = options_.x_scale();
+  decoding_options_.y_scale = options_.y_scale();
+  decoding_options_.w_scale = options_.w_scale();
+  decoding_options_.h_scale = options_.h_scale();
+  decoding_options_.apply_exponential_on_box_size =
+      options_.apply_exponential_on_box_size();
+  decoding_options_.reverse_output_order = options_.reverse_output_order();
 
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status TfLiteTensorsToDetectionsCalculator::ConvertToDetections(
     const float* detection_boxes, const float* detection_scores,
-    const int* detection_classes, std::vector<Detection>* output_detections) {
-  for (int i = 0; i < num_boxes_; ++i) {
+    const int* detection_classes, int num_boxes,
+    std::vector<Detection>* output_detections) {
+  for (int i = 0; i < num_boxes; ++i) {
     if (options_.has_min_score_thresh() &&
         detection_scores[i] < options_.min_score_thresh()) {
       continue;
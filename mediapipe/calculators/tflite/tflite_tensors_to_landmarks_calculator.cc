@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/tflite_tensors_to_landmarks_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
@@ -28,6 +29,7 @@ namespace mediapipe {
 //  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32. Only the first
 //            tensor will be used. The size of the values must be
 //            (num_dimension x num_landmarks).
+//  POOLED_TENSORS - Vector of PooledTfLiteTensor, in place of TENSORS.
 // Output:
 //  LANDMARKS(optional) - Result MediaPipe landmarks.
 //  NORM_LANDMARKS(optional) - Result MediaPipe normalized landmarks.
@@ -71,9 +73,14 @@ REGISTER_CALCULATOR(TfLiteTensorsToLandmarksCalculator);
   RET_CHECK(!cc->Inputs().GetTags().empty());
   RET_CHECK(!cc->Outputs().GetTags().empty());
 
+  RET_CHECK(!(cc->Inputs().HasTag("TENSORS") &&
+              cc->Inputs().HasTag("POOLED_TENSORS")));
   if (cc->Inputs().HasTag("TENSORS")) {
     cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
   }
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+  }
 
   if (cc->Outputs().HasTag("LANDMARKS")) {
     cc->Outputs().Tag("LANDMARKS").Set<std::vector<Landmark>>();
@@ -109,14 +116,17 @@ REGISTER_CALCULATOR(TfLiteTensorsToLandmarksCalculator);
 
 ::mediapipe::Status TfLiteTensorsToLandmarksCalculator::Process(
     CalculatorContext* cc) {
-  if (cc->Inputs().Tag("TENSORS").IsEmpty()) {
+  const auto& tensors_stream = cc->Inputs().HasTag("POOLED_TENSORS")
+                                   ? cc->Inputs().Tag("POOLED_TENSORS")
+                                   : cc->Inputs().Tag("TENSORS");
+  if (tensors_stream.IsEmpty()) {
     return ::mediapipe::OkStatus();
   }
 
-  const auto& input_tensors =
-      cc->Inputs().Tag("TENSORS").Get<std::vector<TfLiteTensor>>();
+  const std::vector<const TfLiteTensor*> input_tensors =
+      GetTfLiteTensors(tensors_stream.Value());
 
-  const TfLiteTensor* raw_tensor = &input_tensors[0];
+  const TfLiteTensor* raw_tensor = input_tensors[0];
 
   int num_values = 1;
   for (int i = 0; i < raw_tensor->dims->size; ++i) {
@@ -16,6 +16,7 @@
 
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
+#include "mediapipe/calculators/tflite/tflite_tensor_pool.h"
 #include "mediapipe/calculators/tflite/tflite_tensors_to_segmentation_calculator.pb.h"
 #include "mediapipe/calculators/tflite/util.h"
 #include "mediapipe/framework/calculator_context.h"
@@ -75,6 +76,7 @@ using ::tflite::gpu::gl::GlShader;
 //   One of the following TENSORS tags:
 //   TENSORS: Vector of TfLiteTensor of type kTfLiteFloat32.
 //            The tensor dimensions are specified in this calculator's options.
+//   POOLED_TENSORS: Vector of PooledTfLiteTensor, in place of TENSORS.
 //   TENSORS_GPU: Vector of GlBuffer.
 //   One of the following REFERENCE_IMAGE tags:
 //   REFERENCE_IMAGE (optional): An ImageFrame input image,
@@ -151,9 +153,14 @@ REGISTER_CALCULATOR(TfLiteTensorsToSegmentationCalculator);
   bool use_gpu = false;
 
   // Inputs CPU.
+  RET_CHECK(!(cc->Inputs().HasTag("TENSORS") &&
+              cc->Inputs().HasTag("POOLED_TENSORS")));
   if (cc->Inputs().HasTag("TENSORS")) {
     cc->Inputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
   }
+  if (cc->Inputs().HasTag("POOLED_TENSORS")) {
+    cc->Inputs().Tag("POOLED_TENSORS").Set<std::vector<PooledTfLiteTensor>>();
+  }
   if (cc->Inputs().HasTag("PREV_MASK")) {
     cc->Inputs().Tag("PREV_MASK").Set<ImageFrame>();
   }
@@ -265,13 +272,16 @@ REGISTER_CALCULATOR(TfLiteTensorsToSegmentationCalculator);
 
 ::mediapipe::Status TfLiteTensorsToSegmentationCalculator::ProcessCpu(
     CalculatorContext* cc) {
-  if (cc->Inputs().Tag("TENSORS").IsEmpty()) {
+  const auto& tensors_stream = cc->Inputs().HasTag("POOLED_TENSORS")
+                                   ? cc->Inputs().Tag("POOLED_TENSORS")
+                                   : cc->Inputs().Tag("TENSORS");
+  if (tensors_stream.IsEmpty()) {
     return ::mediapipe::OkStatus();
   }
 
   // Get input streams.
-  const auto& input_tensors =
-      cc->Inputs().Tag("TENSORS").Get<std::vector<TfLiteTensor>>();
+  const std::vector<const TfLiteTensor*> input_tensors =
+      GetTfLiteTensors(tensors_stream.Value());
   const bool has_prev_mask = cc->Inputs().HasTag("PREV_MASK") &&
                              !cc->Inputs().Tag("PREV_MASK").IsEmpty();
   const ImageFrame placeholder;
@@ -305,7 +315,7 @@ REGISTER_CALCULATOR(TfLiteTensorsToSegmentationCalculator);
   }
 
   // Copy input tensor.
-  const TfLiteTensor* raw_input_tensor = &input_tensors[0];
+  const TfLiteTensor* raw_input_tensor = input_tensors[0];
   const float* raw_input_data = raw_input_tensor->data.f;
   cv::Mat tensor_mat(cv::Size(tensor_width_, tensor_height_),
                      CV_MAKETYPE(CV_32F, tensor_channels_));
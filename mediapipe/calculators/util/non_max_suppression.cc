@@ -0,0 +1,357 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "absl/types/optional.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Boxes covering more grid cells than this are kept in a separate list that
+// every query scans, so that one huge box does not fill the whole grid.
+constexpr int kMaxCellsPerBox = 16;
+constexpr int kMaxGridSize = 128;
+
+// Returns the indices of `boxes` by decreasing score, ties in input order.
+std::vector<int> SortByScore(const NmsBoxes& boxes) {
+  std::vector<int> order(boxes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&boxes](int a, int b) {
+    return boxes.score[a] > boxes.score[b];
+  });
+  return order;
+}
+
+// Boxes with infinite coordinates can overlap boxes far away from them, and
+// NaN coordinates cannot be bucketed, so those fall back to comparing every
+// pair of boxes.
+bool CanUseGrid(const NmsBoxes& boxes, const NmsOptions& options) {
+  // Overlaps are never negative, so a negative threshold lets boxes that share
+  // no grid cell suppress each other.
+  if (options.min_suppression_threshold < 0.0f) return false;
+  for (int i = 0; i < boxes.size(); ++i) {
+    if (!std::isfinite(boxes.xmin[i]) || !std::isfinite(boxes.ymin[i]) ||
+        !std::isfinite(boxes.xmax[i]) || !std::isfinite(boxes.ymax[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A uniform grid over the extent of a set of finite boxes. Two boxes whose
+// overlap is positive share at least one cell.
+class BoxGrid {
+ public:
+  explicit BoxGrid(const NmsBoxes& boxes)
+      : boxes_(boxes), last_query_(boxes.size(), -1) {
+    bool any_box = false;
+    double sum_width = 0.0;
+    double sum_height = 0.0;
+    int num_indexable = 0;
+    for (int i = 0; i < boxes.size(); ++i) {
+      if (!IsIndexable(i)) continue;
+      if (!any_box) {
+        x0_ = boxes.xmin[i];
+        y0_ = boxes.ymin[i];
+        x1_ = boxes.xmax[i];
+        y1_ = boxes.ymax[i];
+        any_box = true;
+      }
+      x0_ = std::min(x0_, boxes.xmin[i]);
+      y0_ = std::min(y0_, boxes.ymin[i]);
+      x1_ = std::max(x1_, boxes.xmax[i]);
+      y1_ = std::max(y1_, boxes.ymax[i]);
+      sum_width += boxes.xmax[i] - boxes.xmin[i];
+      sum_height += boxes.ymax[i] - boxes.ymin[i];
+      ++num_indexable;
+    }
+    // Cells about the size of an average box keep both the number of cells
+    // per box and the number of boxes per cell small.
+    grid_width_ = GridSize(x1_ - x0_, sum_width, num_indexable);
+    grid_height_ = GridSize(y1_ - y0_, sum_height, num_indexable);
+    inv_cell_width_ = grid_width_ > 1 ? grid_width_ / (x1_ - x0_) : 0.0f;
+    inv_cell_height_ = grid_height_ > 1 ? grid_height_ / (y1_ - y0_) : 0.0f;
+    cells_.resize(grid_width_ * grid_height_);
+  }
+
+  void Insert(int box) {
+    int cx0, cy0, cx1, cy1;
+    if (!CellRange(box, &cx0, &cy0, &cx1, &cy1)) return;
+    if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > kMaxCellsPerBox) {
+      large_boxes_.push_back(box);
+      return;
+    }
+    for (int cy = cy0; cy <= cy1; ++cy) {
+      for (int cx = cx0; cx <= cx1; ++cx) {
+        cells_[cy * grid_width_ + cx].push_back(box);
+      }
+    }
+  }
+
+  // Removed boxes are no longer visited. They are dropped from the cells the
+  // next time a query scans them.
+  void Remove(int box) { last_query_[box] = kRemoved; }
+
+  // Calls `fn` once for every inserted box that may overlap `box`, until it
+  // returns true.
+  template <class Fn>
+  void ForEachNeighbor(int box, Fn fn) {
+    int cx0, cy0, cx1, cy1;
+    if (!CellRange(box, &cx0, &cy0, &cx1, &cy1)) return;
+    if (VisitCell(box, &large_boxes_, fn)) return;
+    for (int cy = cy0; cy <= cy1; ++cy) {
+      for (int cx = cx0; cx <= cx1; ++cx) {
+        if (VisitCell(box, &cells_[cy * grid_width_ + cx], fn)) return;
+      }
+    }
+  }
+
+ private:
+  static constexpr int kRemoved = -2;
+
+  template <class Fn>
+  bool VisitCell(int box, std::vector<int>* cell, Fn& fn) {
+    for (int i = 0; i < cell->size();) {
+      const int other = (*cell)[i];
+      if (last_query_[other] == kRemoved) {
+        (*cell)[i] = cell->back();
+        cell->pop_back();
+        continue;
+      }
+      ++i;
+      if (last_query_[other] == box) continue;
+      last_query_[other] = box;
+      if (fn(other)) return true;
+    }
+    return false;
+  }
+
+  // Empty boxes overlap nothing.
+  bool IsIndexable(int i) const {
+    return boxes_.xmin[i] <= boxes_.xmax[i] && boxes_.ymin[i] <= boxes_.ymax[i];
+  }
+
+  static int GridSize(float extent, double sum_sizes, int num_boxes) {
+    if (num_boxes == 0 || !(extent > 0.0f)) return 1;
+    const double average_size = sum_sizes / num_boxes;
+    if (!(average_size > 0.0)) return kMaxGridSize;
+    return static_cast<int>(
+        std::min<double>(kMaxGridSize, std::ceil(extent / average_size)));
+  }
+
+  static int Cell(float value, float origin, float inv_cell_size,
+                  int grid_size) {
+    const int cell = static_cast<int>((value - origin) * inv_cell_size);
+    return std::min(std::max(cell, 0), grid_size - 1);
+  }
+
+  bool CellRange(int i, int* cx0, int* cy0, int* cx1, int* cy1) const {
+    if (!IsIndexable(i)) return false;
+    *cx0 = Cell(boxes_.xmin[i], x0_, inv_cell_width_, grid_width_);
+    *cy0 = Cell(boxes_.ymin[i], y0_, inv_cell_height_, grid_height_);
+    *cx1 = Cell(boxes_.xmax[i], x0_, inv_cell_width_, grid_width_);
+    *cy1 = Cell(boxes_.ymax[i], y0_, inv_cell_height_, grid_height_);
+    return true;
+  }
+
+  const NmsBoxes& boxes_;
+  float x0_ = 0.0f;
+  float y0_ = 0.0f;
+  float x1_ = 0.0f;
+  float y1_ = 0.0f;
+  int grid_width_ = 1;
+  int grid_height_ = 1;
+  float inv_cell_width_ = 0.0f;
+  float inv_cell_height_ = 0.0f;
+  std::vector<std::vector<int>> cells_;
+  std::vector<int> large_boxes_;
+  // The box of the last query that visited each box, to visit boxes spanning
+  // several cells once, or kRemoved.
+  std::vector<int> last_query_;
+};
+
+float Overlap(const NmsBoxes& boxes, NmsOptions::OverlapType overlap_type,
+              int box1, int box2) {
+  const float rect1[] = {boxes.xmin[box1], boxes.ymin[box1], boxes.xmax[box1],
+                         boxes.ymax[box1]};
+  const float rect2[] = {boxes.xmin[box2], boxes.ymin[box2], boxes.xmax[box2],
+                         boxes.ymax[box2]};
+  return BoxOverlap(overlap_type, rect1, rect2);
+}
+
+}  // namespace
+
+float BoxOverlap(NmsOptions::OverlapType overlap_type, const float* box1,
+                 const float* box2) {
+  const float xmin1 = box1[0], ymin1 = box1[1], xmax1 = box1[2],
+              ymax1 = box1[3];
+  const float xmin2 = box2[0], ymin2 = box2[1], xmax2 = box2[2],
+              ymax2 = box2[3];
+  // Same test as Rectangle_f::Intersects().
+  if (xmin1 > xmax1 || ymin1 > ymax1 || xmin2 > xmax2 || ymin2 > ymax2 ||
+      xmax2 < xmin1 || xmax1 < xmin2 || ymax2 < ymin1 || ymax1 < ymin2) {
+    return 0.0f;
+  }
+  const float intersection_area =
+      (std::min(xmax1, xmax2) - std::max(xmin1, xmin2)) *
+      (std::min(ymax1, ymax2) - std::max(ymin1, ymin2));
+  const float area1 = (xmax1 - xmin1) * (ymax1 - ymin1);
+  const float area2 = (xmax2 - xmin2) * (ymax2 - ymin2);
+  float normalization;
+  switch (overlap_type) {
+    case NmsOptions::JACCARD:
+      normalization = (std::max(xmax1, xmax2) - std::min(xmin1, xmin2)) *
+                      (std::max(ymax1, ymax2) - std::min(ymin1, ymin2));
+      break;
+    case NmsOptions::MODIFIED_JACCARD:
+      normalization = area2;
+      break;
+    case NmsOptions::INTERSECTION_OVER_UNION:
+    default:
+      normalization = area1 + area2 - intersection_area;
+      break;
+  }
+  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
+}
+
+void NonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options,
+                       std::vector<int>* retained) {
+  retained->clear();
+  const int max_num_detections = options.max_num_detections > -1
+                                     ? options.max_num_detections
+                                     : boxes.size();
+  absl::optional<BoxGrid> grid;
+  if (CanUseGrid(boxes, options)) grid.emplace(boxes);
+  for (int box : SortByScore(boxes)) {
+    if (options.min_score_threshold > 0 &&
+        boxes.score[box] < options.min_score_threshold) {
+      break;
+    }
+    bool suppressed = false;
+    auto suppresses = [&](int kept) {
+      suppressed = Overlap(boxes, options.overlap_type, kept, box) >
+                   options.min_suppression_threshold;
+      return suppressed;
+    };
+    if (grid) {
+      grid->ForEachNeighbor(box, suppresses);
+    } else {
+      for (int kept : *retained) {
+        if (suppresses(kept)) break;
+      }
+    }
+    if (!suppressed) {
+      retained->push_back(box);
+      if (grid) grid->Insert(box);
+    }
+    if (retained->size() >= max_num_detections) break;
+  }
+}
+
+void WeightedNonMaxSuppression(const NmsBoxes& boxes,
+                               const NmsOptions& options,
+                               std::vector<int>* representatives,
+                               NmsBoxes* merged) {
+  representatives->clear();
+  merged->Clear();
+  merged->num_keypoints = boxes.num_keypoints;
+  const int num_keypoint_values = boxes.num_keypoints * 2;
+
+  const std::vector<int> order = SortByScore(boxes);
+  std::vector<int> rank(boxes.size());
+  for (int i = 0; i < order.size(); ++i) rank[order[i]] = i;
+  std::vector<bool> removed(boxes.size(), false);
+  absl::optional<BoxGrid> grid;
+  if (CanUseGrid(boxes, options)) {
+    grid.emplace(boxes);
+    for (int box : order) grid->Insert(box);
+  }
+
+  std::vector<int> group;
+  std::vector<float> keypoints(num_keypoint_values);
+  for (int next = 0; next < order.size(); ++next) {
+    const int best = order[next];
+    if (removed[best]) continue;
+    if (options.min_score_threshold > 0 &&
+        boxes.score[best] < options.min_score_threshold) {
+      break;
+    }
+
+    group.clear();
+    auto add_if_overlapping = [&](int other) {
+      if (!removed[other] &&
+          Overlap(boxes, options.overlap_type, other, best) >
+              options.min_suppression_threshold) {
+        group.push_back(other);
+      }
+      return false;
+    };
+    if (grid) {
+      grid->ForEachNeighbor(best, add_if_overlapping);
+    } else {
+      for (int i = next; i < order.size(); ++i) add_if_overlapping(order[i]);
+    }
+    // Accumulate in score order.
+    std::sort(group.begin(), group.end(),
+              [&rank](int a, int b) { return rank[a] < rank[b]; });
+    removed[best] = true;
+    if (grid) grid->Remove(best);
+    for (int member : group) {
+      removed[member] = true;
+      if (grid) grid->Remove(member);
+    }
+
+    float w_xmin = boxes.xmin[best];
+    float w_ymin = boxes.ymin[best];
+    float w_xmax = boxes.xmax[best];
+    float w_ymax = boxes.ymax[best];
+    std::copy_n(boxes.keypoints.begin() + best * num_keypoint_values,
+                num_keypoint_values, keypoints.begin());
+    if (!group.empty()) {
+      w_xmin = w_ymin = w_xmax = w_ymax = 0.0f;
+      std::fill(keypoints.begin(), keypoints.end(), 0.0f);
+      float total_score = 0.0f;
+      for (int member : group) {
+        const float score = boxes.score[member];
+        total_score += score;
+        w_xmin += boxes.xmin[member] * score;
+        w_ymin += boxes.ymin[member] * score;
+        w_xmax += boxes.xmax[member] * score;
+        w_ymax += boxes.ymax[member] * score;
+        const float* member_keypoints =
+            boxes.keypoints.data() + member * num_keypoint_values;
+        for (int k = 0; k < num_keypoint_values; ++k) {
+          keypoints[k] += member_keypoints[k] * score;
+        }
+      }
+      w_xmin /= total_score;
+      w_ymin /= total_score;
+      w_xmax /= total_score;
+      w_ymax /= total_score;
+      for (float& value : keypoints) value /= total_score;
+    }
+    representatives->push_back(best);
+    merged->Add(w_xmin, w_ymin, w_xmax, w_ymax, boxes.score[best]);
+    merged->keypoints.insert(merged->keypoints.end(), keypoints.begin(),
+                             keypoints.end());
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,101 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Non-maximum suppression on flat float boxes. Boxes are bucketed into a
+// uniform grid, so each box is only compared against boxes that share a grid
+// cell with it, instead of against every retained box.
+#ifndef MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
+#define MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
+
+#include <vector>
+
+namespace mediapipe {
+
+// Axis-aligned boxes and their scores in struct-of-arrays layout. Each box
+// may carry num_keypoints (x, y) keypoints, which are only used by
+// WeightedNonMaxSuppression.
+struct NmsBoxes {
+  std::vector<float> xmin;
+  std::vector<float> ymin;
+  std::vector<float> xmax;
+  std::vector<float> ymax;
+  std::vector<float> score;
+  int num_keypoints = 0;
+  // num_keypoints (x, y) pairs per box.
+  std::vector<float> keypoints;
+
+  int size() const { return score.size(); }
+  void Clear() {
+    xmin.clear();
+    ymin.clear();
+    xmax.clear();
+    ymax.clear();
+    score.clear();
+    keypoints.clear();
+  }
+  void Add(float box_xmin, float box_ymin, float box_xmax, float box_ymax,
+           float box_score) {
+    xmin.push_back(box_xmin);
+    ymin.push_back(box_ymin);
+    xmax.push_back(box_xmax);
+    ymax.push_back(box_ymax);
+    score.push_back(box_score);
+  }
+};
+
+struct NmsOptions {
+  enum OverlapType {
+    // Intersection area over the area of the enclosing box of the two boxes.
+    JACCARD,
+    // Intersection area over the area of the second box.
+    MODIFIED_JACCARD,
+    // Intersection area over the area of the union of the two boxes.
+    INTERSECTION_OVER_UNION,
+  };
+  OverlapType overlap_type = JACCARD;
+  // A box is suppressed by a box whose overlap with it is above this.
+  float min_suppression_threshold = 1.0f;
+  // Boxes scoring below this are dropped, if it is positive.
+  float min_score_threshold = -1.0f;
+  // The maximum number of boxes kept by NonMaxSuppression, or -1.
+  int max_num_detections = -1;
+};
+
+// Returns the overlap of two boxes given as (xmin, ymin, xmax, ymax), with
+// the same conventions as Rectangle_f: boxes that only touch have zero
+// overlap, and empty boxes overlap nothing.
+float BoxOverlap(NmsOptions::OverlapType overlap_type, const float* box1,
+                 const float* box2);
+
+// Greedy non-maximum suppression. Visits boxes by decreasing score (ties in
+// input order) and keeps a box unless a kept box overlaps it by more than
+// min_suppression_threshold. Writes the indices of the kept boxes to
+// `retained`, by decreasing score.
+void NonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options,
+                       std::vector<int>* retained);
+
+// Weighted non-maximum suppression. Repeatedly takes the best remaining box
+// and removes it together with every remaining box that overlaps it by more
+// than min_suppression_threshold; the coordinates and keypoints of the group
+// are averaged, weighted by score. Writes the index of the best box of each
+// group to `representatives` and the averaged boxes, scored like their
+// representative, to `merged`. max_num_detections is not applied.
+void WeightedNonMaxSuppression(const NmsBoxes& boxes,
+                               const NmsOptions& options,
+                               std::vector<int>* representatives,
+                               NmsBoxes* merged);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
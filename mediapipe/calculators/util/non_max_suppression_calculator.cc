@@ -13,11 +13,13 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "mediapipe/calculators/util/non_max_suppression.h"
 #include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/detection.pb.h"
@@ -30,7 +32,6 @@
 namespace mediapipe {
 
 typedef std::vector<Detection> Detections;
-typedef std::vector<std::pair<int, float>> IndexedScores;
 
 namespace {
 
@@ -72,51 +73,23 @@ bool RetainMaxScoringLabelOnly(Detection* detection) {
   return true;
 }
 
-// Computes an overlap similarity between two rectangles. Similarity measure is
-// defined by overlap_type parameter.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Rectangle_f& rect1, const Rectangle_f& rect2) {
-  if (!rect1.Intersects(rect2)) return 0.0f;
-  const float intersection_area = Rectangle_f(rect1).Intersect(rect2).Area();
-  float normalization;
+NmsOptions::OverlapType ToNmsOverlapType(
+    NonMaxSuppressionCalculatorOptions::OverlapType overlap_type) {
   switch (overlap_type) {
     case NonMaxSuppressionCalculatorOptions::JACCARD:
-      normalization = Rectangle_f(rect1).Union(rect2).Area();
-      break;
+      return NmsOptions::JACCARD;
     case NonMaxSuppressionCalculatorOptions::MODIFIED_JACCARD:
-      normalization = rect2.Area();
-      break;
+      return NmsOptions::MODIFIED_JACCARD;
     case NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION:
-      normalization = rect1.Area() + rect2.Area() - intersection_area;
-      break;
+      return NmsOptions::INTERSECTION_OVER_UNION;
     default:
       LOG(FATAL) << "Unrecognized overlap type: " << overlap_type;
   }
-  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
+  return NmsOptions::JACCARD;
 }
 
-// Computes an overlap similarity between two locations by first extracting the
-// relative box (dimension normalized by frame width/height) from the location.
-float OverlapSimilarity(
-    const int frame_width, const int frame_height,
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.ConvertToRelativeBBox(frame_width, frame_height);
-  const auto rect2 = location2.ConvertToRelativeBBox(frame_width, frame_height);
-  return OverlapSimilarity(overlap_type, rect1, rect2);
-}
-
-// Computes an overlap similarity between two locations by first extracting the
-// relative box from the location. It assumes that a relative-box representation
-// is already available in the location, and therefore frame width and height
-// are not needed for further normalization.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.GetRelativeBBox();
-  const auto rect2 = location2.GetRelativeBBox();
-  return OverlapSimilarity(overlap_type, rect1, rect2);
+void AddBox(const Rectangle_f& rect, float score, NmsBoxes* boxes) {
+  boxes->Add(rect.xmin(), rect.ymin(), rect.xmax(), rect.ymax(), score);
 }
 
 }  // namespace
@@ -176,6 +149,11 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
         << "max_num_detections=0 is not a valid value. Please choose a "
         << "positive number of you want to limit the number of output "
         << "detections, or set -1 if you do not want any limit.";
+    nms_options_.overlap_type = ToNmsOverlapType(options_.overlap_type());
+    nms_options_.min_suppression_threshold =
+        options_.min_suppression_threshold();
+    nms_options_.min_score_threshold = options_.min_score_threshold();
+    nms_options_.max_num_detections = options_.max_num_detections();
     return ::mediapipe::OkStatus();
   }
 
@@ -213,33 +191,11 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
       }
     }
 
-    // Copy all the scores (there is a single score in each detection after
-    // the above pruning) to an indexed vector for sorting. The first value is
-    // the index of the detection in the original vector from which the score
-    // stems, while the second is the actual score.
-    IndexedScores indexed_scores;
-    indexed_scores.reserve(pruned_detections.size());
-    for (int index = 0; index < pruned_detections.size(); ++index) {
-      indexed_scores.push_back(
-          std::make_pair(index, pruned_detections[index].score(0)));
-    }
-    std::sort(indexed_scores.begin(), indexed_scores.end(), SortBySecond);
-
-    const int max_num_detections =
-        (options_.max_num_detections() > -1)
-            ? options_.max_num_detections()
-            : static_cast<int>(indexed_scores.size());
-    // A set of detections and locations, wrapping the location data from each
-    // detection, which are retained after the non-maximum suppression.
     auto* retained_detections = new Detections();
-    retained_detections->reserve(max_num_detections);
-
     if (options_.algorithm() == NonMaxSuppressionCalculatorOptions::WEIGHTED) {
-      WeightedNonMaxSuppression(indexed_scores, pruned_detections,
-                                max_num_detections, cc, retained_detections);
+      WeightedNonMaxSuppression(pruned_detections, retained_detections);
     } else {
-      NonMaxSuppression(indexed_scores, pruned_detections, max_num_detections,
-                        cc, retained_detections);
+      NonMaxSuppression(pruned_detections, cc, retained_detections);
     }
 
     cc->Outputs().Index(0).Add(retained_detections, cc->InputTimestamp());
@@ -248,129 +204,78 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
   }
 
  private:
-  void NonMaxSuppression(const IndexedScores& indexed_scores,
-                         const Detections& detections, int max_num_detections,
-                         CalculatorContext* cc, Detections* output_detections) {
-    std::vector<Location> retained_locations;
-    retained_locations.reserve(max_num_detections);
-    // We traverse the detections by decreasing score.
-    for (const auto& indexed_score : indexed_scores) {
-      const auto& detection = detections[indexed_score.first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
+  void NonMaxSuppression(const Detections& detections, CalculatorContext* cc,
+                         Detections* output_detections) {
+    boxes_.Clear();
+    const ImageFrame* frame = nullptr;
+    if (cc->Inputs().HasTag(kImageTag)) {
+      frame = &cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
+    }
+    for (const auto& detection : detections) {
       const Location location(detection.location_data());
-      bool suppressed = false;
-      // The current detection is suppressed iff there exists a retained
-      // detection, whose location overlaps more than the specified
-      // threshold with the location of the current detection.
-      for (const auto& retained_location : retained_locations) {
-        float similarity;
-        if (cc->Inputs().HasTag(kImageTag)) {
-          const auto& frame = cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
-          similarity = OverlapSimilarity(frame.Width(), frame.Height(),
-                                         options_.overlap_type(),
-                                         retained_location, location);
-        } else {
-          similarity = OverlapSimilarity(options_.overlap_type(),
-                                         retained_location, location);
-        }
-        if (similarity > options_.min_suppression_threshold()) {
-          suppressed = true;
-          break;
-        }
-      }
-      if (!suppressed) {
-        output_detections->push_back(detection);
-        retained_locations.push_back(location);
-      }
-      if (output_detections->size() >= max_num_detections) {
-        break;
+      if (frame) {
+        AddBox(location.ConvertToRelativeBBox(frame->Width(), frame->Height()),
+               detection.score(0), &boxes_);
+      } else {
+        AddBox(location.GetRelativeBBox(), detection.score(0), &boxes_);
       }
     }
+    ::mediapipe::NonMaxSuppression(boxes_, nms_options_, &indices_);
+    output_detections->reserve(indices_.size());
+    for (int index : indices_) output_detections->push_back(detections[index]);
   }
 
-  void WeightedNonMaxSuppression(const IndexedScores& indexed_scores,
-                                 const Detections& detections,
-                                 int max_num_detections, CalculatorContext* cc,
+  // Averages every group of overlapping detections into a copy of its top
+  // scoring detection.
+  void WeightedNonMaxSuppression(const Detections& detections,
                                  Detections* output_detections) {
-    IndexedScores remained_indexed_scores;
-    remained_indexed_scores.assign(indexed_scores.begin(),
-                                   indexed_scores.end());
-
-    IndexedScores remained;
-    IndexedScores candidates;
-    output_detections->clear();
-    while (!remained_indexed_scores.empty()) {
-      const auto& detection = detections[remained_indexed_scores[0].first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
-
-      remained.clear();
-      candidates.clear();
-      const Location location(detection.location_data());
-      // This includes the first box.
-      for (const auto& indexed_score : remained_indexed_scores) {
-        Location rest_location(detections[indexed_score.first].location_data());
-        float similarity =
-            OverlapSimilarity(options_.overlap_type(), rest_location, location);
-        if (similarity > options_.min_suppression_threshold()) {
-          candidates.push_back(indexed_score);
-        } else {
-          remained.push_back(indexed_score);
-        }
+    boxes_.Clear();
+    // Only the keypoints that every detection has are averaged.
+    boxes_.num_keypoints =
+        detections.empty() ? 0 : std::numeric_limits<int>::max();
+    for (const auto& detection : detections) {
+      AddBox(Location(detection.location_data()).GetRelativeBBox(),
+             detection.score(0), &boxes_);
+      boxes_.num_keypoints =
+          std::min(boxes_.num_keypoints,
+                   detection.location_data().relative_keypoints_size());
+    }
+    boxes_.keypoints.reserve(detections.size() * boxes_.num_keypoints * 2);
+    for (const auto& detection : detections) {
+      const auto& location_data = detection.location_data();
+      for (int i = 0; i < boxes_.num_keypoints; ++i) {
+        boxes_.keypoints.push_back(location_data.relative_keypoints(i).x());
+        boxes_.keypoints.push_back(location_data.relative_keypoints(i).y());
       }
-      auto weighted_detection = detection;
-      if (!candidates.empty()) {
-        const int num_keypoints =
-            detection.location_data().relative_keypoints_size();
-        std::vector<float> keypoints(num_keypoints * 2);
-        float w_xmin = 0.0f;
-        float w_ymin = 0.0f;
-        float w_xmax = 0.0f;
-        float w_ymax = 0.0f;
-        float total_score = 0.0f;
-        for (const auto& candidate : candidates) {
-          total_score += candidate.second;
-          const auto& location_data =
-              detections[candidate.first].location_data();
-          const auto& bbox = location_data.relative_bounding_box();
-          w_xmin += bbox.xmin() * candidate.second;
-          w_ymin += bbox.ymin() * candidate.second;
-          w_xmax += (bbox.xmin() + bbox.width()) * candidate.second;
-          w_ymax += (bbox.ymin() + bbox.height()) * candidate.second;
+    }
 
-          for (int i = 0; i < num_keypoints; ++i) {
-            keypoints[i * 2] +=
-                location_data.relative_keypoints(i).x() * candidate.second;
-            keypoints[i * 2 + 1] +=
-                location_data.relative_keypoints(i).y() * candidate.second;
-          }
-        }
-        auto* weighted_location = weighted_detection.mutable_location_data()
-                                      ->mutable_relative_bounding_box();
-        weighted_location->set_xmin(w_xmin / total_score);
-        weighted_location->set_ymin(w_ymin / total_score);
-        weighted_location->set_width((w_xmax / total_score) -
-                                     weighted_location->xmin());
-        weighted_location->set_height((w_ymax / total_score) -
-                                      weighted_location->ymin());
-        for (int i = 0; i < num_keypoints; ++i) {
-          auto* keypoint = weighted_detection.mutable_location_data()
-                               ->mutable_relative_keypoints(i);
-          keypoint->set_x(keypoints[i * 2] / total_score);
-          keypoint->set_y(keypoints[i * 2 + 1] / total_score);
-        }
+    ::mediapipe::WeightedNonMaxSuppression(boxes_, nms_options_, &indices_,
+                                           &merged_boxes_);
+    output_detections->reserve(indices_.size());
+    for (int i = 0; i < indices_.size(); ++i) {
+      output_detections->push_back(detections[indices_[i]]);
+      auto* location_data = output_detections->back().mutable_location_data();
+      auto* box = location_data->mutable_relative_bounding_box();
+      box->set_xmin(merged_boxes_.xmin[i]);
+      box->set_ymin(merged_boxes_.ymin[i]);
+      box->set_width(merged_boxes_.xmax[i] - box->xmin());
+      box->set_height(merged_boxes_.ymax[i] - box->ymin());
+      const float* keypoints =
+          merged_boxes_.keypoints.data() + i * merged_boxes_.num_keypoints * 2;
+      for (int k = 0; k < merged_boxes_.num_keypoints; ++k) {
+        auto* keypoint = location_data->mutable_relative_keypoints(k);
+        keypoint->set_x(keypoints[k * 2]);
+        keypoint->set_y(keypoints[k * 2 + 1]);
       }
-      remained_indexed_scores = std::move(remained);
-      output_detections->push_back(weighted_detection);
     }
   }
 
   NonMaxSuppressionCalculatorOptions options_;
+  NmsOptions nms_options_;
+  // Reused across Process() calls.
+  NmsBoxes boxes_;
+  NmsBoxes merged_boxes_;
+  std::vector<int> indices_;
 };
 REGISTER_CALCULATOR(NonMaxSuppressionCalculator);
 
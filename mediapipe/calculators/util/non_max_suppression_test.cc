@@ -0,0 +1,327 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+// Boxes scattered over the unit square, with sizes typical of detections.
+NmsBoxes RandomBoxes(int num_boxes, int num_keypoints, int seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+  std::uniform_real_distribution<float> size(0.01f, 0.2f);
+  std::uniform_real_distribution<float> score(0.0f, 1.0f);
+  NmsBoxes boxes;
+  boxes.num_keypoints = num_keypoints;
+  for (int i = 0; i < num_boxes; ++i) {
+    const float xmin = position(random);
+    const float ymin = position(random);
+    boxes.Add(xmin, ymin, xmin + size(random), ymin + size(random),
+              score(random));
+    for (int k = 0; k < num_keypoints * 2; ++k) {
+      boxes.keypoints.push_back(position(random));
+    }
+  }
+  return boxes;
+}
+
+float ReferenceOverlap(const NmsBoxes& boxes, NmsOptions::OverlapType type,
+                       int box1, int box2) {
+  const float rect1[] = {boxes.xmin[box1], boxes.ymin[box1], boxes.xmax[box1],
+                         boxes.ymax[box1]};
+  const float rect2[] = {boxes.xmin[box2], boxes.ymin[box2], boxes.xmax[box2],
+                         boxes.ymax[box2]};
+  return BoxOverlap(type, rect1, rect2);
+}
+
+std::vector<int> ReferenceOrder(const NmsBoxes& boxes) {
+  std::vector<int> order(boxes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&boxes](int a, int b) {
+    return boxes.score[a] > boxes.score[b];
+  });
+  return order;
+}
+
+// Compares every box against every retained box, as NonMaxSuppressionCalculator
+// did before it used NonMaxSuppression.
+std::vector<int> ReferenceNms(const NmsBoxes& boxes,
+                              const NmsOptions& options) {
+  std::vector<int> retained;
+  const int max_num_detections = options.max_num_detections > -1
+                                     ? options.max_num_detections
+                                     : boxes.size();
+  for (int box : ReferenceOrder(boxes)) {
+    if (options.min_score_threshold > 0 &&
+        boxes.score[box] < options.min_score_threshold) {
+      break;
+    }
+    bool suppressed = false;
+    for (int kept : retained) {
+      if (ReferenceOverlap(boxes, options.overlap_type, kept, box) >
+          options.min_suppression_threshold) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) retained.push_back(box);
+    if (retained.size() >= max_num_detections) break;
+  }
+  return retained;
+}
+
+// Rescans all remaining boxes for every group.
+void ReferenceWeightedNms(const NmsBoxes& boxes, const NmsOptions& options,
+                          std::vector<int>* representatives,
+                          NmsBoxes* merged) {
+  const int num_values = boxes.num_keypoints * 2;
+  merged->num_keypoints = boxes.num_keypoints;
+  std::vector<int> remaining = ReferenceOrder(boxes);
+  while (!remaining.empty()) {
+    const int best = remaining[0];
+    if (options.min_score_threshold > 0 &&
+        boxes.score[best] < options.min_score_threshold) {
+      break;
+    }
+    std::vector<int> group;
+    std::vector<int> rest;
+    for (int box : remaining) {
+      if (ReferenceOverlap(boxes, options.overlap_type, box, best) >
+          options.min_suppression_threshold) {
+        group.push_back(box);
+      } else if (box != best) {
+        rest.push_back(box);
+      }
+    }
+    float total_score = 0.0f;
+    float xmin = 0.0f, ymin = 0.0f, xmax = 0.0f, ymax = 0.0f;
+    std::vector<float> keypoints(num_values, 0.0f);
+    for (int box : group) {
+      const float score = boxes.score[box];
+      total_score += score;
+      xmin += boxes.xmin[box] * score;
+      ymin += boxes.ymin[box] * score;
+      xmax += boxes.xmax[box] * score;
+      ymax += boxes.ymax[box] * score;
+      for (int k = 0; k < num_values; ++k) {
+        keypoints[k] += boxes.keypoints[box * num_values + k] * score;
+      }
+    }
+    representatives->push_back(best);
+    merged->Add(xmin / total_score, ymin / total_score, xmax / total_score,
+                ymax / total_score, boxes.score[best]);
+    for (float value : keypoints) {
+      merged->keypoints.push_back(value / total_score);
+    }
+    remaining = rest;
+  }
+}
+
+class NonMaxSuppressionTest
+    : public ::testing::TestWithParam<NmsOptions::OverlapType> {};
+
+TEST_P(NonMaxSuppressionTest, MatchesPairwiseReference) {
+  for (int num_boxes : {1, 10, 500, 3000}) {
+    const NmsBoxes boxes = RandomBoxes(num_boxes, 0, num_boxes);
+    for (float threshold : {0.0f, 0.3f, 0.7f}) {
+      NmsOptions options;
+      options.overlap_type = GetParam();
+      options.min_suppression_threshold = threshold;
+      std::vector<int> retained;
+      NonMaxSuppression(boxes, options, &retained);
+      EXPECT_EQ(ReferenceNms(boxes, options), retained)
+          << num_boxes << " boxes, threshold " << threshold;
+    }
+  }
+}
+
+TEST_P(NonMaxSuppressionTest, WeightedMatchesPairwiseReference) {
+  for (int num_boxes : {1, 10, 500, 3000}) {
+    const NmsBoxes boxes = RandomBoxes(num_boxes, 3, num_boxes);
+    for (float threshold : {0.0f, 0.3f, 0.7f}) {
+      NmsOptions options;
+      options.overlap_type = GetParam();
+      options.min_suppression_threshold = threshold;
+      std::vector<int> representatives, expected_representatives;
+      NmsBoxes merged, expected_merged;
+      WeightedNonMaxSuppression(boxes, options, &representatives, &merged);
+      ReferenceWeightedNms(boxes, options, &expected_representatives,
+                           &expected_merged);
+      ASSERT_EQ(expected_representatives, representatives)
+          << num_boxes << " boxes, threshold " << threshold;
+      EXPECT_EQ(expected_merged.xmin, merged.xmin);
+      EXPECT_EQ(expected_merged.ymin, merged.ymin);
+      EXPECT_EQ(expected_merged.xmax, merged.xmax);
+      EXPECT_EQ(expected_merged.ymax, merged.ymax);
+      EXPECT_EQ(expected_merged.score, merged.score);
+      EXPECT_EQ(expected_merged.keypoints, merged.keypoints);
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(OverlapTypes, NonMaxSuppressionTest,
+                        ::testing::Values(NmsOptions::JACCARD,
+                                          NmsOptions::MODIFIED_JACCARD,
+                                          NmsOptions::INTERSECTION_OVER_UNION));
+
+TEST(NonMaxSuppressionTest, ScoreThresholdAndMaxDetections) {
+  const NmsBoxes boxes = RandomBoxes(1000, 0, 7);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.2f;
+  options.min_score_threshold = 0.5f;
+  std::vector<int> retained;
+  NonMaxSuppression(boxes, options, &retained);
+  EXPECT_EQ(ReferenceNms(boxes, options), retained);
+  for (int box : retained) EXPECT_GE(boxes.score[box], 0.5f);
+
+  options.max_num_detections = 5;
+  NonMaxSuppression(boxes, options, &retained);
+  EXPECT_EQ(5, retained.size());
+  EXPECT_EQ(ReferenceNms(boxes, options), retained);
+}
+
+TEST(NonMaxSuppressionTest, LargeAndDegenerateBoxes) {
+  NmsBoxes boxes = RandomBoxes(200, 0, 8);
+  // A box covering everything, an empty box and a box with NaN coordinates.
+  boxes.Add(-1.0f, -1.0f, 2.0f, 2.0f, 0.5f);
+  boxes.Add(0.5f, 0.5f, 0.4f, 0.6f, 0.9f);
+  boxes.Add(0.2f, std::nanf(""), 0.3f, 0.4f, 0.8f);
+  NmsOptions options;
+  options.overlap_type = NmsOptions::MODIFIED_JACCARD;
+  options.min_suppression_threshold = 0.5f;
+  std::vector<int> retained;
+  NonMaxSuppression(boxes, options, &retained);
+  EXPECT_EQ(ReferenceNms(boxes, options), retained);
+}
+
+// Non-finite coordinates make both functions compare every pair of boxes.
+TEST(NonMaxSuppressionTest, NonFiniteBoxes) {
+  NmsBoxes boxes = RandomBoxes(100, 1, 10);
+  const float inf = std::numeric_limits<float>::infinity();
+  boxes.Add(-inf, 0.1f, 0.5f, 0.6f, 0.95f);
+  boxes.Add(0.3f, 0.2f, inf, inf, 0.85f);
+  boxes.Add(std::nanf(""), std::nanf(""), 0.4f, std::nanf(""), 0.75f);
+  boxes.keypoints.resize(boxes.size() * 2, 0.5f);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  std::vector<int> retained;
+  NonMaxSuppression(boxes, options, &retained);
+  EXPECT_EQ(ReferenceNms(boxes, options), retained);
+
+  std::vector<int> representatives, expected_representatives;
+  NmsBoxes merged, expected_merged;
+  WeightedNonMaxSuppression(boxes, options, &representatives, &merged);
+  ReferenceWeightedNms(boxes, options, &expected_representatives,
+                       &expected_merged);
+  EXPECT_EQ(expected_representatives, representatives);
+}
+
+TEST(NonMaxSuppressionTest, NegativeThresholdKeepsOnlyTheBestBox) {
+  const NmsBoxes boxes = RandomBoxes(100, 0, 9);
+  NmsOptions options;
+  options.min_suppression_threshold = -1.0f;
+  std::vector<int> retained;
+  NonMaxSuppression(boxes, options, &retained);
+  ASSERT_EQ(1, retained.size());
+  EXPECT_EQ(ReferenceOrder(boxes)[0], retained[0]);
+}
+
+TEST(NonMaxSuppressionTest, WeightedAveragesOverlappingBoxes) {
+  NmsBoxes boxes;
+  boxes.num_keypoints = 1;
+  boxes.Add(0.0f, 0.0f, 1.0f, 1.0f, 0.75f);
+  boxes.keypoints = {0.0f, 0.0f};
+  boxes.Add(0.1f, 0.1f, 1.1f, 1.1f, 0.25f);
+  boxes.keypoints.insert(boxes.keypoints.end(), {1.0f, 1.0f});
+  boxes.Add(5.0f, 5.0f, 6.0f, 6.0f, 0.5f);
+  boxes.keypoints.insert(boxes.keypoints.end(), {5.5f, 5.5f});
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  std::vector<int> representatives;
+  NmsBoxes merged;
+  WeightedNonMaxSuppression(boxes, options, &representatives, &merged);
+  ASSERT_EQ(std::vector<int>({0, 2}), representatives);
+  EXPECT_FLOAT_EQ(0.025f, merged.xmin[0]);
+  EXPECT_FLOAT_EQ(1.025f, merged.ymax[0]);
+  EXPECT_FLOAT_EQ(0.75f, merged.score[0]);
+  EXPECT_FLOAT_EQ(0.25f, merged.keypoints[0]);
+  EXPECT_FLOAT_EQ(5.0f, merged.xmin[1]);
+  EXPECT_FLOAT_EQ(5.5f, merged.keypoints[3]);
+}
+
+void BM_NonMaxSuppressionReference(benchmark::State& state) {
+  const NmsBoxes boxes = RandomBoxes(state.range(0), 0, 1);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ReferenceNms(boxes, options));
+  }
+}
+
+void BM_NonMaxSuppression(benchmark::State& state) {
+  const NmsBoxes boxes = RandomBoxes(state.range(0), 0, 1);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  std::vector<int> retained;
+  for (auto _ : state) {
+    NonMaxSuppression(boxes, options, &retained);
+    benchmark::DoNotOptimize(retained.data());
+  }
+}
+
+void BM_WeightedNonMaxSuppressionReference(benchmark::State& state) {
+  const NmsBoxes boxes = RandomBoxes(state.range(0), 6, 1);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  for (auto _ : state) {
+    std::vector<int> representatives;
+    NmsBoxes merged;
+    ReferenceWeightedNms(boxes, options, &representatives, &merged);
+    benchmark::DoNotOptimize(merged.score.data());
+  }
+}
+
+void BM_WeightedNonMaxSuppression(benchmark::State& state) {
+  const NmsBoxes boxes = RandomBoxes(state.range(0), 6, 1);
+  NmsOptions options;
+  options.min_suppression_threshold = 0.3f;
+  std::vector<int> representatives;
+  NmsBoxes merged;
+  for (auto _ : state) {
+    WeightedNonMaxSuppression(boxes, options, &representatives, &merged);
+    benchmark::DoNotOptimize(merged.score.data());
+  }
+}
+
+BENCHMARK(BM_NonMaxSuppressionReference)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_NonMaxSuppression)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_WeightedNonMaxSuppressionReference)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(10000);
+BENCHMARK(BM_WeightedNonMaxSuppression)->Arg(100)->Arg(1000)->Arg(10000);
+
+}  // namespace
+}  // namespace mediapipe
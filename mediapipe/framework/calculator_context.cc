@@ -14,6 +14,8 @@
 
 #include "mediapipe/framework/calculator_context.h"
 
+#include "mediapipe/framework/port/logging.h"
+
 namespace mediapipe {
 
 const std::string& CalculatorContext::CalculatorType() const {
@@ -65,6 +67,38 @@ void CalculatorContext::SetOffset(TimestampDiff offset) {
   }
 }
 
+CalculatorContext::CompletionCallback CalculatorContext::DeferCompletion() {
+  CHECK(completion_callback_)
+      << "DeferCompletion() is not supported by source nodes.";
+  CHECK(!completion_deferred_) << "DeferCompletion() was already called.";
+  CHECK_EQ(NumberOfTimestamps(), 1)
+      << "DeferCompletion() does not support batched input sets.";
+  completion_deferred_ = true;
+  pending_completion_parties_ = 2;
+  auto callback_ended = std::make_shared<std::atomic<bool>>(false);
+  completion_callback_ended_ = callback_ended;
+  return [this, callback_ended](const ::mediapipe::Status& status) {
+    // The invocation may have completed already if Process() failed.
+    if (callback_ended->exchange(true)) {
+      return;
+    }
+    completion_status_ = status;
+    ReleaseDeferredCompletion();
+  };
+}
+
+void CalculatorContext::EndCompletionCallback() {
+  if (!completion_callback_ended_->exchange(true)) {
+    ReleaseDeferredCompletion();
+  }
+}
+
+void CalculatorContext::ReleaseDeferredCompletion() {
+  if (pending_completion_parties_.fetch_sub(1) == 1) {
+    (*completion_callback_)(this);
+  }
+}
+
 const InputStreamSet& CalculatorContext::InputStreams() const {
   return calculator_state_->InputStreams();
 }
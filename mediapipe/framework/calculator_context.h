@@ -15,6 +15,8 @@
 #ifndef MEDIAPIPE_FRAMEWORK_CALCULATOR_CONTEXT_H_
 #define MEDIAPIPE_FRAMEWORK_CALCULATOR_CONTEXT_H_
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <queue>
 #include <string>
@@ -81,6 +83,36 @@ class CalculatorContext {
                                      : input_timestamps_.front();
   }
 
+  // Returns the number of input timestamps this context has yet to be run
+  // for, including the current one. This exceeds 1 only when the input stream
+  // handler batches input sets, such as BatchingInputStreamHandler. A
+  // calculator can then gather the inputs of a batch and handle them together
+  // when this returns 1. A batch cut short by the end of the inputs is
+  // followed by Timestamp::Done(), so such calculators also flush in Close().
+  int NumRemainingInputTimestamps() const { return NumberOfTimestamps(); }
+
+  // Completes a Process() call deferred by DeferCompletion(), with the status
+  // the call would otherwise have returned.
+  typedef std::function<void(const ::mediapipe::Status&)> CompletionCallback;
+
+  // Lets the current Process() call complete asynchronously, so that waiting
+  // on external work, such as an accelerator or a file read, does not hold
+  // an executor thread. Process() starts the work and returns, and the work
+  // then calls the returned callback exactly once, from any thread. Until
+  // then the invocation counts against max_in_flight, its inputs stay in this
+  // context, and outputs may still be added to this context; the framework
+  // propagates them once the callback has run. A node with max_in_flight > 1
+  // can thus keep several invocations waiting at once, and is closed only
+  // after all of them complete.
+  //
+  // If Process() returns an error after calling DeferCompletion(), the
+  // invocation completes with that error right away, and a later call of the
+  // callback does nothing. The work must then no longer use this context.
+  //
+  // NOTE: Not supported for source nodes, nor when the input stream handler
+  // batches input sets.
+  CompletionCallback DeferCompletion();
+
   // Returns a reference to the input side packet set.
   const PacketSet& InputSidePackets() const;
   // Returns a reference to the output side packet collection.
@@ -152,6 +184,15 @@ class CalculatorContext {
     graph_status_ = status;
   }
 
+  // Ends the part of the Process() call or of the completion callback in a
+  // deferred invocation. The last of the two to end runs
+  // *completion_callback_.
+  void ReleaseDeferredCompletion();
+
+  // Ends the part of the completion callback in a deferred invocation, unless
+  // the callback has run already. The callback then does nothing.
+  void EndCompletionCallback();
+
   // Interface for the friend class Calculator.
   const InputStreamSet& InputStreams() const;
   const OutputStreamSet& OutputStreams() const;
@@ -169,6 +210,23 @@ class CalculatorContext {
   // The status of the graph run. Only used when Close() is called.
   ::mediapipe::Status graph_status_;
 
+  // True if the current Process() call has called DeferCompletion().
+  bool completion_deferred_ = false;
+  // The number of parties, the Process() call and the completion callback,
+  // that have yet to end their part in the deferred invocation.
+  std::atomic<int> pending_completion_parties_{0};
+  // Set once the completion callback of the current deferred invocation has
+  // run or has been ended by EndCompletionCallback(). Shared with the
+  // callback, which may be called after this context is reused.
+  std::shared_ptr<std::atomic<bool>> completion_callback_ended_;
+  // The statuses returned by Process() and passed to the completion callback.
+  ::mediapipe::Status process_status_;
+  ::mediapipe::Status completion_status_;
+  // Queues the completion of a deferred invocation. Owned by the friend class
+  // CalculatorContextManager, and null if the node does not support deferral.
+  const std::function<void(CalculatorContext*)>* completion_callback_ =
+      nullptr;
+
   // Accesses CalculatorContext for setting input timestamp.
   friend class CalculatorContextManager;
 };
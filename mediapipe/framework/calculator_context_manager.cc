@@ -40,6 +40,9 @@ void CalculatorContextManager::Initialize(
   setup_shards_callback_ = std::move(setup_shards_callback);
   default_context_ = absl::make_unique<CalculatorContext>(
       calculator_state_, input_tag_map_, output_tag_map_);
+  if (completion_callback_) {
+    default_context_->completion_callback_ = &completion_callback_;
+  }
   return setup_shards_callback_(default_context_.get());
 }
 
@@ -79,6 +82,9 @@ CalculatorContext* CalculatorContextManager::PrepareCalculatorContext(
   if (idle_contexts_.empty()) {
     auto new_context = absl::make_unique<CalculatorContext>(
         calculator_state_, input_tag_map_, output_tag_map_);
+    if (completion_callback_) {
+      new_context->completion_callback_ = &completion_callback_;
+    }
     MEDIAPIPE_CHECK_OK(setup_shards_callback_(new_context.get()));
     calculator_context = new_context.get();
     active_contexts_.emplace(input_timestamp, std::move(new_context));
@@ -42,6 +42,14 @@ class CalculatorContextManager {
                   std::shared_ptr<tool::TagMap> output_tag_map,
                   bool calculator_run_in_parallel);
 
+  // Sets the callback that queues the completion of a Process() call deferred
+  // by CalculatorContext::DeferCompletion(). Calculator contexts support
+  // deferral only if it is set. Must be called before PrepareForRun().
+  void SetCompletionCallback(
+      std::function<void(CalculatorContext*)> completion_callback) {
+    completion_callback_ = std::move(completion_callback);
+  }
+
   // Sets the callback that can setup the input and output stream shards in a
   // newly constructed calculator context. Then, initializes the default
   // calculator context.
@@ -107,6 +115,40 @@ class CalculatorContextManager {
     calculator_context->PopInputTimestamp();
   }
 
+  // Returns true if the last Process() call in calculator_context deferred its
+  // completion with CalculatorContext::DeferCompletion().
+  bool CompletionDeferred(const CalculatorContext& calculator_context) const {
+    return calculator_context.completion_deferred_;
+  }
+
+  // Ends the part of the Process() call, which returned process_status, in
+  // the deferred invocation of calculator_context. The completion callback
+  // runs once the deferred work has completed too, possibly right away. If
+  // Process() failed, nothing need complete the deferred work, so the
+  // invocation completes right away.
+  void ReleaseDeferredCompletion(CalculatorContext* calculator_context,
+                                 const ::mediapipe::Status& process_status) {
+    CHECK(calculator_context);
+    calculator_context->process_status_ = process_status;
+    if (!process_status.ok()) {
+      calculator_context->EndCompletionCallback();
+    }
+    calculator_context->ReleaseDeferredCompletion();
+  }
+
+  // Ends the completed deferred invocation of calculator_context, and returns
+  // its status: the error returned by Process(), if any, or else the status
+  // passed to the completion callback.
+  ::mediapipe::Status TakeCompletionStatus(
+      CalculatorContext* calculator_context) {
+    CHECK(calculator_context);
+    calculator_context->completion_deferred_ = false;
+    if (!calculator_context->process_status_.ok()) {
+      return std::move(calculator_context->process_status_);
+    }
+    return std::move(calculator_context->completion_status_);
+  }
+
   void SetGraphStatusInContext(CalculatorContext* calculator_context,
                                const ::mediapipe::Status& status) {
     CHECK(calculator_context);
@@ -126,6 +168,9 @@ class CalculatorContextManager {
   // calculator context manager and input/output stream handlers.
   std::function<::mediapipe::Status(CalculatorContext*)> setup_shards_callback_;
 
+  // The callback that queues the completion of a deferred Process() call.
+  std::function<void(CalculatorContext*)> completion_callback_;
+
   // The default calculator context that is always reused for sequential
   // execution. It is also used by Open() and Close() method of a parallel
   // calculator.
@@ -104,6 +104,17 @@ class CalculatorContract {
     return input_stream_handler_options_;
   }
 
+  // Set the number of Process() calls this Node may have in flight at once.
+  // If the graph (.pbtxt) specifies max_in_flight for this Node, the graph's
+  // value takes priority. A calculator setting this above one must tolerate
+  // concurrent Process() calls; outputs are still delivered in timestamp
+  // order by the default OutputStreamHandler.
+  void SetMaxInFlight(int max_in_flight) { max_in_flight_ = max_in_flight; }
+
+  // Returns the max_in_flight requested by the calculator, or 0 if none is
+  // set.
+  int GetMaxInFlight() const { return max_in_flight_; }
+
   class GraphServiceRequest {
    public:
     // APIs that should be used by calculators.
@@ -145,6 +156,7 @@ class CalculatorContract {
   std::unique_ptr<PacketTypeSet> output_side_packets_;
   std::string input_stream_handler_;
   MediaPipeOptions input_stream_handler_options_;
+  int max_in_flight_ = 0;
   std::string node_name_;
   std::map<std::string, GraphServiceRequest> service_requests_;
 };
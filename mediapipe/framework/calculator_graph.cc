@@ -257,6 +257,9 @@ CalculatorGraph::~CalculatorGraph() {}
 
 ::mediapipe::Status CalculatorGraph::InitializeProfiler() {
   profiler_->Initialize(*validated_graph_);
+  profiler_->SetQueueSizeCallback([this](int index) {
+    return input_stream_managers_[index].QueueSize();
+  });
   return ::mediapipe::OkStatus();
 }
 
@@ -317,6 +320,14 @@ CalculatorGraph::~CalculatorGraph() {}
                                                  use_application_thread));
   }
 
+  for (const ExecutorConfig& executor_config :
+       validated_graph_->Config().executor()) {
+    if (executor_config.num_queue_shards() > 1) {
+      MP_RETURN_IF_ERROR(scheduler_.SetNumQueueShards(
+          executor_config.name(), executor_config.num_queue_shards()));
+    }
+  }
+
   return ::mediapipe::OkStatus();
 }
 
@@ -351,7 +362,7 @@ CalculatorGraph::~CalculatorGraph() {}
 }
 
 ::mediapipe::Status CalculatorGraph::Initialize(
-    std::unique_ptr<ValidatedGraphConfig> validated_graph,
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
     const std::map<std::string, Packet>& side_packets) {
   RET_CHECK(!initialized_).SetNoLogging()
       << "CalculatorGraph can be initialized only once.";
@@ -143,6 +143,19 @@ class CalculatorGraph {
       const std::string& graph_type = "",
       const Subgraph::SubgraphOptions* options = nullptr);
 
+  // Initializes the graph from a ValidatedGraphConfig, which any number of
+  // graphs may share.  This skips validating the config again, so it is the
+  // fastest way to create many graphs, e.g. one per request:
+  //
+  //   auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  //   MP_RETURN_IF_ERROR(validated_graph->Initialize(config));
+  //   ...
+  //   CalculatorGraph graph;
+  //   MP_RETURN_IF_ERROR(graph.Initialize(validated_graph));
+  ::mediapipe::Status Initialize(
+      std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+      const std::map<std::string, Packet>& side_packets = {});
+
   // Resturns the canonicalized CalculatorGraphConfig for this graph.
   const CalculatorGraphConfig& Config() const {
     return validated_graph_->Config();
@@ -435,11 +448,6 @@ class CalculatorGraph {
     OutputStreamShard shard_;
   };
 
-  // Initializes the graph from a ValidatedGraphConfig object.
-  ::mediapipe::Status Initialize(
-      std::unique_ptr<ValidatedGraphConfig> validated_graph,
-      const std::map<std::string, Packet>& side_packets);
-
   // AddPacketToInputStreamInternal template is called by either
   // AddPacketToInputStream(Packet&& packet) or
   // AddPacketToInputStream(const Packet& packet).
@@ -540,8 +548,9 @@ class CalculatorGraph {
   // A packet type that has SetAny() called on it.
   PacketType any_packet_type_;
 
-  // The ValidatedGraphConfig object defining this CalculatorGraph.
-  std::unique_ptr<ValidatedGraphConfig> validated_graph_;
+  // The ValidatedGraphConfig object defining this CalculatorGraph, which
+  // may be shared with other graphs.
+  std::shared_ptr<const ValidatedGraphConfig> validated_graph_;
 
   // The PacketGeneratorGraph to use to generate all the input side packets.
   PacketGeneratorGraph packet_generator_graph_;
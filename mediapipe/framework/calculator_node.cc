@@ -87,16 +87,20 @@ Timestamp CalculatorNode::SourceProcessOrder(
       validated_graph_->Config().node(node_id_);
   name_ = CanonicalNodeName(validated_graph_->Config(), node_id_);
 
+  const NodeTypeInfo& node_type_info =
+      validated_graph_->CalculatorInfos()[node_id_];
+
+  // The graph specified max_in_flight takes priority over the calculator's.
   max_in_flight_ = node_config.max_in_flight();
+  if (max_in_flight_ == 0) {
+    max_in_flight_ = node_type_info.Contract().GetMaxInFlight();
+  }
   max_in_flight_ = max_in_flight_ ? max_in_flight_ : 1;
   if (!node_config.executor().empty()) {
     executor_ = node_config.executor();
   }
   source_layer_ = node_config.source_layer();
 
-  const NodeTypeInfo& node_type_info =
-      validated_graph_->CalculatorInfos()[node_id_];
-
   uses_gpu_ =
       node_type_info.InputSidePacketTypes().HasTag(kGpuSharedTagName) ||
       ContainsKey(node_type_info.Contract().ServiceRequests(), kGpuService.key);
@@ -381,9 +385,14 @@ void CalculatorNode::SetMaxInputStreamQueueSize(int max_queue_size) {
     status_ = kStatePrepared;
     scheduling_state_ = kIdle;
     current_in_flight_ = 0;
+    num_deferred_invocations_ = 0;
+    close_after_deferred_invocations_ = false;
     input_stream_headers_ready_called_ = false;
     input_side_packets_ready_called_ = false;
+    // With open_nodes_concurrently, Open() does not wait for the upstream
+    // nodes to set the input stream headers.
     input_stream_headers_ready_ =
+        validated_graph_->Config().open_nodes_concurrently() ||
         (input_stream_handler_->UnsetHeaderCount() == 0);
     input_side_packets_ready_ =
         (input_side_packet_handler_.MissingInputSidePacketCount() == 0);
@@ -563,6 +572,7 @@ void CalculatorNode::CloseOutputStreams(OutputStreamShardSet* outputs) {
 }
 
 void CalculatorNode::CleanupAfterRun(const ::mediapipe::Status& graph_status) {
+  input_stream_handler_->CleanupAfterRun();
   if (needs_to_close_) {
     calculator_context_manager_.PushInputTimestampToContext(
         calculator_context_manager_.GetDefaultCalculatorContext(),
@@ -583,6 +593,8 @@ void CalculatorNode::CleanupAfterRun(const ::mediapipe::Status& graph_status) {
     status_ = kStateUninitialized;
     scheduling_state_ = kIdle;
     current_in_flight_ = 0;
+    num_deferred_invocations_ = 0;
+    close_after_deferred_invocations_ = false;
   }
 }
 
@@ -630,9 +642,13 @@ void CalculatorNode::InputStreamHeadersReady() {
   bool ready_for_open = false;
   {
     absl::MutexLock lock(&status_mutex_);
-    CHECK_EQ(status_, kStatePrepared) << DebugName();
     CHECK(!input_stream_headers_ready_called_);
     input_stream_headers_ready_called_ = true;
+    if (input_stream_headers_ready_) {
+      // The node did not wait for the headers, and may be open already.
+      return;
+    }
+    CHECK_EQ(status_, kStatePrepared) << DebugName();
     input_stream_headers_ready_ = true;
     ready_for_open = input_side_packets_ready_;
   }
@@ -789,14 +805,19 @@ std::string CalculatorNode::DebugName() const {
     // This is not a source Calculator.
     InputStreamShardSet* const inputs = &calculator_context->Inputs();
     OutputStreamShardSet* const outputs = &calculator_context->Outputs();
-    ::mediapipe::Status result =
-        ::mediapipe::InternalError("Calculator context has no input packets.");
+    ::mediapipe::Status result;
 
     int num_invocations = calculator_context_manager_.NumberOfContextTimestamps(
         *calculator_context);
     RET_CHECK(num_invocations <= 1 || max_in_flight_ <= 1)
         << "num_invocations:" << num_invocations
         << ", max_in_flight_:" << max_in_flight_;
+    // Built only when needed: a non-OK status allocates, and this runs for
+    // every invocation.
+    if (num_invocations == 0) {
+      return ::mediapipe::InternalError(
+          "Calculator context has no input packets.");
+    }
     for (int i = 0; i < num_invocations; ++i) {
       const Timestamp input_timestamp = calculator_context->InputTimestamp();
       // The node is ready for Process().
@@ -816,22 +837,16 @@ std::string CalculatorNode::DebugName() const {
           result = calculator_->Process(calculator_context);
         }
 
-        // Removes one packet from each shard and progresses to the next input
-        // timestamp.
-        input_stream_handler_->ClearCurrentInputs(calculator_context);
-
-        // Nodes are allowed to return StatusStop() to cause the termination
-        // of the graph. This is different from an error in that it will
-        // ensure that all sources will be closed and that packets in input
-        // streams will be processed before the graph is terminated.
-        if (!result.ok() && result != tool::StatusStop()) {
-          return ::mediapipe::StatusBuilder(result, MEDIAPIPE_LOC).SetPrepend()
-                 << absl::Substitute(
-                        "Calculator::Process() for node \"$0\" failed: ",
-                        DebugName());
+        if (calculator_context_manager_.CompletionDeferred(
+                *calculator_context)) {
+          // The inputs stay in the calculator context until the invocation
+          // completes. See CompleteProcessNode().
+          absl::MutexLock lock(&status_mutex_);
+          ++num_deferred_invocations_;
+          return result;
         }
-        output_stream_handler_->PostProcess(input_timestamp);
-        if (result == tool::StatusStop()) {
+        result = FinishProcess(calculator_context, input_timestamp, result);
+        if (!result.ok()) {
           return result;
         }
       } else if (input_timestamp == Timestamp::Done()) {
@@ -842,6 +857,14 @@ std::string CalculatorNode::DebugName() const {
         CHECK_EQ(calculator_context_manager_.NumberOfContextTimestamps(
                      *calculator_context),
                  1);
+        {
+          absl::MutexLock lock(&status_mutex_);
+          if (num_deferred_invocations_ > 0) {
+            // The last deferred invocation to complete closes the node.
+            close_after_deferred_invocations_ = true;
+            return ::mediapipe::OkStatus();
+          }
+        }
         return CloseNode(::mediapipe::OkStatus(), /*graph_run_ended=*/false);
       } else {
         RET_CHECK_FAIL()
@@ -853,6 +876,58 @@ std::string CalculatorNode::DebugName() const {
   }
 }
 
+::mediapipe::Status CalculatorNode::FinishProcess(
+    CalculatorContext* calculator_context, Timestamp input_timestamp,
+    const ::mediapipe::Status& result) {
+  // Removes one packet from each shard and progresses to the next input
+  // timestamp.
+  input_stream_handler_->ClearCurrentInputs(calculator_context);
+
+  // Nodes are allowed to return StatusStop() to cause the termination
+  // of the graph. This is different from an error in that it will
+  // ensure that all sources will be closed and that packets in input
+  // streams will be processed before the graph is terminated.
+  if (!result.ok() && result != tool::StatusStop()) {
+    return ::mediapipe::StatusBuilder(result, MEDIAPIPE_LOC).SetPrepend()
+           << absl::Substitute(
+                  "Calculator::Process() for node \"$0\" failed: ",
+                  DebugName());
+  }
+  output_stream_handler_->PostProcess(input_timestamp);
+  return result;
+}
+
+bool CalculatorNode::ProcessDeferred(
+    CalculatorContext* calculator_context) const {
+  return calculator_context_manager_.CompletionDeferred(*calculator_context);
+}
+
+void CalculatorNode::ReleaseDeferredProcess(
+    CalculatorContext* calculator_context, const ::mediapipe::Status& status) {
+  calculator_context_manager_.ReleaseDeferredCompletion(calculator_context,
+                                                        status);
+}
+
+::mediapipe::Status CalculatorNode::CompleteProcessNode(
+    CalculatorContext* calculator_context) {
+  ::mediapipe::Status result = FinishProcess(
+      calculator_context, calculator_context->InputTimestamp(),
+      calculator_context_manager_.TakeCompletionStatus(calculator_context));
+  bool close_node = false;
+  {
+    absl::MutexLock lock(&status_mutex_);
+    --num_deferred_invocations_;
+    if (num_deferred_invocations_ == 0 && close_after_deferred_invocations_) {
+      close_after_deferred_invocations_ = false;
+      close_node = result.ok();
+    }
+  }
+  if (close_node) {
+    return CloseNode(::mediapipe::OkStatus(), /*graph_run_ended=*/false);
+  }
+  return result;
+}
+
 void CalculatorNode::SetQueueSizeCallbacks(
     InputStreamManager::QueueSizeCallback becomes_full_callback,
     InputStreamManager::QueueSizeCallback becomes_not_full_callback) {
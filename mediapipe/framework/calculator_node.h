@@ -97,6 +97,31 @@ class CalculatorNode {
   // Calls Process() on the Calculator corresponding to this node.
   ::mediapipe::Status ProcessNode(CalculatorContext* calculator_context);
 
+  // Returns true if the Process() call just run by ProcessNode() deferred its
+  // completion with CalculatorContext::DeferCompletion(). The scheduler then
+  // calls ReleaseDeferredProcess() with the status ProcessNode() returned,
+  // and calls CompleteProcessNode() and EndScheduling() once the completion
+  // callback has queued the node again.
+  bool ProcessDeferred(CalculatorContext* calculator_context) const;
+
+  // Ends the part of the ProcessNode() call, which returned status, in a
+  // deferred invocation. The calculator context must not be used afterwards.
+  void ReleaseDeferredProcess(CalculatorContext* calculator_context,
+                              const ::mediapipe::Status& status);
+
+  // Finishes a deferred invocation after it completed: propagates its outputs
+  // and returns its status, like ProcessNode() does for other invocations.
+  ::mediapipe::Status CompleteProcessNode(
+      CalculatorContext* calculator_context) LOCKS_EXCLUDED(status_mutex_);
+
+  // Sets the callback that queues the completion of a deferred invocation.
+  // Nodes without it, such as sources, cannot defer completion.
+  void SetCompletionCallback(
+      std::function<void(CalculatorContext*)> completion_callback) {
+    calculator_context_manager_.SetCompletionCallback(
+        std::move(completion_callback));
+  }
+
   // Initializes the node.  The buffer_size_hint argument is
   // set to the value specified in the graph proto for this field.
   // input_stream_managers/output_stream_managers is expected to point to
@@ -260,6 +285,12 @@ class CalculatorNode {
       const OutputStreamHandlerConfig& handler_config,
       const PacketTypeSet& output_stream_types);
 
+  // Clears the inputs of the invocation of Calculator::Process() for
+  // input_timestamp, which returned result, and propagates its outputs.
+  ::mediapipe::Status FinishProcess(CalculatorContext* calculator_context,
+                                    Timestamp input_timestamp,
+                                    const ::mediapipe::Status& result);
+
   // Connects the input/output stream shards in the given calculator context to
   // the input/output streams of the node.
   ::mediapipe::Status ConnectShardsToStreams(
@@ -313,6 +344,10 @@ class CalculatorNode {
   //
   // The number of invocations that are scheduled but not finished.
   int current_in_flight_ GUARDED_BY(status_mutex_) = 0;
+  // The number of invocations that deferred their completion and have not
+  // been completed, and whether Close() waits for them.
+  int num_deferred_invocations_ GUARDED_BY(status_mutex_) = 0;
+  bool close_after_deferred_invocations_ GUARDED_BY(status_mutex_) = false;
   // SchedulingState incidates the current state of the node scheduling process.
   // There are four possible transitions:
   // (a) From kIdle to kScheduling.
@@ -19,22 +19,31 @@
 //
 // TODO: Add more tests to verify the correctness of parallel execution.
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/thread_pool_executor.pb.h"
 
 namespace mediapipe {
 
@@ -77,6 +86,47 @@ class SlowPlusOneCalculator : public CalculatorBase {
 
 REGISTER_CALCULATOR(SlowPlusOneCalculator);
 
+// Requests parallel invocations through its contract and records the highest
+// number of concurrent Process() calls.
+class ContractParallelPlusOneCalculator : public CalculatorBase {
+ public:
+  static constexpr int kMaxInFlight = 4;
+
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    cc->SetMaxInFlight(kMaxInFlight);
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override {
+    cc->SetOffset(mediapipe::TimestampDiff(0));
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    const int in_flight = ++in_flight_;
+    int observed = max_observed_in_flight_.load();
+    while (in_flight > observed &&
+           !max_observed_in_flight_.compare_exchange_weak(observed,
+                                                          in_flight)) {
+    }
+    absl::SleepFor(absl::Milliseconds(10));
+    cc->Outputs().Index(0).Add(new int(cc->Inputs().Index(0).Get<int>() + 1),
+                               cc->InputTimestamp());
+    --in_flight_;
+    return ::mediapipe::OkStatus();
+  }
+
+  static std::atomic<int> max_observed_in_flight_;
+
+ private:
+  std::atomic<int> in_flight_{0};
+};
+std::atomic<int> ContractParallelPlusOneCalculator::max_observed_in_flight_{0};
+
+REGISTER_CALCULATOR(ContractParallelPlusOneCalculator);
+
 class ParallelExecutionTest : public testing::Test {
  public:
   void AddThreadSafeVectorSink(const Packet& packet) {
@@ -153,5 +203,451 @@ TEST_F(ParallelExecutionTest, SlowPlusOneCalculatorsTest) {
   }
 }
 
+// Runs |num_packets| through a ContractParallelPlusOneCalculator node and
+// returns the outputs in the order they were observed.
+std::vector<Packet> RunContractParallelGraph(const std::string& node_extra,
+                                             int num_packets) {
+  CalculatorGraphConfig graph_config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrCat(
+          R"(
+            input_stream: "input"
+            node {
+              calculator: "ContractParallelPlusOneCalculator"
+              input_stream: "input"
+              output_stream: "output"
+              )",
+          node_extra, R"(
+            }
+            num_threads: 4
+          )"));
+  std::vector<Packet> output_packets;
+  CalculatorGraph graph(graph_config);
+  MEDIAPIPE_CHECK_OK(graph.ObserveOutputStream(
+      "output", [&output_packets](const Packet& packet) {
+        output_packets.push_back(packet);
+        return ::mediapipe::OkStatus();
+      }));
+  ContractParallelPlusOneCalculator::max_observed_in_flight_ = 0;
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  for (int i = 0; i < num_packets; ++i) {
+    MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  return output_packets;
+}
+
+TEST(ContractMaxInFlightTest, CalculatorRunsInParallelInTimestampOrder) {
+  constexpr int kNumPackets = 40;
+  std::vector<Packet> output_packets =
+      RunContractParallelGraph(/*node_extra=*/"", kNumPackets);
+  ASSERT_EQ(kNumPackets, output_packets.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(Timestamp(i), output_packets[i].Timestamp());
+    EXPECT_EQ(i + 1, output_packets[i].Get<int>());
+  }
+  EXPECT_GT(ContractParallelPlusOneCalculator::max_observed_in_flight_, 1);
+  EXPECT_LE(ContractParallelPlusOneCalculator::max_observed_in_flight_,
+            ContractParallelPlusOneCalculator::kMaxInFlight);
+}
+
+TEST(ContractMaxInFlightTest, GraphMaxInFlightTakesPriority) {
+  constexpr int kNumPackets = 10;
+  std::vector<Packet> output_packets =
+      RunContractParallelGraph("max_in_flight: 1", kNumPackets);
+  ASSERT_EQ(kNumPackets, output_packets.size());
+  EXPECT_EQ(1, ContractParallelPlusOneCalculator::max_observed_in_flight_);
+}
+
+// Fails Process() of DeferredPlusOneCalculator after it deferred completion.
+constexpr int kProcessFailure = -100;
+
+// Adds one to its input on a thread of its own, and completes its Process()
+// calls from there. The work of an invocation only starts once BATCH_SIZE
+// invocations are waiting, so with a BATCH_SIZE above 1 the graph only runs
+// if Process() returns before its invocation completes. Negative inputs fail,
+// and kProcessFailure fails Process() without ever completing the invocation.
+class DeferredPlusOneCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    cc->InputSidePackets().Tag("BATCH_SIZE").Set<int>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override {
+    cc->SetOffset(mediapipe::TimestampDiff(0));
+    batch_size_ = cc->InputSidePackets().Tag("BATCH_SIZE").Get<int>();
+    worker_ = absl::make_unique<ThreadPool>("deferred_plus_one", 1);
+    worker_->StartWorkers();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    CalculatorContext::CompletionCallback done = cc->DeferCompletion();
+    if (cc->Inputs().Index(0).Get<int>() == kProcessFailure) {
+      return ::mediapipe::InternalError("failed to start the work");
+    }
+    std::vector<std::function<void()>> batch;
+    {
+      absl::MutexLock lock(&mutex_);
+      waiting_.push_back([cc, done]() {
+        const int value = cc->Inputs().Index(0).Get<int>();
+        if (value < 0) {
+          done(::mediapipe::InvalidArgumentError("negative input"));
+          return;
+        }
+        cc->Outputs().Index(0).Add(new int(value + 1), cc->InputTimestamp());
+        done(::mediapipe::OkStatus());
+      });
+      if (waiting_.size() < batch_size_) {
+        return ::mediapipe::OkStatus();
+      }
+      batch.swap(waiting_);
+    }
+    worker_->Schedule([batch]() {
+      for (const auto& work : batch) {
+        work();
+      }
+    });
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Close(CalculatorContext* cc) override {
+    absl::MutexLock lock(&mutex_);
+    RET_CHECK(waiting_.empty());
+    return ::mediapipe::OkStatus();
+  }
+
+ private:
+  int batch_size_ = 1;
+  std::unique_ptr<ThreadPool> worker_;
+  absl::Mutex mutex_;
+  std::vector<std::function<void()>> waiting_ GUARDED_BY(mutex_);
+};
+
+REGISTER_CALCULATOR(DeferredPlusOneCalculator);
+
+// Runs |inputs| through a DeferredPlusOneCalculator on a graph with a single
+// executor thread, and stores the outputs in |output_packets|.
+::mediapipe::Status RunDeferredGraph(int max_in_flight, int batch_size,
+                                     const std::vector<int>& inputs,
+                                     std::vector<Packet>* output_packets) {
+  CalculatorGraphConfig graph_config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrCat(
+          R"(
+            input_stream: "input"
+            node {
+              calculator: "DeferredPlusOneCalculator"
+              input_stream: "input"
+              output_stream: "output"
+              input_side_packet: "BATCH_SIZE:batch_size"
+              max_in_flight: )",
+          max_in_flight, R"(
+            }
+            num_threads: 1
+          )"));
+  CalculatorGraph graph(graph_config);
+  MP_RETURN_IF_ERROR(graph.ObserveOutputStream(
+      "output", [output_packets](const Packet& packet) {
+        output_packets->push_back(packet);
+        return ::mediapipe::OkStatus();
+      }));
+  MP_RETURN_IF_ERROR(
+      graph.StartRun({{"batch_size", MakePacket<int>(batch_size)}}));
+  for (int i = 0; i < inputs.size(); ++i) {
+    MP_RETURN_IF_ERROR(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(inputs[i]).At(Timestamp(i))));
+  }
+  MP_RETURN_IF_ERROR(graph.CloseAllInputStreams());
+  return graph.WaitUntilDone();
+}
+
+TEST(DeferredCompletionTest, CompletesInvocationsInTimestampOrder) {
+  constexpr int kNumPackets = 20;
+  std::vector<int> inputs(kNumPackets);
+  std::iota(inputs.begin(), inputs.end(), 0);
+  std::vector<Packet> output_packets;
+  MP_ASSERT_OK(RunDeferredGraph(/*max_in_flight=*/1, /*batch_size=*/1, inputs,
+                                &output_packets));
+  ASSERT_EQ(kNumPackets, output_packets.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(Timestamp(i), output_packets[i].Timestamp());
+    EXPECT_EQ(i + 1, output_packets[i].Get<int>());
+  }
+}
+
+// Each group of 4 invocations waits on one executor thread until the last of
+// them has run Process(). The node is closed only after all of them complete.
+TEST(DeferredCompletionTest, KeepsSeveralInvocationsWaiting) {
+  constexpr int kNumPackets = 12;
+  std::vector<int> inputs(kNumPackets);
+  std::iota(inputs.begin(), inputs.end(), 0);
+  std::vector<Packet> output_packets;
+  MP_ASSERT_OK(RunDeferredGraph(/*max_in_flight=*/5, /*batch_size=*/4, inputs,
+                                &output_packets));
+  ASSERT_EQ(kNumPackets, output_packets.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(Timestamp(i), output_packets[i].Timestamp());
+    EXPECT_EQ(i + 1, output_packets[i].Get<int>());
+  }
+}
+
+TEST(DeferredCompletionTest, ReportsCompletionErrors) {
+  std::vector<Packet> output_packets;
+  ::mediapipe::Status status = RunDeferredGraph(
+      /*max_in_flight=*/1, /*batch_size=*/1, {0, -1, 2}, &output_packets);
+  EXPECT_THAT(status.message(), testing::HasSubstr("negative input"));
+  ASSERT_GE(output_packets.size(), 1);
+  EXPECT_EQ(1, output_packets[0].Get<int>());
+}
+
+// The failed invocation must not keep the graph waiting for its callback.
+TEST(DeferredCompletionTest, CompletesInvocationsThatFailInProcess) {
+  std::vector<Packet> output_packets;
+  ::mediapipe::Status status =
+      RunDeferredGraph(/*max_in_flight=*/1, /*batch_size=*/1,
+                       {0, kProcessFailure, 2}, &output_packets);
+  EXPECT_THAT(status.message(), testing::HasSubstr("failed to start the work"));
+  ASSERT_GE(output_packets.size(), 1);
+  EXPECT_EQ(1, output_packets[0].Get<int>());
+}
+
+// Lets the Open() calls of several nodes wait for each other.
+struct OpenRendezvous {
+  explicit OpenRendezvous(int num_nodes) : num_nodes(num_nodes) {}
+  bool AllArrived() const EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    return num_arrived == num_nodes;
+  }
+
+  const int num_nodes;
+  absl::Mutex mutex;
+  int num_arrived GUARDED_BY(mutex) = 0;
+};
+
+// Passes its input through. Open() fails unless the Open() of every node
+// sharing its RENDEZVOUS runs at the same time.
+class OpenRendezvousCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).SetSameAs(&cc->Inputs().Index(0));
+    cc->InputSidePackets().Tag("RENDEZVOUS").Set<OpenRendezvous*>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override {
+    cc->SetOffset(mediapipe::TimestampDiff(0));
+    OpenRendezvous* rendezvous =
+        cc->InputSidePackets().Tag("RENDEZVOUS").Get<OpenRendezvous*>();
+    absl::MutexLock lock(&rendezvous->mutex);
+    ++rendezvous->num_arrived;
+    RET_CHECK(rendezvous->mutex.AwaitWithTimeout(
+        absl::Condition(rendezvous, &OpenRendezvous::AllArrived),
+        absl::Seconds(10)))
+        << "The other nodes did not open concurrently.";
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return ::mediapipe::OkStatus();
+  }
+};
+
+REGISTER_CALCULATOR(OpenRendezvousCalculator);
+
+// The nodes of a chain open before the nodes upstream of them have opened,
+// and the profiler reports when each of them finished opening.
+TEST(ConcurrentOpenTest, OpensChainedNodesConcurrently) {
+  constexpr int kNumNodes = 3;
+  constexpr int kNumPackets = 10;
+  CalculatorGraphConfig graph_config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "input"
+        node {
+          calculator: "OpenRendezvousCalculator"
+          input_stream: "input"
+          output_stream: "stream_1"
+          input_side_packet: "RENDEZVOUS:rendezvous"
+        }
+        node {
+          calculator: "OpenRendezvousCalculator"
+          input_stream: "stream_1"
+          output_stream: "stream_2"
+          input_side_packet: "RENDEZVOUS:rendezvous"
+        }
+        node {
+          calculator: "OpenRendezvousCalculator"
+          input_stream: "stream_2"
+          output_stream: "output"
+          input_side_packet: "RENDEZVOUS:rendezvous"
+        }
+        num_threads: 3
+        open_nodes_concurrently: true
+        profiler_config { enable_profiler: true trace_log_disabled: true }
+      )");
+  CalculatorGraph graph(graph_config);
+  std::vector<Packet> output_packets;
+  MP_ASSERT_OK(
+      graph.ObserveOutputStream("output", [&output_packets](const Packet& p) {
+        output_packets.push_back(p);
+        return ::mediapipe::OkStatus();
+      }));
+  OpenRendezvous rendezvous(kNumNodes);
+  MP_ASSERT_OK(graph.StartRun(
+      {{"rendezvous", MakePacket<OpenRendezvous*>(&rendezvous)}}));
+  for (int i = 0; i < kNumPackets; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+
+  ASSERT_EQ(kNumPackets, output_packets.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(i, output_packets[i].Get<int>());
+  }
+  std::vector<CalculatorProfile> profiles;
+  MP_ASSERT_OK(graph.profiler()->GetCalculatorProfiles(&profiles));
+  ASSERT_EQ(kNumNodes, profiles.size());
+  for (const CalculatorProfile& profile : profiles) {
+    EXPECT_TRUE(profile.has_open_latency()) << profile.name();
+    EXPECT_GE(profile.open_latency(), profile.open_runtime()) << profile.name();
+  }
+}
+
+// Returns a graph with an input stream "input" feeding |num_branches| chains
+// of |chain_length| PassThroughCalculators, whose outputs are "output_<i>".
+CalculatorGraphConfig PassThroughGraphConfig(int num_branches,
+                                             int chain_length, int num_threads,
+                                             int num_queue_shards) {
+  CalculatorGraphConfig config;
+  config.add_input_stream("input");
+  ExecutorConfig* executor = config.add_executor();
+  executor->set_num_queue_shards(num_queue_shards);
+  executor->mutable_options()
+      ->MutableExtension(ThreadPoolExecutorOptions::ext)
+      ->set_num_threads(num_threads);
+  for (int b = 0; b < num_branches; ++b) {
+    std::string stream = "input";
+    for (int n = 0; n < chain_length; ++n) {
+      CalculatorGraphConfig::Node* node = config.add_node();
+      node->set_calculator("PassThroughCalculator");
+      node->add_input_stream(stream);
+      stream = n + 1 < chain_length ? absl::StrCat("branch_", b, "_", n)
+                                    : absl::StrCat("output_", b);
+      node->add_output_stream(stream);
+    }
+  }
+  return config;
+}
+
+TEST(ShardedSchedulerQueueTest, PassThroughGraphDeliversAllPackets) {
+  constexpr int kNumBranches = 8;
+  constexpr int kNumPackets = 100;
+  CalculatorGraph graph(PassThroughGraphConfig(kNumBranches, /*chain_length=*/5,
+                                               /*num_threads=*/4,
+                                               /*num_queue_shards=*/4));
+  std::vector<std::vector<Timestamp>> timestamps(kNumBranches);
+  for (int b = 0; b < kNumBranches; ++b) {
+    MP_ASSERT_OK(graph.ObserveOutputStream(
+        absl::StrCat("output_", b), [&timestamps, b](const Packet& packet) {
+          timestamps[b].push_back(packet.Timestamp());
+          return ::mediapipe::OkStatus();
+        }));
+  }
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < kNumPackets; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+
+  for (int b = 0; b < kNumBranches; ++b) {
+    ASSERT_EQ(kNumPackets, timestamps[b].size());
+    for (int i = 0; i < kNumPackets; ++i) {
+      EXPECT_EQ(Timestamp(i), timestamps[b][i]);
+    }
+  }
+}
+
+constexpr int kBenchmarkNumBranches = 20;
+constexpr int kBenchmarkChainLength = 10;
+
+// Sends packets through the 200 PassThroughCalculators (20 chains of 10) of
+// "config", and reports the number of node invocations per second.
+void RunPassThroughGraphBenchmark(benchmark::State& state,
+                                  const CalculatorGraphConfig& config) {
+  constexpr int kNumPackets = 100;
+  CalculatorGraph graph(config);
+  std::atomic<int> num_outputs(0);
+  for (int b = 0; b < kBenchmarkNumBranches; ++b) {
+    MEDIAPIPE_CHECK_OK(graph.ObserveOutputStream(
+        absl::StrCat("output_", b), [&num_outputs](const Packet&) {
+          ++num_outputs;
+          return ::mediapipe::OkStatus();
+        }));
+  }
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+    for (int i = 0; i < kNumPackets; ++i) {
+      MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+          "input", MakePacket<int>(i).At(Timestamp(i))));
+    }
+    MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  }
+  CHECK_EQ(state.iterations() * kBenchmarkNumBranches * kNumPackets,
+           num_outputs);
+  state.counters["tasks_per_sec"] = benchmark::Counter(
+      state.iterations() * kBenchmarkNumBranches * kBenchmarkChainLength *
+          kNumPackets,
+      benchmark::Counter::kIsRate);
+}
+
+// state.range(0) is the number of threads and state.range(1) the number of
+// scheduler queue shards.
+void BM_PassThroughGraph(benchmark::State& state) {
+  RunPassThroughGraphBenchmark(
+      state, PassThroughGraphConfig(kBenchmarkNumBranches,
+                                    kBenchmarkChainLength, state.range(0),
+                                    state.range(1)));
+}
+
+BENCHMARK(BM_PassThroughGraph)
+    ->ArgPair(4, 1)
+    ->ArgPair(4, 4)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 16)
+    ->UseRealTime();
+
+// Runs the graph of BM_PassThroughGraph on a work-stealing executor with
+// state.range(0) threads placed by the ProcessorAffinity state.range(1). On a
+// multi-socket machine, the throughput difference between ANY_PROCESSOR and
+// NUMA_NODE measures the cost of packets crossing sockets.
+void BM_PassThroughGraphProcessorAffinity(benchmark::State& state) {
+  CalculatorGraphConfig config =
+      PassThroughGraphConfig(kBenchmarkNumBranches, kBenchmarkChainLength,
+                             state.range(0), /*num_queue_shards=*/1);
+  ThreadPoolExecutorOptions* options =
+      config.mutable_executor(0)->mutable_options()->MutableExtension(
+          ThreadPoolExecutorOptions::ext);
+  options->set_scheduling_policy(ThreadPoolExecutorOptions::WORK_STEALING);
+  options->set_processor_affinity(
+      static_cast<ThreadPoolExecutorOptions::ProcessorAffinity>(
+          state.range(1)));
+  RunPassThroughGraphBenchmark(state, config);
+}
+
+BENCHMARK(BM_PassThroughGraphProcessorAffinity)
+    ->ArgPair(16, ThreadPoolExecutorOptions::ANY_PROCESSOR)
+    ->ArgPair(16, ThreadPoolExecutorOptions::NUMA_NODE)
+    ->ArgPair(16, ThreadPoolExecutorOptions::CACHE_DOMAIN)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
@@ -20,16 +20,31 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <random>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "mediapipe/framework/port/logging.h"
 
 namespace mediapipe {
 
+namespace {
+
+// Number of rounds an idle work-stealing worker polls the other queues
+// before it parks on the pool's condition variable.
+constexpr int kMaxSpinRounds = 64;
+
+// The pool and worker index of the worker running on the current thread.
+// Lets Schedule() push callbacks onto the calling worker's own queue.
+thread_local const void* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+}  // namespace
+
 class ThreadPool::WorkerThread {
  public:
-  // Creates and starts a thread that runs pool->RunWorker().
-  WorkerThread(ThreadPool* pool, const std::string& name_prefix);
+  // Creates and starts a thread that runs pool->RunWorker(index).
+  WorkerThread(ThreadPool* pool, const std::string& name_prefix, int index);
 
   // REQUIRES: Join() must have been called.
   ~WorkerThread();
@@ -42,12 +57,14 @@ class ThreadPool::WorkerThread {
 
   ThreadPool* pool_;
   std::string name_prefix_;
+  int index_;
   pthread_t thread_;
 };
 
 ThreadPool::WorkerThread::WorkerThread(ThreadPool* pool,
-                                       const std::string& name_prefix)
-    : pool_(pool), name_prefix_(name_prefix) {
+                                       const std::string& name_prefix,
+                                       int index)
+    : pool_(pool), name_prefix_(name_prefix), index_(index) {
   pthread_create(&thread_, nullptr, ThreadBody, this);
 }
 
@@ -59,7 +76,8 @@ void* ThreadPool::WorkerThread::ThreadBody(void* arg) {
   auto thread = reinterpret_cast<WorkerThread*>(arg);
   int nice_priority_level =
       thread->pool_->thread_options().nice_priority_level();
-  const std::set<int> selected_cpus = thread->pool_->thread_options().cpu_set();
+  const std::set<int> selected_cpus =
+      thread->pool_->WorkerCpuSet(thread->index_);
   const std::string name =
       internal::CreateThreadName(thread->name_prefix_, syscall(SYS_gettid));
 #if defined(__linux__)
@@ -105,7 +123,7 @@ void* ThreadPool::WorkerThread::ThreadBody(void* arg) {
                << "Failed to set name for thread: " << name;
   }
 #endif
-  thread->pool_->RunWorker();
+  thread->pool_->RunWorker(thread->index_);
   return nullptr;
 }
 
@@ -124,6 +142,22 @@ ThreadPool::ThreadPool(const ThreadOptions& thread_options,
   num_threads_ = (num_threads == 0) ? 1 : num_threads;
 }
 
+ThreadPool::ThreadPool(const ThreadOptions& thread_options,
+                       const std::string& name_prefix, int num_threads,
+                       SchedulingPolicy scheduling_policy)
+    : name_prefix_(name_prefix),
+      scheduling_policy_(scheduling_policy),
+      thread_options_(thread_options) {
+  num_threads_ = (num_threads == 0) ? 1 : num_threads;
+  // The queues exist before the workers so that Schedule() can be called
+  // before StartWorkers(), as with kSharedQueue.
+  if (scheduling_policy_ == SchedulingPolicy::kWorkStealing) {
+    for (int i = 0; i < num_threads_; ++i) {
+      local_queues_.emplace_back(new LocalQueue);
+    }
+  }
+}
+
 ThreadPool::~ThreadPool() {
   mutex_.Lock();
   stopped_ = true;
@@ -138,22 +172,71 @@ ThreadPool::~ThreadPool() {
   threads_.clear();
 }
 
+void ThreadPool::SetWorkerGroups(std::vector<std::set<int>> cpu_sets) {
+  CHECK(threads_.empty()) << "SetWorkerGroups() after StartWorkers().";
+  worker_cpu_sets_ = std::move(cpu_sets);
+}
+
 void ThreadPool::StartWorkers() {
   for (int i = 0; i < num_threads_; ++i) {
-    threads_.push_back(new WorkerThread(this, name_prefix_));
+    threads_.push_back(new WorkerThread(this, name_prefix_, i));
   }
 }
 
 void ThreadPool::Schedule(std::function<void()> callback) {
-  mutex_.Lock();
-  tasks_.push_back(std::move(callback));
-  condition_.Signal();
-  mutex_.Unlock();
+  if (scheduling_policy_ == SchedulingPolicy::kSharedQueue) {
+    mutex_.Lock();
+    tasks_.push_back(std::move(callback));
+    condition_.Signal();
+    mutex_.Unlock();
+    return;
+  }
+
+  // Callbacks scheduled by a worker stay on that worker's queue, where they
+  // are likely to find their inputs still in cache.  Other threads spread
+  // their callbacks over the workers round-robin.
+  int index = CurrentWorkerIndex();
+  if (index < 0) {
+    index = next_queue_.fetch_add(1, std::memory_order_relaxed) % num_threads_;
+  }
+  LocalQueue* queue = local_queues_[index].get();
+  queue->mutex.Lock();
+  queue->tasks.push_back(std::move(callback));
+  queue->mutex.Unlock();
+
+  // Pairs with the increment of num_parked_workers_ in
+  // RunWorkStealingWorker: either the parking worker sees the new task or we
+  // see the parked worker and wake it up.
+  num_pending_tasks_.fetch_add(1, std::memory_order_seq_cst);
+  if (num_parked_workers_.load(std::memory_order_seq_cst) > 0) {
+    mutex_.Lock();
+    condition_.Signal();
+    mutex_.Unlock();
+  }
 }
 
 int ThreadPool::num_threads() const { return num_threads_; }
 
-void ThreadPool::RunWorker() {
+int ThreadPool::worker_group(int worker_index) const {
+  return worker_cpu_sets_.empty() ? 0 : worker_index % worker_cpu_sets_.size();
+}
+
+const std::set<int>& ThreadPool::WorkerCpuSet(int worker_index) const {
+  if (worker_cpu_sets_.empty()) {
+    return thread_options_.cpu_set();
+  }
+  return worker_cpu_sets_[worker_group(worker_index)];
+}
+
+void ThreadPool::RunWorker(int worker_index) {
+  if (scheduling_policy_ == SchedulingPolicy::kWorkStealing) {
+    RunWorkStealingWorker(worker_index);
+  } else {
+    RunSharedQueueWorker();
+  }
+}
+
+void ThreadPool::RunSharedQueueWorker() {
   mutex_.Lock();
   while (true) {
     if (!tasks_.empty()) {
@@ -173,6 +256,88 @@ void ThreadPool::RunWorker() {
   mutex_.Unlock();
 }
 
+void ThreadPool::RunWorkStealingWorker(int worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  std::minstd_rand rng(worker_index + 1);
+  std::uniform_int_distribution<int> victim_dist(0, num_threads_ - 1);
+
+  int idle_rounds = 0;
+  while (true) {
+    std::function<void()> task;
+    if (TryGetTask(worker_index, victim_dist(rng), &task)) {
+      num_pending_tasks_.fetch_sub(1, std::memory_order_relaxed);
+      idle_rounds = 0;
+      task();
+      continue;
+    }
+    if (++idle_rounds < kMaxSpinRounds) {
+      sched_yield();
+      continue;
+    }
+    idle_rounds = 0;
+
+    mutex_.Lock();
+    num_parked_workers_.fetch_add(1, std::memory_order_seq_cst);
+    while (!stopped_ &&
+           num_pending_tasks_.load(std::memory_order_seq_cst) == 0) {
+      condition_.Wait(&mutex_);
+    }
+    num_parked_workers_.fetch_sub(1, std::memory_order_relaxed);
+    const bool done =
+        stopped_ && num_pending_tasks_.load(std::memory_order_seq_cst) == 0;
+    mutex_.Unlock();
+    if (done) {
+      break;
+    }
+  }
+
+  current_pool = nullptr;
+  current_worker_index = -1;
+}
+
+int ThreadPool::CurrentWorkerIndex() const {
+  return current_pool == this ? current_worker_index : -1;
+}
+
+bool ThreadPool::TryGetTask(int worker_index, int first_victim,
+                            std::function<void()>* task) {
+  {
+    LocalQueue* own = local_queues_[worker_index].get();
+    absl::MutexLock lock(&own->mutex);
+    if (!own->tasks.empty()) {
+      *task = std::move(own->tasks.back());
+      own->tasks.pop_back();
+      return true;
+    }
+  }
+  // Without worker groups, the first pass tries every victim.
+  const int group = worker_group(worker_index);
+  const int num_passes = worker_cpu_sets_.size() > 1 ? 2 : 1;
+  for (int pass = 0; pass < num_passes; ++pass) {
+    for (int i = 0; i < num_threads_; ++i) {
+      const int victim = (first_victim + i) % num_threads_;
+      if (victim == worker_index ||
+          (num_passes > 1 && (worker_group(victim) == group) != (pass == 0))) {
+        continue;
+      }
+      LocalQueue* queue = local_queues_[victim].get();
+      // Don't wait for a busy victim; another one may be free.
+      if (!queue->mutex.TryLock()) {
+        continue;
+      }
+      if (!queue->tasks.empty()) {
+        *task = std::move(queue->tasks.front());
+        queue->tasks.pop_front();
+        queue->mutex.Unlock();
+        return true;
+      }
+      queue->mutex.Unlock();
+    }
+  }
+  return false;
+}
+
 const ThreadOptions& ThreadPool::thread_options() const {
   return thread_options_;
 }
@@ -15,8 +15,11 @@
 #ifndef MEDIAPIPE_DEPS_THREADPOOL_H_
 #define MEDIAPIPE_DEPS_THREADPOOL_H_
 
+#include <atomic>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -31,6 +34,19 @@ namespace mediapipe {
 //
 // The thread pool is shut down when the pool is destroyed.
 //
+// By default all threads share a single queue of callbacks.  A pool created
+// with SchedulingPolicy::kWorkStealing instead gives every worker its own
+// deque: callbacks scheduled from a worker thread go to that worker's deque
+// and are popped in LIFO order, idle workers steal the oldest callbacks from
+// randomly chosen victims, and workers spin briefly before parking.  This
+// avoids contention on a single lock when many threads schedule short tasks.
+//
+// On machines with several NUMA nodes or cache domains, SetWorkerGroups()
+// pins the workers to groups of CPUs. Work-stealing workers then steal from
+// the workers of their own group before the others, so that tasks and the
+// data they touch tend to stay on one node. Tasks are not bound to a group:
+// a worker steals from the other groups when its own has no queued tasks.
+//
 // Sample usage:
 //
 // {
@@ -43,6 +59,14 @@ namespace mediapipe {
 //
 class ThreadPool {
  public:
+  // How scheduled callbacks are distributed among the worker threads.
+  enum class SchedulingPolicy {
+    // All workers pull callbacks from one mutex-guarded FIFO queue.
+    kSharedQueue,
+    // Every worker owns a deque and idle workers steal from the others.
+    kWorkStealing,
+  };
+
   // Create a thread pool that provides a concurrency of "num_threads"
   // threads. I.e., if "num_threads" items are added, they are all
   // guaranteed to run concurrently without excessive delay.
@@ -64,39 +88,92 @@ class ThreadPool {
   ThreadPool(const ThreadOptions& thread_options,
              const std::string& name_prefix, int num_threads);
 
+  // Like the constructor above, except that callbacks are distributed among
+  // the worker threads according to "scheduling_policy".
+  ThreadPool(const ThreadOptions& thread_options,
+             const std::string& name_prefix, int num_threads,
+             SchedulingPolicy scheduling_policy);
+
   // Waits for closures (if any) to complete. May be called without
   // having called StartWorkers().
   ~ThreadPool();
 
+  // REQUIRES: StartWorkers has not been called
+  // Splits the workers into groups, one per element of "cpu_sets": worker i
+  // joins group i % cpu_sets.size() and only runs on the CPUs of that group,
+  // in place of thread_options().cpu_set().
+  void SetWorkerGroups(std::vector<std::set<int>> cpu_sets);
+
   // REQUIRES: StartWorkers has not been called
   // Actually start the worker threads.
   void StartWorkers();
 
-  // REQUIRES: StartWorkers has been called
   // Add specified callback to queue of pending callbacks.  Eventually a
-  // thread will pull this callback off the queue and execute it.
+  // thread will pull this callback off the queue and execute it.  Callbacks
+  // scheduled before StartWorkers() run once the workers start.
   void Schedule(std::function<void()> callback);
 
   // Provided for debugging and testing only.
   int num_threads() const;
 
+  // Returns the group of worker "worker_index", or 0 without worker groups.
+  int worker_group(int worker_index) const;
+
   // Standard thread options.  Use this accessor to get them.
   const ThreadOptions& thread_options() const;
 
+  SchedulingPolicy scheduling_policy() const { return scheduling_policy_; }
+
  private:
   class WorkerThread;
-  void RunWorker();
+
+  // The deque owned by one worker in the kWorkStealing policy.  The owner
+  // pushes and pops at the back, thieves take from the front.
+  struct LocalQueue {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks GUARDED_BY(mutex);
+  };
+
+  void RunWorker(int worker_index);
+  void RunSharedQueueWorker();
+  void RunWorkStealingWorker(int worker_index);
+
+  // Returns the index of the worker of this pool running on the calling
+  // thread, or -1 if the calling thread is not one of its workers.
+  int CurrentWorkerIndex() const;
+
+  // Returns the CPUs worker "worker_index" may run on; empty for any CPU.
+  const std::set<int>& WorkerCpuSet(int worker_index) const;
+
+  // Pops a callback from the back of the local queue of "worker_index", or
+  // steals one from the front of another worker's queue, starting at
+  // "first_victim" and trying the workers of the same group first.  Returns
+  // false if every queue was found empty.
+  bool TryGetTask(int worker_index, int first_victim,
+                  std::function<void()>* task);
 
   std::string name_prefix_;
   std::vector<WorkerThread*> threads_;
   int num_threads_;
+  SchedulingPolicy scheduling_policy_ = SchedulingPolicy::kSharedQueue;
 
   absl::Mutex mutex_;
   absl::CondVar condition_;
   bool stopped_ GUARDED_BY(mutex_) = false;
   std::deque<std::function<void()>> tasks_ GUARDED_BY(mutex_);
 
+  // Used only by the kWorkStealing policy.
+  std::vector<std::unique_ptr<LocalQueue>> local_queues_;
+  // Number of callbacks scheduled but not yet picked up by a worker.
+  std::atomic<int> num_pending_tasks_{0};
+  // Number of workers parked (or about to park) on condition_.
+  std::atomic<int> num_parked_workers_{0};
+  // Spreads callbacks scheduled from non-worker threads over the workers.
+  std::atomic<unsigned int> next_queue_{0};
+
   ThreadOptions thread_options_;
+  // The CPU sets of the worker groups set by SetWorkerGroups(), if any.
+  std::vector<std::set<int>> worker_cpu_sets_;
 };
 
 namespace internal {
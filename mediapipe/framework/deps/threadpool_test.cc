@@ -14,9 +14,18 @@
 
 #include "mediapipe/framework/deps/threadpool.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <atomic>
 #include <set>
+#include <vector>
 
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gtest.h"
 
 namespace mediapipe {
@@ -91,6 +100,116 @@ TEST(ThreadPoolTest, CreateWithCPUAffinity) {
   thread_pool.StartWorkers();
 }
 
+TEST(ThreadPoolTest, WorkStealingMultiThreads) {
+  std::atomic<int> n(1000);
+  {
+    ThreadPool thread_pool(ThreadOptions(), "testpool", 8,
+                           ThreadPool::SchedulingPolicy::kWorkStealing);
+    ASSERT_EQ(8, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 1000; ++i) {
+      thread_pool.Schedule([&n]() { --n; });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+TEST(ThreadPoolTest, WorkStealingScheduleFromWorkers) {
+  // Each task schedules two children from its worker thread, so that most
+  // tasks land on the local queues and have to be stolen to keep all
+  // workers busy.
+  constexpr int kDepth = 10;
+  std::atomic<int> n(0);
+  {
+    ThreadPool thread_pool(ThreadOptions(), "testpool", 4,
+                           ThreadPool::SchedulingPolicy::kWorkStealing);
+    thread_pool.StartWorkers();
+
+    std::function<void(int)> spawn = [&](int depth) {
+      ++n;
+      if (depth < kDepth) {
+        thread_pool.Schedule([&spawn, depth]() { spawn(depth + 1); });
+        thread_pool.Schedule([&spawn, depth]() { spawn(depth + 1); });
+      }
+    };
+    thread_pool.Schedule([&spawn]() { spawn(0); });
+    // Wait for all tasks to finish before spawn goes out of scope.
+    while (n < (1 << (kDepth + 1)) - 1) {
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+  }
+
+  EXPECT_EQ((1 << (kDepth + 1)) - 1, n);
+}
+
+TEST(ThreadPoolTest, WorkStealingDestroyWithoutStart) {
+  ThreadPool thread_pool(ThreadOptions(), "testpool", 10,
+                         ThreadPool::SchedulingPolicy::kWorkStealing);
+}
+
+TEST(ThreadPoolTest, WorkStealingScheduleBeforeStart) {
+  std::atomic<int> n(100);
+  {
+    ThreadPool thread_pool(ThreadOptions(), "testpool", 4,
+                           ThreadPool::SchedulingPolicy::kWorkStealing);
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n]() { --n; });
+    }
+    thread_pool.StartWorkers();
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+#if defined(__linux__)
+TEST(ThreadPoolTest, WorkerGroupsPinWorkers) {
+  cpu_set_t allowed;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+  ASSERT_FALSE(cpus.empty());
+  const std::vector<std::set<int>> groups = {{cpus.front()}, {cpus.back()}};
+
+  absl::Mutex mu;
+  std::set<std::set<int>> observed_cpu_sets;
+  {
+    ThreadPool thread_pool(ThreadOptions(), "testpool", 4,
+                           ThreadPool::SchedulingPolicy::kWorkStealing);
+    thread_pool.SetWorkerGroups(groups);
+    EXPECT_EQ(0, thread_pool.worker_group(0));
+    EXPECT_EQ(1, thread_pool.worker_group(1));
+    EXPECT_EQ(0, thread_pool.worker_group(2));
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&mu, &observed_cpu_sets]() {
+        cpu_set_t cpu_set;
+        EXPECT_EQ(0, sched_getaffinity(0, sizeof(cpu_set), &cpu_set));
+        std::set<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &cpu_set)) {
+            cpus.insert(cpu);
+          }
+        }
+        absl::MutexLock l(&mu);
+        observed_cpu_sets.insert(cpus);
+      });
+    }
+  }
+
+  ASSERT_FALSE(observed_cpu_sets.empty());
+  for (const std::set<int>& cpus : observed_cpu_sets) {
+    EXPECT_TRUE(cpus == groups[0] || cpus == groups[1]);
+  }
+}
+#endif  // defined(__linux__)
+
 TEST(ThreadPoolTest, CreateThreadName) {
   ASSERT_EQ("name_prefix/123", internal::CreateThreadName("name_prefix", 1234));
   ASSERT_EQ("name_prefix/123",
@@ -115,4 +234,75 @@ TEST(ThreadPoolTest, CreateThreadName) {
             internal::CreateThreadName("name_prefix_lon", 1234));
 }
 
+// Schedules state.range(1) small tasks from the benchmark thread and waits
+// for all of them to finish, using a pool of state.range(0) threads.
+void RunScheduleBenchmark(benchmark::State& state,
+                          ThreadPool::SchedulingPolicy scheduling_policy) {
+  const int num_threads = state.range(0);
+  const int num_tasks = state.range(1);
+  ThreadPool thread_pool(ThreadOptions(), "benchpool", num_threads,
+                         scheduling_policy);
+  thread_pool.StartWorkers();
+  for (auto _ : state) {
+    absl::BlockingCounter done(num_tasks);
+    for (int i = 0; i < num_tasks; ++i) {
+      thread_pool.Schedule([&done]() { done.DecrementCount(); });
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * num_tasks);
+}
+
+// Like RunScheduleBenchmark, but the small tasks are scheduled from the
+// worker threads themselves, which is how the MediaPipe scheduler uses the
+// pool.
+void RunFanOutBenchmark(benchmark::State& state,
+                        ThreadPool::SchedulingPolicy scheduling_policy) {
+  const int num_threads = state.range(0);
+  const int tasks_per_thread = state.range(1) / num_threads;
+  ThreadPool thread_pool(ThreadOptions(), "benchpool", num_threads,
+                         scheduling_policy);
+  thread_pool.StartWorkers();
+  for (auto _ : state) {
+    absl::BlockingCounter done(num_threads * tasks_per_thread);
+    for (int t = 0; t < num_threads; ++t) {
+      thread_pool.Schedule([&thread_pool, &done, tasks_per_thread]() {
+        for (int i = 0; i < tasks_per_thread; ++i) {
+          thread_pool.Schedule([&done]() { done.DecrementCount(); });
+        }
+      });
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * num_threads * tasks_per_thread);
+}
+
+void BM_ScheduleSharedQueue(benchmark::State& state) {
+  RunScheduleBenchmark(state, ThreadPool::SchedulingPolicy::kSharedQueue);
+}
+
+void BM_ScheduleWorkStealing(benchmark::State& state) {
+  RunScheduleBenchmark(state, ThreadPool::SchedulingPolicy::kWorkStealing);
+}
+
+void BM_FanOutSharedQueue(benchmark::State& state) {
+  RunFanOutBenchmark(state, ThreadPool::SchedulingPolicy::kSharedQueue);
+}
+
+void BM_FanOutWorkStealing(benchmark::State& state) {
+  RunFanOutBenchmark(state, ThreadPool::SchedulingPolicy::kWorkStealing);
+}
+
+void ThreadPoolBenchmarkArgs(benchmark::internal::Benchmark* b) {
+  for (int num_threads : {1, 4, 16, 32}) {
+    b->Args({num_threads, 10000});
+  }
+  b->UseRealTime();
+}
+
+BENCHMARK(BM_ScheduleSharedQueue)->Apply(ThreadPoolBenchmarkArgs);
+BENCHMARK(BM_ScheduleWorkStealing)->Apply(ThreadPoolBenchmarkArgs);
+BENCHMARK(BM_FanOutSharedQueue)->Apply(ThreadPoolBenchmarkArgs);
+BENCHMARK(BM_FanOutWorkStealing)->Apply(ThreadPoolBenchmarkArgs);
+
 }  // namespace mediapipe
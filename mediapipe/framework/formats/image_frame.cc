@@ -55,6 +55,7 @@ const ImageFrame::Deleter ImageFrame::PixelDataDeleter::kNone = [](uint8* x) {};
 
 const uint32 ImageFrame::kDefaultAlignmentBoundary;
 const uint32 ImageFrame::kGlDefaultAlignmentBoundary;
+const uint32 ImageFrame::kPixelDataAlignmentBoundary;
 
 ImageFrame::ImageFrame()
     : format_(ImageFormat::UNKNOWN), width_(0), height_(0), width_step_(0) {}
@@ -100,19 +101,16 @@ void ImageFrame::Reset(ImageFormat::Format format, int width, int height,
   CHECK_NE(ImageFormat::UNKNOWN, format_);
   CHECK(IsValidAlignmentNumber(alignment_boundary));
   width_step_ = width * NumberOfChannels() * ByteDepth();
-  if (alignment_boundary == 1) {
-    pixel_data_ = {new uint8[height * width_step_],
-                   PixelDataDeleter::kArrayDelete};
-  } else {
-    // Increase width_step_ to the smallest multiple of alignment_boundary
-    // which is large enough to hold all the data.  This is done by
-    // twiddling bits.  alignment_boundary - 1 is a mask which sets all
-    // the low order bits.
-    width_step_ = ((width_step_ - 1) | (alignment_boundary - 1)) + 1;
-    pixel_data_ = {reinterpret_cast<uint8*>(aligned_malloc(height * width_step_,
-                                                           alignment_boundary)),
-                   PixelDataDeleter::kAlignedFree};
-  }
+  // Increase width_step_ to the smallest multiple of alignment_boundary
+  // which is large enough to hold all the data.  This is done by
+  // twiddling bits.  alignment_boundary - 1 is a mask which sets all
+  // the low order bits.
+  width_step_ = ((width_step_ - 1) | (alignment_boundary - 1)) + 1;
+  const uint32 data_alignment =
+      std::max(alignment_boundary, kPixelDataAlignmentBoundary);
+  pixel_data_ = {reinterpret_cast<uint8*>(
+                     aligned_malloc(height * width_step_, data_alignment)),
+                 PixelDataDeleter::kAlignedFree};
 }
 
 void ImageFrame::AdoptPixelData(ImageFormat::Format format, int width,
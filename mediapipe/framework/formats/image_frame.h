@@ -83,6 +83,13 @@ class ImageFrame {
   // and GL_UNPACK_ALIGNMENT parameters.
   static const uint32 kGlDefaultAlignmentBoundary = 4;
 
+  // Pixel data that ImageFrame allocates starts on a boundary of at least
+  // this many bytes, whatever the alignment_boundary of its rows. This is a
+  // cache line and the widest SIMD register (AVX-512), so it also meets
+  // Eigen's EIGEN_MAX_ALIGN_BYTES, which TensorFlow requires of tensors
+  // that point at the pixels.
+  static const uint32 kPixelDataAlignmentBoundary = 64;
+
   // Returns number of channels for an ImageFormat.
   static int NumberOfChannelsForFormat(ImageFormat::Format format);
   // Returns the channel size for an ImageFormat.
@@ -99,7 +106,8 @@ class ImageFrame {
   // Allocate a frame of the appropriate size.  Does not zero it out.
   // Each row will be aligned to alignment_boundary.  alignment_boundary
   // must be a power of 2 (the number 1 is valid, and means the data will
-  // be stored contiguously).
+  // be stored contiguously).  The pixel data starts on a boundary of
+  // kPixelDataAlignmentBoundary or alignment_boundary, whichever is larger.
   ImageFrame(ImageFormat::Format format, int width, int height,
              uint32 alignment_boundary);
   // Same as above, but use kDefaultAlignmentBoundary for alignment_boundary.
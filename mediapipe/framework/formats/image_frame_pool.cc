@@ -0,0 +1,181 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_pool.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+#include <algorithm>
+#include <functional>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the NUMA node of the processor the calling thread runs on, or 0 if
+// it is unknown.
+int CurrentNumaNode() {
+#if defined(__linux__)
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif  // defined(__linux__)
+  return 0;
+}
+
+}  // namespace
+
+const GraphService<ImageFramePool> kImageFramePoolService(
+    "kImageFramePoolService");
+
+size_t ImageFramePool::FrameSpecHash::operator()(const FrameSpec& spec) const {
+  size_t hash = std::hash<int>{}(spec.format);
+  hash = hash * 31 + std::hash<int>{}(spec.width);
+  hash = hash * 31 + std::hash<int>{}(spec.height);
+  hash = hash * 31 + std::hash<uint32>{}(spec.alignment_boundary);
+  return hash * 31 + std::hash<int>{}(spec.numa_node);
+}
+
+// static
+std::shared_ptr<ImageFramePool> ImageFramePool::Create() {
+  return Create(Options());
+}
+
+// static
+std::shared_ptr<ImageFramePool> ImageFramePool::Create(
+    const Options& options) {
+  return std::shared_ptr<ImageFramePool>(new ImageFramePool(options));
+}
+
+ImageFramePool::ImageFramePool(const Options& options) : options_(options) {}
+
+ImageFramePool::~ImageFramePool() { Clear(); }
+
+std::unique_ptr<ImageFrame> ImageFramePool::GetFrame(
+    ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary) {
+  CHECK_NE(ImageFormat::UNKNOWN, format);
+  CHECK(alignment_boundary > 0 &&
+        (alignment_boundary & (alignment_boundary - 1)) == 0)
+      << "Alignment boundary must be a power of 2: " << alignment_boundary;
+  // Same row layout as ImageFrame::Reset().
+  int width_step = width * ImageFrame::NumberOfChannelsForFormat(format) *
+                   ImageFrame::ByteDepthForFormat(format);
+  width_step = ((width_step - 1) | (alignment_boundary - 1)) + 1;
+  const int64 size = static_cast<int64>(height) * width_step;
+  const FrameSpec spec = {format, width, height, alignment_boundary,
+                          CurrentNumaNode()};
+
+  uint8* data = nullptr;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = available_.find(spec);
+    if (it != available_.end() && !it->second.empty()) {
+      // Reuses the most recently returned buffer, which is the most likely to
+      // still be in cache.
+      auto cached = it->second.back();
+      it->second.pop_back();
+      data = cached->data;
+      cached_bytes_ -= cached->size;
+      lru_.erase(cached);
+    }
+  }
+  if (!data) {
+    data = reinterpret_cast<uint8*>(aligned_malloc(
+        size, std::max(alignment_boundary,
+                       ImageFrame::kPixelDataAlignmentBoundary)));
+  }
+
+  std::weak_ptr<ImageFramePool> weak_pool = shared_from_this();
+  auto frame = absl::make_unique<ImageFrame>();
+  frame->AdoptPixelData(
+      format, width, height, width_step, data,
+      [weak_pool, spec, size](uint8* data) {
+        if (auto pool = weak_pool.lock()) {
+          pool->Return(spec, data, size);
+        } else {
+          aligned_free(data);
+        }
+      });
+  return frame;
+}
+
+void ImageFramePool::Return(const FrameSpec& spec, uint8* data, int64 size) {
+  if (size > options_.max_cached_bytes || options_.max_cached_buffers <= 0) {
+    aligned_free(data);
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  available_[spec].push_back(lru_.insert(lru_.end(), {spec, data, size}));
+  cached_bytes_ += size;
+  TrimToLimits();
+}
+
+void ImageFramePool::TrimToLimits() {
+  while (cached_bytes_ > options_.max_cached_bytes ||
+         static_cast<int>(lru_.size()) > options_.max_cached_buffers) {
+    const CachedBuffer& oldest = lru_.front();
+    // The oldest buffer overall is also the oldest one of its spec.
+    auto it = available_.find(oldest.spec);
+    it->second.erase(it->second.begin());
+    if (it->second.empty()) {
+      available_.erase(it);
+    }
+    cached_bytes_ -= oldest.size;
+    aligned_free(oldest.data);
+    lru_.pop_front();
+  }
+}
+
+void ImageFramePool::Clear() {
+  absl::MutexLock lock(&mutex_);
+  for (const CachedBuffer& buffer : lru_) {
+    aligned_free(buffer.data);
+  }
+  lru_.clear();
+  available_.clear();
+  cached_bytes_ = 0;
+}
+
+int ImageFramePool::NumCachedBuffers() {
+  absl::MutexLock lock(&mutex_);
+  return lru_.size();
+}
+
+int64 ImageFramePool::CachedBytes() {
+  absl::MutexLock lock(&mutex_);
+  return cached_bytes_;
+}
+
+std::unique_ptr<ImageFrame> MakeImageFrame(ImageFramePool* pool,
+                                           ImageFormat::Format format,
+                                           int width, int height,
+                                           uint32 alignment_boundary) {
+  if (pool) {
+    return pool->GetFrame(format, width, height, alignment_boundary);
+  }
+  return absl::make_unique<ImageFrame>(format, width, height,
+                                       alignment_boundary);
+}
+
+}  // namespace mediapipe
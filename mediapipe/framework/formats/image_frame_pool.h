@@ -0,0 +1,152 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// ImageFramePool recycles the pixel buffers of ImageFrames, so that CPU
+// graphs producing frames of the same size over and over do not allocate and
+// free them for every frame. It is the CPU counterpart of GpuBufferMultiPool.
+//
+// A frame from the pool owns its pixel data as usual, but destroying it
+// returns the buffer to the pool instead of freeing it. Unused buffers are
+// cached per (format, width, height, alignment boundary); when the cache
+// exceeds its limits, the least recently returned buffers are freed. Frames
+// may outlive the pool, in which case their buffers are simply freed.
+//
+// On Linux, buffers are also cached per NUMA node, and only handed out again
+// on the node of the thread that allocated them. The kernel places the pages
+// of a new buffer on the node that first touches them, so threads pinned to
+// one node (see ThreadPoolExecutorOptions.processor_affinity) keep getting
+// buffers in their local memory.
+//
+// Applications enable pooling for a graph with
+//
+//   graph.SetServiceObject(kImageFramePoolService, ImageFramePool::Create());
+//
+// and calculators that produce ImageFrames opt in with
+//
+//   // In GetContract():
+//   cc->UseService(kImageFramePoolService).Optional();
+//   // In Open():
+//   if (cc->Service(kImageFramePoolService).IsAvailable()) {
+//     image_frame_pool_ = &cc->Service(kImageFramePoolService).GetObject();
+//   }
+//   // In Process():
+//   std::unique_ptr<ImageFrame> output =
+//       MakeImageFrame(image_frame_pool_, format, width, height);
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_POOL_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_POOL_H_
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+class ImageFramePool : public std::enable_shared_from_this<ImageFramePool> {
+ public:
+  struct Options {
+    // The maximum number of bytes held by unused buffers.
+    int64 max_cached_bytes = 256 << 20;
+    // The maximum number of unused buffers.
+    int max_cached_buffers = 32;
+  };
+
+  // Creates a pool. Pools are always owned by a shared_ptr, so that the
+  // buffers' deleters can refer to the pool weakly.
+  static std::shared_ptr<ImageFramePool> Create();
+  static std::shared_ptr<ImageFramePool> Create(const Options& options);
+
+  ~ImageFramePool();
+
+  // Returns a frame with the same layout as
+  // ImageFrame(format, width, height, alignment_boundary). Its pixel data is
+  // a recycled buffer if one is available, and is not initialized.
+  std::unique_ptr<ImageFrame> GetFrame(
+      ImageFormat::Format format, int width, int height,
+      uint32 alignment_boundary = ImageFrame::kDefaultAlignmentBoundary);
+
+  // Frees all unused buffers.
+  void Clear();
+
+  // The number and total size of unused buffers.
+  int NumCachedBuffers();
+  int64 CachedBytes();
+
+ private:
+  struct FrameSpec {
+    ImageFormat::Format format;
+    int width;
+    int height;
+    uint32 alignment_boundary;
+    // The NUMA node the buffer was allocated on.
+    int numa_node;
+
+    bool operator==(const FrameSpec& other) const {
+      return format == other.format && width == other.width &&
+             height == other.height &&
+             alignment_boundary == other.alignment_boundary &&
+             numa_node == other.numa_node;
+    }
+  };
+
+  struct FrameSpecHash {
+    size_t operator()(const FrameSpec& spec) const;
+  };
+
+  struct CachedBuffer {
+    FrameSpec spec;
+    uint8* data;
+    int64 size;
+  };
+
+  explicit ImageFramePool(const Options& options);
+
+  // Takes back a buffer from a destroyed frame.
+  void Return(const FrameSpec& spec, uint8* data, int64 size);
+
+  // Frees the least recently returned buffers until the cache is within
+  // its limits.
+  void TrimToLimits() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+
+  absl::Mutex mutex_;
+  // Unused buffers, least recently returned first.
+  std::list<CachedBuffer> lru_ GUARDED_BY(mutex_);
+  // Unused buffers by spec, in the order they were returned.
+  std::unordered_map<FrameSpec, std::vector<std::list<CachedBuffer>::iterator>,
+                     FrameSpecHash>
+      available_ GUARDED_BY(mutex_);
+  int64 cached_bytes_ GUARDED_BY(mutex_) = 0;
+};
+
+// Returns a frame from `pool`, or a newly allocated one if `pool` is null.
+std::unique_ptr<ImageFrame> MakeImageFrame(
+    ImageFramePool* pool, ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary = ImageFrame::kDefaultAlignmentBoundary);
+
+// Provides a graph-wide ImageFramePool to the calculators that request it.
+extern const GraphService<ImageFramePool> kImageFramePoolService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_POOL_H_
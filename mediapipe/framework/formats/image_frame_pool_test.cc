@@ -0,0 +1,134 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_pool.h"
+
+#include <cstdint>
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(ImageFramePoolTest, FrameLayoutMatchesImageFrame) {
+  auto pool = ImageFramePool::Create();
+  for (ImageFormat::Format format :
+       {ImageFormat::SRGB, ImageFormat::SRGBA, ImageFormat::GRAY8,
+        ImageFormat::GRAY16, ImageFormat::VEC32F1}) {
+    for (uint32 alignment : {1u, 4u, 16u}) {
+      ImageFrame expected(format, 37, 11, alignment);
+      std::unique_ptr<ImageFrame> frame =
+          pool->GetFrame(format, 37, 11, alignment);
+      EXPECT_EQ(expected.Format(), frame->Format());
+      EXPECT_EQ(expected.Width(), frame->Width());
+      EXPECT_EQ(expected.Height(), frame->Height());
+      EXPECT_EQ(expected.WidthStep(), frame->WidthStep());
+      EXPECT_TRUE(frame->IsAligned(alignment));
+      // Both start on the same boundary, whatever the row alignment.
+      for (const ImageFrame* image_frame : {&expected, frame.get()}) {
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(image_frame->PixelData()) %
+                         ImageFrame::kPixelDataAlignmentBoundary);
+      }
+    }
+  }
+}
+
+TEST(ImageFramePoolTest, ReusesReturnedBuffers) {
+  auto pool = ImageFramePool::Create();
+  std::unique_ptr<ImageFrame> frame =
+      pool->GetFrame(ImageFormat::SRGB, 64, 48);
+  const uint8* data = frame->PixelData();
+  EXPECT_EQ(0, pool->NumCachedBuffers());
+
+  frame.reset();
+  EXPECT_EQ(1, pool->NumCachedBuffers());
+  EXPECT_EQ(64 * 48 * 3, pool->CachedBytes());
+
+  frame = pool->GetFrame(ImageFormat::SRGB, 64, 48);
+  EXPECT_EQ(data, frame->PixelData());
+  EXPECT_EQ(0, pool->NumCachedBuffers());
+  EXPECT_EQ(0, pool->CachedBytes());
+
+  // A buffer is only reused for the same spec.
+  std::unique_ptr<ImageFrame> other =
+      pool->GetFrame(ImageFormat::SRGB, 48, 64);
+  EXPECT_NE(data, other->PixelData());
+}
+
+TEST(ImageFramePoolTest, EvictsLeastRecentlyReturnedBuffers) {
+  ImageFramePool::Options options;
+  options.max_cached_buffers = 2;
+  auto pool = ImageFramePool::Create(options);
+  std::unique_ptr<ImageFrame> a = pool->GetFrame(ImageFormat::GRAY8, 16, 16);
+  std::unique_ptr<ImageFrame> b = pool->GetFrame(ImageFormat::GRAY8, 16, 16);
+  std::unique_ptr<ImageFrame> c = pool->GetFrame(ImageFormat::GRAY8, 32, 32);
+  const uint8* b_data = b->PixelData();
+  const uint8* c_data = c->PixelData();
+  a.reset();
+  b.reset();
+  c.reset();
+  // `a` was evicted.
+  EXPECT_EQ(2, pool->NumCachedBuffers());
+  EXPECT_EQ(16 * 16 + 32 * 32, pool->CachedBytes());
+  EXPECT_EQ(b_data, pool->GetFrame(ImageFormat::GRAY8, 16, 16)->PixelData());
+  EXPECT_EQ(c_data, pool->GetFrame(ImageFormat::GRAY8, 32, 32)->PixelData());
+}
+
+TEST(ImageFramePoolTest, RespectsByteLimit) {
+  ImageFramePool::Options options;
+  options.max_cached_bytes = 1000;
+  auto pool = ImageFramePool::Create(options);
+  std::unique_ptr<ImageFrame> small =
+      pool->GetFrame(ImageFormat::GRAY8, 16, 32);
+  std::unique_ptr<ImageFrame> medium =
+      pool->GetFrame(ImageFormat::GRAY8, 16, 48);
+  std::unique_ptr<ImageFrame> large =
+      pool->GetFrame(ImageFormat::GRAY8, 32, 40);
+  large.reset();
+  EXPECT_EQ(0, pool->NumCachedBuffers());
+  small.reset();
+  medium.reset();
+  // Keeping both would exceed the limit, so `small` was evicted.
+  EXPECT_EQ(1, pool->NumCachedBuffers());
+  EXPECT_EQ(16 * 48, pool->CachedBytes());
+
+  pool->Clear();
+  EXPECT_EQ(0, pool->NumCachedBuffers());
+  EXPECT_EQ(0, pool->CachedBytes());
+}
+
+TEST(ImageFramePoolTest, FramesCanOutliveThePool) {
+  auto pool = ImageFramePool::Create();
+  std::unique_ptr<ImageFrame> frame =
+      pool->GetFrame(ImageFormat::SRGBA, 8, 8);
+  pool.reset();
+  frame->SetToZero();
+  frame.reset();
+}
+
+TEST(ImageFramePoolTest, MakeImageFrameWithoutPool) {
+  std::unique_ptr<ImageFrame> frame =
+      MakeImageFrame(nullptr, ImageFormat::SRGB, 10, 10);
+  EXPECT_EQ(ImageFormat::SRGB, frame->Format());
+  EXPECT_EQ(10, frame->Width());
+  EXPECT_EQ(10, frame->Height());
+  EXPECT_EQ(ImageFrame(ImageFormat::SRGB, 10, 10).WidthStep(),
+            frame->WidthStep());
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,246 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/graph_pool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/tool/validate_name.h"
+
+namespace mediapipe {
+
+struct GraphPool::Instance {
+  std::unique_ptr<CalculatorGraph> graph;
+  // True from the start of the graph run until it is stopped.
+  bool running = false;
+  // The timestamp of the next request.
+  Timestamp next_timestamp = Timestamp(0);
+
+  absl::Mutex mutex;
+  // The packets produced by the current request.
+  std::map<std::string, Packet> outputs GUARDED_BY(mutex);
+};
+
+// static
+::mediapipe::StatusOr<std::unique_ptr<GraphPool>> GraphPool::Create(
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+    const Options& options) {
+  RET_CHECK(validated_graph && validated_graph->Initialized());
+  RET_CHECK_GE(options.num_graphs, 1);
+  // A source node would run outside of requests, and a back edge would
+  // carry packets of one request into the next.
+  const CalculatorGraphConfig& config = validated_graph->Config();
+  const auto& calculator_infos = validated_graph->CalculatorInfos();
+  for (int i = 0; i < calculator_infos.size(); ++i) {
+    if (calculator_infos[i].InputStreamTypes().NumEntries() == 0) {
+      return ::mediapipe::InvalidArgumentError(absl::StrCat(
+          "GraphPool does not support source nodes, but node \"",
+          CanonicalNodeName(config, i), "\" has no input streams."));
+    }
+  }
+  for (const EdgeInfo& edge_info : validated_graph->InputStreamInfos()) {
+    if (edge_info.back_edge) {
+      return ::mediapipe::InvalidArgumentError(absl::StrCat(
+          "GraphPool does not support back edges, but input stream \"",
+          edge_info.name, "\" of node \"",
+          CanonicalNodeName(config, edge_info.parent_node.index),
+          "\" is one."));
+    }
+  }
+  std::unique_ptr<GraphPool> pool(
+      new GraphPool(std::move(validated_graph), options));
+  for (const std::string& input_stream :
+       pool->validated_graph_->Config().input_stream()) {
+    std::string tag;
+    std::string name;
+    MP_RETURN_IF_ERROR(tool::ParseTagAndName(input_stream, &tag, &name));
+    pool->input_streams_.insert(name);
+  }
+  for (int i = 0; i < options.num_graphs; ++i) {
+    auto instance = absl::make_unique<Instance>();
+    ::mediapipe::Status status = pool->StartGraph(instance.get());
+    if (!status.ok()) {
+      pool->StopGraph(instance.get());
+      return status;
+    }
+    absl::MutexLock lock(&pool->mutex_);
+    pool->free_instances_.push_back(instance.get());
+    pool->instances_.push_back(std::move(instance));
+  }
+  return std::move(pool);
+}
+
+// static
+::mediapipe::StatusOr<std::unique_ptr<GraphPool>> GraphPool::Create(
+    const CalculatorGraphConfig& config, const Options& options) {
+  auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  MP_RETURN_IF_ERROR(validated_graph->Initialize(config));
+  return Create(std::move(validated_graph), options);
+}
+
+GraphPool::GraphPool(
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+    const Options& options)
+    : validated_graph_(std::move(validated_graph)), options_(options) {}
+
+GraphPool::~GraphPool() {
+  ::mediapipe::Status status = Close();
+  if (!status.ok()) {
+    LOG(ERROR) << "GraphPool failed to close: " << status;
+  }
+}
+
+::mediapipe::Status GraphPool::StartGraph(Instance* instance) {
+  // A previous graph failed and cannot run more requests.
+  StopGraph(instance);
+  if (instance->graph) {
+    absl::MutexLock lock(&mutex_);
+    ++num_restarts_;
+  }
+  instance->graph = absl::make_unique<CalculatorGraph>();
+  instance->next_timestamp = Timestamp(0);
+  CalculatorGraph* graph = instance->graph.get();
+  MP_RETURN_IF_ERROR(graph->Initialize(validated_graph_));
+  for (const std::string& stream_name : options_.output_streams) {
+    MP_RETURN_IF_ERROR(graph->ObserveOutputStream(
+        stream_name, [instance, stream_name](const Packet& packet) {
+          absl::MutexLock lock(&instance->mutex);
+          instance->outputs[stream_name] = packet;
+          return ::mediapipe::OkStatus();
+        }));
+  }
+  if (options_.setup_graph) {
+    MP_RETURN_IF_ERROR(options_.setup_graph(graph));
+  }
+  MP_RETURN_IF_ERROR(graph->StartRun(options_.side_packets));
+  instance->running = true;
+  // Calculators are opened by the scheduler. Waiting for them keeps Open()
+  // out of the first request, and reports its errors here.
+  return graph->WaitUntilIdle();
+}
+
+void GraphPool::StopGraph(Instance* instance) {
+  if (instance->running) {
+    instance->graph->Cancel();
+    instance->graph->WaitUntilDone().IgnoreError();
+    instance->running = false;
+  }
+}
+
+::mediapipe::StatusOr<std::map<std::string, Packet>> GraphPool::Run(
+    const std::map<std::string, Packet>& inputs) {
+  Instance* instance;
+  {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &GraphPool::HasFreeInstance));
+    RET_CHECK(!closed_) << "Run() called on a closed GraphPool.";
+    instance = free_instances_.back();
+    free_instances_.pop_back();
+  }
+
+  auto outputs = RunOnGraph(instance, inputs);
+  if (!outputs.ok() && instance->graph->HasError()) {
+    // Replaces the failed graph right away, rather than in the next request.
+    ::mediapipe::Status status = StartGraph(instance);
+    if (!status.ok()) {
+      LOG(ERROR) << "GraphPool failed to restart a graph: " << status;
+    }
+  }
+
+  absl::MutexLock lock(&mutex_);
+  ++num_requests_;
+  free_instances_.push_back(instance);
+  return outputs;
+}
+
+::mediapipe::StatusOr<std::map<std::string, Packet>> GraphPool::RunOnGraph(
+    Instance* instance, const std::map<std::string, Packet>& inputs) {
+  RET_CHECK_EQ(inputs.size(), input_streams_.size())
+      << "Every request needs a packet for each graph input stream.";
+  for (const auto& name_packet : inputs) {
+    RET_CHECK(input_streams_.count(name_packet.first))
+        << "\"" << name_packet.first << "\" is not a graph input stream.";
+  }
+  if (!instance->running) {
+    MP_RETURN_IF_ERROR(StartGraph(instance));
+  }
+  CalculatorGraph* graph = instance->graph.get();
+  const Timestamp timestamp = instance->next_timestamp;
+  instance->next_timestamp = timestamp.NextAllowedInStream();
+  {
+    absl::MutexLock lock(&instance->mutex);
+    instance->outputs.clear();
+  }
+  for (const auto& name_packet : inputs) {
+    MP_RETURN_IF_ERROR(graph->AddPacketToInputStream(
+        name_packet.first, name_packet.second.At(timestamp)));
+  }
+  // The graph has no sources, so once it is idle every calculator has
+  // processed the request.
+  MP_RETURN_IF_ERROR(graph->WaitUntilIdle());
+
+  std::map<std::string, Packet> outputs;
+  absl::MutexLock lock(&instance->mutex);
+  for (const std::string& stream_name : options_.output_streams) {
+    outputs[stream_name] = instance->outputs[stream_name];
+  }
+  instance->outputs.clear();
+  return outputs;
+}
+
+::mediapipe::Status GraphPool::Close() {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (closed_) {
+      return ::mediapipe::OkStatus();
+    }
+    // Waits for the running requests.
+    mutex_.Await(absl::Condition(this, &GraphPool::AllInstancesFree));
+    closed_ = true;
+  }
+  ::mediapipe::Status status;
+  for (auto& instance : instances_) {
+    if (!instance->running) {
+      continue;
+    }
+    status.Update(instance->graph->CloseAllInputStreams());
+    status.Update(instance->graph->WaitUntilDone());
+  }
+  return status;
+}
+
+int64 GraphPool::NumRequests() {
+  absl::MutexLock lock(&mutex_);
+  return num_requests_;
+}
+
+int64 GraphPool::NumRestarts() {
+  absl::MutexLock lock(&mutex_);
+  return num_restarts_;
+}
+
+bool GraphPool::HasFreeInstance() const {
+  return closed_ || !free_instances_.empty();
+}
+
+bool GraphPool::AllInstancesFree() const {
+  return free_instances_.size() == instances_.size();
+}
+
+}  // namespace mediapipe
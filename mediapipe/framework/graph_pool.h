@@ -0,0 +1,146 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_GRAPH_POOL_H_
+#define MEDIAPIPE_FRAMEWORK_GRAPH_POOL_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+
+// Runs requests on a pool of warm graphs, for request/response serving.
+//
+// Starting a graph run opens every calculator, which for inference graphs
+// includes loading models and allocating interpreters. A GraphPool starts
+// each of its graphs once and keeps it running: a request adds one packet
+// to each graph input stream of a free graph, at the next timestamp of that
+// graph, and waits until the graph is idle again. Requests thus only pay
+// for Process(), and up to num_graphs of them run concurrently.
+//
+//   GraphPool::Options options;
+//   options.num_graphs = 4;
+//   options.output_streams = {"detections"};
+//   ASSIGN_OR_RETURN(auto pool, GraphPool::Create(config, options));
+//   ...
+//   ASSIGN_OR_RETURN(auto outputs, pool->Run({{"input_image", image}}));
+//   const auto& detections =
+//       outputs["detections"].Get<std::vector<Detection>>();
+//
+// Since calculators are not reopened between requests, the graph must not
+// carry state from one request to the next, e.g. through a
+// FlowLimiterCalculator. Create() rejects graphs with source nodes or back
+// edges. The graph run is not restarted either, so the requests on a graph
+// get increasing timestamps 0, 1, 2, ... rather than each starting at 0;
+// calculators must not rely on the absolute timestamp. A graph that fails a
+// request is replaced by a new one, which starts again at timestamp 0.
+//
+// This class is thread-safe.
+class GraphPool {
+ public:
+  struct Options {
+    // The number of graphs, i.e. of requests that can run concurrently.
+    int num_graphs = 1;
+    // The output streams whose packets Run() returns.
+    std::vector<std::string> output_streams;
+    // The side packets every graph run is started with.
+    std::map<std::string, Packet> side_packets;
+    // If set, called for each graph before it starts running, e.g. to set
+    // service objects or executors.
+    std::function<::mediapipe::Status(CalculatorGraph*)> setup_graph;
+  };
+
+  // Creates a pool of graphs sharing `validated_graph`, and starts them.
+  // Returns an InvalidArgumentError if the graph has a source node or a back
+  // edge.
+  static ::mediapipe::StatusOr<std::unique_ptr<GraphPool>> Create(
+      std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+      const Options& options);
+  static ::mediapipe::StatusOr<std::unique_ptr<GraphPool>> Create(
+      const CalculatorGraphConfig& config, const Options& options);
+
+  // Closes the graphs. Errors are logged, call Close() to get them.
+  ~GraphPool();
+  GraphPool(const GraphPool&) = delete;
+  GraphPool& operator=(const GraphPool&) = delete;
+
+  // Runs one request on a free graph, waiting for one if all are busy.
+  // `inputs` holds a packet for every graph input stream, whose timestamp
+  // is replaced. Returns, for each of Options::output_streams, the last
+  // packet it produced for the request, or an empty packet if none.
+  ::mediapipe::StatusOr<std::map<std::string, Packet>> Run(
+      const std::map<std::string, Packet>& inputs);
+
+  // Waits for the running requests, then closes the graphs and returns the
+  // first error. Run() must not be called afterwards.
+  ::mediapipe::Status Close();
+
+  // The number of requests run, and of graphs replaced after an error.
+  int64 NumRequests();
+  int64 NumRestarts();
+
+ private:
+  // A running graph of the pool.
+  struct Instance;
+
+  GraphPool(std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+            const Options& options);
+
+  // Creates and starts the graph of `instance`, replacing the failed graph
+  // it may have.
+  ::mediapipe::Status StartGraph(Instance* instance);
+
+  // Cancels the graph run of `instance`, if any.
+  void StopGraph(Instance* instance);
+
+  // Runs a request on the graph of `instance`, starting it first if it is
+  // not running.
+  ::mediapipe::StatusOr<std::map<std::string, Packet>> RunOnGraph(
+      Instance* instance, const std::map<std::string, Packet>& inputs);
+
+  // Returns true if a graph is free for Run().
+  bool HasFreeInstance() const EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns true if no graph is running a request.
+  bool AllInstancesFree() const EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::shared_ptr<const ValidatedGraphConfig> validated_graph_;
+  const Options options_;
+  // The names of the graph input streams.
+  std::set<std::string> input_streams_;
+
+  std::vector<std::unique_ptr<Instance>> instances_;
+
+  absl::Mutex mutex_;
+  // The instances not running a request.
+  std::vector<Instance*> free_instances_ GUARDED_BY(mutex_);
+  bool closed_ GUARDED_BY(mutex_) = false;
+  int64 num_requests_ GUARDED_BY(mutex_) = 0;
+  int64 num_restarts_ GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_GRAPH_POOL_H_
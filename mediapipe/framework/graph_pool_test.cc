@@ -0,0 +1,277 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/graph_pool.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kFailingValue = -100;
+
+// The number of times ServingTestCalculator::Open() was called.
+std::atomic<int> num_opens(0);
+
+// Doubles each int packet of a and adds the int packet of b. Outputs nothing
+// for negative values of a, and fails for kFailingValue.
+class ServingTestCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Inputs().Index(1).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Open(CalculatorContext* cc) final {
+    ++num_opens;
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) final {
+    const int a = cc->Inputs().Index(0).Get<int>();
+    const int b = cc->Inputs().Index(1).Get<int>();
+    if (a == kFailingValue) {
+      return ::mediapipe::InternalError("Failing as requested.");
+    }
+    if (a >= 0) {
+      cc->Outputs().Index(0).AddPacket(
+          MakePacket<int>(2 * a + b).At(cc->InputTimestamp()));
+    }
+    return ::mediapipe::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(ServingTestCalculator);
+
+// Outputs a single int packet.
+class ServingTestSourceCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Outputs().Index(0).Set<int>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) final {
+    cc->Outputs().Index(0).AddPacket(MakePacket<int>(0).At(Timestamp(0)));
+    return tool::StatusStop();
+  }
+};
+REGISTER_CALCULATOR(ServingTestSourceCalculator);
+
+CalculatorGraphConfig ServingGraphConfig() {
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+    input_stream: "a"
+    input_stream: "b"
+    node {
+      calculator: "ServingTestCalculator"
+      input_stream: "a"
+      input_stream: "b"
+      output_stream: "result"
+    }
+  )");
+}
+
+// Runs the request a, b on `pool` and returns the result, or -1 if the
+// graph produced none.
+::mediapipe::StatusOr<int> RunRequest(GraphPool* pool, int a, int b) {
+  ASSIGN_OR_RETURN(auto outputs, pool->Run({{"a", MakePacket<int>(a)},
+                                            {"b", MakePacket<int>(b)}}));
+  const Packet& result = outputs["result"];
+  return result.IsEmpty() ? -1 : result.Get<int>();
+}
+
+GraphPool::Options PoolOptions(int num_graphs) {
+  GraphPool::Options options;
+  options.num_graphs = num_graphs;
+  options.output_streams = {"result"};
+  return options;
+}
+
+TEST(GraphPoolTest, OpensCalculatorsOncePerGraph) {
+  num_opens = 0;
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(2));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  EXPECT_EQ(2, num_opens);
+  for (int i = 0; i < 10; ++i) {
+    auto result = RunRequest(pool.get(), i, 1);
+    MP_ASSERT_OK(result);
+    EXPECT_EQ(2 * i + 1, result.ValueOrDie());
+  }
+  EXPECT_EQ(2, num_opens);
+  EXPECT_EQ(10, pool->NumRequests());
+  MP_EXPECT_OK(pool->Close());
+}
+
+TEST(GraphPoolTest, ReturnsEmptyPacketsForMissingOutputs) {
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(1));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  auto no_result = RunRequest(pool.get(), -1, 0);
+  MP_ASSERT_OK(no_result);
+  EXPECT_EQ(-1, no_result.ValueOrDie());
+  // The next request is not affected.
+  auto result = RunRequest(pool.get(), 3, 0);
+  MP_ASSERT_OK(result);
+  EXPECT_EQ(6, result.ValueOrDie());
+}
+
+TEST(GraphPoolTest, RejectsInvalidInputs) {
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(1));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  EXPECT_FALSE(pool->Run({{"a", MakePacket<int>(1)}}).ok());
+  EXPECT_FALSE(
+      pool->Run({{"a", MakePacket<int>(1)}, {"c", MakePacket<int>(1)}}).ok());
+  EXPECT_EQ(0, pool->NumRestarts());
+  auto result = RunRequest(pool.get(), 1, 1);
+  MP_ASSERT_OK(result);
+  EXPECT_EQ(3, result.ValueOrDie());
+}
+
+TEST(GraphPoolTest, ReplacesFailedGraphs) {
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(1));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  auto failed = RunRequest(pool.get(), kFailingValue, 0);
+  ASSERT_FALSE(failed.ok());
+  EXPECT_THAT(failed.status().message(),
+              testing::HasSubstr("Failing as requested."));
+  EXPECT_EQ(1, pool->NumRestarts());
+  auto result = RunRequest(pool.get(), 4, 0);
+  MP_ASSERT_OK(result);
+  EXPECT_EQ(8, result.ValueOrDie());
+  MP_EXPECT_OK(pool->Close());
+}
+
+// The graph run is not restarted between requests, so each request on a
+// graph gets the next timestamp, until the graph is replaced.
+TEST(GraphPoolTest, RequestTimestampsIncreasePerGraph) {
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(1));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  auto run = [&pool](int a) {
+    return pool->Run({{"a", MakePacket<int>(a).At(Timestamp(100))},
+                      {"b", MakePacket<int>(0).At(Timestamp(100))}});
+  };
+  for (int i = 0; i < 3; ++i) {
+    auto outputs = run(i);
+    MP_ASSERT_OK(outputs);
+    EXPECT_EQ(Timestamp(i), outputs.ValueOrDie()["result"].Timestamp());
+  }
+  ASSERT_FALSE(run(kFailingValue).ok());
+  auto outputs = run(1);
+  MP_ASSERT_OK(outputs);
+  EXPECT_EQ(Timestamp(0), outputs.ValueOrDie()["result"].Timestamp());
+  MP_EXPECT_OK(pool->Close());
+}
+
+TEST(GraphPoolTest, RejectsSourceNodesAndBackEdges) {
+  auto source_pool = GraphPool::Create(
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "a"
+        node {
+          calculator: "ServingTestSourceCalculator"
+          output_stream: "b"
+        }
+        node {
+          calculator: "ServingTestCalculator"
+          input_stream: "a"
+          input_stream: "b"
+          output_stream: "result"
+        }
+      )"),
+      PoolOptions(1));
+  ASSERT_FALSE(source_pool.ok());
+  EXPECT_EQ(::mediapipe::StatusCode::kInvalidArgument,
+            source_pool.status().code());
+  EXPECT_THAT(source_pool.status().message(),
+              testing::HasSubstr("ServingTestSourceCalculator"));
+
+  auto loopback_pool = GraphPool::Create(
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "a"
+        node {
+          calculator: "ServingTestCalculator"
+          input_stream: "a"
+          input_stream: "result"
+          input_stream_info: { tag_index: ":1" back_edge: true }
+          output_stream: "result"
+        }
+      )"),
+      PoolOptions(1));
+  ASSERT_FALSE(loopback_pool.ok());
+  EXPECT_EQ(::mediapipe::StatusCode::kInvalidArgument,
+            loopback_pool.status().code());
+  EXPECT_THAT(loopback_pool.status().message(),
+              testing::HasSubstr("back edge"));
+}
+
+TEST(GraphPoolTest, RunsConcurrentRequests) {
+  const int kNumRequests = 64;
+  auto pool_or = GraphPool::Create(ServingGraphConfig(), PoolOptions(4));
+  MP_ASSERT_OK(pool_or);
+  std::unique_ptr<GraphPool> pool = std::move(pool_or).ValueOrDie();
+  std::vector<int> results(kNumRequests, -1);
+  {
+    ThreadPool threads("graph_pool_test", 8);
+    threads.StartWorkers();
+    for (int r = 0; r < kNumRequests; ++r) {
+      threads.Schedule([&pool, &results, r] {
+        auto result = RunRequest(pool.get(), r, r);
+        if (result.ok()) {
+          results[r] = result.ValueOrDie();
+        }
+      });
+    }
+  }
+  for (int r = 0; r < kNumRequests; ++r) {
+    EXPECT_EQ(3 * r, results[r]) << r;
+  }
+  EXPECT_EQ(kNumRequests, pool->NumRequests());
+  MP_EXPECT_OK(pool->Close());
+}
+
+TEST(GraphPoolTest, SharesValidatedGraphConfig) {
+  auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  MP_ASSERT_OK(validated_graph->Initialize(ServingGraphConfig()));
+  int num_setups = 0;
+  GraphPool::Options options = PoolOptions(3);
+  options.setup_graph = [&num_setups](CalculatorGraph* graph) {
+    ++num_setups;
+    return ::mediapipe::OkStatus();
+  };
+  auto pool_or = GraphPool::Create(validated_graph, options);
+  MP_ASSERT_OK(pool_or);
+  EXPECT_EQ(3, num_setups);
+  auto result = RunRequest(pool_or.ValueOrDie().get(), 5, 5);
+  MP_ASSERT_OK(result);
+  EXPECT_EQ(15, result.ValueOrDie());
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -18,8 +18,13 @@
 #include "mediapipe/framework/graph_validation.h"
 
 #include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
 
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/compiled_graph_config.pb.h"
 #include "mediapipe/framework/deps/message_matchers.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
@@ -210,5 +215,126 @@ TEST(ValidatedGraphConfigTest, InitializeTemplateFromProtos) {
       )")));
 }
 
+// A graph with a subgraph whose nodes are listed out of topological order.
+constexpr char kPassThroughSubgraphConfig[] = R"(
+  type: "PassThroughGraph"
+  input_stream: "INPUT:stream_1"
+  output_stream: "OUTPUT:stream_2"
+  node {
+    calculator: "PassThroughCalculator"
+    input_stream: "stream_1"
+    output_stream: "stream_2"
+  }
+)";
+constexpr char kUnsortedGraphConfig[] = R"(
+  input_stream: "stream_1"
+  node {
+    calculator: "PassThroughGraph"
+    input_stream: "INPUT:stream_2"
+    output_stream: "OUTPUT:stream_3"
+  }
+  node {
+    calculator: "PassThroughCalculator"
+    input_stream: "stream_1"
+    output_stream: "stream_2"
+  }
+)";
+
+// Returns a ValidatedGraphConfig for kUnsortedGraphConfig.
+std::unique_ptr<ValidatedGraphConfig> ValidateUnsortedGraph() {
+  auto validated_graph = absl::make_unique<ValidatedGraphConfig>();
+  MEDIAPIPE_CHECK_OK(validated_graph->Initialize(
+      {ParseTextProtoOrDie<CalculatorGraphConfig>(kPassThroughSubgraphConfig),
+       ParseTextProtoOrDie<CalculatorGraphConfig>(kUnsortedGraphConfig)},
+      {}));
+  return validated_graph;
+}
+
+// Shows that a compiled config loads into the same canonical config.
+TEST(ValidatedGraphConfigTest, InitializeFromCompiledConfig) {
+  auto validated_graph = ValidateUnsortedGraph();
+  auto compiled_config = validated_graph->Compile();
+  MP_ASSERT_OK(compiled_config);
+  EXPECT_EQ(3, compiled_config.ValueOrDie().output_stream_type_size());
+
+  CompiledGraphConfig loaded_config;
+  ASSERT_TRUE(loaded_config.ParseFromString(
+      compiled_config.ValueOrDie().SerializeAsString()));
+  ValidatedGraphConfig loaded_graph;
+  MP_ASSERT_OK(loaded_graph.Initialize(loaded_config));
+  EXPECT_THAT(loaded_graph.Config(), EqualsProto(validated_graph->Config()));
+  EXPECT_THAT(
+      loaded_graph.Config(),
+      EqualsProto(::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "stream_1"
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "stream_1"
+          output_stream: "stream_2"
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "stream_2"
+          output_stream: "stream_3"
+        }
+        executor {}
+      )")));
+  EXPECT_EQ(validated_graph->OutputStreamInfos().size(),
+            loaded_graph.OutputStreamInfos().size());
+}
+
+// Shows that a compiled config is rejected if its types do not match.
+TEST(ValidatedGraphConfigTest, InitializeFromStaleCompiledConfig) {
+  auto compiled_config = ValidateUnsortedGraph()->Compile();
+  MP_ASSERT_OK(compiled_config);
+
+  CompiledGraphConfig changed_type = compiled_config.ValueOrDie();
+  changed_type.set_output_stream_type(1, "NotTheResolvedType");
+  ValidatedGraphConfig graph_1;
+  ::mediapipe::Status status_1 = graph_1.Initialize(changed_type);
+  EXPECT_EQ(status_1.code(), ::mediapipe::StatusCode::kFailedPrecondition);
+  EXPECT_THAT(status_1.message(), testing::HasSubstr("NotTheResolvedType"));
+
+  CompiledGraphConfig missing_type = compiled_config.ValueOrDie();
+  missing_type.mutable_output_stream_type()->RemoveLast();
+  ValidatedGraphConfig graph_2;
+  EXPECT_EQ(graph_2.Initialize(missing_type).code(),
+            ::mediapipe::StatusCode::kFailedPrecondition);
+}
+
+// Shows that a compiled config must list its nodes in topological order.
+TEST(ValidatedGraphConfigTest, InitializeFromUnsortedCompiledConfig) {
+  auto compiled_config = ValidateUnsortedGraph()->Compile();
+  MP_ASSERT_OK(compiled_config);
+  CompiledGraphConfig unsorted = compiled_config.ValueOrDie();
+  unsorted.mutable_config()->mutable_node()->SwapElements(0, 1);
+  ValidatedGraphConfig graph;
+  EXPECT_FALSE(graph.Initialize(unsorted).ok());
+}
+
+// Shows several graphs running from one shared ValidatedGraphConfig.
+TEST(ValidatedGraphConfigTest, GraphsShareValidatedConfig) {
+  std::shared_ptr<const ValidatedGraphConfig> validated_graph =
+      ValidateUnsortedGraph();
+  for (int run = 0; run < 3; ++run) {
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(validated_graph));
+    EXPECT_EQ(&graph.Config(), &validated_graph->Config());
+    std::vector<Packet> outputs;
+    MP_ASSERT_OK(graph.ObserveOutputStream(
+        "stream_3", [&outputs](const Packet& packet) {
+          outputs.push_back(packet);
+          return ::mediapipe::OkStatus();
+        }));
+    MP_ASSERT_OK(graph.StartRun({}));
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "stream_1", MakePacket<int>(run).At(Timestamp(run))));
+    MP_ASSERT_OK(graph.CloseAllInputStreams());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_EQ(run, outputs[0].Get<int>());
+  }
+}
+
 }  // namespace
 }  // namespace mediapipe
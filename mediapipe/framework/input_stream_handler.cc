@@ -158,21 +158,25 @@ bool InputStreamHandler::ScheduleInvocations(int max_allowance,
     // Sets *input_bound iff the latest node readiness is kNotReady before the
     // function returns regardless of how many invocations have been scheduled.
     if (node_readiness == NodeReadiness::kNotReady) {
+      CalculatorContext* default_context =
+          calculator_context_manager_->GetDefaultCalculatorContext();
       if (batch_size_ > 1 &&
           calculator_context_manager_->ContextHasInputTimestamp(
-              *calculator_context_manager_->GetDefaultCalculatorContext())) {
+              *default_context)) {
         // When batching is in progress, input_bound stays equal to the first
         // timestamp in the calculator context. This allows timestamp
         // propagation to be performed only for the first timestamp, and
         // prevents propagation for the subsequent inputs.
-        *input_bound =
-            calculator_context_manager_->GetDefaultCalculatorContext()
-                ->InputTimestamp();
+        *input_bound = default_context->InputTimestamp();
+        if (ShouldScheduleIncompleteBatch(
+                calculator_context_manager_->NumberOfContextTimestamps(
+                    *default_context))) {
+          schedule_callback_(default_context);
+          ++invocations_scheduled;
+        }
       } else {
         *input_bound = min_stream_timestamp;
       }
-      CalculatorContext* default_context =
-          calculator_context_manager_->GetDefaultCalculatorContext();
       ::mediapipe::LogEvent(default_context->GetProfilingContext(),
                             TraceEvent(TraceEvent::NOT_READY)
                                 .set_node_id(default_context->NodeId()));
@@ -186,6 +190,9 @@ bool InputStreamHandler::ScheduleInvocations(int max_allowance,
       if (!late_preparation_) {
         FillInputSet(min_stream_timestamp, &calculator_context->Inputs());
       }
+      ::mediapipe::AddReadyTime(calculator_context->GetProfilingContext(),
+                                calculator_context->NodeId(),
+                                min_stream_timestamp);
       if (calculator_context_manager_->NumberOfContextTimestamps(
               *calculator_context) == batch_size_) {
         schedule_callback_(calculator_context);
@@ -229,7 +236,7 @@ void InputStreamHandler::FinalizeInputSet(Timestamp timestamp,
 }
 
 void InputStreamHandler::AddPackets(CollectionItemId id,
-                                    const std::list<Packet>& packets) {
+                                    const std::vector<Packet>& packets) {
   bool notify = false;
   ::mediapipe::Status result =
       input_stream_managers_.Get(id)->AddPackets(packets, &notify);
@@ -242,7 +249,7 @@ void InputStreamHandler::AddPackets(CollectionItemId id,
 }
 
 void InputStreamHandler::MovePackets(CollectionItemId id,
-                                     std::list<Packet>* packets) {
+                                     std::vector<Packet>* packets) {
   bool notify = false;
   ::mediapipe::Status result =
       input_stream_managers_.Get(id)->MovePackets(packets, &notify);
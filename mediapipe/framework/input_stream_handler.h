@@ -17,7 +17,6 @@
 
 #include <atomic>
 #include <functional>
-#include <list>
 #include <memory>
 #include <string>
 #include <utility>
@@ -110,6 +109,12 @@ class InputStreamHandler {
       std::function<void(CalculatorContext*)> schedule_callback,
       std::function<void(::mediapipe::Status)> error_callback);
 
+  // Called by the calculator node when the graph run ends, before its
+  // calculator contexts are destroyed. A subclass that invokes
+  // notification_callback from a thread of its own must stop doing so, and
+  // wait for any invocation in progress, before it returns.
+  virtual void CleanupAfterRun() {}
+
   int NumInputStreams() const { return input_stream_managers_.NumEntries(); }
 
   // Returns the tag map of the input streams.
@@ -135,10 +140,10 @@ class InputStreamHandler {
 
   // Add packets into a particular stream.
   virtual void AddPackets(CollectionItemId id,
-                          const std::list<Packet>& packets);
+                          const std::vector<Packet>& packets);
 
   // Moves packets into a particular stream.
-  virtual void MovePackets(CollectionItemId id, std::list<Packet>* packets);
+  virtual void MovePackets(CollectionItemId id, std::vector<Packet>* packets);
 
   // Sets next timestamp bound in a particular stream.
   void SetNextTimestampBound(CollectionItemId id, Timestamp bound);
@@ -215,6 +220,15 @@ class InputStreamHandler {
   virtual void FillInputSet(Timestamp input_timestamp,
                             InputStreamShardSet* input_set) = 0;
 
+  // Returns true if an incomplete batch of num_input_sets input sets should be
+  // scheduled without waiting for more inputs. Called only when batching is
+  // enabled, at least one input set has been collected, and the node is not
+  // ready for another input set. By default, a batch is scheduled only once
+  // it is full or the node is ready for Close().
+  virtual bool ShouldScheduleIncompleteBatch(int num_input_sets) {
+    return false;
+  }
+
   // Collection of InputStreamManager objects.
   InputStreamManagerSet input_stream_managers_;
   // A pointer to the calculator context manager of the calculator node.
@@ -80,13 +80,14 @@ Packet InputStreamManager::QueueHead() const {
 }
 
 ::mediapipe::Status InputStreamManager::AddPackets(
-    const std::list<Packet>& container, bool* notify) {
-  return AddOrMovePacketsInternal<const std::list<Packet>&>(container, notify);
+    const std::vector<Packet>& container, bool* notify) {
+  return AddOrMovePacketsInternal<const std::vector<Packet>&>(container,
+                                                              notify);
 }
 
 ::mediapipe::Status InputStreamManager::MovePackets(
-    std::list<Packet>* container, bool* notify) {
-  return AddOrMovePacketsInternal<std::list<Packet>&>(*container, notify);
+    std::vector<Packet>* container, bool* notify) {
+  return AddOrMovePacketsInternal<std::vector<Packet>&>(*container, notify);
 }
 
 template <typename Container>
@@ -17,8 +17,8 @@
 
 #include <deque>
 #include <functional>
-#include <list>
 #include <string>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
@@ -87,13 +87,13 @@ class InputStreamManager {
   //   Timestamp::PostStream(), the packet must be the only packet in the
   //   stream.
   // Violation of any of these conditions causes an error status.
-  ::mediapipe::Status AddPackets(const std::list<Packet>& container,
+  ::mediapipe::Status AddPackets(const std::vector<Packet>& container,
                                  bool* notify);
 
   // Move a list of timestamped packets. Sets "notify" to true if the queue
   // becomes non-empty. Does nothing if the input stream is closed. After the
   // move, all packets in the container must be empty.
-  ::mediapipe::Status MovePackets(std::list<Packet>* container, bool* notify);
+  ::mediapipe::Status MovePackets(std::vector<Packet>* container, bool* notify);
 
   // Closes the input stream.  This function can be called multiple times.
   void Close() LOCKS_EXCLUDED(stream_mutex_);
@@ -15,6 +15,7 @@
 #include "mediapipe/framework/input_stream_manager.h"
 
 #include <memory>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "mediapipe/framework/input_stream_shard.h"
@@ -92,7 +93,7 @@ class InputStreamManagerTest : public ::testing::Test {
 TEST_F(InputStreamManagerTest, Init) {}
 
 TEST_F(InputStreamManagerTest, AddPackets) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
@@ -109,7 +110,7 @@ TEST_F(InputStreamManagerTest, AddPackets) {
 }
 
 TEST_F(InputStreamManagerTest, MovePackets) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
@@ -129,7 +130,7 @@ TEST_F(InputStreamManagerTest, MovePackets) {
 // a stream: Timestamp::Unset(), Timestamp::Unstarted(),
 // Timestamp::OneOverPostStream(), and Timestamp::Done().
 TEST_F(InputStreamManagerTest, AddPacketUnset) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp::Unset()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
 
@@ -140,7 +141,7 @@ TEST_F(InputStreamManagerTest, AddPacketUnset) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketUnstarted) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::Unstarted()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -152,7 +153,7 @@ TEST_F(InputStreamManagerTest, AddPacketUnstarted) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketOneOverPostStream) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::OneOverPostStream()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -165,7 +166,7 @@ TEST_F(InputStreamManagerTest, AddPacketOneOverPostStream) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketDone) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp::Done()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
 
@@ -176,7 +177,7 @@ TEST_F(InputStreamManagerTest, AddPacketDone) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketsOnlyPreStream) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PreStream()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -190,7 +191,7 @@ TEST_F(InputStreamManagerTest, AddPacketsOnlyPreStream) {
 // An attempt to add a packet after Timestamp::PreStream() should be rejected
 // because the next timestamp bound is Timestamp::OneOverPostStream().
 TEST_F(InputStreamManagerTest, AddPacketsAfterPreStream) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PreStream()));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(10)));
@@ -204,7 +205,7 @@ TEST_F(InputStreamManagerTest, AddPacketsAfterPreStream) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketsOnlyPostStream) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PostStream()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -218,7 +219,7 @@ TEST_F(InputStreamManagerTest, AddPacketsOnlyPostStream) {
 // A packet at Timestamp::PostStream() must be the only Packet in an input
 // stream.
 TEST_F(InputStreamManagerTest, AddPacketsBeforePostStream) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(
       MakePacket<std::string>("packet 2").At(Timestamp::PostStream()));
@@ -231,7 +232,7 @@ TEST_F(InputStreamManagerTest, AddPacketsBeforePostStream) {
 }
 
 TEST_F(InputStreamManagerTest, AddPacketsReverseTimestamps) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
@@ -249,7 +250,7 @@ TEST_F(InputStreamManagerTest, PopPacketAtTimestamp) {
   std::string expected_value_at_10("packet 1");
   std::string expected_value_at_20("packet 2");
   std::string expected_value_at_30("packet 3");
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>(expected_value_at_10).At(Timestamp(10)));
   packets.push_back(
@@ -334,7 +335,7 @@ TEST_F(InputStreamManagerTest, PopQueueHead) {
   std::string expected_value_at_10("packet 1");
   std::string expected_value_at_20("packet 2");
   std::string expected_value_at_30("packet 3");
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>(expected_value_at_10).At(Timestamp(10)));
   packets.push_back(
@@ -394,7 +395,7 @@ TEST_F(InputStreamManagerTest, PopQueueHead) {
 }
 
 TEST_F(InputStreamManagerTest, BadPacketType) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<int>(10).At(Timestamp(10)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
 
@@ -405,7 +406,7 @@ TEST_F(InputStreamManagerTest, BadPacketType) {
 }
 
 TEST_F(InputStreamManagerTest, Close) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
@@ -428,7 +429,7 @@ TEST_F(InputStreamManagerTest, Close) {
 }
 
 TEST_F(InputStreamManagerTest, ReuseInputStreamManager) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
@@ -481,7 +482,7 @@ TEST_F(InputStreamManagerTest, ReuseInputStreamManager) {
 }
 
 TEST_F(InputStreamManagerTest, MultipleNotifications) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -526,7 +527,7 @@ TEST_F(InputStreamManagerTest, SetHeader) {
 }
 
 TEST_F(InputStreamManagerTest, BackwardsInTime) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -593,7 +594,7 @@ TEST_F(InputStreamManagerTest, BackwardsInTime) {
 }
 
 TEST_F(InputStreamManagerTest, SelectBackwardsInTime) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -637,7 +638,7 @@ TEST_F(InputStreamManagerTest, SelectBackwardsInTime) {
 }
 
 TEST_F(InputStreamManagerTest, TimestampBound) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -747,7 +748,7 @@ TEST_F(InputStreamManagerTest, TimestampBound) {
 }
 
 TEST_F(InputStreamManagerTest, QueueSizeTest) {
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   int max_queue_size = 2;
   input_stream_manager_->SetMaxQueueSize(max_queue_size);
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
@@ -833,7 +834,7 @@ TEST_F(InputStreamManagerTest, InputReleaseTest) {
 // if packet timestamps don't need to be increasing.
 TEST_F(InputStreamManagerTest, AddPacketsAfterPreStreamUntimed) {
   input_stream_manager_->DisableTimestamps();
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PreStream()));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(10)));
@@ -849,7 +850,7 @@ TEST_F(InputStreamManagerTest, AddPacketsAfterPreStreamUntimed) {
 // an input stream if packet timestamps don't need to be increasing.
 TEST_F(InputStreamManagerTest, AddPacketsBeforePostStreamUntimed) {
   input_stream_manager_->DisableTimestamps();
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(
       MakePacket<std::string>("packet 2").At(Timestamp::PostStream()));
@@ -863,7 +864,7 @@ TEST_F(InputStreamManagerTest, AddPacketsBeforePostStreamUntimed) {
 
 TEST_F(InputStreamManagerTest, BackwardsInTimeUntimed) {
   input_stream_manager_->DisableTimestamps();
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -44,6 +44,17 @@ inline void LogEvent(ProfilingContext* context, TraceEvent event) {
   }
 #endif
 }
+
+// Records when an input set of a node became ready for Process(), before the
+// node is scheduled.
+inline void AddReadyTime(ProfilingContext* context, int node_id,
+                         Timestamp input_timestamp) {
+#ifdef MEDIAPIPE_PROFILER_AVAILABLE
+  if (context) {
+    context->AddReadyTime(node_id, input_timestamp);
+  }
+#endif
+}
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_FRAMEWORK_MEDIAPIPE_PROFILING_H_
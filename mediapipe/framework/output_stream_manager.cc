@@ -163,7 +163,8 @@ void OutputStreamManager::PropagateUpdatesToMirrors(
     absl::MutexLock lock(&stream_mutex_);
     next_timestamp_bound_ = next_timestamp_bound;
   }
-  std::list<Packet>* packets_to_propagate = output_stream_shard->OutputQueue();
+  std::vector<Packet>* packets_to_propagate =
+      output_stream_shard->OutputQueue();
   VLOG(2) << "Output stream: " << Name()
           << " queue size: " << packets_to_propagate->size();
   VLOG(2) << "Output stream: " << Name()
@@ -0,0 +1,152 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Counts the heap allocations made while packets travel through a graph.
+// This binary replaces the global operator new to count every allocation.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/thread_pool_executor.pb.h"
+
+namespace {
+std::atomic<int64> num_allocations(0);
+}  // namespace
+
+void* operator new(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace mediapipe {
+namespace {
+
+// Passes the input packet on to the output; no allocations of its own.
+class ForwardCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).SetSameAs(&cc->Inputs().Index(0));
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override {
+    cc->SetOffset(TimestampDiff(0));
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return ::mediapipe::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(ForwardCalculator);
+
+// A chain of ForwardCalculators, run on a single thread.
+CalculatorGraphConfig ChainConfig(int chain_length) {
+  CalculatorGraphConfig config;
+  config.add_input_stream("input");
+  ExecutorConfig* executor = config.add_executor();
+  executor->mutable_options()
+      ->MutableExtension(ThreadPoolExecutorOptions::ext)
+      ->set_num_threads(1);
+  std::string stream = "input";
+  for (int n = 0; n < chain_length; ++n) {
+    CalculatorGraphConfig::Node* node = config.add_node();
+    node->set_calculator("ForwardCalculator");
+    node->add_input_stream(stream);
+    stream = n + 1 < chain_length ? absl::StrCat("stream_", n) : "output";
+    node->add_output_stream(stream);
+  }
+  return config;
+}
+
+// Sends packets through a chain one at a time and returns the number of
+// allocations per packet, once the graph reaches a steady state. The packets
+// are created up front, so only allocations made by the framework count.
+double AllocationsPerPacket(int chain_length, int num_packets) {
+  constexpr int kNumWarmUpPackets = 100;
+  CalculatorGraph graph(ChainConfig(chain_length));
+  int num_outputs = 0;
+  MEDIAPIPE_CHECK_OK(
+      graph.ObserveOutputStream("output", [&num_outputs](const Packet&) {
+        ++num_outputs;
+        return ::mediapipe::OkStatus();
+      }));
+  std::vector<Packet> packets;
+  for (int i = 0; i < kNumWarmUpPackets + num_packets; ++i) {
+    packets.push_back(MakePacket<int>(i).At(Timestamp(i)));
+  }
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  int64 start_allocations = 0;
+  for (int i = 0; i < packets.size(); ++i) {
+    if (i == kNumWarmUpPackets) {
+      start_allocations = num_allocations.load();
+    }
+    MEDIAPIPE_CHECK_OK(
+        graph.AddPacketToInputStream("input", std::move(packets[i])));
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+  }
+  const int64 end_allocations = num_allocations.load();
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  CHECK_EQ(packets.size(), num_outputs);
+  return static_cast<double>(end_allocations - start_allocations) /
+         num_packets;
+}
+
+// The graph itself allocates for every packet it receives, notifies about or
+// waits on, but passing a packet from one node to the next does not allocate.
+// What remains per node is the occasional new block of the std::deque based
+// input queues.
+TEST(PacketPropagationTest, NodesDoNotAllocatePerPacket) {
+  constexpr int kNumPackets = 1000;
+  const double single_node = AllocationsPerPacket(1, kNumPackets);
+  const double ten_nodes = AllocationsPerPacket(10, kNumPackets);
+  EXPECT_LT((ten_nodes - single_node) / 9, 0.5);
+}
+
+// Reports the allocations per packet through a chain of state.range(0)
+// nodes.
+void BM_ChainAllocations(benchmark::State& state) {
+  const int chain_length = state.range(0);
+  double allocations_per_packet = 0;
+  for (auto _ : state) {
+    allocations_per_packet = AllocationsPerPacket(chain_length, 1000);
+  }
+  state.counters["allocs_per_packet"] = allocations_per_packet;
+  state.counters["allocs_per_node"] = allocations_per_packet / chain_length;
+}
+
+BENCHMARK(BM_ChainAllocations)->Arg(1)->Arg(10);
+
+}  // namespace
+}  // namespace mediapipe
@@ -14,9 +14,11 @@
 
 #include "mediapipe/framework/profiler/graph_profiler.h"
 
+#include <algorithm>
 #include <fstream>
 #include <list>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
@@ -27,6 +29,7 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/profiler/profiler_resource_util.h"
+#include "mediapipe/framework/profiler/trace_stream.h"
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/validate_name.h"
 
@@ -43,6 +46,8 @@ const char kDefaultLogFilePrefix[] = "mediapipe_trace_";
 // The number of recent timestamps tracked for each input stream.
 const int kPacketInfoRecentCount = 100;
 
+const int kDefaultQueueSizeSampleCount = 100;
+
 std::string PacketIdToString(const PacketId& packet_id) {
   return absl::Substitute("stream_name: $0, timestamp_usec: $1",
                           packet_id.stream_name, packet_id.timestamp_usec);
@@ -75,13 +80,50 @@ bool IsTraceLogEnabled(const ProfilerConfig& profiler_config) {
          !profiler_config.trace_log_disabled();
 }
 
+// Returns true if trace events are written continuously to binary files.
+bool IsTraceStreamingEnabled(const ProfilerConfig& profiler_config) {
+  return IsTraceLogEnabled(profiler_config) &&
+         profiler_config.trace_log_streaming();
+}
+
 // Returns true if trace events are written periodically.
 bool IsTraceIntervalEnabled(const ProfilerConfig& profiler_config,
                             GraphTracer* tracer) {
-  return IsTraceLogEnabled(profiler_config) && tracer &&
+  return IsTraceLogEnabled(profiler_config) &&
+         !IsTraceStreamingEnabled(profiler_config) && tracer &&
          absl::ToInt64Microseconds(tracer->GetTraceLogInterval()) != -1;
 }
 
+// Returns true if latency percentiles are recorded.
+bool IsLatencyPercentilesEnabled(const ProfilerConfig& profiler_config) {
+  return IsProfilerEnabled(profiler_config) &&
+         profiler_config.enable_latency_percentiles();
+}
+
+// Returns true if input stream queue sizes are sampled.
+bool IsQueueSizeSamplingEnabled(const ProfilerConfig& profiler_config) {
+  return IsProfilerEnabled(profiler_config) &&
+         profiler_config.queue_size_sample_interval_usec() > 0;
+}
+
+int GetQueueSizeSampleCount(const ProfilerConfig& profiler_config) {
+  return profiler_config.queue_size_sample_count()
+             ? profiler_config.queue_size_sample_count()
+             : kDefaultQueueSizeSampleCount;
+}
+
+void FillLatencyPercentiles(const LatencyHistogram& histogram,
+                            LatencyPercentiles* percentiles) {
+  percentiles->set_count(histogram.Count());
+  percentiles->set_min(histogram.Min());
+  percentiles->set_max(histogram.Max());
+  percentiles->set_mean(histogram.Mean());
+  percentiles->set_p50(histogram.ValueAtPercentile(50));
+  percentiles->set_p90(histogram.ValueAtPercentile(90));
+  percentiles->set_p99(histogram.ValueAtPercentile(99));
+  percentiles->set_p999(histogram.ValueAtPercentile(99.9));
+}
+
 using PacketInfoMap =
     ShardedMap<std::string, std::list<std::pair<int64, PacketInfo>>>;
 
@@ -138,19 +180,33 @@ void GraphProfiler::Initialize(
     profile.set_name(node_name);
     InitializeTimeHistogram(interval_size_usec, num_intervals,
                             profile.mutable_process_runtime());
+    const CalculatorGraphConfig::Node& node_config =
+        validated_graph_config.Config().node(node_id);
     if (profiler_config_.enable_stream_latency()) {
       InitializeTimeHistogram(interval_size_usec, num_intervals,
                               profile.mutable_process_input_latency());
       InitializeTimeHistogram(interval_size_usec, num_intervals,
                               profile.mutable_process_output_latency());
-
-      const CalculatorGraphConfig::Node& node_config =
-          validated_graph_config.Config().node(node_id);
       InitializeOutputStreams(node_config);
+    }
+    if (profiler_config_.enable_stream_latency() ||
+        IsQueueSizeSamplingEnabled(profiler_config_)) {
       InitializeInputStreams(node_config, interval_size_usec, num_intervals,
                              &profile);
     }
 
+    auto stats = absl::make_unique<NodeStats>();
+    stats->input_stream_base_index =
+        validated_graph_config.CalculatorInfos()[node_id]
+            .InputStreamBaseIndex();
+    {
+      absl::MutexLock stats_lock(&stats->mutex);
+      stats->queue_size_samples.resize(node_config.input_stream_size());
+      stats->max_queue_sizes.resize(node_config.input_stream_size(), 0);
+    }
+    node_stats_.push_back(std::move(stats));
+    node_ids_[node_name] = node_id;
+
     auto iter = calculator_profiles_.insert({node_name, profile});
     CHECK(iter.second) << absl::Substitute(
         "Calculator \"$0\" has already been added.", node_name);
@@ -195,12 +251,27 @@ void GraphProfiler::Reset() {
       ResetTimeHistogram(input_stream_profile.mutable_latency());
     }
   }
+  for (auto& stats : node_stats_) {
+    stats->process_runtime.Reset();
+    stats->queueing_delay.Reset();
+    absl::MutexLock stats_lock(&stats->mutex);
+    stats->ready_times.clear();
+    for (auto& samples : stats->queue_size_samples) {
+      samples.clear();
+    }
+    std::fill(stats->max_queue_sizes.begin(), stats->max_queue_sizes.end(), 0);
+  }
 }
 
 // Begins profiling for a single graph run.
 ::mediapipe::Status GraphProfiler::Start(::mediapipe::Executor* executor) {
+  run_start_usec_ = TimeNowUsec();
   // If specified, start periodic profile output while the graph runs.
   Resume();
+  if (is_tracing_ && IsTraceStreamingEnabled(profiler_config_) &&
+      !tracer()->GetStreamWriter()) {
+    MP_RETURN_IF_ERROR(StartTraceStream());
+  }
   if (is_tracing_ && IsTraceIntervalEnabled(profiler_config_, tracer()) &&
       executor != nullptr) {
     is_running_ = true;
@@ -222,6 +293,9 @@ void GraphProfiler::Reset() {
 ::mediapipe::Status GraphProfiler::Stop() {
   is_running_ = false;
   Pause();
+  if (tracer() && tracer()->GetStreamWriter()) {
+    MP_RETURN_IF_ERROR(tracer()->GetStreamWriter()->Flush());
+  }
   // If specified, write a final profile.
   if (IsTraceLogEnabled(profiler_config_)) {
     MP_RETURN_IF_ERROR(WriteProfile());
@@ -248,6 +322,30 @@ void GraphProfiler::LogEvent(const TraceEvent& event) {
   }
 }
 
+void GraphProfiler::AddReadyTime(int node_id, Timestamp input_timestamp) {
+  if (!IsLatencyPercentilesEnabled(profiler_config_)) {
+    return;
+  }
+  absl::ReaderMutexLock lock(&profiler_mutex_);
+  if (!is_profiling_ || node_id < 0 ||
+      node_id >= static_cast<int>(node_stats_.size())) {
+    return;
+  }
+  NodeStats* stats = node_stats_[node_id].get();
+  int64 time_usec = TimeNowUsec();
+  absl::MutexLock stats_lock(&stats->mutex);
+  stats->ready_times.push_back({input_timestamp.Value(), time_usec});
+  while (stats->ready_times.size() > kPacketInfoRecentCount) {
+    stats->ready_times.pop_front();
+  }
+}
+
+void GraphProfiler::SetQueueSizeCallback(
+    std::function<int(int)> queue_size_callback) {
+  absl::WriterMutexLock lock(&profiler_mutex_);
+  queue_size_callback_ = std::move(queue_size_callback);
+}
+
 void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
   absl::ReaderMutexLock lock(&profiler_mutex_);
   if (!is_profiling_) {
@@ -283,10 +381,40 @@ void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
       << "GetCalculatorProfiles can only be called after Initialize()";
   for (auto& entry : calculator_profiles_) {
     profiles->push_back(entry.second);
+    FillNodeStats(&profiles->back());
   }
   return ::mediapipe::OkStatus();
 }
 
+void GraphProfiler::FillNodeStats(CalculatorProfile* calculator_profile) const {
+  auto id_iter = node_ids_.find(calculator_profile->name());
+  if (id_iter == node_ids_.end()) {
+    return;
+  }
+  NodeStats* stats = node_stats_[id_iter->second].get();
+  if (IsLatencyPercentilesEnabled(profiler_config_)) {
+    FillLatencyPercentiles(
+        stats->process_runtime,
+        calculator_profile->mutable_process_runtime_percentiles());
+    FillLatencyPercentiles(
+        stats->queueing_delay,
+        calculator_profile->mutable_queueing_delay_percentiles());
+  }
+  if (IsQueueSizeSamplingEnabled(profiler_config_)) {
+    absl::MutexLock stats_lock(&stats->mutex);
+    for (int i = 0; i < calculator_profile->input_stream_profiles_size() &&
+                    i < stats->queue_size_samples.size();
+         ++i) {
+      StreamProfile* stream_profile =
+          calculator_profile->mutable_input_stream_profiles(i);
+      for (const QueueSizeSample& sample : stats->queue_size_samples[i]) {
+        *stream_profile->add_queue_size_samples() = sample;
+      }
+      stream_profile->set_max_queue_size(stats->max_queue_sizes[i]);
+    }
+  }
+}
+
 void GraphProfiler::InitializeTimeHistogram(int64 interval_size_usec,
                                             int64 num_intervals,
                                             TimeHistogram* histogram) {
@@ -396,6 +524,7 @@ void GraphProfiler::SetOpenRuntime(const CalculatorContext& calculator_context,
       calculator_context.NodeName());
   CalculatorProfile* calculator_profile = &profile_iter->second;
   calculator_profile->set_open_runtime(time_usec);
+  calculator_profile->set_open_latency(end_time_usec - run_start_usec_);
 
   if (profiler_config_.enable_stream_latency()) {
     AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
@@ -503,6 +632,70 @@ void GraphProfiler::AddProcessSample(
     AddTimeSample(min_source_process_start_usec, end_time_usec,
                   calculator_profile->mutable_process_output_latency());
   }
+
+  if (IsLatencyPercentilesEnabled(profiler_config_)) {
+    AddLatencySamples(calculator_context, start_time_usec, end_time_usec);
+  }
+  if (IsQueueSizeSamplingEnabled(profiler_config_)) {
+    MaybeSampleQueueSizes(end_time_usec);
+  }
+}
+
+void GraphProfiler::AddLatencySamples(
+    const CalculatorContext& calculator_context, int64 start_time_usec,
+    int64 end_time_usec) {
+  int node_id = calculator_context.NodeId();
+  if (node_id < 0 || node_id >= static_cast<int>(node_stats_.size())) {
+    return;
+  }
+  NodeStats* stats = node_stats_[node_id].get();
+  stats->process_runtime.Record(end_time_usec - start_time_usec);
+
+  // Source nodes have no ready times, and are not counted.
+  int64 input_timestamp = calculator_context.InputTimestamp().Value();
+  int64 ready_time_usec = -1;
+  {
+    absl::MutexLock stats_lock(&stats->mutex);
+    auto& ready_times = stats->ready_times;
+    while (!ready_times.empty() &&
+           ready_times.front().first < input_timestamp) {
+      ready_times.pop_front();
+    }
+    if (!ready_times.empty() && ready_times.front().first == input_timestamp) {
+      ready_time_usec = ready_times.front().second;
+      ready_times.pop_front();
+    }
+  }
+  if (ready_time_usec >= 0) {
+    stats->queueing_delay.Record(start_time_usec - ready_time_usec);
+  }
+}
+
+void GraphProfiler::MaybeSampleQueueSizes(int64 time_usec) {
+  int64 next_sample_usec = next_queue_size_sample_usec_;
+  if (time_usec < next_sample_usec || !queue_size_callback_ ||
+      !next_queue_size_sample_usec_.compare_exchange_strong(
+          next_sample_usec,
+          time_usec + profiler_config_.queue_size_sample_interval_usec())) {
+    return;
+  }
+  const int sample_count = GetQueueSizeSampleCount(profiler_config_);
+  for (auto& stats : node_stats_) {
+    absl::MutexLock stats_lock(&stats->mutex);
+    for (int i = 0; i < stats->queue_size_samples.size(); ++i) {
+      QueueSizeSample sample;
+      sample.set_time_usec(time_usec);
+      sample.set_queue_size(
+          queue_size_callback_(stats->input_stream_base_index + i));
+      auto& samples = stats->queue_size_samples[i];
+      samples.push_back(sample);
+      while (static_cast<int>(samples.size()) > sample_count) {
+        samples.pop_front();
+      }
+      stats->max_queue_sizes[i] =
+          std::max(stats->max_queue_sizes[i], sample.queue_size());
+    }
+  }
 }
 
 std::unique_ptr<GlProfilingHelper> GraphProfiler::CreateGlProfilingHelper() {
@@ -570,6 +763,30 @@ void AssignNodeNames(GraphProfile* profile) {
   }
 }
 
+::mediapipe::Status GraphProfiler::StartTraceStream() {
+  ASSIGN_OR_RETURN(std::string trace_log_path, GetTraceLogPath());
+  TraceStreamWriter::Options options;
+  options.path_prefix = absl::StrCat(trace_log_path, "stream_");
+  options.file_count = GetLogFileCount(profiler_config_);
+  if (profiler_config_.trace_log_stream_file_size()) {
+    options.file_size = profiler_config_.trace_log_stream_file_size();
+  }
+  std::vector<std::string> node_names;
+  for (int i = 0; i < validated_graph_->CalculatorInfos().size(); ++i) {
+    node_names.push_back(CanonicalNodeName(validated_graph_->Config(), i));
+  }
+  std::vector<std::string> stream_names;
+  for (const EdgeInfo& stream : validated_graph_->OutputStreamInfos()) {
+    stream_names.push_back(stream.name);
+  }
+  ASSIGN_OR_RETURN(auto writer,
+                   TraceStreamWriter::Create(options, std::move(node_names),
+                                             std::move(stream_names)));
+  LOG(INFO) << "trace_log_path: " << writer->CurrentPath();
+  tracer()->SetStreamWriter(std::move(writer));
+  return ::mediapipe::OkStatus();
+}
+
 ::mediapipe::Status GraphProfiler::WriteProfile() {
   if (profiler_config_.trace_log_disabled()) {
     // Logging is disabled, so we can exit writing without error.
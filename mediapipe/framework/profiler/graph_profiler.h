@@ -17,9 +17,13 @@
 
 #include <atomic>
 #include <cstddef>
+#include <deque>
+#include <functional>
+#include <list>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/time/time.h"
@@ -31,6 +35,7 @@
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/profiler/graph_tracer.h"
+#include "mediapipe/framework/profiler/latency_histogram.h"
 #include "mediapipe/framework/profiler/sharded_map.h"
 #include "mediapipe/framework/validated_graph_config.h"
 
@@ -80,6 +85,10 @@ class GraphProfilerTestPeer;
 // the graph (source nodes) to reach the Calculator.
 // - Process input latency: Process input latency + process runtime for a
 // packet.
+// - Optionally, percentiles of the Process() runtime and of the queueing
+// delay: Time from when an input set became ready to when Process() was
+// called for it.
+// - Optionally, recent samples of the input stream queue sizes.
 //
 // The profiler can be configured in the graph definition:
 //   profiler_config {
@@ -153,6 +162,17 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   ::mediapipe::Status GetCalculatorProfiles(
       std::vector<CalculatorProfile>*) const LOCKS_EXCLUDED(profiler_mutex_);
 
+  // Records when the input set for `input_timestamp` of a calculator became
+  // ready for Process(). Used to measure the queueing delay.
+  void AddReadyTime(int node_id, Timestamp input_timestamp)
+      LOCKS_EXCLUDED(profiler_mutex_);
+
+  // Sets the function that returns the number of packets queued in an input
+  // stream, given the index of the stream in
+  // ValidatedGraphConfig::InputStreamInfos(). It is used to sample queue sizes
+  // if ProfilerConfig.queue_size_sample_interval_usec is set.
+  void SetQueueSizeCallback(std::function<int(int)> queue_size_callback);
+
   // Writes recent profiling and tracing data to a file specified in the
   // ProfilerConfig.  Includes events since the previous call to WriteProfile.
   ::mediapipe::Status WriteProfile();
@@ -291,11 +311,24 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
                         int64 start_time_usec, int64 end_time_usec)
       LOCKS_EXCLUDED(profiler_mutex_);
 
+  // Updates the latency percentiles of a calculator for one Process() call.
+  void AddLatencySamples(const CalculatorContext& calculator_context,
+                         int64 start_time_usec, int64 end_time_usec);
+
+  // Samples the input stream queue sizes, if the sample interval has passed.
+  void MaybeSampleQueueSizes(int64 time_usec);
+
+  // Copies the latency percentiles and queue size samples into a profile.
+  void FillNodeStats(CalculatorProfile* calculator_profile) const;
+
   // Helper method to get trace_log_path.  If the trace_log_path is empty and
   // tracing is enabled, this function returns a default platform dependent
   // trace_log_path.
   ::mediapipe::StatusOr<std::string> GetTraceLogPath();
 
+  // Starts writing trace events continuously to binary trace log files.
+  ::mediapipe::Status StartTraceStream();
+
   // Helper method to get the clock time in microsecond.
   int64 TimeNowUsec() { return ToUnixMicros(clock_->TimeNow()); }
 
@@ -320,6 +353,31 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
       ShardedMap<std::string, std::list<std::pair<int64, PacketInfo>>>;
   PacketInfoMap packets_info_;
 
+  // Latency percentiles and queue size samples for one calculator.
+  struct NodeStats {
+    // The index of the first input stream in InputStreamInfos().
+    int input_stream_base_index = 0;
+    LatencyHistogram process_runtime;
+    LatencyHistogram queueing_delay;
+    absl::Mutex mutex;
+    // Recent input timestamps that became ready for Process(), and the times
+    // when they became ready, in order.
+    std::deque<std::pair<int64, int64>> ready_times GUARDED_BY(mutex);
+    // Recent queue size samples, for each input stream.
+    std::vector<std::deque<QueueSizeSample>> queue_size_samples
+        GUARDED_BY(mutex);
+    std::vector<int> max_queue_sizes GUARDED_BY(mutex);
+  };
+  // The stats for each calculator, indexed by node id.
+  std::vector<std::unique_ptr<NodeStats>> node_stats_;
+  // The node id for each calculator name.
+  std::unordered_map<std::string, int> node_ids_;
+
+  // Returns the number of packets queued in an input stream.
+  std::function<int(int)> queue_size_callback_;
+  // The earliest time for the next queue size sample.
+  std::atomic<int64> next_queue_size_sample_usec_{0};
+
   // Global mutex for the profiler.
   mutable absl::Mutex profiler_mutex_;
 
@@ -332,6 +390,9 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // Inidicates that profiling has started and not yet stopped.
   std::atomic_bool is_running_;
 
+  // The time when the current graph run started, for open_latency.
+  std::atomic<int64> run_start_usec_{0};
+
   // The end time of the previous output log.
   absl::Time previous_log_end_time_;
 
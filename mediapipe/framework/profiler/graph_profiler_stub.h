@@ -15,6 +15,8 @@
 #ifndef MEDIAPIPE_FRAMEWORK_PROFILER_MEDIAPIPE_PROFILER_STUB_H_
 #define MEDIAPIPE_FRAMEWORK_PROFILER_MEDIAPIPE_PROFILER_STUB_H_
 
+#include <functional>
+
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/timestamp.h"
 
@@ -78,6 +80,8 @@ class GraphProfilerStub {
   inline void Initialize(const ValidatedGraphConfig& validated_graph_config) {}
   inline void SetClock(const std::shared_ptr<mediapipe::Clock>& clock) {}
   inline void LogEvent(const TraceEvent& event) {}
+  inline void AddReadyTime(int node_id, Timestamp input_timestamp) {}
+  inline void SetQueueSizeCallback(std::function<int(int)> callback) {}
   inline ::mediapipe::Status GetCalculatorProfiles(
       std::vector<CalculatorProfile>*) const {
     return mediapipe::OkStatus();
@@ -1205,5 +1205,77 @@ TEST(GraphProfilerTest, ParallelReads) {
   EXPECT_EQ(1001, out_1_packets.size());
 }
 
+// Checks the latency percentiles and the queue size samples reported for
+// each calculator.
+TEST(GraphProfilerTest, LatencyPercentilesAndQueueSizes) {
+  CalculatorGraphConfig config = CreateGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      enable_latency_percentiles: true
+      queue_size_sample_interval_usec: 1
+      queue_size_sample_count: 10
+    }
+    node {
+      calculator: "RangeCalculator"
+      input_side_packet: "range_step"
+      output_stream: "out"
+      output_stream: "sum"
+      output_stream: "mean"
+    }
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "out"
+      input_stream: "sum"
+      input_stream: "mean"
+      output_stream: "out_1"
+      output_stream: "sum_1"
+      output_stream: "mean_1"
+    }
+    )");
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  MP_ASSERT_OK(graph.Run(
+      {{"range_step", MakePacket<std::pair<uint32, uint32>>(1000, 1)}}));
+  std::vector<CalculatorProfile> profiles;
+  MP_ASSERT_OK(graph.profiler()->GetCalculatorProfiles(&profiles));
+
+  // Source calculators have no queueing delay.
+  CalculatorProfile range = GetProfileWithName(profiles, "RangeCalculator");
+  EXPECT_EQ(1000, range.process_runtime_percentiles().count());
+  EXPECT_EQ(0, range.queueing_delay_percentiles().count());
+  EXPECT_EQ(0, range.input_stream_profiles_size());
+
+  CalculatorProfile pass_through =
+      GetProfileWithName(profiles, "PassThroughCalculator");
+  EXPECT_EQ(1003, pass_through.process_runtime_percentiles().count());
+  const LatencyPercentiles& delay = pass_through.queueing_delay_percentiles();
+  EXPECT_EQ(1003, delay.count());
+  EXPECT_LE(delay.min(), delay.p50());
+  EXPECT_LE(delay.p50(), delay.p90());
+  EXPECT_LE(delay.p90(), delay.p99());
+  EXPECT_LE(delay.p99(), delay.p999());
+  EXPECT_LE(delay.p999(), delay.max());
+
+  ASSERT_EQ(3, pass_through.input_stream_profiles_size());
+  for (const StreamProfile& stream : pass_through.input_stream_profiles()) {
+    EXPECT_GT(stream.queue_size_samples_size(), 0);
+    EXPECT_LE(stream.queue_size_samples_size(), 10);
+    int64 previous_time_usec = 0;
+    for (const QueueSizeSample& sample : stream.queue_size_samples()) {
+      EXPECT_LE(sample.queue_size(), stream.max_queue_size());
+      EXPECT_GE(sample.time_usec(), previous_time_usec);
+      previous_time_usec = sample.time_usec();
+    }
+  }
+
+  // Reset clears the percentiles and the samples.
+  graph.profiler()->Reset();
+  profiles.clear();
+  MP_ASSERT_OK(graph.profiler()->GetCalculatorProfiles(&profiles));
+  pass_through = GetProfileWithName(profiles, "PassThroughCalculator");
+  EXPECT_EQ(0, pass_through.queueing_delay_percentiles().count());
+  EXPECT_EQ(0, pass_through.input_stream_profiles(0).queue_size_samples_size());
+}
+
 }  // namespace
 }  // namespace mediapipe
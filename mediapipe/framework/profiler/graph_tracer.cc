@@ -63,6 +63,10 @@ void GraphTracer::LogEvent(TraceEvent event) {
     return;
   }
   event.set_thread_id(GetCurrentThreadId());
+  if (stream_writer_) {
+    stream_writer_->Write(event);
+    return;
+  }
   trace_buffer_.push_back(event);
 }
 
@@ -126,6 +130,14 @@ void GraphTracer::GetLog(absl::Time begin_time, absl::Time end_time,
 
 const TraceBuffer& GraphTracer::GetTraceBuffer() { return trace_buffer_; }
 
+void GraphTracer::SetStreamWriter(std::unique_ptr<TraceStreamWriter> writer) {
+  stream_writer_ = std::move(writer);
+}
+
+TraceStreamWriter* GraphTracer::GetStreamWriter() {
+  return stream_writer_.get();
+}
+
 Timestamp GraphTracer::GetOutputTimestamp(const CalculatorContext* context) {
   for (const OutputStreamShard& out_stream : context->Outputs()) {
     for (const Packet& packet : *out_stream.OutputQueue()) {
@@ -15,6 +15,7 @@
 #ifndef MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 #define MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 
+#include <memory>
 #include <string>
 
 #include "mediapipe/framework/calculator.pb.h"
@@ -22,6 +23,7 @@
 #include "mediapipe/framework/calculator_profile.pb.h"
 #include "mediapipe/framework/profiler/trace_buffer.h"
 #include "mediapipe/framework/profiler/trace_builder.h"
+#include "mediapipe/framework/profiler/trace_stream.h"
 
 namespace mediapipe {
 
@@ -78,6 +80,13 @@ class GraphTracer {
   // Returns the logged TraceEvents.
   const TraceBuffer& GetTraceBuffer();
 
+  // Sends subsequent events to |writer| rather than to the TraceBuffer.
+  // Must be called before events are logged concurrently.
+  void SetStreamWriter(std::unique_ptr<TraceStreamWriter> writer);
+
+  // Returns the TraceStreamWriter, or nullptr if events are buffered.
+  TraceStreamWriter* GetStreamWriter();
+
  private:
   // Returns the timestamp of the first output packet.
   Timestamp GetOutputTimestamp(const CalculatorContext* context);
@@ -93,6 +102,9 @@ class GraphTracer {
 
   // The builder for the GraphTrace protobuf.
   TraceBuilder trace_builder_;
+
+  // The continuous event output, if any.
+  std::unique_ptr<TraceStreamWriter> stream_writer_;
 };
 
 }  // namespace mediapipe
@@ -620,7 +620,8 @@ TEST_F(GraphTracerE2ETest, PassThroughGraphProfile) {
         name: "LambdaCalculator"
         open_runtime: 0
         close_runtime: 0
-        input_stream_profiles { name: "input_0" back_edge: false })");
+        input_stream_profiles { name: "input_0" back_edge: false }
+        open_latency: 0)");
 
   FillHistogram({20001, 20001, 20001, 20001, 20001, 20001},
                 expected.mutable_process_runtime());
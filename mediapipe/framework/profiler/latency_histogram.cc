@@ -0,0 +1,105 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mediapipe {
+
+constexpr int64 LatencyHistogram::kMaxValue;
+constexpr int LatencyHistogram::kSubBucketBits;
+constexpr int LatencyHistogram::kSubBucketCount;
+constexpr int LatencyHistogram::kNumBuckets;
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+// static
+int LatencyHistogram::BucketIndex(int64 value) {
+  int shift = 0;
+  while ((value >> shift) >= 2 * kSubBucketCount) {
+    ++shift;
+  }
+  // The top kSubBucketBits + 1 bits of the value select the bucket.
+  return shift * kSubBucketCount + static_cast<int>(value >> shift);
+}
+
+// static
+int64 LatencyHistogram::BucketLimit(int index) {
+  if (index < 2 * kSubBucketCount) {
+    return index;
+  }
+  int shift = index / kSubBucketCount - 1;
+  int64 mantissa = index % kSubBucketCount + kSubBucketCount;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64 value) {
+  value = std::min(std::max(value, int64{0}), kMaxValue);
+  counts_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  int64 min = min_.load(std::memory_order_relaxed);
+  while (value < min && !min_.compare_exchange_weak(min, value)) {
+  }
+  int64 max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value)) {
+  }
+  // Incremented last, so that a reader seeing a sample count also sees it
+  // in a bucket.
+  count_.fetch_add(1, std::memory_order_release);
+}
+
+void LatencyHistogram::Reset() {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  count_ = 0;
+  sum_ = 0;
+  min_ = kMaxValue;
+  max_ = 0;
+}
+
+int64 LatencyHistogram::Min() const {
+  return Count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+int64 LatencyHistogram::Max() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+int64 LatencyHistogram::Mean() const {
+  int64 count = Count();
+  return count == 0 ? 0 : sum_.load(std::memory_order_relaxed) / count;
+}
+
+int64 LatencyHistogram::ValueAtPercentile(double percentile) const {
+  int64 count = count_.load(std::memory_order_acquire);
+  if (count == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  int64 target = std::max(
+      int64{1}, static_cast<int64>(std::ceil(percentile / 100.0 * count)));
+  int64 seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      return std::max(std::min(BucketLimit(i), Max()), Min());
+    }
+  }
+  return Max();
+}
+
+}  // namespace mediapipe
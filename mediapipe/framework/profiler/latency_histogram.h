@@ -0,0 +1,84 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_LATENCY_HISTOGRAM_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_LATENCY_HISTOGRAM_H_
+
+#include <atomic>
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A histogram of latencies in microseconds with log-linear buckets, in the
+// style of HdrHistogram. Values below 64 are counted exactly, and larger
+// values fall into one of 32 equal buckets per power of two, so reported
+// percentiles are within about 3% of the recorded values. Values are clamped
+// to kMaxValue.
+//
+// Record() is lock-free and may be called from any number of threads.
+// Readers see a consistent count for each bucket, but not necessarily a
+// snapshot across buckets taken at one instant.
+class LatencyHistogram {
+ public:
+  // The largest value tracked, about 12.7 days in microseconds.
+  static constexpr int64 kMaxValue = (int64{1} << 40) - 1;
+
+  LatencyHistogram();
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Adds one sample. Negative values are counted as 0.
+  void Record(int64 value);
+
+  // Removes all samples.
+  void Reset();
+
+  // The number of samples recorded.
+  int64 Count() const { return count_.load(std::memory_order_relaxed); }
+
+  // The smallest and largest samples, or 0 if there are none.
+  int64 Min() const;
+  int64 Max() const;
+
+  // The mean of the samples, or 0 if there are none.
+  int64 Mean() const;
+
+  // Returns the smallest bucket limit at or below which `percentile` percent
+  // of the samples fall, for `percentile` in [0, 100]. Returns 0 if there are
+  // no samples.
+  int64 ValueAtPercentile(double percentile) const;
+
+ private:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+  // Buckets for the values below 2 * kSubBucketCount, and kSubBucketCount
+  // buckets for each power of two up to kMaxValue.
+  static constexpr int kNumBuckets =
+      (40 - kSubBucketBits + 1) * kSubBucketCount;
+
+  static int BucketIndex(int64 value);
+  // The largest value counted in a bucket.
+  static int64 BucketLimit(int index);
+
+  std::atomic<int64> counts_[kNumBuckets];
+  std::atomic<int64> count_{0};
+  std::atomic<int64> sum_{0};
+  std::atomic<int64> min_;
+  std::atomic<int64> max_{0};
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,106 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/latency_histogram.h"
+
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.Count());
+  EXPECT_EQ(0, histogram.Min());
+  EXPECT_EQ(0, histogram.Max());
+  EXPECT_EQ(0, histogram.Mean());
+  EXPECT_EQ(0, histogram.ValueAtPercentile(50));
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 50; ++i) {
+    histogram.Record(i);
+  }
+  EXPECT_EQ(50, histogram.Count());
+  EXPECT_EQ(1, histogram.Min());
+  EXPECT_EQ(50, histogram.Max());
+  EXPECT_EQ(25, histogram.Mean());
+  EXPECT_EQ(25, histogram.ValueAtPercentile(50));
+  EXPECT_EQ(45, histogram.ValueAtPercentile(90));
+  EXPECT_EQ(50, histogram.ValueAtPercentile(99));
+  EXPECT_EQ(1, histogram.ValueAtPercentile(0));
+  EXPECT_EQ(50, histogram.ValueAtPercentile(100));
+}
+
+TEST(LatencyHistogramTest, LargeValuesAreWithinRelativeError) {
+  LatencyHistogram histogram;
+  for (int64 i = 1; i <= 100000; ++i) {
+    histogram.Record(i * 10);
+  }
+  for (double percentile : {50.0, 90.0, 99.0, 99.9}) {
+    double expected = percentile / 100.0 * 1000000;
+    EXPECT_NEAR(expected, histogram.ValueAtPercentile(percentile),
+                expected * 0.04)
+        << percentile;
+  }
+  EXPECT_EQ(10, histogram.Min());
+  EXPECT_EQ(1000000, histogram.Max());
+  EXPECT_EQ(1000000, histogram.ValueAtPercentile(100));
+}
+
+TEST(LatencyHistogramTest, ClampsValues) {
+  LatencyHistogram histogram;
+  histogram.Record(-5);
+  histogram.Record(LatencyHistogram::kMaxValue * 2);
+  EXPECT_EQ(2, histogram.Count());
+  EXPECT_EQ(0, histogram.Min());
+  EXPECT_EQ(LatencyHistogram::kMaxValue, histogram.Max());
+  EXPECT_EQ(LatencyHistogram::kMaxValue, histogram.ValueAtPercentile(100));
+}
+
+TEST(LatencyHistogramTest, Reset) {
+  LatencyHistogram histogram;
+  histogram.Record(100);
+  histogram.Reset();
+  EXPECT_EQ(0, histogram.Count());
+  EXPECT_EQ(0, histogram.Max());
+  histogram.Record(7);
+  EXPECT_EQ(7, histogram.Min());
+  EXPECT_EQ(7, histogram.ValueAtPercentile(50));
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecords) {
+  LatencyHistogram histogram;
+  {
+    ThreadPool pool(4);
+    pool.StartWorkers();
+    for (int t = 0; t < 4; ++t) {
+      pool.Schedule([&histogram] {
+        for (int i = 0; i < 10000; ++i) {
+          histogram.Record(i % 100);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(40000, histogram.Count());
+  EXPECT_EQ(0, histogram.Min());
+  EXPECT_EQ(99, histogram.Max());
+  EXPECT_EQ(49, histogram.ValueAtPercentile(50));
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,460 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/trace_stream.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/timestamp.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kTraceFileMagic[8] = "MPTRACE";
+constexpr uint32 kTraceFileVersion = 1;
+constexpr int kRecordsAlignment = 64;
+
+std::atomic<uint64> next_writer_id(1);
+std::atomic<uint64> next_thread_number(0);
+
+// Returns a unique number for the current thread.
+uint64 CurrentThreadNumber() {
+  static thread_local uint64 thread_number = next_thread_number++;
+  return thread_number;
+}
+
+// The size of a list of names, as written to a trace file.
+int64 NamesSize(const std::vector<std::string>& names) {
+  int64 size = sizeof(uint32);
+  for (const std::string& name : names) {
+    size += sizeof(uint32) + name.size();
+  }
+  return size;
+}
+
+uint8* WriteNames(const std::vector<std::string>& names, uint8* out) {
+  uint32 count = names.size();
+  std::memcpy(out, &count, sizeof(count));
+  out += sizeof(count);
+  for (const std::string& name : names) {
+    uint32 length = name.size();
+    std::memcpy(out, &length, sizeof(length));
+    out += sizeof(length);
+    std::memcpy(out, name.data(), length);
+    out += length;
+  }
+  return out;
+}
+
+::mediapipe::Status ReadNames(const std::string& data, int64* offset,
+                              std::vector<std::string>* names) {
+  uint32 count;
+  RET_CHECK_LE(*offset + sizeof(count), data.size());
+  std::memcpy(&count, data.data() + *offset, sizeof(count));
+  *offset += sizeof(count);
+  for (uint32 i = 0; i < count; ++i) {
+    uint32 length;
+    RET_CHECK_LE(*offset + sizeof(length), data.size());
+    std::memcpy(&length, data.data() + *offset, sizeof(length));
+    *offset += sizeof(length);
+    RET_CHECK_LE(*offset + length, data.size());
+    names->push_back(data.substr(*offset, length));
+    *offset += length;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+std::string ErrnoMessage(const std::string& action, const std::string& path) {
+  return absl::StrCat("Could not ", action, " trace file ", path, ": ",
+                      std::strerror(errno));
+}
+
+// Appends `text` as a JSON string literal.
+void AppendJsonString(const std::string& text, std::string* json) {
+  json->push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppend(json, "\\u00", absl::Hex(c, absl::kZeroPad2));
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+std::string TimestampString(int64 value) {
+  return Timestamp::CreateNoErrorChecking(value).DebugString();
+}
+
+}  // namespace
+
+// static
+::mediapipe::StatusOr<std::unique_ptr<TraceStreamWriter>>
+TraceStreamWriter::Create(const Options& options,
+                          std::vector<std::string> node_names,
+                          std::vector<std::string> stream_names) {
+  RET_CHECK(!options.path_prefix.empty());
+  RET_CHECK_GT(options.file_count, 0);
+  RET_CHECK(options.thread_buffer_size > 0 &&
+            (options.thread_buffer_size & (options.thread_buffer_size - 1)) ==
+                0)
+      << "thread_buffer_size must be a power of 2.";
+  std::unique_ptr<TraceStreamWriter> writer(new TraceStreamWriter(
+      options, std::move(node_names), std::move(stream_names)));
+  {
+    absl::MutexLock lock(&writer->file_mutex_);
+    MP_RETURN_IF_ERROR(writer->OpenNextFile());
+  }
+  writer->flush_thread_ = absl::make_unique<ThreadPool>("mediapipe_trace", 1);
+  writer->flush_thread_->StartWorkers();
+  TraceStreamWriter* raw_writer = writer.get();
+  writer->flush_thread_->Schedule([raw_writer] { raw_writer->RunFlushLoop(); });
+  return std::move(writer);
+}
+
+TraceStreamWriter::TraceStreamWriter(const Options& options,
+                                     std::vector<std::string> node_names,
+                                     std::vector<std::string> stream_names)
+    : options_(options),
+      node_names_(std::move(node_names)),
+      stream_names_(std::move(stream_names)),
+      writer_id_(next_writer_id++) {
+  for (int i = 0; i < stream_names_.size(); ++i) {
+    stream_indexes_.insert({stream_names_[i], i});
+  }
+}
+
+TraceStreamWriter::~TraceStreamWriter() {
+  {
+    absl::MutexLock lock(&flush_loop_mutex_);
+    stopping_ = true;
+    flush_loop_cond_.Signal();
+  }
+  // Waits for the flush loop to return.
+  flush_thread_.reset();
+  ::mediapipe::Status status = Flush();
+  LOG_IF(ERROR, !status.ok()) << status;
+  absl::MutexLock lock(&file_mutex_);
+  CloseFile();
+}
+
+TraceStreamWriter::ThreadBuffer* TraceStreamWriter::GetThreadBuffer() {
+  // Caches the ring of the most recently used writer.
+  static thread_local uint64 cached_writer_id = 0;
+  static thread_local ThreadBuffer* cached_buffer = nullptr;
+  if (cached_writer_id == writer_id_) {
+    return cached_buffer;
+  }
+  absl::MutexLock lock(&buffers_mutex_);
+  std::unique_ptr<ThreadBuffer>& buffer = buffers_[CurrentThreadNumber()];
+  if (!buffer) {
+    buffer = absl::make_unique<ThreadBuffer>(options_.thread_buffer_size);
+  }
+  cached_writer_id = writer_id_;
+  cached_buffer = buffer.get();
+  return cached_buffer;
+}
+
+void TraceStreamWriter::Write(const TraceEvent& event) {
+  ThreadBuffer* buffer = GetThreadBuffer();
+  const uint64 head = buffer->head.load(std::memory_order_relaxed);
+  if (head - buffer->tail.load(std::memory_order_acquire) >=
+      static_cast<uint64>(options_.thread_buffer_size)) {
+    num_dropped_events_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TraceRecord& record =
+      buffer->records[head & (options_.thread_buffer_size - 1)];
+  record.event_time_usec = absl::ToUnixMicros(event.event_time);
+  record.input_ts = event.input_ts.Value();
+  record.packet_ts = event.packet_ts.Value();
+  record.packet_data_id = reinterpret_cast<uint64>(event.packet_data_id);
+  record.node_id = event.node_id;
+  record.stream_index = -1;
+  if (event.stream_id) {
+    auto it = stream_indexes_.find(*event.stream_id);
+    if (it != stream_indexes_.end()) {
+      record.stream_index = it->second;
+    }
+  }
+  record.thread_id = event.thread_id;
+  record.event_type = static_cast<uint8>(event.event_type);
+  record.is_finish = event.is_finish;
+  record.reserved = 0;
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+::mediapipe::Status TraceStreamWriter::Flush() {
+  absl::MutexLock file_lock(&file_mutex_);
+  if (!header_) {
+    // The previous file could not be opened.
+    MP_RETURN_IF_ERROR(OpenNextFile());
+  }
+  absl::MutexLock buffers_lock(&buffers_mutex_);
+  const uint64 mask = options_.thread_buffer_size - 1;
+  for (auto& entry : buffers_) {
+    ThreadBuffer* buffer = entry.second.get();
+    uint64 tail = buffer->tail.load(std::memory_order_relaxed);
+    const uint64 head = buffer->head.load(std::memory_order_acquire);
+    while (tail < head) {
+      if (header_->num_records == max_records_) {
+        CloseFile();
+        MP_RETURN_IF_ERROR(OpenNextFile());
+      }
+      // Copies the longest run that is contiguous in both the ring and the
+      // file.
+      uint64 count = std::min(head - tail, max_records_ - header_->num_records);
+      count = std::min(count, options_.thread_buffer_size - (tail & mask));
+      TraceRecord* records = reinterpret_cast<TraceRecord*>(
+          mapped_ + header_->records_offset);
+      std::memcpy(records + header_->num_records,
+                  &buffer->records[tail & mask], count * sizeof(TraceRecord));
+      header_->num_records += count;
+      tail += count;
+      buffer->tail.store(tail, std::memory_order_release);
+    }
+  }
+  header_->num_dropped_events = num_dropped_events_;
+  return ::mediapipe::OkStatus();
+}
+
+std::string TraceStreamWriter::CurrentPath() {
+  absl::MutexLock lock(&file_mutex_);
+  return absl::StrCat(options_.path_prefix, file_index_, ".mptrace");
+}
+
+::mediapipe::Status TraceStreamWriter::OpenNextFile() {
+  file_index_ = (file_index_ + 1) % options_.file_count;
+  const std::string path =
+      absl::StrCat(options_.path_prefix, file_index_, ".mptrace");
+  const int64 names_end = sizeof(TraceFileHeader) + NamesSize(node_names_) +
+                          NamesSize(stream_names_);
+  const int64 records_offset =
+      (names_end + kRecordsAlignment - 1) / kRecordsAlignment *
+      kRecordsAlignment;
+  RET_CHECK_LE(records_offset + sizeof(TraceRecord), options_.file_size)
+      << "file_size is too small for the trace file header.";
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return ::mediapipe::InternalError(ErrnoMessage("open", path));
+  }
+  if (ftruncate(fd, options_.file_size) != 0) {
+    close(fd);
+    return ::mediapipe::InternalError(ErrnoMessage("resize", path));
+  }
+  void* mapped = mmap(nullptr, options_.file_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    close(fd);
+    return ::mediapipe::InternalError(ErrnoMessage("map", path));
+  }
+  fd_ = fd;
+  mapped_ = static_cast<uint8*>(mapped);
+  header_ = reinterpret_cast<TraceFileHeader*>(mapped_);
+  std::memcpy(header_->magic, kTraceFileMagic, sizeof(header_->magic));
+  header_->version = kTraceFileVersion;
+  header_->record_size = sizeof(TraceRecord);
+  header_->records_offset = records_offset;
+  header_->num_records = 0;
+  header_->num_dropped_events = num_dropped_events_;
+  uint8* names = mapped_ + sizeof(TraceFileHeader);
+  names = WriteNames(node_names_, names);
+  WriteNames(stream_names_, names);
+  max_records_ = (options_.file_size - records_offset) / sizeof(TraceRecord);
+  return ::mediapipe::OkStatus();
+}
+
+void TraceStreamWriter::CloseFile() {
+  if (!mapped_) {
+    return;
+  }
+  const int64 num_dropped_events = num_dropped_events_;
+  header_->num_dropped_events = num_dropped_events;
+  LOG_IF(WARNING, num_dropped_events > num_dropped_events_logged_)
+      << "Dropped " << num_dropped_events - num_dropped_events_logged_
+      << " trace events while writing " << options_.path_prefix
+      << file_index_ << ".mptrace, because a thread buffer of "
+      << options_.thread_buffer_size << " events was full.";
+  num_dropped_events_logged_ = num_dropped_events;
+  const int64 used_size =
+      header_->records_offset + header_->num_records * sizeof(TraceRecord);
+  munmap(mapped_, options_.file_size);
+  if (ftruncate(fd_, used_size) != 0) {
+    LOG(ERROR) << "Could not truncate trace file: " << std::strerror(errno);
+  }
+  close(fd_);
+  fd_ = -1;
+  mapped_ = nullptr;
+  header_ = nullptr;
+  max_records_ = 0;
+}
+
+void TraceStreamWriter::RunFlushLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&flush_loop_mutex_);
+      if (!stopping_) {
+        flush_loop_cond_.WaitWithTimeout(&flush_loop_mutex_,
+                                         options_.flush_interval);
+      }
+      if (stopping_) {
+        return;
+      }
+    }
+    ::mediapipe::Status status = Flush();
+    LOG_IF(ERROR, !status.ok()) << status;
+  }
+}
+
+::mediapipe::Status ReadTraceStreamFile(const std::string& path,
+                                        TraceStreamContents* contents) {
+  std::string data;
+  MP_RETURN_IF_ERROR(file::GetContents(path, &data));
+  TraceFileHeader header;
+  RET_CHECK_GE(data.size(), sizeof(header)) << "Not a trace file: " << path;
+  std::memcpy(&header, data.data(), sizeof(header));
+  RET_CHECK_EQ(0, std::memcmp(header.magic, kTraceFileMagic,
+                              sizeof(header.magic)))
+      << "Not a trace file: " << path;
+  RET_CHECK_EQ(kTraceFileVersion, header.version);
+  RET_CHECK_EQ(sizeof(TraceRecord), header.record_size);
+
+  int64 offset = sizeof(header);
+  MP_RETURN_IF_ERROR(ReadNames(data, &offset, &contents->node_names));
+  MP_RETURN_IF_ERROR(ReadNames(data, &offset, &contents->stream_names));
+  RET_CHECK_LE(offset, header.records_offset);
+  RET_CHECK_LE(header.records_offset, data.size());
+
+  // The file may be cut short if the writer did not close it.
+  const uint64 num_records = std::min<uint64>(
+      header.num_records,
+      (data.size() - header.records_offset) / sizeof(TraceRecord));
+  contents->num_dropped_events = header.num_dropped_events;
+  contents->records.resize(num_records);
+  std::memcpy(contents->records.data(), data.data() + header.records_offset,
+              num_records * sizeof(TraceRecord));
+  return ::mediapipe::OkStatus();
+}
+
+std::string TraceStreamToChromeJson(const TraceStreamContents& contents) {
+  std::vector<const TraceRecord*> records;
+  records.reserve(contents.records.size());
+  for (const TraceRecord& record : contents.records) {
+    records.push_back(&record);
+  }
+  // Each thread's records are in order, but threads are flushed in turn.
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord* a, const TraceRecord* b) {
+                     return a->event_time_usec < b->event_time_usec;
+                   });
+
+  auto node_name = [&contents](int node_id) {
+    if (node_id >= 0 && node_id < contents.node_names.size()) {
+      return contents.node_names[node_id];
+    }
+    return node_id == -1 ? std::string("graph") : absl::StrCat(node_id);
+  };
+  auto stream_name = [&contents](int stream_index) {
+    if (stream_index >= 0 && stream_index < contents.stream_names.size()) {
+      return contents.stream_names[stream_index];
+    }
+    return std::string();
+  };
+
+  std::string json = "{\"traceEvents\":[";
+  bool first = true;
+  auto append_event = [&](const TraceRecord& record, const char* phase,
+                          int64 duration_usec) {
+    if (!first) {
+      json.push_back(',');
+    }
+    first = false;
+    json.append("\n{\"name\":");
+    AppendJsonString(node_name(record.node_id), &json);
+    json.append(",\"cat\":");
+    AppendJsonString(GraphTrace::EventType_Name(
+                         static_cast<GraphTrace::EventType>(record.event_type)),
+                     &json);
+    absl::StrAppend(&json, ",\"ph\":\"", phase,
+                    "\",\"ts\":", record.event_time_usec);
+    if (duration_usec >= 0) {
+      absl::StrAppend(&json, ",\"dur\":", duration_usec);
+    } else {
+      json.append(",\"s\":\"t\"");
+    }
+    absl::StrAppend(&json, ",\"pid\":0,\"tid\":", record.thread_id,
+                    ",\"args\":{\"input_ts\":");
+    AppendJsonString(TimestampString(record.input_ts), &json);
+    json.append(",\"packet_ts\":");
+    AppendJsonString(TimestampString(record.packet_ts), &json);
+    json.append(",\"stream\":");
+    AppendJsonString(stream_name(record.stream_index), &json);
+    json.append("}}");
+  };
+
+  // A calculator method logs a start record per input packet and a finish
+  // record per output packet, on the same thread.
+  using MethodKey = std::tuple<int32, uint8, int64, int32>;
+  struct Method {
+    const TraceRecord* start;
+    bool finished;
+  };
+  std::map<MethodKey, Method> methods;
+  for (const TraceRecord* record : records) {
+    MethodKey key(record->node_id, record->event_type, record->input_ts,
+                  record->thread_id);
+    auto it = methods.find(key);
+    if (!record->is_finish) {
+      if (it == methods.end() || it->second.finished) {
+        methods[key] = {record, false};
+      }
+    } else if (it != methods.end() && !it->second.finished) {
+      append_event(*it->second.start, "X",
+                   record->event_time_usec - it->second.start->event_time_usec);
+      it->second.finished = true;
+    } else if (it == methods.end()) {
+      append_event(*record, "i", -1);
+    }
+  }
+  for (const auto& entry : methods) {
+    if (!entry.second.finished) {
+      append_event(*entry.second.start, "i", -1);
+    }
+  }
+  absl::StrAppend(&json, "\n],\"displayTimeUnit\":\"ms\",",
+                  "\"otherData\":{\"num_dropped_events\":\"",
+                  contents.num_dropped_events, "\"}}\n");
+  return json;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,199 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Continuous binary trace output for GraphTracer.
+//
+// TraceStreamWriter appends every TraceEvent as a fixed-size TraceRecord to a
+// set of rotating, memory-mapped files. Logging threads never block: each
+// thread fills its own lock-free ring buffer, and a flush thread copies the
+// rings into the current file. If a ring is full, the event is dropped and
+// counted. The file "<prefix><index>.mptrace" is reused once
+// <file_count> files have been written.
+//
+// File layout:
+//   TraceFileHeader
+//   node names and stream names, each as a uint32 count followed by
+//     (uint32 length, characters) entries
+//   TraceRecord[num_records], starting at records_offset
+//
+// The number of dropped events is kept in each file header and logged when a
+// file is closed.
+//
+// ReadTraceStreamFile reads a file back, and TraceStreamToChromeJson
+// converts its events to the Chrome trace event format for chrome://tracing.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_STREAM_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_STREAM_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/profiler/trace_buffer.h"
+
+namespace mediapipe {
+
+// The on-disk form of a TraceEvent.
+struct TraceRecord {
+  int64 event_time_usec;
+  int64 input_ts;
+  int64 packet_ts;
+  uint64 packet_data_id;
+  int32 node_id;
+  // Index into the stream names of the file, or -1.
+  int32 stream_index;
+  int32 thread_id;
+  uint8 event_type;
+  uint8 is_finish;
+  uint16 reserved;
+};
+static_assert(sizeof(TraceRecord) == 48, "TraceRecord must be 48 bytes");
+
+struct TraceFileHeader {
+  char magic[8];
+  uint32 version;
+  uint32 record_size;
+  uint64 records_offset;
+  // The number of complete records, updated after every flush.
+  uint64 num_records;
+  // The number of events the writer has dropped so far, over all files,
+  // updated after every flush.
+  uint64 num_dropped_events;
+  uint64 reserved[3];
+};
+static_assert(sizeof(TraceFileHeader) == 64, "TraceFileHeader must be 64 B");
+
+class TraceStreamWriter {
+ public:
+  struct Options {
+    // Files are written to StrCat(path_prefix, index, ".mptrace").
+    std::string path_prefix;
+    // The number of files retained.
+    int file_count = 2;
+    // The maximum size of each file.
+    int64 file_size = 64 << 20;
+    // The number of events buffered per logging thread, a power of 2.
+    int thread_buffer_size = 8192;
+    // The interval between flushes to the file.
+    absl::Duration flush_interval = absl::Milliseconds(100);
+  };
+
+  // Opens the first file and starts the flush thread. Event node ids and
+  // stream names are recorded relative to `node_names` and `stream_names`.
+  static ::mediapipe::StatusOr<std::unique_ptr<TraceStreamWriter>> Create(
+      const Options& options, std::vector<std::string> node_names,
+      std::vector<std::string> stream_names);
+
+  // Flushes the remaining events and closes the current file.
+  ~TraceStreamWriter();
+
+  // Appends an event. Thread-safe and non-blocking.
+  void Write(const TraceEvent& event);
+
+  // Copies all buffered events to the current file.
+  ::mediapipe::Status Flush() LOCKS_EXCLUDED(file_mutex_);
+
+  // The number of events dropped because a thread buffer was full.
+  int64 NumDroppedEvents() const { return num_dropped_events_; }
+
+  // The path of the file currently written.
+  std::string CurrentPath() LOCKS_EXCLUDED(file_mutex_);
+
+ private:
+  // A single-producer, single-consumer ring of records.
+  struct ThreadBuffer {
+    explicit ThreadBuffer(int size) : records(new TraceRecord[size]) {}
+    std::unique_ptr<TraceRecord[]> records;
+    // Written only by the logging thread.
+    std::atomic<uint64> head{0};
+    // Written only by the flushing thread.
+    std::atomic<uint64> tail{0};
+  };
+
+  TraceStreamWriter(const Options& options,
+                    std::vector<std::string> node_names,
+                    std::vector<std::string> stream_names);
+
+  // Returns the ring of the calling thread, creating it on first use.
+  ThreadBuffer* GetThreadBuffer();
+
+  // Opens and maps the next file, and writes its header.
+  ::mediapipe::Status OpenNextFile() EXCLUSIVE_LOCKS_REQUIRED(file_mutex_);
+
+  // Unmaps the current file and truncates it to its used size. Logs the
+  // events dropped since the previous file was closed.
+  void CloseFile() EXCLUSIVE_LOCKS_REQUIRED(file_mutex_);
+
+  // Flushes periodically until the writer is destroyed.
+  void RunFlushLoop();
+
+  const Options options_;
+  const std::vector<std::string> node_names_;
+  const std::vector<std::string> stream_names_;
+  std::unordered_map<std::string, int> stream_indexes_;
+  // Identifies this writer in the per-thread buffer cache.
+  const uint64 writer_id_;
+  std::atomic<int64> num_dropped_events_{0};
+
+  absl::Mutex buffers_mutex_;
+  // The ring of each logging thread, by thread number.
+  std::unordered_map<uint64, std::unique_ptr<ThreadBuffer>> buffers_
+      GUARDED_BY(buffers_mutex_);
+
+  absl::Mutex file_mutex_;
+  int file_index_ GUARDED_BY(file_mutex_) = -1;
+  int fd_ GUARDED_BY(file_mutex_) = -1;
+  uint8* mapped_ GUARDED_BY(file_mutex_) = nullptr;
+  TraceFileHeader* header_ GUARDED_BY(file_mutex_) = nullptr;
+  uint64 max_records_ GUARDED_BY(file_mutex_) = 0;
+  // The value of num_dropped_events_ when a file was last closed.
+  int64 num_dropped_events_logged_ GUARDED_BY(file_mutex_) = 0;
+
+  absl::Mutex flush_loop_mutex_;
+  absl::CondVar flush_loop_cond_;
+  bool stopping_ GUARDED_BY(flush_loop_mutex_) = false;
+  std::unique_ptr<ThreadPool> flush_thread_;
+};
+
+// The contents of a trace stream file.
+struct TraceStreamContents {
+  std::vector<std::string> node_names;
+  std::vector<std::string> stream_names;
+  std::vector<TraceRecord> records;
+  // The number of events the writer had dropped when it last flushed this
+  // file.
+  int64 num_dropped_events = 0;
+};
+
+// Reads a file written by TraceStreamWriter.
+::mediapipe::Status ReadTraceStreamFile(const std::string& path,
+                                        TraceStreamContents* contents);
+
+// Converts trace records to Chrome trace event JSON. The start and finish
+// records of a calculator method are combined into one complete event. The
+// number of dropped events is reported in "otherData".
+std::string TraceStreamToChromeJson(const TraceStreamContents& contents);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_STREAM_H_
@@ -0,0 +1,352 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/trace_stream.h"
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+std::string TempPath(const std::string& name) {
+  const char* dir = std::getenv("TEST_TMPDIR");
+  return absl::StrCat(dir ? dir : "/tmp", "/", name);
+}
+
+std::unique_ptr<TraceStreamWriter> CreateWriter(
+    const TraceStreamWriter::Options& options) {
+  auto writer_or = TraceStreamWriter::Create(
+      options, {"node_a", "node_b"}, {"stream_x", "stream_y"});
+  MEDIAPIPE_CHECK_OK(writer_or.status());
+  return std::move(writer_or).ValueOrDie();
+}
+
+TraceEvent ProcessEvent(int64 time_usec, int node_id, bool is_finish,
+                        int64 input_ts, const std::string* stream) {
+  return TraceEvent(GraphTrace::PROCESS)
+      .set_event_time(absl::FromUnixMicros(time_usec))
+      .set_node_id(node_id)
+      .set_is_finish(is_finish)
+      .set_input_ts(Timestamp(input_ts))
+      .set_packet_ts(Timestamp(input_ts))
+      .set_stream_id(stream);
+}
+
+TEST(TraceStreamTest, WritesEventsFromManyThreads) {
+  TraceStreamWriter::Options options;
+  options.path_prefix = TempPath("trace_stream_threads_");
+  options.file_count = 1;
+  const std::string stream_y = "stream_y";
+  const std::string unknown = "unknown";
+  constexpr int kNumThreads = 4;
+  constexpr int kNumEvents = 1000;
+  {
+    std::unique_ptr<TraceStreamWriter> writer = CreateWriter(options);
+    ThreadPool pool(kNumThreads);
+    pool.StartWorkers();
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&writer, &stream_y, &unknown, t] {
+        for (int i = 0; i < kNumEvents; ++i) {
+          writer->Write(ProcessEvent(i, t % 2, i % 2, i,
+                                     t == 0 ? &unknown : &stream_y)
+                            .set_thread_id(t));
+        }
+      });
+    }
+  }
+
+  TraceStreamContents contents;
+  MP_ASSERT_OK(ReadTraceStreamFile(
+      absl::StrCat(options.path_prefix, "0.mptrace"), &contents));
+  EXPECT_EQ(std::vector<std::string>({"node_a", "node_b"}),
+            contents.node_names);
+  EXPECT_EQ(std::vector<std::string>({"stream_x", "stream_y"}),
+            contents.stream_names);
+  ASSERT_EQ(kNumThreads * kNumEvents, contents.records.size());
+  std::map<int, int> next_event;
+  for (const TraceRecord& record : contents.records) {
+    // Events of each thread keep their order.
+    int& i = next_event[record.thread_id];
+    EXPECT_EQ(i, record.event_time_usec);
+    EXPECT_EQ(i, record.input_ts);
+    EXPECT_EQ(i % 2, record.is_finish);
+    EXPECT_EQ(record.thread_id % 2, record.node_id);
+    EXPECT_EQ(record.thread_id == 0 ? -1 : 1, record.stream_index);
+    EXPECT_EQ(GraphTrace::PROCESS, record.event_type);
+    ++i;
+  }
+  EXPECT_EQ(kNumThreads, next_event.size());
+}
+
+TEST(TraceStreamTest, RotatesFiles) {
+  TraceStreamWriter::Options options;
+  options.path_prefix = TempPath("trace_stream_rotation_");
+  options.file_count = 2;
+  // Room for the header and 10 records.
+  options.file_size = 128 + 10 * sizeof(TraceRecord);
+  std::unique_ptr<TraceStreamWriter> writer = CreateWriter(options);
+  EXPECT_EQ(absl::StrCat(options.path_prefix, "0.mptrace"),
+            writer->CurrentPath());
+  for (int i = 0; i < 25; ++i) {
+    writer->Write(ProcessEvent(i, 0, false, i, nullptr));
+  }
+  MP_ASSERT_OK(writer->Flush());
+  // Records 0-9 went to file 0, 10-19 to file 1, and 20-24 to file 0 again.
+  EXPECT_EQ(absl::StrCat(options.path_prefix, "0.mptrace"),
+            writer->CurrentPath());
+  writer.reset();
+
+  TraceStreamContents file_0;
+  MP_ASSERT_OK(ReadTraceStreamFile(
+      absl::StrCat(options.path_prefix, "0.mptrace"), &file_0));
+  ASSERT_EQ(5, file_0.records.size());
+  EXPECT_EQ(20, file_0.records[0].event_time_usec);
+  TraceStreamContents file_1;
+  MP_ASSERT_OK(ReadTraceStreamFile(
+      absl::StrCat(options.path_prefix, "1.mptrace"), &file_1));
+  ASSERT_EQ(10, file_1.records.size());
+  EXPECT_EQ(10, file_1.records[0].event_time_usec);
+}
+
+TEST(TraceStreamTest, DropsEventsWhenBufferIsFull) {
+  TraceStreamWriter::Options options;
+  options.path_prefix = TempPath("trace_stream_drops_");
+  options.thread_buffer_size = 4;
+  options.flush_interval = absl::Hours(1);
+  std::unique_ptr<TraceStreamWriter> writer = CreateWriter(options);
+  for (int i = 0; i < 10; ++i) {
+    writer->Write(ProcessEvent(i, 0, false, i, nullptr));
+  }
+  EXPECT_EQ(6, writer->NumDroppedEvents());
+  MP_ASSERT_OK(writer->Flush());
+  for (int i = 10; i < 13; ++i) {
+    writer->Write(ProcessEvent(i, 0, false, i, nullptr));
+  }
+  EXPECT_EQ(6, writer->NumDroppedEvents());
+  writer.reset();
+
+  TraceStreamContents contents;
+  MP_ASSERT_OK(ReadTraceStreamFile(
+      absl::StrCat(options.path_prefix, "0.mptrace"), &contents));
+  std::vector<int64> times;
+  for (const TraceRecord& record : contents.records) {
+    times.push_back(record.event_time_usec);
+  }
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 10, 11, 12}), times);
+  EXPECT_EQ(6, contents.num_dropped_events);
+}
+
+TEST(TraceStreamTest, RejectsOtherFiles) {
+  const std::string path = TempPath("trace_stream_not_a_trace");
+  MP_ASSERT_OK(file::SetContents(path, std::string(100, 'x')));
+  TraceStreamContents contents;
+  EXPECT_FALSE(ReadTraceStreamFile(path, &contents).ok());
+}
+
+TEST(TraceStreamTest, ConvertsToChromeJson) {
+  TraceStreamContents contents;
+  contents.node_names = {"node_\"a\"", "node_b"};
+  contents.stream_names = {"stream_x"};
+  auto record = [](int64 time, int node_id, bool is_finish, int64 input_ts) {
+    TraceRecord r = {};
+    r.event_time_usec = time;
+    r.node_id = node_id;
+    r.is_finish = is_finish;
+    r.input_ts = input_ts;
+    r.packet_ts = input_ts;
+    r.stream_index = 0;
+    r.event_type = GraphTrace::PROCESS;
+    r.thread_id = 7;
+    return r;
+  };
+  contents.records = {
+      // Two inputs and two outputs of one Process call.
+      record(100, 0, false, 5), record(100, 0, false, 5),
+      record(130, 0, true, 5), record(130, 0, true, 5),
+      // An output without a start.
+      record(150, 1, true, 6),
+      // A start without an output, logged out of order.
+      record(120, 1, false, 7)};
+  contents.num_dropped_events = 3;
+  const std::string json = TraceStreamToChromeJson(contents);
+  EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"node_\\\"a\\\"\",\"cat\":\"PROCESS\","
+                      "\"ph\":\"X\",\"ts\":100,\"dur\":30,\"pid\":0,"
+                      "\"tid\":7,\"args\":{\"input_ts\":\"5\","
+                      "\"packet_ts\":\"5\",\"stream\":\"stream_x\"}}"));
+  EXPECT_NE(std::string::npos,
+            json.find("\"name\":\"node_b\",\"cat\":\"PROCESS\",\"ph\":\"i\","
+                      "\"ts\":150"));
+  EXPECT_NE(std::string::npos,
+            json.find("\"name\":\"node_b\",\"cat\":\"PROCESS\",\"ph\":\"i\","
+                      "\"ts\":120"));
+  // One complete event and two instant events.
+  int num_events = 0;
+  for (size_t pos = json.find("\"ph\""); pos != std::string::npos;
+       pos = json.find("\"ph\"", pos + 1)) {
+    ++num_events;
+  }
+  EXPECT_EQ(3, num_events);
+  EXPECT_NE(std::string::npos,
+            json.find("\"otherData\":{\"num_dropped_events\":\"3\"}"));
+}
+
+// Passes the input packet on to the output.
+class TraceStreamTestCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).SetSameAs(&cc->Inputs().Index(0));
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return ::mediapipe::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(TraceStreamTestCalculator);
+
+// A chain of |chain_length| nodes, traced as specified.
+CalculatorGraphConfig ChainConfig(int chain_length,
+                                  const ProfilerConfig& profiler_config) {
+  CalculatorGraphConfig config;
+  config.add_input_stream("stream_0");
+  for (int n = 0; n < chain_length; ++n) {
+    CalculatorGraphConfig::Node* node = config.add_node();
+    node->set_calculator("TraceStreamTestCalculator");
+    node->add_input_stream(absl::StrCat("stream_", n));
+    node->add_output_stream(absl::StrCat("stream_", n + 1));
+  }
+  *config.mutable_profiler_config() = profiler_config;
+  return config;
+}
+
+// Sends |num_packets| packets through the graph.
+::mediapipe::Status RunGraph(const CalculatorGraphConfig& config,
+                             int num_packets) {
+  CalculatorGraph graph;
+  MP_RETURN_IF_ERROR(graph.Initialize(config));
+  MP_RETURN_IF_ERROR(graph.StartRun({}));
+  for (int i = 0; i < num_packets; ++i) {
+    MP_RETURN_IF_ERROR(
+        graph.AddPacketToInputStream("stream_0", MakePacket<int>(i).At(
+                                                     Timestamp(i))));
+  }
+  MP_RETURN_IF_ERROR(graph.CloseAllInputStreams());
+  return graph.WaitUntilDone();
+}
+
+TEST(TraceStreamTest, GraphStreamsTraceEvents) {
+  ProfilerConfig profiler_config;
+  profiler_config.set_trace_enabled(true);
+  profiler_config.set_trace_log_streaming(true);
+  profiler_config.set_trace_log_path(TempPath("trace_stream_graph_"));
+  MP_ASSERT_OK(RunGraph(ChainConfig(2, profiler_config), 10));
+
+  TraceStreamContents contents;
+  MP_ASSERT_OK(ReadTraceStreamFile(
+      TempPath("trace_stream_graph_stream_0.mptrace"), &contents));
+  EXPECT_EQ(2, contents.node_names.size());
+  EXPECT_EQ(3, contents.stream_names.size());
+  std::map<std::pair<int, bool>, int> process_events;
+  for (const TraceRecord& record : contents.records) {
+    if (record.event_type == GraphTrace::PROCESS && record.node_id >= 0) {
+      ++process_events[{record.node_id, record.is_finish}];
+      EXPECT_NE(-1, record.stream_index);
+    }
+  }
+  // One input and one output event per packet and node.
+  EXPECT_EQ(10, (process_events[{0, false}]));
+  EXPECT_EQ(10, (process_events[{0, true}]));
+  EXPECT_EQ(10, (process_events[{1, false}]));
+  EXPECT_EQ(10, (process_events[{1, true}]));
+}
+
+// The cost of logging and flushing one event.
+void BM_TraceStreamWrite(benchmark::State& state) {
+  TraceStreamWriter::Options options;
+  options.path_prefix = TempPath("trace_stream_benchmark_");
+  options.flush_interval = absl::Hours(1);
+  std::unique_ptr<TraceStreamWriter> writer = CreateWriter(options);
+  const std::string stream = "stream_y";
+  TraceEvent event = ProcessEvent(0, 1, false, 0, &stream);
+  int64 num_events = 0;
+  for (auto _ : state) {
+    writer->Write(event);
+    if (++num_events % 4096 == 0) {
+      MEDIAPIPE_CHECK_OK(writer->Flush());
+    }
+  }
+  CHECK_EQ(0, writer->NumDroppedEvents());
+}
+BENCHMARK(BM_TraceStreamWrite);
+
+// The cost of sending 100 packets through a running chain of range(1) nodes
+// with tracing off (0), tracing to the in-memory TraceBuffer (1), and
+// streaming trace events (2). The hand tracking desktop CPU graph has 36
+// nodes once its subgraphs are expanded, so the difference between modes 0
+// and 2 on the 36-node chain bounds the per-frame cost of streaming there,
+// apart from the time its calculators take.
+void BM_TracedGraph(benchmark::State& state) {
+  ProfilerConfig profiler_config;
+  profiler_config.set_trace_log_disabled(true);
+  if (state.range(0) > 0) {
+    profiler_config.set_trace_enabled(true);
+  }
+  if (state.range(0) == 2) {
+    profiler_config.set_trace_log_disabled(false);
+    profiler_config.set_trace_log_streaming(true);
+    profiler_config.set_trace_log_path(TempPath("trace_stream_benchmark_"));
+  }
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(
+      graph.Initialize(ChainConfig(state.range(1), profiler_config)));
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < 100; ++i) {
+      MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+          "stream_0", MakePacket<int>(0).At(Timestamp(timestamp++))));
+    }
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+}
+BENCHMARK(BM_TracedGraph)
+    ->ArgPair(0, 10)
+    ->ArgPair(1, 10)
+    ->ArgPair(2, 10)
+    ->ArgPair(0, 36)
+    ->ArgPair(1, 36)
+    ->ArgPair(2, 36);
+
+}  // namespace
+}  // namespace mediapipe
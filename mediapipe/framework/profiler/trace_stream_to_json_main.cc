@@ -0,0 +1,70 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Converts streamed trace log files to Chrome trace event JSON, which can be
+// viewed in chrome://tracing:
+//
+//   trace_stream_to_json \
+//     --input_trace_paths=/tmp/mediapipe_trace_stream_0.mptrace \
+//     --output_json_path=/tmp/trace.json
+
+#include <algorithm>
+#include <string>
+
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/profiler/trace_stream.h"
+
+DEFINE_string(input_trace_paths, "",
+              "Comma-separated list of .mptrace files written by one graph.");
+DEFINE_string(output_json_path, "", "The Chrome trace JSON file to write.");
+
+::mediapipe::Status ConvertTraceStream() {
+  ::mediapipe::TraceStreamContents contents;
+  for (absl::string_view path :
+       absl::StrSplit(FLAGS_input_trace_paths, ',', absl::SkipEmpty())) {
+    ::mediapipe::TraceStreamContents file_contents;
+    MP_RETURN_IF_ERROR(
+        ::mediapipe::ReadTraceStreamFile(std::string(path), &file_contents));
+    // Files written by one graph share the same names.
+    contents.node_names = std::move(file_contents.node_names);
+    contents.stream_names = std::move(file_contents.stream_names);
+    contents.records.insert(contents.records.end(),
+                            file_contents.records.begin(),
+                            file_contents.records.end());
+    // Each file holds the writer's running total.
+    contents.num_dropped_events = std::max(contents.num_dropped_events,
+                                           file_contents.num_dropped_events);
+  }
+  LOG_IF(WARNING, contents.num_dropped_events > 0)
+      << contents.num_dropped_events
+      << " trace events were dropped while writing the trace.";
+  return ::mediapipe::file::SetContents(
+      FLAGS_output_json_path, ::mediapipe::TraceStreamToChromeJson(contents));
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ::mediapipe::Status status = ConvertTraceStream();
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to convert the trace: " << status.message();
+    return 1;
+  }
+  return 0;
+}
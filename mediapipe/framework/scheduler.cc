@@ -102,6 +102,24 @@ void Scheduler::SetExecutor(Executor* executor) {
   return ::mediapipe::OkStatus();
 }
 
+::mediapipe::Status Scheduler::SetNumQueueShards(const std::string& name,
+                                                 int num_shards) {
+  absl::MutexLock lock(&state_mutex_);
+  RET_CHECK_EQ(state_, STATE_NOT_STARTED) << "SetNumQueueShards must not be "
+                                             "called after the scheduler has "
+                                             "started";
+  RET_CHECK_GT(num_shards, 0);
+  SchedulerQueue* queue = &default_queue_;
+  if (!name.empty()) {
+    auto iter = non_default_queues_.find(name);
+    RET_CHECK(iter != non_default_queues_.end())
+        << "No scheduler queue for the executor \"" << name << "\"";
+    queue = iter->second.get();
+  }
+  queue->SetNumShards(num_shards);
+  return ::mediapipe::OkStatus();
+}
+
 void Scheduler::SetQueuesRunning(bool running) {
   for (auto queue : scheduler_queues_) {
     queue->SetRunning(running);
@@ -445,6 +463,10 @@ void Scheduler::AssignNodeToSchedulerQueue(CalculatorNode* node) {
     queue = &default_queue_;
   }
   node->SetSchedulerQueue(queue);
+  if (!node->IsSource()) {
+    node->SetCompletionCallback(std::bind(&SchedulerQueue::AddCompletedNode,
+                                          queue, node, std::placeholders::_1));
+  }
 }
 
 void Scheduler::QueueIdleStateChanged(bool idle) {
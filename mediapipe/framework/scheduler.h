@@ -59,6 +59,12 @@ class Scheduler {
   ::mediapipe::Status SetNonDefaultExecutor(const std::string& name,
                                             Executor* executor);
 
+  // Splits the scheduler queue of the executor named |name| ("" for the
+  // default executor) into |num_shards| independently locked shards. Must be
+  // called before the scheduler is started.
+  ::mediapipe::Status SetNumQueueShards(const std::string& name, int num_shards)
+      LOCKS_EXCLUDED(state_mutex_);
+
   // Resets the data members at the beginning of each graph run.
   void Reset();
 
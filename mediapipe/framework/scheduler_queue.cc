@@ -16,6 +16,7 @@
 
 #include <memory>
 #include <queue>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 
 #include "absl/synchronization/mutex.h"
@@ -53,6 +54,14 @@ SchedulerQueue::Item::Item(CalculatorNode* node)
   }
 }
 
+// static
+SchedulerQueue::Item SchedulerQueue::Item::Completion(CalculatorNode* node,
+                                                      CalculatorContext* cc) {
+  Item item(node, cc);
+  item.is_completion_ = true;
+  return item;
+}
+
 // Returning true means "this runs after that".
 bool SchedulerQueue::Item::operator<(const SchedulerQueue::Item& that) const {
   if (is_open_node_ || that.is_open_node_) {
@@ -82,25 +91,29 @@ bool SchedulerQueue::Item::operator<(const SchedulerQueue::Item& that) const {
   }
 }
 
+SchedulerQueue::SchedulerQueue(SchedulerShared* shared) : shared_(shared) {
+  SetNumShards(1);
+}
+
 void SchedulerQueue::Reset() {
-  absl::MutexLock lock(&mutex_);
-  num_pending_tasks_ = 0;
+  num_unfinished_items_ = 0;
   num_tasks_to_add_ = 0;
   running_count_ = 0;
 }
 
 void SchedulerQueue::SetExecutor(Executor* executor) { executor_ = executor; }
 
-bool SchedulerQueue::IsIdle() {
-  VLOG(3) << "Scheduler queue empty: " << queue_.empty()
-          << ", # of pending tasks: " << num_pending_tasks_;
-  return queue_.empty() && num_pending_tasks_ == 0;
+void SchedulerQueue::SetNumShards(int num_shards) {
+  CHECK_GT(num_shards, 0);
+  shards_.clear();
+  for (int i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard);
+  }
 }
 
 void SchedulerQueue::SetRunning(bool running) {
-  absl::MutexLock lock(&mutex_);
-  running_count_ += running ? 1 : -1;
-  DCHECK_LE(running_count_, 1);
+  const int running_count = (running_count_ += running ? 1 : -1);
+  DCHECK_LE(running_count, 1);
 }
 
 void SchedulerQueue::AddNode(CalculatorNode* node, CalculatorContext* cc) {
@@ -126,22 +139,38 @@ void SchedulerQueue::AddNodeForOpen(CalculatorNode* node) {
   AddItemToQueue(Item(node));
 }
 
+void SchedulerQueue::AddCompletedNode(CalculatorNode* node,
+                                      CalculatorContext* cc) {
+  AddItemToQueue(Item::Completion(node, cc));
+  // Releases the count taken by RunCalculatorNode() for the deferred
+  // invocation. The item added above may have run already.
+  const int num_unfinished_items = --num_unfinished_items_;
+  DCHECK_GE(num_unfinished_items, 0);
+  if (num_unfinished_items == 0 && idle_callback_) {
+    // Became idle.
+    idle_callback_(true);
+  }
+}
+
 void SchedulerQueue::AddItemToQueue(Item&& item) {
   const CalculatorNode* node = item.Node();
-  bool was_idle;
-  int tasks_to_add = 0;
+  const bool was_idle = num_unfinished_items_.fetch_add(1) == 0;
+  Shard* shard = shards_[node->Id() % shards_.size()].get();
   {
-    absl::MutexLock lock(&mutex_);
-    was_idle = IsIdle();
-    queue_.push(item);
-    ++num_tasks_to_add_;
-    VLOG(4) << node->DebugName() << " was added to the scheduler queue.";
-
-    // Now grab the tasks to execute while still holding the lock. This will
-    // gather any waiting tasks, in addition to the one we just added.
-    if (running_count_ > 0) {
-      tasks_to_add = GetTasksToSubmitToExecutor();
-    }
+    absl::MutexLock lock(&shard->mutex);
+    shard->queue.push(item);
+    ++shard->size;
+  }
+  VLOG(4) << node->DebugName() << " was added to the scheduler queue.";
+
+  // Now grab the tasks to execute. This will gather any waiting tasks, in
+  // addition to the one we just added. Pairs with SetRunning(true) followed
+  // by SubmitWaitingTasksToExecutor: either we see the queue running or
+  // SubmitWaitingTasksToExecutor sees our task.
+  ++num_tasks_to_add_;
+  int tasks_to_add = 0;
+  if (running_count_ > 0) {
+    tasks_to_add = GetTasksToSubmitToExecutor();
   }
   if (was_idle && idle_callback_) {
     // Became not idle.
@@ -158,10 +187,7 @@ void SchedulerQueue::AddItemToQueue(Item&& item) {
 }
 
 int SchedulerQueue::GetTasksToSubmitToExecutor() {
-  int tasks_to_add = num_tasks_to_add_;
-  num_tasks_to_add_ = 0;
-  num_pending_tasks_ += tasks_to_add;
-  return tasks_to_add;
+  return num_tasks_to_add_.exchange(0);
 }
 
 void SchedulerQueue::SubmitWaitingTasksToExecutor() {
@@ -169,11 +195,8 @@ void SchedulerQueue::SubmitWaitingTasksToExecutor() {
   // we do not immediately submit tasks to the executor. Here we check for any
   // such waiting tasks, and submit them.
   int tasks_to_add = 0;
-  {
-    absl::MutexLock lock(&mutex_);
-    if (running_count_ > 0) {
-      tasks_to_add = GetTasksToSubmitToExecutor();
-    }
+  if (running_count_ > 0) {
+    tasks_to_add = GetTasksToSubmitToExecutor();
   }
   while (tasks_to_add > 0) {
     executor_->AddTask(this);
@@ -181,24 +204,62 @@ void SchedulerQueue::SubmitWaitingTasksToExecutor() {
   }
 }
 
+bool SchedulerQueue::PopNextItem(int first_shard, CalculatorNode** node,
+                                 CalculatorContext** cc, bool* is_open_node,
+                                 bool* is_completion) {
+  const int num_shards = shards_.size();
+  // The first pass only takes items that run before sources, the second pass
+  // takes any item.
+  for (bool sources_allowed : {false, true}) {
+    for (int i = 0; i < num_shards; ++i) {
+      Shard* shard = shards_[(first_shard + i) % num_shards].get();
+      if (shard->size == 0) {
+        continue;
+      }
+      absl::MutexLock lock(&shard->mutex);
+      if (shard->queue.empty()) {
+        continue;
+      }
+      const Item& top = shard->queue.top();
+      if (!sources_allowed && !top.IsOpenNode() && top.Node()->IsSource()) {
+        continue;
+      }
+      *node = top.Node();
+      *cc = top.Context();
+      *is_open_node = top.IsOpenNode();
+      *is_completion = top.IsCompletion();
+      shard->queue.pop();
+      --shard->size;
+      return true;
+    }
+  }
+  return false;
+}
+
 void SchedulerQueue::RunNextTask() {
+  // Rotates the first shard examined by each thread, so that threads spread
+  // out over the shards.
+  static thread_local unsigned int next_first_shard = 0;
+
   CalculatorNode* node;
   CalculatorContext* calculator_context;
   bool is_open_node;
-  {
-    absl::MutexLock lock(&mutex_);
-
-    CHECK(!queue_.empty()) << "Called RunNextTask when the queue is empty. "
-                              "This should not happen.";
-
-    node = queue_.top().Node();
-    calculator_context = queue_.top().Context();
-    is_open_node = queue_.top().IsOpenNode();
-    queue_.pop();
-
-    CHECK(!node->Closed())
-        << "Scheduled a node that was closed. This should not happen.";
+  bool is_completion;
+  // Every task submitted to the executor corresponds to an item added to the
+  // queue, so an item is available for this task. With several shards, a
+  // concurrent pop and push may hide it from one scan; yield to the thread
+  // adding it and scan again.
+  int attempts = 0;
+  while (!PopNextItem(next_first_shard++ % shards_.size(), &node,
+                      &calculator_context, &is_open_node, &is_completion)) {
+    CHECK(shards_.size() > 1 || attempts == 0)
+        << "Called RunNextTask when the queue is empty. "
+           "This should not happen.";
+    ++attempts;
+    std::this_thread::yield();
   }
+  CHECK(!node->Closed())
+      << "Scheduled a node that was closed. This should not happen.";
 
   // On iOS, calculators may rely on the existence of an autorelease pool
   // (either directly, or because system code they call does). We do not
@@ -209,19 +270,17 @@ void SchedulerQueue::RunNextTask() {
     if (is_open_node) {
       DCHECK(!calculator_context);
       OpenCalculatorNode(node);
+    } else if (is_completion) {
+      CompleteCalculatorNode(node, calculator_context);
     } else {
       RunCalculatorNode(node, calculator_context);
     }
   }
 
-  bool is_idle;
-  {
-    absl::MutexLock lock(&mutex_);
-    DCHECK_GT(num_pending_tasks_, 0);
-    --num_pending_tasks_;
-    is_idle = IsIdle();
-  }
-  if (is_idle && idle_callback_) {
+  const int num_unfinished_items = --num_unfinished_items_;
+  DCHECK_GE(num_unfinished_items, 0);
+  VLOG(3) << "Scheduler queue unfinished items: " << num_unfinished_items;
+  if (num_unfinished_items == 0 && idle_callback_) {
     // Became idle.
     idle_callback_(true);
   }
@@ -256,27 +315,53 @@ void SchedulerQueue::RunCalculatorNode(CalculatorNode* node,
     const ::mediapipe::Status result = node->ProcessNode(cc);
     shared_->timer.EndNode(start_time);
 
-    if (!result.ok()) {
-      if (result == tool::StatusStop()) {
-        // Check if StatusStop was returned by a non-source node. This means
-        // that all sources will be closed and no further sources should be
-        // scheduled. The graph will be terminated as soon as its scheduler
-        // queue becomes empty.
-        CHECK(!node->IsSource());  // ProcessNode takes care of StatusStop()
-                                   // from sources.
-        shared_->stopping = true;
-      } else {
-        // If we have an error in this calculator.
-        VLOG(3) << node->DebugName() << " had an error!";
-        shared_->error_callback(result);
-      }
+    if (node->ProcessDeferred(cc)) {
+      // The node stays scheduled, and the queue busy, until the completion
+      // callback queues the node again with AddCompletedNode().
+      VLOG(4) << node->DebugName() << " deferred its completion.";
+      ++num_unfinished_items_;
+      node->ReleaseDeferredProcess(cc, result);
+      return;
     }
+    HandleProcessResult(node, result);
   }
 
   VLOG(4) << "Done running " << node->DebugName();
   node->EndScheduling();
 }
 
+void SchedulerQueue::CompleteCalculatorNode(CalculatorNode* node,
+                                            CalculatorContext* cc) {
+  VLOG(3) << "Completing " << node->DebugName();
+  int64 start_time = shared_->timer.StartNode();
+  const ::mediapipe::Status result = node->CompleteProcessNode(cc);
+  shared_->timer.EndNode(start_time);
+  HandleProcessResult(node, result);
+
+  VLOG(4) << "Done completing " << node->DebugName();
+  node->EndScheduling();
+}
+
+void SchedulerQueue::HandleProcessResult(CalculatorNode* node,
+                                         const ::mediapipe::Status& result) {
+  if (result.ok()) {
+    return;
+  }
+  if (result == tool::StatusStop()) {
+    // Check if StatusStop was returned by a non-source node. This means
+    // that all sources will be closed and no further sources should be
+    // scheduled. The graph will be terminated as soon as its scheduler
+    // queue becomes empty.
+    CHECK(!node->IsSource());  // ProcessNode takes care of StatusStop()
+                               // from sources.
+    shared_->stopping = true;
+  } else {
+    // If we have an error in this calculator.
+    VLOG(3) << node->DebugName() << " had an error!";
+    shared_->error_callback(result);
+  }
+}
+
 void SchedulerQueue::OpenCalculatorNode(CalculatorNode* node) {
   VLOG(3) << "Opening " << node->DebugName();
   int64 start_time = shared_->timer.StartNode();
@@ -291,18 +376,21 @@ void SchedulerQueue::OpenCalculatorNode(CalculatorNode* node) {
 }
 
 void SchedulerQueue::CleanupAfterRun() {
-  bool was_idle;
-  {
-    absl::MutexLock lock(&mutex_);
-    was_idle = IsIdle();
-    CHECK_EQ(num_pending_tasks_, 0);
-    CHECK_EQ(num_tasks_to_add_, queue_.size());
-    num_tasks_to_add_ = 0;
-    while (!queue_.empty()) {
-      queue_.pop();
+  int num_queued_items = 0;
+  for (auto& shard : shards_) {
+    absl::MutexLock lock(&shard->mutex);
+    num_queued_items += shard->queue.size();
+    while (!shard->queue.empty()) {
+      shard->queue.pop();
     }
+    shard->size = 0;
   }
-  if (!was_idle && idle_callback_) {
+  // No tasks may be running, so all unfinished items are still queued.
+  CHECK_EQ(num_unfinished_items_.load(), num_queued_items);
+  CHECK_EQ(num_tasks_to_add_.load(), num_queued_items);
+  num_tasks_to_add_ = 0;
+  num_unfinished_items_ = 0;
+  if (num_queued_items > 0 && idle_callback_) {
     // Became idle.
     idle_callback_(true);
   }
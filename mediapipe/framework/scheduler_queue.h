@@ -20,6 +20,7 @@
 #include <memory>
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/synchronization/mutex.h"
@@ -35,6 +36,14 @@ class CalculatorNode;
 namespace internal {
 
 // Manages a priority queue of nodes to be run on the associated executor.
+//
+// The queue may be split into several shards, each with its own lock, so
+// that executor threads adding and running nodes do not all contend for one
+// mutex. Items are assigned to shards by node id. Each shard preserves the
+// order defined by Item::operator<; across shards, nodes that are not
+// sources are still preferred over sources, but the order among the shards'
+// highest priority items is otherwise unspecified. With one shard (the
+// default) the queue runs nodes in exactly the order of Item::operator<.
 class SchedulerQueue : public TaskQueue {
  public:
   // Callback to be invoked when the queue's idle state changes.
@@ -48,6 +57,8 @@ class SchedulerQueue : public TaskQueue {
     Item(CalculatorNode* node, CalculatorContext* cc);
     // A null CalculatorContext indicates the task should run OpenNode().
     Item(CalculatorNode* node);
+    // Returns an item that completes the deferred invocation of node in cc.
+    static Item Completion(CalculatorNode* node, CalculatorContext* cc);
 
     CalculatorNode* Node() const { return node_; }
 
@@ -55,6 +66,8 @@ class SchedulerQueue : public TaskQueue {
 
     bool IsOpenNode() const { return is_open_node_; }
 
+    bool IsCompletion() const { return is_completion_; }
+
     // This comparison is meant to be used with a std::priority_queue. Since
     // the priority queue returns higher priority items first, this function
     // means "this is lower priority than that", i.e. "this runs after that".
@@ -74,14 +87,22 @@ class SchedulerQueue : public TaskQueue {
     int layer_ = 0;
     bool is_source_ = false;
     bool is_open_node_ = false;  // True if the task should run OpenNode().
+    // True if the task should run CompleteProcessNode().
+    bool is_completion_ = false;
   };
 
-  explicit SchedulerQueue(SchedulerShared* shared) : shared_(shared) {}
+  explicit SchedulerQueue(SchedulerShared* shared);
 
   // Sets the executor that will run the nodes. Must be called before the
   // scheduler is started.
   void SetExecutor(Executor* executor);
 
+  // Splits the queue into num_shards independently locked priority queues.
+  // Must be called before the scheduler is started.
+  void SetNumShards(int num_shards);
+
+  int NumShards() const { return shards_.size(); }
+
   // Sets the idle callback. It is called exactly once whenever the queue goes
   // from idle to active, or vice versa.
   // Note: if the queue is accessed by multiple threads, it is possible for
@@ -105,45 +126,70 @@ class SchedulerQueue : public TaskQueue {
   // NOTE: After calling SetRunning(true), the caller must call
   // SubmitWaitingTasksToExecutor since tasks may have been added while the
   // queue was not running.
-  void SetRunning(bool running) LOCKS_EXCLUDED(mutex_);
+  void SetRunning(bool running);
 
   // Gets the number of tasks that need to be submitted to the executor, and
-  // updates num_pending_tasks_. If this method is called and returns a
-  // non-zero value, the executor's AddTask method *must* be called for each
-  // task returned, but it can be called without holding the lock.
-  int GetTasksToSubmitToExecutor() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // resets num_tasks_to_add_. If this method is called and returns a non-zero
+  // value, the executor's AddTask method *must* be called for each task
+  // returned.
+  int GetTasksToSubmitToExecutor();
 
   // Submits tasks that are waiting (e.g. that were added while the queue was
   // not running) if the queue is running. The caller must not hold any mutex.
-  void SubmitWaitingTasksToExecutor() LOCKS_EXCLUDED(mutex_);
+  void SubmitWaitingTasksToExecutor();
 
   // Adds a node and a calculator context to the scheduler queue if the node is
   // not already running. Note that if the node was running, then it will be
   // rescheduled upon completion (after checking dependencies), so this call is
   // not lost.
-  void AddNode(CalculatorNode* node, CalculatorContext* cc)
-      LOCKS_EXCLUDED(mutex_);
+  void AddNode(CalculatorNode* node, CalculatorContext* cc);
 
   // Adds a node to the scheduler queue for an OpenNode() call.
-  void AddNodeForOpen(CalculatorNode* node) LOCKS_EXCLUDED(mutex_);
+  void AddNodeForOpen(CalculatorNode* node);
+
+  // Adds a node whose invocation in cc deferred its completion, once the
+  // invocation has completed, to finish it. The queue counts as busy from
+  // the time the invocation is deferred.
+  void AddCompletedNode(CalculatorNode* node, CalculatorContext* cc);
 
-  // Adds an Item to queue_.
+  // Adds an Item to the shard of its node.
   void AddItemToQueue(Item&& item);
 
-  void CleanupAfterRun() LOCKS_EXCLUDED(mutex_);
+  void CleanupAfterRun();
 
  private:
+  // A priority queue holding the items of a subset of the nodes.
+  struct Shard {
+    absl::Mutex mutex;
+    std::priority_queue<Item> queue GUARDED_BY(mutex);
+    // The size of queue, readable without locking mutex.
+    std::atomic<int> size{0};
+  };
+
+  // Used internally by RunNextTask. Pops the highest priority item of the
+  // first shard, starting at first_shard, whose highest priority item runs
+  // before sources. If there is no such shard, pops the highest priority
+  // item of the first non-empty shard. Returns false if all shards were
+  // found empty.
+  bool PopNextItem(int first_shard, CalculatorNode** node,
+                   CalculatorContext** cc, bool* is_open_node,
+                   bool* is_completion);
+
   // Used internally by RunNextTask. Invokes ProcessNode or CloseNode, followed
-  // by EndScheduling.
-  void RunCalculatorNode(CalculatorNode* node, CalculatorContext* cc)
-      LOCKS_EXCLUDED(mutex_);
+  // by EndScheduling unless Process() deferred its completion.
+  void RunCalculatorNode(CalculatorNode* node, CalculatorContext* cc);
+
+  // Used internally by RunNextTask. Invokes CompleteProcessNode, followed by
+  // EndScheduling.
+  void CompleteCalculatorNode(CalculatorNode* node, CalculatorContext* cc);
+
+  // Reports an error or a StatusStop() returned for an invocation of node.
+  void HandleProcessResult(CalculatorNode* node,
+                           const ::mediapipe::Status& result);
 
   // Used internally by RunNextTask. Invokes OpenNode, followed by
   // CheckIfBecameReady.
-  void OpenCalculatorNode(CalculatorNode* node) LOCKS_EXCLUDED(mutex_);
-
-  // Checks whether the queue has no queued nodes or pending tasks.
-  bool IsIdle() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void OpenCalculatorNode(CalculatorNode* node);
 
   Executor* executor_ = nullptr;
 
@@ -154,20 +200,21 @@ class SchedulerQueue : public TaskQueue {
   // decrements it. The queue is running if running_count_ > 0. A running
   // queue will submit tasks to the executor.
   // Invariant: running_count_ <= 1.
-  int running_count_ GUARDED_BY(mutex_) = 0;
+  std::atomic<int> running_count_{0};
 
-  // Number of tasks added to the Executor and not yet complete.
-  int num_pending_tasks_ GUARDED_BY(mutex_);
+  // Number of items added to the queue and not yet finished running, i.e.
+  // the queued items plus the tasks that are running an item, plus the
+  // deferred invocations whose completion has not been queued yet. The queue
+  // is idle when this is zero.
+  std::atomic<int> num_unfinished_items_{0};
 
   // Number of tasks that need to be added to the Executor.
-  int num_tasks_to_add_ GUARDED_BY(mutex_);
+  std::atomic<int> num_tasks_to_add_{0};
 
-  // Queue of nodes that need to be run.
-  std::priority_queue<Item> queue_ GUARDED_BY(mutex_);
+  // Queues of nodes that need to be run.
+  std::vector<std::unique_ptr<Shard>> shards_;
 
   SchedulerShared* const shared_;
-
-  absl::Mutex mutex_;
 };
 
 }  // namespace internal
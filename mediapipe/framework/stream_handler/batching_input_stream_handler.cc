@@ -0,0 +1,157 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/stream_handler/batching_input_stream_handler.pb.h"
+#include "mediapipe/framework/stream_handler/default_input_stream_handler.h"
+
+namespace mediapipe {
+
+// Input stream handler that groups the input sets of consecutive timestamps
+// into batches, so that a calculator can handle several timestamps at once,
+// e.g. to run inference on a stacked tensor. The calculator's Process() is
+// called once per input timestamp, as usual, but the calls of one batch
+// follow each other without waiting for other nodes. The calculator can use
+// CalculatorContext::NumRemainingInputTimestamps() to find the last input
+// set of the batch.
+//
+// A batch is passed to the calculator when it holds max_batch_size input
+// sets, when the inputs are done, or when max_wait_time_usec has passed
+// since its first input set became ready. With the default wait of 0, a
+// batch holds whatever input sets are ready when the calculator becomes
+// idle, so batches grow only while the calculator falls behind its inputs.
+//
+// For example:
+//
+// node {
+//   calculator: "BatchedTfLiteInferenceCalculator"
+//   input_stream: "TENSORS:image_tensor"
+//   output_stream: "TENSORS:detection_tensors"
+//   input_stream_handler {
+//     input_stream_handler: "BatchingInputStreamHandler"
+//     options {
+//       [mediapipe.BatchingInputStreamHandlerOptions.ext] {
+//         max_batch_size: 4
+//         max_wait_time_usec: 5000
+//       }
+//     }
+//   }
+// }
+//
+// Batching cannot be combined with parallel execution, so the calculator's
+// max_in_flight must be 1. A calculator that emits a packet for an earlier
+// timestamp of the batch must not set an output timestamp offset.
+class BatchingInputStreamHandler : public DefaultInputStreamHandler {
+ public:
+  BatchingInputStreamHandler() = delete;
+  BatchingInputStreamHandler(std::shared_ptr<tool::TagMap> tag_map,
+                             CalculatorContextManager* cc_manager,
+                             const MediaPipeOptions& options,
+                             bool calculator_run_in_parallel)
+      : DefaultInputStreamHandler(std::move(tag_map), cc_manager, options,
+                                  calculator_run_in_parallel) {
+    const auto& ext =
+        options.GetExtension(BatchingInputStreamHandlerOptions::ext);
+    SetBatchSize(ext.max_batch_size());
+    max_wait_time_ = absl::Microseconds(ext.max_wait_time_usec());
+    if (max_wait_time_ > absl::ZeroDuration() && ext.max_batch_size() > 1) {
+      timer_thread_ = absl::make_unique<ThreadPool>("mediapipe_batching", 1);
+      timer_thread_->StartWorkers();
+      timer_thread_->Schedule([this] { RunTimerLoop(); });
+    }
+  }
+
+  ~BatchingInputStreamHandler() override {
+    {
+      absl::MutexLock lock(&timer_mutex_);
+      stopping_ = true;
+      timer_cond_.Signal();
+    }
+    timer_thread_.reset();
+  }
+
+  // The timer thread notifies the node outside of the graph's scheduler, so
+  // the graph run may end while a notification is still scheduling the node.
+  void CleanupAfterRun() override {
+    absl::MutexLock lock(&timer_mutex_);
+    timer_deadline_ = absl::InfiniteFuture();
+    timer_mutex_.Await(absl::Condition(
+        +[](bool* notifying) { return !*notifying; }, &notifying_));
+  }
+
+ protected:
+  void FillInputSet(Timestamp input_timestamp,
+                    InputStreamShardSet* input_set) override {
+    DefaultInputStreamHandler::FillInputSet(input_timestamp, input_set);
+    // The input timestamp has already been added to the calculator context,
+    // so a single timestamp means that a new batch has started.
+    if (calculator_context_manager_->NumberOfContextTimestamps(
+            *calculator_context_manager_->GetDefaultCalculatorContext()) != 1) {
+      return;
+    }
+    batch_deadline_ = absl::Now() + max_wait_time_;
+    if (timer_thread_) {
+      absl::MutexLock lock(&timer_mutex_);
+      timer_deadline_ = batch_deadline_;
+      timer_cond_.Signal();
+    }
+  }
+
+  bool ShouldScheduleIncompleteBatch(int num_input_sets) override {
+    return max_wait_time_ >= absl::ZeroDuration() &&
+           absl::Now() >= batch_deadline_;
+  }
+
+ private:
+  // Notifies the calculator node at each batch deadline, so that it schedules
+  // the incomplete batch, until the handler is destroyed.
+  void RunTimerLoop() {
+    absl::MutexLock lock(&timer_mutex_);
+    while (!stopping_) {
+      if (absl::Now() < timer_deadline_) {
+        timer_cond_.WaitWithDeadline(&timer_mutex_, timer_deadline_);
+        continue;
+      }
+      timer_deadline_ = absl::InfiniteFuture();
+      notifying_ = true;
+      // No locks may be held while invoking the callback.
+      timer_mutex_.Unlock();
+      notification_();
+      timer_mutex_.Lock();
+      notifying_ = false;
+    }
+  }
+
+  absl::Duration max_wait_time_;
+  // The time at which the current batch is due. Only accessed while the
+  // calculator node is scheduling, which happens on one thread at a time.
+  absl::Time batch_deadline_ = absl::InfiniteFuture();
+
+  absl::Mutex timer_mutex_;
+  absl::CondVar timer_cond_;
+  absl::Time timer_deadline_ GUARDED_BY(timer_mutex_) = absl::InfiniteFuture();
+  bool notifying_ GUARDED_BY(timer_mutex_) = false;
+  bool stopping_ GUARDED_BY(timer_mutex_) = false;
+  std::unique_ptr<ThreadPool> timer_thread_;
+};
+
+REGISTER_INPUT_STREAM_HANDLER(BatchingInputStreamHandler);
+
+}  // namespace mediapipe
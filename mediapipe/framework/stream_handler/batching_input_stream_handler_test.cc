@@ -0,0 +1,177 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/stream_handler/batching_input_stream_handler.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Blocks BatchSizeCalculator::Process() while set.
+ABSL_CONST_INIT absl::Mutex g_gate_mutex(absl::kConstInit);
+bool g_gate_closed GUARDED_BY(g_gate_mutex) = false;
+bool g_gate_waiting GUARDED_BY(g_gate_mutex) = false;
+
+// Outputs, at each input timestamp, the number of input timestamps left in
+// the batch including the current one.
+class BatchSizeCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).Set<int>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    {
+      absl::MutexLock lock(&g_gate_mutex);
+      g_gate_waiting = g_gate_closed;
+      g_gate_mutex.Await(absl::Condition(
+          +[](bool* closed) { return !*closed; }, &g_gate_closed));
+      g_gate_waiting = false;
+    }
+    cc->Outputs().Index(0).AddPacket(
+        MakePacket<int>(cc->NumRemainingInputTimestamps())
+            .At(cc->InputTimestamp()));
+    return ::mediapipe::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(BatchSizeCalculator);
+
+CalculatorGraphConfig BatchingConfig(int max_batch_size,
+                                     int64 max_wait_time_usec) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "input"
+        node {
+          calculator: "BatchSizeCalculator"
+          input_stream: "input"
+          output_stream: "output"
+          input_stream_handler {
+            input_stream_handler: "BatchingInputStreamHandler"
+          }
+        }
+      )");
+  auto* options =
+      config.mutable_node(0)
+          ->mutable_input_stream_handler()
+          ->mutable_options()
+          ->MutableExtension(BatchingInputStreamHandlerOptions::ext);
+  options->set_max_batch_size(max_batch_size);
+  options->set_max_wait_time_usec(max_wait_time_usec);
+  return config;
+}
+
+class BatchingInputStreamHandlerTest : public ::testing::Test {
+ protected:
+  void StartRun(int max_batch_size, int64 max_wait_time_usec) {
+    MP_ASSERT_OK(
+        graph_.Initialize(BatchingConfig(max_batch_size, max_wait_time_usec)));
+    MP_ASSERT_OK(graph_.ObserveOutputStream(
+        "output", [this](const Packet& packet) {
+          absl::MutexLock lock(&mutex_);
+          outputs_.push_back(packet.Get<int>());
+          return ::mediapipe::OkStatus();
+        }));
+    MP_ASSERT_OK(graph_.StartRun({}));
+  }
+
+  void AddInput(int64 timestamp) {
+    MP_ASSERT_OK(graph_.AddPacketToInputStream(
+        "input", MakePacket<int>(0).At(Timestamp(timestamp))));
+  }
+
+  void Finish() {
+    MP_ASSERT_OK(graph_.CloseAllInputStreams());
+    MP_ASSERT_OK(graph_.WaitUntilDone());
+  }
+
+  std::vector<int> Outputs() {
+    absl::MutexLock lock(&mutex_);
+    return outputs_;
+  }
+
+  CalculatorGraph graph_;
+  absl::Mutex mutex_;
+  std::vector<int> outputs_ GUARDED_BY(mutex_);
+};
+
+// Without a deadline, only full batches are passed on until the inputs are
+// done, when the last batch is followed by Timestamp::Done().
+TEST_F(BatchingInputStreamHandlerTest, WaitsForFullBatches) {
+  StartRun(3, -1);
+  for (int i = 0; i < 7; ++i) {
+    AddInput(i);
+  }
+  MP_ASSERT_OK(graph_.WaitUntilIdle());
+  EXPECT_EQ(Outputs(), std::vector<int>({3, 2, 1, 3, 2, 1}));
+  Finish();
+  EXPECT_EQ(Outputs(), std::vector<int>({3, 2, 1, 3, 2, 1, 2}));
+}
+
+// With a wait of 0, a batch holds the input sets that arrived while the
+// calculator was busy.
+TEST_F(BatchingInputStreamHandlerTest, BatchesInputsWhileBusy) {
+  StartRun(4, 0);
+  AddInput(0);
+  MP_ASSERT_OK(graph_.WaitUntilIdle());
+  EXPECT_EQ(Outputs(), std::vector<int>({1}));
+
+  {
+    absl::MutexLock lock(&g_gate_mutex);
+    g_gate_closed = true;
+  }
+  AddInput(1);
+  {
+    absl::MutexLock lock(&g_gate_mutex);
+    g_gate_mutex.Await(absl::Condition(&g_gate_waiting));
+  }
+  for (int i = 2; i < 8; ++i) {
+    AddInput(i);
+  }
+  {
+    absl::MutexLock lock(&g_gate_mutex);
+    g_gate_closed = false;
+  }
+  MP_ASSERT_OK(graph_.WaitUntilIdle());
+  EXPECT_EQ(Outputs(), std::vector<int>({1, 1, 4, 3, 2, 1, 2, 1}));
+  Finish();
+}
+
+// An incomplete batch is passed on once the wait time has passed.
+TEST_F(BatchingInputStreamHandlerTest, PassesIncompleteBatchAtDeadline) {
+  StartRun(8, 20000);
+  AddInput(0);
+  AddInput(1);
+  absl::Time give_up = absl::Now() + absl::Seconds(10);
+  while (Outputs().size() < 2 && absl::Now() < give_up) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_EQ(Outputs(), std::vector<int>({2, 1}));
+  Finish();
+  EXPECT_EQ(Outputs(), std::vector<int>({2, 1}));
+}
+
+}  // namespace
+}  // namespace mediapipe
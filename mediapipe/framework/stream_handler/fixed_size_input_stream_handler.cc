@@ -182,7 +182,7 @@ class FixedSizeInputStreamHandler : public DefaultInputStreamHandler {
   }
 
   void AddPackets(CollectionItemId id,
-                  const std::list<Packet>& packets) override {
+                  const std::vector<Packet>& packets) override {
     InputStreamHandler::AddPackets(id, packets);
     absl::MutexLock lock(&erase_mutex_);
     if (!pending_) {
@@ -190,7 +190,7 @@ class FixedSizeInputStreamHandler : public DefaultInputStreamHandler {
     }
   }
 
-  void MovePackets(CollectionItemId id, std::list<Packet>* packets) override {
+  void MovePackets(CollectionItemId id, std::vector<Packet>* packets) override {
     InputStreamHandler::MovePackets(id, packets);
     absl::MutexLock lock(&erase_mutex_);
     if (!pending_) {
@@ -13,7 +13,6 @@
 // limitations under the License.
 
 #include <functional>
-#include <list>
 #include <memory>
 #include <vector>
 
@@ -165,7 +164,7 @@ TEST_F(ImmediateInputStreamHandlerTest, EmptyPacketsNotReady) {
 // input streams has a packet available.
 TEST_F(ImmediateInputStreamHandlerTest, AnyPacketsReady) {
   Timestamp min_stream_timestamp;
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(Adopt(new std::string("packet 1")).At(Timestamp(10)));
   input_stream_handler_->AddPackets(name_to_id_["input_a"], packets);
   ASSERT_TRUE(input_stream_handler_->ScheduleInvocations(
@@ -177,7 +176,7 @@ TEST_F(ImmediateInputStreamHandlerTest, AnyPacketsReady) {
 // input streams has become done.
 TEST_F(ImmediateInputStreamHandlerTest, StreamDoneReady) {
   Timestamp min_stream_timestamp;
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
 
   // One packet arrives, ready for process.
   packets.push_back(Adopt(new std::string("packet 1")).At(Timestamp(10)));
@@ -230,7 +229,7 @@ TEST_F(ImmediateInputStreamHandlerTest, StreamDoneReady) {
 // This test checks that when any stream is done, the state is ready to close.
 TEST_F(ImmediateInputStreamHandlerTest, ReadyForClose) {
   Timestamp min_stream_timestamp;
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(Adopt(new std::string("packet 1")).At(Timestamp(1)));
   input_stream_handler_->AddPackets(name_to_id_["input_b"], packets);
   input_stream_handler_->SetNextTimestampBound(name_to_id_["input_b"],
@@ -266,7 +265,7 @@ TEST_F(ImmediateInputStreamHandlerTest, ReadyForClose) {
 // stream handler and the associated input streams.
 TEST_F(ImmediateInputStreamHandlerTest, SimulateProcessNode) {
   Timestamp min_stream_timestamp;
-  std::list<Packet> packets;
+  std::vector<Packet> packets;
   packets.push_back(Adopt(new std::string("packet 1")).At(Timestamp(10)));
   packets.push_back(Adopt(new std::string("packet 2")).At(Timestamp(30)));
   packets.push_back(Adopt(new std::string("packet 3")).At(Timestamp(40)));
@@ -14,6 +14,8 @@
 
 #include "mediapipe/framework/thread_pool_executor.h"
 
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
 #include "mediapipe/framework/port/canonical_errors.h"
@@ -71,7 +73,43 @@ namespace mediapipe {
       break;
   }
 #endif
-  return new ThreadPoolExecutor(thread_options, options.num_threads());
+  std::vector<std::set<int>> worker_groups;
+#if defined(__linux__)
+  switch (options.processor_affinity()) {
+    case ThreadPoolExecutorOptions::NUMA_NODE:
+      worker_groups = InferNumaNodeCoreIds();
+      break;
+    case ThreadPoolExecutorOptions::CACHE_DOMAIN:
+      worker_groups = InferCacheDomainCoreIds();
+      break;
+    default:
+      break;
+  }
+  if (!thread_options.cpu_set().empty()) {
+    std::vector<std::set<int>> allowed_groups;
+    for (const std::set<int>& group : worker_groups) {
+      std::set<int> allowed;
+      std::set_intersection(group.begin(), group.end(),
+                            thread_options.cpu_set().begin(),
+                            thread_options.cpu_set().end(),
+                            std::inserter(allowed, allowed.begin()));
+      if (!allowed.empty()) {
+        allowed_groups.push_back(std::move(allowed));
+      }
+    }
+    worker_groups = std::move(allowed_groups);
+  }
+  // A single group places the threads no differently than cpu_set.
+  if (worker_groups.size() < 2) {
+    worker_groups.clear();
+  }
+#endif
+  ThreadPool::SchedulingPolicy scheduling_policy =
+      options.scheduling_policy() == ThreadPoolExecutorOptions::WORK_STEALING
+          ? ThreadPool::SchedulingPolicy::kWorkStealing
+          : ThreadPool::SchedulingPolicy::kSharedQueue;
+  return new ThreadPoolExecutor(thread_options, options.num_threads(),
+                                scheduling_policy, std::move(worker_groups));
 }
 
 ThreadPoolExecutor::ThreadPoolExecutor(int num_threads)
@@ -79,13 +117,19 @@ ThreadPoolExecutor::ThreadPoolExecutor(int num_threads)
   Start();
 }
 
-ThreadPoolExecutor::ThreadPoolExecutor(const ThreadOptions& thread_options,
-                                       int num_threads)
+ThreadPoolExecutor::ThreadPoolExecutor(
+    const ThreadOptions& thread_options, int num_threads,
+    ThreadPool::SchedulingPolicy scheduling_policy,
+    std::vector<std::set<int>> worker_groups)
     : thread_pool_(thread_options,
                    thread_options.name_prefix().empty()
                        ? "mediapipe"
                        : thread_options.name_prefix(),
-                   num_threads) {
+                   num_threads, scheduling_policy),
+      num_worker_groups_(worker_groups.size()) {
+  if (!worker_groups.empty()) {
+    thread_pool_.SetWorkerGroups(std::move(worker_groups));
+  }
   Start();
 }
 
@@ -101,7 +145,8 @@ void ThreadPoolExecutor::Start() {
   stack_size_ = thread_pool_.thread_options().stack_size();
   thread_pool_.StartWorkers();
   VLOG(2) << "Started thread pool with " << thread_pool_.num_threads()
-          << " threads.";
+          << " threads in " << std::max(num_worker_groups_, 1)
+          << " processor groups.";
 }
 
 REGISTER_EXECUTOR(ThreadPoolExecutor);
@@ -15,6 +15,9 @@
 #ifndef MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
 #define MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
 
+#include <set>
+#include <vector>
+
 #include "mediapipe/framework/deps/thread_options.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/statusor.h"
@@ -36,9 +39,14 @@ class ThreadPoolExecutor : public Executor {
   int num_threads() const { return thread_pool_.num_threads(); }
   // Returns the thread stack size (in bytes).
   size_t stack_size() const { return stack_size_; }
+  // Returns the number of groups of processors the threads are pinned to, or
+  // 0 if they are not pinned to groups.
+  int num_worker_groups() const { return num_worker_groups_; }
 
  private:
-  ThreadPoolExecutor(const ThreadOptions& thread_options, int num_threads);
+  ThreadPoolExecutor(const ThreadOptions& thread_options, int num_threads,
+                     ThreadPool::SchedulingPolicy scheduling_policy,
+                     std::vector<std::set<int>> worker_groups);
 
   // Saves the value of the stack size option and starts the thread pool.
   void Start();
@@ -56,6 +64,8 @@ class ThreadPoolExecutor : public Executor {
   // size from the stack size returned by pthread_getattr_np(),
   // pthread_attr_getstacksize(), and pthread_attr_getguardsize().
   size_t stack_size_ = 0;
+
+  int num_worker_groups_ = 0;
 };
 
 }  // namespace mediapipe
@@ -168,6 +168,30 @@ std::string DebugName(const CalculatorGraphConfig& config,
   return ::mediapipe::OkStatus();
 }
 
+// Returns the name of the type the edge resolves to, after following any
+// SetSameAs() links.
+std::string ResolvedTypeName(const EdgeInfo& edge_info) {
+  if (!edge_info.packet_type) {
+    return "";
+  }
+  return edge_info.packet_type->GetSameAs()->DebugTypeName();
+}
+
+// Returns an error if the edge does not resolve to the type recorded for it
+// by ValidatedGraphConfig::Compile().
+::mediapipe::Status CheckCompiledType(const std::string& edge_kind,
+                                      const EdgeInfo& edge_info,
+                                      const std::string& compiled_type) {
+  const std::string type = ResolvedTypeName(edge_info);
+  if (type != compiled_type) {
+    return ::mediapipe::FailedPreconditionErrorBuilder(MEDIAPIPE_LOC)
+           << "The " << edge_kind << " \"" << edge_info.name
+           << "\" was compiled with type " << compiled_type
+           << " but now has type " << type << ".";
+  }
+  return ::mediapipe::OkStatus();
+}
+
 }  // namespace
 
 std::string CanonicalNodeName(const CalculatorGraphConfig& graph_config,
@@ -383,7 +407,65 @@ std::string NodeTypeInfo::NodeTypeToString(NodeType node_type) {
 
   MP_RETURN_IF_ERROR(
       PerformBasicTransforms(input_config, graph_registry, &config_));
+  MP_RETURN_IF_ERROR(InitializeFromCanonicalConfig(/*nodes_sorted=*/false));
+
+#if !defined(MEDIAPIPE_MOBILE)
+  VLOG(1) << "ValidatedGraphConfig produced canonical config:\n"
+          << config_.DebugString();
+#endif
+  initialized_ = true;
+  return ::mediapipe::OkStatus();
+}
 
+::mediapipe::Status ValidatedGraphConfig::Initialize(
+    const CompiledGraphConfig& compiled_config) {
+  RET_CHECK(!initialized_)
+      << "ValidatedGraphConfig can be initialized only once.";
+  config_ = compiled_config.config();
+  MP_RETURN_IF_ERROR(InitializeFromCanonicalConfig(/*nodes_sorted=*/true));
+
+  if (compiled_config.output_stream_type_size() != output_streams_.size() ||
+      compiled_config.output_side_packet_type_size() !=
+          output_side_packets_.size()) {
+    return ::mediapipe::FailedPreconditionErrorBuilder(MEDIAPIPE_LOC)
+           << "The compiled graph config lists types for "
+           << compiled_config.output_stream_type_size()
+           << " output streams and "
+           << compiled_config.output_side_packet_type_size()
+           << " output side packets, but the graph has "
+           << output_streams_.size() << " and " << output_side_packets_.size()
+           << ".";
+  }
+  for (int index = 0; index < output_streams_.size(); ++index) {
+    MP_RETURN_IF_ERROR(CheckCompiledType(
+        "output stream", output_streams_[index],
+        compiled_config.output_stream_type(index)));
+  }
+  for (int index = 0; index < output_side_packets_.size(); ++index) {
+    MP_RETURN_IF_ERROR(CheckCompiledType(
+        "output side packet", output_side_packets_[index],
+        compiled_config.output_side_packet_type(index)));
+  }
+  initialized_ = true;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::StatusOr<CompiledGraphConfig> ValidatedGraphConfig::Compile()
+    const {
+  RET_CHECK(initialized_) << "ValidatedGraphConfig is not initialized.";
+  CompiledGraphConfig compiled_config;
+  *compiled_config.mutable_config() = config_;
+  for (const EdgeInfo& edge_info : output_streams_) {
+    compiled_config.add_output_stream_type(ResolvedTypeName(edge_info));
+  }
+  for (const EdgeInfo& edge_info : output_side_packets_) {
+    compiled_config.add_output_side_packet_type(ResolvedTypeName(edge_info));
+  }
+  return compiled_config;
+}
+
+::mediapipe::Status ValidatedGraphConfig::InitializeFromCanonicalConfig(
+    bool nodes_sorted) {
   // Initialize the basic node information.
   MP_RETURN_IF_ERROR(InitializeGeneratorInfo());
   MP_RETURN_IF_ERROR(InitializeCalculatorInfo());
@@ -408,9 +490,10 @@ std::string NodeTypeInfo::NodeTypeToString(NodeType node_type) {
 
   // Initialize the side packet information.
   bool need_sorting = false;
-  MP_RETURN_IF_ERROR(InitializeSidePacketInfo(&need_sorting));
+  bool* need_sorting_ptr = nodes_sorted ? nullptr : &need_sorting;
+  MP_RETURN_IF_ERROR(InitializeSidePacketInfo(need_sorting_ptr));
   // Initialize the stream information.
-  MP_RETURN_IF_ERROR(InitializeStreamInfo(&need_sorting));
+  MP_RETURN_IF_ERROR(InitializeStreamInfo(need_sorting_ptr));
   if (need_sorting) {
     MP_RETURN_IF_ERROR(TopologicalSortNodes());
 
@@ -446,12 +529,6 @@ std::string NodeTypeInfo::NodeTypeToString(NodeType node_type) {
   MP_RETURN_IF_ERROR(ComputeSourceDependence());
 
   MP_RETURN_IF_ERROR(ValidateExecutors());
-
-#if !defined(MEDIAPIPE_MOBILE)
-  VLOG(1) << "ValidatedGraphConfig produced canonical config:\n"
-          << config_.DebugString();
-#endif
-  initialized_ = true;
   return ::mediapipe::OkStatus();
 }
 
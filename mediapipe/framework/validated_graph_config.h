@@ -21,11 +21,13 @@
 
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_contract.h"
+#include "mediapipe/framework/compiled_graph_config.pb.h"
 #include "mediapipe/framework/packet_generator.pb.h"
 #include "mediapipe/framework/packet_type.h"
 #include "mediapipe/framework/port/map_util.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/port/statusor.h"
 #include "mediapipe/framework/status_handler.pb.h"
 #include "mediapipe/framework/subgraph.h"
 
@@ -262,6 +264,19 @@ class ValidatedGraphConfig {
       const std::string& graph_type = "",
       const Subgraph::SubgraphOptions* arguments = nullptr);
 
+  // Initializes the ValidatedGraphConfig from the output of Compile(),
+  // without expanding subgraphs or sorting the nodes again.  Calculator
+  // contracts are still run, since packet types cannot be serialized.
+  // Returns an error if the calculators now resolve different types, e.g.
+  // if the config was compiled by a binary with different calculators.
+  ::mediapipe::Status Initialize(const CompiledGraphConfig& compiled_config);
+
+  // Returns the canonical config together with its resolved types, which
+  // can be stored and later passed to Initialize() to validate the same
+  // graph faster.  To create many graphs from the same config within one
+  // process, pass a shared ValidatedGraphConfig to CalculatorGraph instead.
+  ::mediapipe::StatusOr<CompiledGraphConfig> Compile() const;
+
   // Returns true if the ValidatedGraphConfig has been initialized.
   bool Initialized() const { return initialized_; }
 
@@ -337,6 +352,11 @@ class ValidatedGraphConfig {
   static bool IsReservedExecutorName(const std::string& name);
 
  private:
+  // Validates config_, which must already be canonical, and fills in the
+  // node and edge information.  If nodes_sorted is true, it is an error for
+  // the nodes not to be in topological order, otherwise they are sorted.
+  ::mediapipe::Status InitializeFromCanonicalConfig(bool nodes_sorted);
+
   // Initialize the PacketGenerator information.
   ::mediapipe::Status InitializeGeneratorInfo();
   // Initialize the Calculator information.
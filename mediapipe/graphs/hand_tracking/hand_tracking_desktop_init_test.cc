@@ -0,0 +1,117 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Checks and benchmarks the ways of initializing the hand_tracking_desktop
+// graph: from its config, from a compiled config, and from a shared
+// ValidatedGraphConfig.
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/compiled_graph_config.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr char kGraphPath[] =
+    "mediapipe/graphs/hand_tracking/hand_tracking_desktop.pbtxt";
+
+// Returns the hand_tracking_desktop graph config, before subgraph expansion.
+const CalculatorGraphConfig& GraphConfig() {
+  static const CalculatorGraphConfig* config = [] {
+    std::string contents;
+    MEDIAPIPE_CHECK_OK(file::GetContents(kGraphPath, &contents));
+    return new CalculatorGraphConfig(
+        ParseTextProtoOrDie<CalculatorGraphConfig>(contents));
+  }();
+  return *config;
+}
+
+// Returns the compiled hand_tracking_desktop graph config.
+const CompiledGraphConfig& CompiledConfig() {
+  static const CompiledGraphConfig* compiled_config = [] {
+    ValidatedGraphConfig validated_graph;
+    MEDIAPIPE_CHECK_OK(validated_graph.Initialize(GraphConfig()));
+    auto compiled = validated_graph.Compile();
+    MEDIAPIPE_CHECK_OK(compiled.status());
+    return new CompiledGraphConfig(std::move(compiled).ValueOrDie());
+  }();
+  return *compiled_config;
+}
+
+TEST(HandTrackingDesktopInitTest, CompiledConfigMatchesConfig) {
+  ValidatedGraphConfig validated_graph;
+  MP_ASSERT_OK(validated_graph.Initialize(GraphConfig()));
+
+  CompiledGraphConfig loaded_config;
+  ASSERT_TRUE(
+      loaded_config.ParseFromString(CompiledConfig().SerializeAsString()));
+  ValidatedGraphConfig loaded_graph;
+  MP_ASSERT_OK(loaded_graph.Initialize(loaded_config));
+  EXPECT_EQ(validated_graph.Config().SerializeAsString(),
+            loaded_graph.Config().SerializeAsString());
+  EXPECT_EQ(validated_graph.InputStreamInfos().size(),
+            loaded_graph.InputStreamInfos().size());
+  EXPECT_EQ(validated_graph.OutputStreamInfos().size(),
+            loaded_graph.OutputStreamInfos().size());
+}
+
+void BM_ValidateConfig(benchmark::State& state) {
+  const CalculatorGraphConfig& config = GraphConfig();
+  for (auto _ : state) {
+    ValidatedGraphConfig validated_graph;
+    MEDIAPIPE_CHECK_OK(validated_graph.Initialize(config));
+  }
+}
+BENCHMARK(BM_ValidateConfig);
+
+void BM_ValidateCompiledConfig(benchmark::State& state) {
+  const CompiledGraphConfig& compiled_config = CompiledConfig();
+  for (auto _ : state) {
+    ValidatedGraphConfig validated_graph;
+    MEDIAPIPE_CHECK_OK(validated_graph.Initialize(compiled_config));
+  }
+}
+BENCHMARK(BM_ValidateCompiledConfig);
+
+void BM_InitializeGraph(benchmark::State& state) {
+  const CalculatorGraphConfig& config = GraphConfig();
+  for (auto _ : state) {
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  }
+}
+BENCHMARK(BM_InitializeGraph);
+
+void BM_InitializeGraphFromSharedConfig(benchmark::State& state) {
+  auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  MEDIAPIPE_CHECK_OK(validated_graph->Initialize(GraphConfig()));
+  for (auto _ : state) {
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(validated_graph));
+  }
+}
+BENCHMARK(BM_InitializeGraphFromSharedConfig);
+
+}  // namespace
+}  // namespace mediapipe
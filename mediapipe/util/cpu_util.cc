@@ -26,6 +26,7 @@
 #include "absl/algorithm/container.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/substitute.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -65,6 +66,17 @@ constexpr uint32 kBufferLength = 64;
   }
 }
 
+// Returns the first line of the file at path, or an empty string if it cannot
+// be read.
+std::string ReadFirstLine(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  if (file.is_open()) {
+    std::getline(file, line);
+  }
+  return line;
+}
+
 std::set<int> InferLowerOrHigherCoreIds(bool lower) {
   std::vector<std::pair<int, uint64>> cpu_freq_pairs;
   for (int cpu = 0; cpu < NumCPUCores(); ++cpu) {
@@ -119,4 +131,66 @@ std::set<int> InferHigherCoreIds() {
   return InferLowerOrHigherCoreIds(/* lower= */ false);
 }
 
+std::vector<std::set<int>> InferNumaNodeCoreIds() {
+  std::vector<std::set<int>> nodes;
+  // Node ids are contiguous on all but exotic hotplug configurations; stop at
+  // the first missing node.
+  for (int node = 0;; ++node) {
+    const std::string cpu_list = ReadFirstLine(
+        absl::Substitute("/sys/devices/system/node/node$0/cpulist", node));
+    if (cpu_list.empty()) {
+      break;
+    }
+    std::set<int> cpus = ParseCpuList(cpu_list);
+    // Nodes with memory but no CPUs have nothing to pin threads to.
+    if (!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+  return nodes;
+}
+
+std::vector<std::set<int>> InferCacheDomainCoreIds() {
+  std::set<std::set<int>> domains;
+  for (int cpu = 0; cpu < NumCPUCores(); ++cpu) {
+    // The highest cache index is the last level cache.
+    std::string cpu_list;
+    for (int index = 0;; ++index) {
+      const std::string shared_cpu_list = ReadFirstLine(absl::Substitute(
+          "/sys/devices/system/cpu/cpu$0/cache/index$1/shared_cpu_list", cpu,
+          index));
+      if (shared_cpu_list.empty()) {
+        break;
+      }
+      cpu_list = shared_cpu_list;
+    }
+    std::set<int> cpus = ParseCpuList(cpu_list);
+    if (cpus.empty()) {
+      return {};
+    }
+    domains.insert(std::move(cpus));
+  }
+  return std::vector<std::set<int>>(domains.begin(), domains.end());
+}
+
+std::set<int> ParseCpuList(const std::string& cpu_list) {
+  std::set<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    std::vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    int first = 0;
+    int last = 0;
+    if (bounds.size() > 2 ||
+        !absl::SimpleAtoi(bounds.front(), &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first < 0 ||
+        last < first) {
+      return {};
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.insert(cpu);
+    }
+  }
+  return cpus;
+}
+
 }  // namespace mediapipe.
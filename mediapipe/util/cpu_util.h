@@ -16,6 +16,8 @@
 #define MEDIAPIPE_UTIL_CPU_UTIL_H_
 
 #include <set>
+#include <string>
+#include <vector>
 
 namespace mediapipe {
 // Returns the number of CPU cores. Compatible with Android.
@@ -24,6 +26,15 @@ int NumCPUCores();
 std::set<int> InferLowerCoreIds();
 // Returns a set of inferred CPU ids of higher cores.
 std::set<int> InferHigherCoreIds();
+// Returns the CPU ids of each NUMA node, as listed in /sys. Returns an empty
+// vector if the topology is unknown.
+std::vector<std::set<int>> InferNumaNodeCoreIds();
+// Returns the CPU ids of each group of cores sharing a last level cache, as
+// listed in /sys. Returns an empty vector if the topology is unknown.
+std::vector<std::set<int>> InferCacheDomainCoreIds();
+// Parses a CPU list in the format of /sys, such as "0-3,8,10-11". Returns an
+// empty set if the list is malformed.
+std::set<int> ParseCpuList(const std::string& cpu_list);
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_UTIL_CPU_UTIL_H_
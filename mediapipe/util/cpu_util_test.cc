@@ -0,0 +1,55 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/cpu_util.h"
+
+#include <set>
+#include <vector>
+
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(CpuUtilTest, ParsesCpuLists) {
+  EXPECT_EQ(std::set<int>({0}), ParseCpuList("0"));
+  EXPECT_EQ(std::set<int>({0, 1, 2, 3, 8, 10, 11}),
+            ParseCpuList("0-3,8,10-11"));
+  EXPECT_EQ(std::set<int>({4, 5}), ParseCpuList("4-5\n"));
+  EXPECT_TRUE(ParseCpuList("").empty());
+}
+
+TEST(CpuUtilTest, RejectsMalformedCpuLists) {
+  EXPECT_TRUE(ParseCpuList("a").empty());
+  EXPECT_TRUE(ParseCpuList("3-1").empty());
+  EXPECT_TRUE(ParseCpuList("1-2-3").empty());
+  EXPECT_TRUE(ParseCpuList("-1").empty());
+}
+
+// Cores belong to at most one NUMA node and one cache domain.
+TEST(CpuUtilTest, TopologyGroupsAreDisjoint) {
+  for (const auto& groups :
+       {InferNumaNodeCoreIds(), InferCacheDomainCoreIds()}) {
+    std::set<int> seen;
+    for (const std::set<int>& group : groups) {
+      EXPECT_FALSE(group.empty());
+      for (int cpu : group) {
+        EXPECT_TRUE(seen.insert(cpu).second) << cpu;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
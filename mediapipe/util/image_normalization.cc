@@ -0,0 +1,181 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/image_normalization.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the start of the source row written to destination row `row`.
+template <class T>
+const T* SourceRow(const T* src, int src_row_stride, int height, int row,
+                   bool flip_vertically) {
+  const int src_row = flip_vertically ? height - 1 - row : row;
+  return reinterpret_cast<const T*>(reinterpret_cast<const uint8*>(src) +
+                                    src_row * src_row_stride);
+}
+
+}  // namespace
+
+void NormalizeUint8Values(const uint8* src, int size, float scale,
+                          float offset, float* dst) {
+  int i = 0;
+  // The vector paths multiply and add separately, rather than fusing, so
+  // that every path rounds the same way as the scalar tail.
+#if defined(__AVX2__)
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  const __m256 offset_v = _mm256_set1_ps(offset);
+  for (; i + 8 <= size; i += 8) {
+    const __m128i bytes =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    const __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+    _mm256_storeu_ps(dst + i,
+                     _mm256_add_ps(_mm256_mul_ps(values, scale_v), offset_v));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale_v = _mm_set1_ps(scale);
+  const __m128 offset_v = _mm_set1_ps(offset);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= size; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    const __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+    const __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+    const __m128 v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+    const __m128 v3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(v0, scale_v), offset_v));
+    _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(v1, scale_v), offset_v));
+    _mm_storeu_ps(dst + i + 8, _mm_add_ps(_mm_mul_ps(v2, scale_v), offset_v));
+    _mm_storeu_ps(dst + i + 12,
+                  _mm_add_ps(_mm_mul_ps(v3, scale_v), offset_v));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t scale_v = vdupq_n_f32(scale);
+  const float32x4_t offset_v = vdupq_n_f32(offset);
+  for (; i + 16 <= size; i += 16) {
+    const uint8x16_t bytes = vld1q_u8(src + i);
+    const uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    const uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    const float32x4_t v0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(low)));
+    const float32x4_t v1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(low)));
+    const float32x4_t v2 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(high)));
+    const float32x4_t v3 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(high)));
+    vst1q_f32(dst + i, vaddq_f32(vmulq_f32(v0, scale_v), offset_v));
+    vst1q_f32(dst + i + 4, vaddq_f32(vmulq_f32(v1, scale_v), offset_v));
+    vst1q_f32(dst + i + 8, vaddq_f32(vmulq_f32(v2, scale_v), offset_v));
+    vst1q_f32(dst + i + 12, vaddq_f32(vmulq_f32(v3, scale_v), offset_v));
+  }
+#endif
+  for (; i < size; ++i) {
+    dst[i] = src[i] * scale + offset;
+  }
+}
+
+void NormalizeUint8Image(const uint8* src, int src_row_stride, int width,
+                         int height, int src_channels, int dst_channels,
+                         float scale, float offset, bool flip_vertically,
+                         float* dst) {
+  const int row_size = width * src_channels;
+  if (src_channels == dst_channels) {
+    if (!flip_vertically && src_row_stride == row_size) {
+      NormalizeUint8Values(src, row_size * height, scale, offset, dst);
+      return;
+    }
+    for (int row = 0; row < height; ++row) {
+      NormalizeUint8Values(
+          SourceRow(src, src_row_stride, height, row, flip_vertically),
+          row_size, scale, offset, dst);
+      dst += row_size;
+    }
+    return;
+  }
+  for (int row = 0; row < height; ++row) {
+    const uint8* src_pixel =
+        SourceRow(src, src_row_stride, height, row, flip_vertically);
+    for (int col = 0; col < width; ++col) {
+      for (int c = 0; c < dst_channels; ++c) {
+        *dst++ = src_pixel[c] * scale + offset;
+      }
+      src_pixel += src_channels;
+    }
+  }
+}
+
+void NormalizeFloatImage(const float* src, int src_row_stride, int width,
+                         int height, int src_channels, int dst_channels,
+                         float scale, float offset, bool flip_vertically,
+                         float* dst) {
+  for (int row = 0; row < height; ++row) {
+    const float* src_pixel =
+        SourceRow(src, src_row_stride, height, row, flip_vertically);
+    if (src_channels == dst_channels) {
+      const int row_size = width * src_channels;
+      for (int i = 0; i < row_size; ++i) {
+        dst[i] = src_pixel[i] * scale + offset;
+      }
+      dst += row_size;
+      continue;
+    }
+    for (int col = 0; col < width; ++col) {
+      for (int c = 0; c < dst_channels; ++c) {
+        *dst++ = src_pixel[c] * scale + offset;
+      }
+      src_pixel += src_channels;
+    }
+  }
+}
+
+void CopyUint8Image(const uint8* src, int src_row_stride, int width,
+                    int height, int src_channels, int dst_channels,
+                    bool flip_vertically, uint8* dst) {
+  const int row_size = width * src_channels;
+  if (src_channels == dst_channels) {
+    if (!flip_vertically && src_row_stride == row_size) {
+      std::memcpy(dst, src, row_size * height);
+      return;
+    }
+    for (int row = 0; row < height; ++row) {
+      std::memcpy(dst,
+                  SourceRow(src, src_row_stride, height, row, flip_vertically),
+                  row_size);
+      dst += row_size;
+    }
+    return;
+  }
+  for (int row = 0; row < height; ++row) {
+    const uint8* src_pixel =
+        SourceRow(src, src_row_stride, height, row, flip_vertically);
+    for (int col = 0; col < width; ++col) {
+      for (int c = 0; c < dst_channels; ++c) {
+        *dst++ = src_pixel[c];
+      }
+      src_pixel += src_channels;
+    }
+  }
+}
+
+}  // namespace mediapipe
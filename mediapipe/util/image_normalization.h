@@ -0,0 +1,54 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Kernels for turning interleaved image pixels into packed tensor data.
+// The 8-bit to float conversion uses AVX2, SSE2 or NEON when the target
+// supports it, and a scalar loop otherwise.
+#ifndef MEDIAPIPE_UTIL_IMAGE_NORMALIZATION_H_
+#define MEDIAPIPE_UTIL_IMAGE_NORMALIZATION_H_
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Writes dst[i] = src[i] * scale + offset for `size` values.
+void NormalizeUint8Values(const uint8* src, int size, float scale,
+                          float offset, float* dst);
+
+// Converts a `width` x `height` image of 8-bit pixels with `src_channels`
+// interleaved channels into packed floats value * scale + offset, keeping
+// the first `dst_channels` channels of every pixel. `src_row_stride` is in
+// bytes. Rows are written bottom-up when `flip_vertically` is true.
+void NormalizeUint8Image(const uint8* src, int src_row_stride, int width,
+                         int height, int src_channels, int dst_channels,
+                         float scale, float offset, bool flip_vertically,
+                         float* dst);
+
+// Same as NormalizeUint8Image for 32-bit float pixels. `src_row_stride` is
+// in bytes.
+void NormalizeFloatImage(const float* src, int src_row_stride, int width,
+                         int height, int src_channels, int dst_channels,
+                         float scale, float offset, bool flip_vertically,
+                         float* dst);
+
+// Copies a `width` x `height` image of 8-bit pixels into a packed buffer,
+// keeping the first `dst_channels` of the `src_channels` channels of every
+// pixel. Contiguous rows are copied with a single memcpy.
+void CopyUint8Image(const uint8* src, int src_row_stride, int width,
+                    int height, int src_channels, int dst_channels,
+                    bool flip_vertically, uint8* dst);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_IMAGE_NORMALIZATION_H_
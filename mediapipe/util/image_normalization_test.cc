@@ -0,0 +1,151 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/image_normalization.h"
+
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+namespace {
+
+// A source image with `padding` bytes at the end of every row.
+struct TestImage {
+  TestImage(int width, int height, int channels, int padding)
+      : width(width),
+        height(height),
+        channels(channels),
+        row_stride(width * channels + padding),
+        pixels(row_stride * height) {
+    for (int i = 0; i < pixels.size(); ++i) pixels[i] = (i * 37 + 11) % 256;
+  }
+
+  int width;
+  int height;
+  int channels;
+  int row_stride;
+  std::vector<uint8> pixels;
+};
+
+// The per-pixel loop that TfLiteConverterCalculator used before the kernels.
+void ReferenceNormalize(const TestImage& image, int dst_channels, float div,
+                        float sub, bool flip_vertically, float* dst) {
+  for (int i = 0; i < image.height; ++i) {
+    const uint8* src =
+        image.pixels.data() +
+        (flip_vertically ? image.height - 1 - i : i) * image.row_stride;
+    for (int j = 0; j < image.width; ++j) {
+      for (int c = 0; c < dst_channels; ++c) {
+        *dst++ = *src++ / div - sub;
+      }
+      src += image.channels - dst_channels;
+    }
+  }
+}
+
+void ExpectMatchesReference(const TestImage& image, int dst_channels,
+                            bool flip_vertically) {
+  const int size = image.width * image.height * dst_channels;
+  std::vector<float> expected(size);
+  std::vector<float> actual(size);
+  ReferenceNormalize(image, dst_channels, 127.5f, 1.0f, flip_vertically,
+                     expected.data());
+  NormalizeUint8Image(image.pixels.data(), image.row_stride, image.width,
+                      image.height, image.channels, dst_channels,
+                      1.0f / 127.5f, -1.0f, flip_vertically, actual.data());
+  for (int i = 0; i < size; ++i) {
+    ASSERT_NEAR(expected[i], actual[i], 1e-6f) << "at i = " << i;
+  }
+}
+
+TEST(ImageNormalizationTest, NormalizeContiguousRgb) {
+  ExpectMatchesReference(TestImage(37, 5, 3, /*padding=*/0), 3, false);
+}
+
+TEST(ImageNormalizationTest, NormalizePaddedFlippedRgb) {
+  ExpectMatchesReference(TestImage(37, 5, 3, /*padding=*/5), 3, true);
+}
+
+TEST(ImageNormalizationTest, NormalizeRgbaDropsAlpha) {
+  ExpectMatchesReference(TestImage(19, 4, 4, /*padding=*/0), 3, false);
+}
+
+TEST(ImageNormalizationTest, NormalizeFloatImage) {
+  const int width = 5, height = 3, channels = 2;
+  const int row_stride = (width * channels + 1) * sizeof(float);
+  std::vector<float> src(height * (width * channels + 1));
+  for (int i = 0; i < src.size(); ++i) src[i] = i;
+  std::vector<float> dst(width * height);
+  NormalizeFloatImage(src.data(), row_stride, width, height, channels,
+                      /*dst_channels=*/1, 2.0f, 1.0f,
+                      /*flip_vertically=*/true, dst.data());
+  for (int row = 0; row < height; ++row) {
+    for (int col = 0; col < width; ++col) {
+      const float value = src[(height - 1 - row) * (width * channels + 1) +
+                              col * channels];
+      EXPECT_EQ(value * 2.0f + 1.0f, dst[row * width + col]);
+    }
+  }
+}
+
+TEST(ImageNormalizationTest, CopyUint8Image) {
+  TestImage image(7, 3, 4, /*padding=*/3);
+  std::vector<uint8> dst(7 * 3 * 3);
+  CopyUint8Image(image.pixels.data(), image.row_stride, image.width,
+                 image.height, image.channels, /*dst_channels=*/3,
+                 /*flip_vertically=*/false, dst.data());
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 7; ++col) {
+      for (int c = 0; c < 3; ++c) {
+        EXPECT_EQ(image.pixels[row * image.row_stride + col * 4 + c],
+                  dst[(row * 7 + col) * 3 + c]);
+      }
+    }
+  }
+}
+
+void BM_NormalizeRgbReference(benchmark::State& state) {
+  TestImage image(state.range(0), state.range(1), 3, /*padding=*/0);
+  std::vector<float> dst(image.width * image.height * 3);
+  for (auto _ : state) {
+    ReferenceNormalize(image, 3, 127.5f, 1.0f, false, dst.data());
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * image.pixels.size());
+}
+
+void BM_NormalizeRgb(benchmark::State& state) {
+  TestImage image(state.range(0), state.range(1), 3, /*padding=*/0);
+  std::vector<float> dst(image.width * image.height * 3);
+  for (auto _ : state) {
+    NormalizeUint8Image(image.pixels.data(), image.row_stride, image.width,
+                        image.height, 3, 3, 1.0f / 127.5f, -1.0f, false,
+                        dst.data());
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * image.pixels.size());
+}
+
+void ImageSizeArgs(benchmark::internal::Benchmark* b) {
+  b->Args({224, 224})->Args({320, 320})->Args({640, 480});
+}
+
+BENCHMARK(BM_NormalizeRgbReference)->Apply(ImageSizeArgs);
+BENCHMARK(BM_NormalizeRgb)->Apply(ImageSizeArgs);
+
+}  // namespace
+}  // namespace mediapipe
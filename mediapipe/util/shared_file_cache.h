@@ -0,0 +1,153 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_SHARED_FILE_CACHE_H_
+#define MEDIAPIPE_UTIL_SHARED_FILE_CACHE_H_
+
+#include <sys/stat.h>
+
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// Shares read-only objects loaded from files, such as models, between all
+// their users. An object is loaded once per file path, modification time,
+// file size and variant, where the variant describes any other setting the
+// object depends on. The cache only holds weak references: an object is
+// freed once its last user releases it, and a file that changed on disk is
+// loaded again by the next lookup.
+//
+// Typically one cache per object type is shared by the whole process:
+//
+//   SharedFileCache<Model>* ModelCache() {
+//     static auto* cache = new SharedFileCache<Model>();
+//     return cache;
+//   }
+//
+// This class is thread-safe.
+template <typename T>
+class SharedFileCache {
+ public:
+  using Loader = std::function<::mediapipe::StatusOr<std::unique_ptr<T>>()>;
+
+  SharedFileCache() = default;
+  SharedFileCache(const SharedFileCache&) = delete;
+  SharedFileCache& operator=(const SharedFileCache&) = delete;
+
+  // Returns the object for the current version of the file at `path` and
+  // for `variant`. If no user holds it, calls `load` to load it. Concurrent
+  // lookups of the same object wait for a single load, while objects for
+  // other keys load in parallel.
+  ::mediapipe::StatusOr<std::shared_ptr<T>> Get(const std::string& path,
+                                                const std::string& variant,
+                                                const Loader& load);
+
+  // Returns the number of objects currently held by some user.
+  int NumObjects() LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // The path, modification time, size and variant of an object.
+  using Key = std::tuple<std::string, int64, int64, std::string>;
+
+  struct Entry {
+    absl::Mutex mutex;
+    std::weak_ptr<T> object GUARDED_BY(mutex);
+  };
+
+  // Drops the entries that are neither held nor being looked up.
+  void RemoveUnusedEntries() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  std::map<Key, std::shared_ptr<Entry>> entries_ GUARDED_BY(mutex_);
+};
+
+template <typename T>
+::mediapipe::StatusOr<std::shared_ptr<T>> SharedFileCache<T>::Get(
+    const std::string& path, const std::string& variant, const Loader& load) {
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    return ::mediapipe::NotFoundError(
+        absl::StrCat("Cannot read the file: ", path));
+  }
+  const Key key(path, static_cast<int64>(file_stat.st_mtime),
+                static_cast<int64>(file_stat.st_size), variant);
+
+  std::shared_ptr<Entry> entry;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      RemoveUnusedEntries();
+      it = entries_.emplace(key, std::make_shared<Entry>()).first;
+    }
+    entry = it->second;
+  }
+
+  absl::MutexLock lock(&entry->mutex);
+  std::shared_ptr<T> object = entry->object.lock();
+  if (!object) {
+    ::mediapipe::StatusOr<std::unique_ptr<T>> loaded = load();
+    if (!loaded.ok()) {
+      return loaded.status();
+    }
+    object = std::move(loaded).ValueOrDie();
+    entry->object = object;
+  }
+  return object;
+}
+
+template <typename T>
+int SharedFileCache<T>::NumObjects() {
+  absl::MutexLock lock(&mutex_);
+  int num_objects = 0;
+  for (const auto& key_entry : entries_) {
+    absl::MutexLock entry_lock(&key_entry.second->mutex);
+    if (!key_entry.second->object.expired()) {
+      ++num_objects;
+    }
+  }
+  return num_objects;
+}
+
+template <typename T>
+void SharedFileCache<T>::RemoveUnusedEntries() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    // Lookups copy the entry while holding mutex_, so an entry that only the
+    // map refers to cannot be in use.
+    bool unused = it->second.use_count() == 1;
+    if (unused) {
+      absl::MutexLock entry_lock(&it->second->mutex);
+      unused = it->second->object.expired();
+    }
+    it = unused ? entries_.erase(it) : std::next(it);
+  }
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_SHARED_FILE_CACHE_H_
@@ -0,0 +1,154 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/shared_file_cache.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+std::string TestPath(const std::string& name) {
+  const char* dir = std::getenv("TEST_TMPDIR");
+  return absl::StrCat(dir ? dir : "/tmp", "/", name);
+}
+
+// Returns a loader that reads the file at `path` and counts its calls.
+SharedFileCache<std::string>::Loader ContentsLoader(const std::string& path,
+                                                    std::atomic<int>* loads) {
+  return [path,
+          loads]() -> ::mediapipe::StatusOr<std::unique_ptr<std::string>> {
+    ++*loads;
+    auto contents = absl::make_unique<std::string>();
+    MP_RETURN_IF_ERROR(file::GetContents(path, contents.get()));
+    return std::move(contents);
+  };
+}
+
+TEST(SharedFileCacheTest, SharesObjectsWhileHeld) {
+  const std::string path = TestPath("shared_file_cache_shares");
+  MP_ASSERT_OK(file::SetContents(path, "model"));
+  SharedFileCache<std::string> cache;
+  std::atomic<int> loads(0);
+
+  auto first = cache.Get(path, "", ContentsLoader(path, &loads));
+  auto second = cache.Get(path, "", ContentsLoader(path, &loads));
+  MP_ASSERT_OK(first);
+  MP_ASSERT_OK(second);
+  EXPECT_EQ("model", *first.ValueOrDie());
+  EXPECT_EQ(first.ValueOrDie(), second.ValueOrDie());
+  EXPECT_EQ(1, loads);
+  EXPECT_EQ(1, cache.NumObjects());
+
+  // A different variant is a different object.
+  auto other = cache.Get(path, "other", ContentsLoader(path, &loads));
+  MP_ASSERT_OK(other);
+  EXPECT_NE(first.ValueOrDie(), other.ValueOrDie());
+  EXPECT_EQ(2, loads);
+  EXPECT_EQ(2, cache.NumObjects());
+}
+
+TEST(SharedFileCacheTest, ReleasesUnusedObjects) {
+  const std::string path = TestPath("shared_file_cache_releases");
+  MP_ASSERT_OK(file::SetContents(path, "model"));
+  SharedFileCache<std::string> cache;
+  std::atomic<int> loads(0);
+
+  MP_ASSERT_OK(cache.Get(path, "", ContentsLoader(path, &loads)));
+  EXPECT_EQ(0, cache.NumObjects());
+  MP_ASSERT_OK(cache.Get(path, "", ContentsLoader(path, &loads)));
+  EXPECT_EQ(2, loads);
+}
+
+TEST(SharedFileCacheTest, ReloadsChangedFiles) {
+  const std::string path = TestPath("shared_file_cache_reloads");
+  MP_ASSERT_OK(file::SetContents(path, "model"));
+  SharedFileCache<std::string> cache;
+  std::atomic<int> loads(0);
+
+  auto old_model = cache.Get(path, "", ContentsLoader(path, &loads));
+  MP_ASSERT_OK(old_model);
+  MP_ASSERT_OK(file::SetContents(path, "new model"));
+  auto new_model = cache.Get(path, "", ContentsLoader(path, &loads));
+  MP_ASSERT_OK(new_model);
+  EXPECT_EQ("model", *old_model.ValueOrDie());
+  EXPECT_EQ("new model", *new_model.ValueOrDie());
+  EXPECT_EQ(2, loads);
+}
+
+TEST(SharedFileCacheTest, ReportsErrors) {
+  SharedFileCache<std::string> cache;
+  std::atomic<int> loads(0);
+  const std::string missing = TestPath("shared_file_cache_missing");
+  EXPECT_EQ(::mediapipe::StatusCode::kNotFound,
+            cache.Get(missing, "", ContentsLoader(missing, &loads))
+                .status()
+                .code());
+  EXPECT_EQ(0, loads);
+
+  const std::string path = TestPath("shared_file_cache_errors");
+  MP_ASSERT_OK(file::SetContents(path, "model"));
+  auto result = cache.Get(
+      path, "", []() -> ::mediapipe::StatusOr<std::unique_ptr<std::string>> {
+        return ::mediapipe::InvalidArgumentError("bad model");
+      });
+  EXPECT_EQ(::mediapipe::StatusCode::kInvalidArgument,
+            result.status().code());
+  EXPECT_EQ(0, cache.NumObjects());
+}
+
+TEST(SharedFileCacheTest, LoadsOnceForConcurrentLookups) {
+  constexpr int kNumLookups = 8;
+  const std::string path = TestPath("shared_file_cache_concurrent");
+  MP_ASSERT_OK(file::SetContents(path, "model"));
+  SharedFileCache<std::string> cache;
+  std::atomic<int> loads(0);
+  SharedFileCache<std::string>::Loader slow_load = [&path, &loads]() {
+    absl::SleepFor(absl::Milliseconds(50));
+    return ContentsLoader(path, &loads)();
+  };
+
+  std::vector<std::shared_ptr<std::string>> models(kNumLookups);
+  {
+    ThreadPool pool("shared_file_cache_test", kNumLookups);
+    pool.StartWorkers();
+    for (int i = 0; i < kNumLookups; ++i) {
+      pool.Schedule([&cache, &path, &slow_load, &models, i]() {
+        models[i] = cache.Get(path, "", slow_load).ValueOrDie();
+      });
+    }
+  }
+  EXPECT_EQ(1, loads);
+  for (const auto& model : models) {
+    EXPECT_EQ(models[0], model);
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
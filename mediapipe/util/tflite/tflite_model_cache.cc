@@ -0,0 +1,47 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tflite/tflite_model_cache.h"
+
+#include <utility>
+
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/shared_file_cache.h"
+
+namespace mediapipe {
+
+namespace {
+
+SharedFileCache<const tflite::FlatBufferModel>* ModelCache() {
+  static auto* cache = new SharedFileCache<const tflite::FlatBufferModel>();
+  return cache;
+}
+
+}  // namespace
+
+::mediapipe::StatusOr<std::shared_ptr<const tflite::FlatBufferModel>>
+GetSharedTfLiteModel(const std::string& model_path) {
+  return ModelCache()->Get(
+      model_path, /*variant=*/"",
+      [&model_path]() -> ::mediapipe::StatusOr<
+                          std::unique_ptr<const tflite::FlatBufferModel>> {
+        std::unique_ptr<tflite::FlatBufferModel> model =
+            tflite::FlatBufferModel::BuildFromFile(model_path.c_str());
+        RET_CHECK(model) << "Failed to load TF Lite model " << model_path;
+        return std::unique_ptr<const tflite::FlatBufferModel>(
+            std::move(model));
+      });
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,37 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_TFLITE_TFLITE_MODEL_CACHE_H_
+#define MEDIAPIPE_UTIL_TFLITE_TFLITE_MODEL_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/port/statusor.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+// Returns the TF Lite model in the file at `model_path`. The file is
+// memory-mapped by FlatBufferModel::BuildFromFile once per process, and the
+// model is shared by every calculator and graph that loads the same version
+// of the file while any of them holds it. Interpreters read the weights of
+// the model from the mapping, so N pipelines running the same model keep one
+// copy of its weights resident.
+::mediapipe::StatusOr<std::shared_ptr<const tflite::FlatBufferModel>>
+GetSharedTfLiteModel(const std::string& model_path);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TFLITE_TFLITE_MODEL_CACHE_H_